@@ -9,5 +9,24 @@ SET( GTEST_DIR ${EXTERNAL_LIBS_DIR}/gtest-1.7.0/lib )
 INCLUDE_DIRECTORIES( /opt/intel/mkl/include )
 SET( MKL_LIB_DIR /opt/intel/mkl/lib/intel64 )
 
+# SIMD instruction set for vectorized kernels (e.g. "-mavx2 -mfma" or "-mavx512f"):
+SET( CEM_SIMD_FLAGS "" CACHE STRING "Compiler flags selecting the SIMD instruction set" )
+IF( CEM_SIMD_FLAGS )
+    STRING( REPLACE " ${CEM_SIMD_FLAGS}" "" CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS}" )
+    SET( CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${CEM_SIMD_FLAGS}" )
+ENDIF( )
+
+# OpenMP threading of element loops (the code runs serially without it):
+OPTION( CEM_USE_OPENMP "Thread element loops with OpenMP" ON )
+IF( CEM_USE_OPENMP )
+    FIND_PACKAGE( OpenMP )
+    IF( OPENMP_FOUND )
+        STRING( REPLACE " ${OpenMP_CXX_FLAGS}" "" CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS}" )
+        SET( CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${OpenMP_CXX_FLAGS}" )
+        SET( CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} ${OpenMP_CXX_FLAGS}" )
+        SET( CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} ${OpenMP_CXX_FLAGS}" )
+    ENDIF( )
+ENDIF( )
+
 
 #EOF
@@ -22,3 +22,17 @@ void cemcommon::Exception::PrintException() const
     std::cerr << "** Error ("<<tag_<<") **\n";
     std::cerr << "Problem: " << problem_ << "\n\n";
 }
+
+
+//************************************************************************************************//
+/** @brief cemcommon::Exception::tag : Gets short string tag of the error.
+ * @return : tag_ */
+//************************************************************************************************//
+const std::string& cemcommon::Exception::tag() const {return tag_;}
+
+
+//************************************************************************************************//
+/** @brief cemcommon::Exception::problem : Gets description of the error.
+ * @return : problem_ */
+//************************************************************************************************//
+const std::string& cemcommon::Exception::problem() const {return problem_;}
@@ -20,6 +20,8 @@ public:
     Exception(std::string tag_string, std::string prob_string);
 
     void PrintException() const;
+    const std::string& tag() const;
+    const std::string& problem() const;
 
 private:
     std::string tag_;       /**< Short string tag for the error message. */
@@ -1,10 +1,10 @@
 #include "BasisFunctions.h"
 #include "cemError.h"
-#include "SpecialFunctions/MiscFunctions.h"
 
 
 using cem_core::ShapeFunction;
 using cem_core::TriShapeFunction;
+using cem_core::TriHierarchicalShapeFunction;
 using cemcommon::Exception;
 
 
@@ -23,6 +23,7 @@ ShapeFunction::ShapeFunction(const cemINT& order)
         throw(Exception("INPUT ERROR","ShapeFunction's order must be >= 1"));
 
     order_ = order;
+    setUpFactorials();
 }
 
 
@@ -37,7 +38,11 @@ cemINT ShapeFunction::order() const {return order_;}
 /** @brief ShapeFunction::set_order : Sets polynomial order of ShapeFunction.
  * @param [in] order : polynomial order */
 //************************************************************************************************//
-void ShapeFunction::set_order(const cemINT &order) {order_ = order;}
+void ShapeFunction::set_order(const cemINT &order)
+{
+    order_ = order;
+    setUpFactorials();
+}
 
 
 
@@ -58,19 +63,11 @@ void ShapeFunction::set_order(const cemINT &order) {order_ = order;}
 cemDOUBLE ShapeFunction::SilvesterPolynomial(const cemINT& index,
                                              const cemDOUBLE& ksi) const
 {
-    if (index > order_)
+    if (index < 0 || index > order_)
         throw(Exception("INPUT ERROR","index must be <= order_"));
 
-    cemDOUBLE poly = 1.0;
-
-    if (index > 0)
-    {
-        for (cemINT p=0; p<index; ++p)
-        {
-            poly *= order_*ksi - p;
-        }
-        poly /= cem_math::Factorial(index);
-    }
+    cemDOUBLE poly;
+    EvaluateSilvester(index,1,&ksi,&poly,NULL);
 
     return poly;
 }
@@ -90,28 +87,108 @@ cemDOUBLE ShapeFunction::SilvesterPolynomial(const cemINT& index,
 cemDOUBLE ShapeFunction::SilvesterPolynomialDeriv(const cemINT &index,
                                                   const cemDOUBLE &ksi) const
 {
-    if (index > order_)
+    if (index < 0 || index > order_)
+        throw(Exception("INPUT ERROR","index must be <= order_"));
+
+    cemDOUBLE poly,deriv;
+    EvaluateSilvester(index,1,&ksi,&poly,&deriv);
+
+    return deriv;
+}
+
+
+//************************************************************************************************//
+/** @brief ShapeFunction::SilvesterPolynomials : Evaluates Silvester Polynomial and its derivative
+ * at several points.
+ *
+ * The index is checked once for all points.
+ * @param [in] index : index \f$m\f$ of the polynomial to evaluate (0 <= index <= order)
+ * @param [in] num_points : number of points
+ * @param [in] ksi : points in real line \f$\xi\f$ in which to evaluate the polynomial
+ * @param [out] values : \f$ P_{m}^{N}(\xi) \f$ at each point
+ * @param [out] derivs : \f$ \frac{d}{d\xi}P_{m}^{N}(\xi) \f$ at each point (or NULL) */
+//************************************************************************************************//
+void ShapeFunction::SilvesterPolynomials(const cemINT& index,
+                                         const cemINT& num_points,
+                                         const cemDOUBLE* ksi,
+                                         cemDOUBLE* values,
+                                         cemDOUBLE* derivs) const
+{
+    if (index < 0 || index > order_)
         throw(Exception("INPUT ERROR","index must be <= order_"));
 
-    cemDOUBLE deriv = 0.0;
+    EvaluateSilvester(index,num_points,ksi,values,derivs);
+}
+
+
+//************************************************************************************************//
+/** @brief ShapeFunction::EvaluateSilvester : Evaluates Silvester Polynomial (and its derivative)
+ * at several points, without checking the index.
+ *
+ * Both are built in one recurrence over the factors \f$ (u-p) \f$, \f$ u = N\xi \f$ (product
+ * rule for the derivative), and divided by the precomputed \f$ m! \f$ at the end. This costs
+ * O(m) per point instead of O(m^2), keeps the zeros and the unity value exact, and unlike Horner
+ * on the expanded polynomial does not lose accuracy near the zeros. The loop over points is the
+ * innermost one, so that the compiler can vectorize it.
+ * @param [in] index : index \f$m\f$ of the polynomial to evaluate (0 <= index <= order)
+ * @param [in] num_points : number of points
+ * @param [in] ksi : points in real line \f$\xi\f$ in which to evaluate the polynomial
+ * @param [out] values : \f$ P_{m}^{N}(\xi) \f$ at each point
+ * @param [out] derivs : \f$ \frac{d}{d\xi}P_{m}^{N}(\xi) \f$ at each point (or NULL) */
+//************************************************************************************************//
+void ShapeFunction::EvaluateSilvester(const cemINT& index,
+                                      const cemINT& num_points,
+                                      const cemDOUBLE* ksi,
+                                      cemDOUBLE* values,
+                                      cemDOUBLE* derivs) const
+{
+    const cemDOUBLE N = order_;
+    const cemDOUBLE factorial = factorials_[index];
+
+    for (cemINT t=0; t<num_points; ++t)
+        values[t] = 1.0;
 
-    if (index > 0)
+    if (derivs == NULL)
     {
-        for (cemINT j=0; j<index; ++j)
+        for (cemINT p=0; p<index; ++p)
         {
-            cemDOUBLE poly = 1.0;
-            for (cemINT p=0; p<index; ++p)
-            {
-                if (p != j)
-                    poly *= order_*ksi - p;
-            }
-            deriv += poly;
+            for (cemINT t=0; t<num_points; ++t)
+                values[t] *= N*ksi[t] - p;
         }
-        deriv *= order_;
-        deriv /= cem_math::Factorial(index);
+        for (cemINT t=0; t<num_points; ++t)
+            values[t] /= factorial;
+        return;
     }
 
-    return deriv;
+    for (cemINT t=0; t<num_points; ++t)
+        derivs[t] = 0.0;
+
+    for (cemINT p=0; p<index; ++p)
+    {
+        for (cemINT t=0; t<num_points; ++t)
+        {
+            cemDOUBLE factor = N*ksi[t] - p;
+            derivs[t] = derivs[t]*factor + values[t];
+            values[t] *= factor;
+        }
+    }
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        values[t] /= factorial;
+        derivs[t] = N*derivs[t]/factorial;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief ShapeFunction::setUpFactorials : Computes the normalization factor \f$ m! \f$ of every
+ * Silvester Polynomial of order order_. */
+//************************************************************************************************//
+void ShapeFunction::setUpFactorials()
+{
+    factorials_.assign(order_ < 0 ? 1 : order_+1,1.0);
+    for (cemINT m=1; m<static_cast<cemINT>(factorials_.size()); ++m)
+        factorials_[m] = m*factorials_[m-1];
 }
 
 
@@ -250,8 +327,8 @@ std::vector<cemDOUBLE> TriShapeFunction::Evaluate(const cemINT& index_i,
     std::vector<cemDOUBLE> result;
     result.resize(N);
 
-    for (cemINT i=0; i<N; ++i)
-        result[i] = Evaluate(index_i,index_j,index_k,ksi[i],eta[i]);
+    if (N > 0)
+        EvaluateBatch(index_i,index_j,index_k,N,&ksi[0],&eta[0],&result[0],NULL,NULL);
 
     return result;
 }
@@ -288,8 +365,8 @@ std::vector<cemDOUBLE> TriShapeFunction::EvaluateKsiDeriv(const cemINT &index_i,
     std::vector<cemDOUBLE> result;
     result.resize(N);
 
-    for (cemINT i=0; i<N; ++i)
-        result[i] = EvaluateKsiDeriv(index_i,index_j,index_k,ksi[i],eta[i]);
+    if (N > 0)
+        EvaluateBatch(index_i,index_j,index_k,N,&ksi[0],&eta[0],NULL,&result[0],NULL);
 
     return result;
 }
@@ -326,15 +403,233 @@ std::vector<cemDOUBLE> TriShapeFunction::EvaluateEtaDeriv(const cemINT &index_i,
     std::vector<cemDOUBLE> result;
     result.resize(N);
 
-    for (cemINT i=0; i<N; ++i)
-        result[i] = EvaluateEtaDeriv(index_i,index_j,index_k,ksi[i],eta[i]);
+    if (N > 0)
+        EvaluateBatch(index_i,index_j,index_k,N,&ksi[0],&eta[0],NULL,NULL,&result[0]);
 
     return result;
 }
 
 
+//************************************************************************************************//
+/** @brief TriShapeFunction::EvaluateBatch : Evaluates shape function and its derivatives at
+ * several points in the unit-triangle.
+ *
+ * The three Silvester Polynomials and their derivatives are evaluated once per point, for
+ * blocks of BLOCK_SIZE points, and combined into the function and both derivatives. Indices are
+ * checked once for all points. Any of the outputs may be NULL if it is not needed.
+ * @param [in] index_i : index \f$I\f$ for the Silvester Polynomial in \f$\xi\f$
+ * @param [in] index_j : index \f$J\f$ for the Silvester Polynomial in \f$\eta\f$
+ * @param [in] index_k : index \f$K\f$ for the Silvester Polynomial in \f$1-\xi-\eta\f$
+ * @param [in] num_points : number of points
+ * @param [in] ksi : points in the \f$\xi\f$ axis in which to evaluate
+ * @param [in] eta : points in the \f$\eta\f$ axis in which to evaluate
+ * @param [out] values : \f$ N_{i}(\xi,\eta) \f$ at each point (or NULL)
+ * @param [out] ksi_derivs : \f$ \frac{\partial}{\partial\xi}N_{i}(\xi,\eta) \f$ at each point (or NULL)
+ * @param [out] eta_derivs : \f$ \frac{\partial}{\partial\eta}N_{i}(\xi,\eta) \f$ at each point (or NULL) */
+//************************************************************************************************//
+void TriShapeFunction::EvaluateBatch(const cemINT& index_i,
+                                     const cemINT& index_j,
+                                     const cemINT& index_k,
+                                     const cemINT& num_points,
+                                     const cemDOUBLE* ksi,
+                                     const cemDOUBLE* eta,
+                                     cemDOUBLE* values,
+                                     cemDOUBLE* ksi_derivs,
+                                     cemDOUBLE* eta_derivs) const
+{
+    if (index_i < 0 || index_j < 0 || index_k < 0)
+        throw(Exception("INPUT ERROR","Indices must be >= 0"));
 
+    if (index_i + index_j + index_k > order_)
+        throw(Exception("INPUT ERROR","Sum of indices must be <= order"));
+
+    cemBOOL need_derivs = (ksi_derivs != NULL || eta_derivs != NULL);
+    cemDOUBLE zeta[BLOCK_SIZE];
+    cemDOUBLE P_i[BLOCK_SIZE], P_j[BLOCK_SIZE], P_k[BLOCK_SIZE];
+    cemDOUBLE dP_i[BLOCK_SIZE], dP_j[BLOCK_SIZE], dP_k[BLOCK_SIZE];
+
+    for (cemINT first=0; first<num_points; first+=BLOCK_SIZE)
+    {
+        cemINT n = num_points - first;
+        if (n > BLOCK_SIZE)
+            n = BLOCK_SIZE;
+
+        const cemDOUBLE* x = ksi + first;
+        const cemDOUBLE* y = eta + first;
+        for (cemINT t=0; t<n; ++t)
+            zeta[t] = 1.0 - x[t] - y[t];
+
+        EvaluateSilvester(index_i,n,x,P_i,need_derivs ? dP_i : NULL);
+        EvaluateSilvester(index_j,n,y,P_j,need_derivs ? dP_j : NULL);
+        EvaluateSilvester(index_k,n,zeta,P_k,need_derivs ? dP_k : NULL);
+
+        if (values != NULL)
+        {
+            for (cemINT t=0; t<n; ++t)
+                values[first+t] = P_i[t]*P_j[t]*P_k[t];
+        }
+        if (ksi_derivs != NULL)
+        {
+            for (cemINT t=0; t<n; ++t)
+                ksi_derivs[first+t] = P_j[t]*(dP_i[t]*P_k[t] - P_i[t]*dP_k[t]);
+        }
+        if (eta_derivs != NULL)
+        {
+            for (cemINT t=0; t<n; ++t)
+                eta_derivs[first+t] = P_i[t]*(dP_j[t]*P_k[t] - P_j[t]*dP_k[t]);
+        }
+    }
+}
 
 
 
+///***********************************************************************************************//
+/// CLASS TriHierarchicalShapeFunction:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TriHierarchicalShapeFunction::NumFunctions : Gets number of functions of an order.
+ * @param [in] order : polynomial order
+ * @return : (order+1)(order+2)/2 */
+//************************************************************************************************//
+cemINT TriHierarchicalShapeFunction::NumFunctions(const cemINT& order)
+{
+    return (order+1)*(order+2)/2;
+}
+
+
+//************************************************************************************************//
+/** @brief TriHierarchicalShapeFunction::Degree : Gets polynomial degree of a function.
+ * @param [in] index : index of the function (>= 0)
+ * @return : lowest order whose functions include this one */
+//************************************************************************************************//
+cemINT TriHierarchicalShapeFunction::Degree(const cemINT& index)
+{
+    cemINT degree = 1;
+    while (NumFunctions(degree) <= index)
+        ++degree;
+
+    return degree;
+}
 
+
+//************************************************************************************************//
+/** @brief TriHierarchicalShapeFunction::EvaluateBatch : Evaluates a hierarchical function and its
+ * derivatives at several points in the unit-triangle.
+ *
+ * The value of a function does not depend on the order of the element, only on its index. Any
+ * of the outputs may be NULL if it is not needed.
+ * @param [in] index : index of the function (>= 0)
+ * @param [in] num_points : number of points
+ * @param [in] ksi : points in the \f$\xi\f$ axis in which to evaluate
+ * @param [in] eta : points in the \f$\eta\f$ axis in which to evaluate
+ * @param [out] values : function at each point (or NULL)
+ * @param [out] ksi_derivs : \f$\xi\f$-derivative at each point (or NULL)
+ * @param [out] eta_derivs : \f$\eta\f$-derivative at each point (or NULL) */
+//************************************************************************************************//
+void TriHierarchicalShapeFunction::EvaluateBatch(const cemINT& index,
+                                                 const cemINT& num_points,
+                                                 const cemDOUBLE* ksi,
+                                                 const cemDOUBLE* eta,
+                                                 cemDOUBLE* values,
+                                                 cemDOUBLE* ksi_derivs,
+                                                 cemDOUBLE* eta_derivs)
+{
+    if (index < 0)
+        throw(Exception("INPUT ERROR","index must be >= 0"));
+
+    // Derivatives of the barycentric coordinates:
+    const cemDOUBLE dL_dksi[3] = {1.0, 0.0, -1.0};
+    const cemDOUBLE dL_deta[3] = {0.0, 1.0, -1.0};
+
+    // Kind of function (vertex, edge or interior):
+    cemINT degree = Degree(index);
+    cemINT local = index - NumFunctions(degree-1);
+    if (degree == 1)
+        local = index;
+
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        cemDOUBLE L[3] = {ksi[t], eta[t], 1.0 - ksi[t] - eta[t]};
+        cemDOUBLE f, f_ksi, f_eta;
+
+        if (degree == 1)
+        {
+            f = L[local];
+            f_ksi = dL_dksi[local];
+            f_eta = dL_deta[local];
+        }
+        else if (local < 3)
+        {
+            // Edge (a,b): L_a L_b L'_{k-1}(L_b - L_a):
+            cemINT a = local;
+            cemINT b = (local+1)%3;
+            cemDOUBLE P, dP, d2P;
+            Legendre(degree-1,L[b]-L[a],P,dP,d2P);
+            f = L[a]*L[b]*dP;
+            f_ksi = (dL_dksi[a]*L[b] + L[a]*dL_dksi[b])*dP +
+                    L[a]*L[b]*d2P*(dL_dksi[b] - dL_dksi[a]);
+            f_eta = (dL_deta[a]*L[b] + L[a]*dL_deta[b])*dP +
+                    L[a]*L[b]*d2P*(dL_deta[b] - dL_deta[a]);
+        }
+        else
+        {
+            // Interior: L_0 L_1 L_2 P_i(L_1 - L_0) P_j(2 L_2 - 1):
+            cemINT i = local - 3;
+            cemINT j = degree - 3 - i;
+            cemDOUBLE P_i, dP_i, P_j, dP_j, unused;
+            Legendre(i,L[1]-L[0],P_i,dP_i,unused);
+            Legendre(j,2.0*L[2]-1.0,P_j,dP_j,unused);
+            cemDOUBLE bubble = L[0]*L[1]*L[2];
+            cemDOUBLE bubble_ksi = dL_dksi[0]*L[1]*L[2] + L[0]*dL_dksi[1]*L[2] + L[0]*L[1]*dL_dksi[2];
+            cemDOUBLE bubble_eta = dL_deta[0]*L[1]*L[2] + L[0]*dL_deta[1]*L[2] + L[0]*L[1]*dL_deta[2];
+            f = bubble*P_i*P_j;
+            f_ksi = bubble_ksi*P_i*P_j + bubble*(dP_i*(dL_dksi[1] - dL_dksi[0])*P_j +
+                                                 P_i*dP_j*2.0*dL_dksi[2]);
+            f_eta = bubble_eta*P_i*P_j + bubble*(dP_i*(dL_deta[1] - dL_deta[0])*P_j +
+                                                 P_i*dP_j*2.0*dL_deta[2]);
+        }
+
+        if (values != NULL)
+            values[t] = f;
+        if (ksi_derivs != NULL)
+            ksi_derivs[t] = f_ksi;
+        if (eta_derivs != NULL)
+            eta_derivs[t] = f_eta;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief TriHierarchicalShapeFunction::Legendre : Evaluates a Legendre polynomial and its first
+ * two derivatives, with the three-term recurrence and
+ * \f$ L'_{n+1} = L'_{n-1} + (2n+1) L_n \f$.
+ * @param [in] degree : degree of the polynomial (>= 0)
+ * @param [in] x : point in [-1,1]
+ * @param [out] P : \f$ L_n(x) \f$
+ * @param [out] dP : \f$ L'_n(x) \f$
+ * @param [out] d2P : \f$ L''_n(x) \f$ */
+//************************************************************************************************//
+void TriHierarchicalShapeFunction::Legendre(const cemINT& degree,
+                                            const cemDOUBLE& x,
+                                            cemDOUBLE& P,
+                                            cemDOUBLE& dP,
+                                            cemDOUBLE& d2P)
+{
+    cemDOUBLE P_prev = 0.0, dP_prev = 0.0, d2P_prev = 0.0;
+    P = 1.0;
+    dP = 0.0;
+    d2P = 0.0;
+    for (cemINT m=0; m<degree; ++m)
+    {
+        cemDOUBLE P_next = ((2*m+1)*x*P - m*P_prev)/(m+1);
+        cemDOUBLE dP_next = dP_prev + (2*m+1)*P;
+        cemDOUBLE d2P_next = d2P_prev + (2*m+1)*dP;
+        P_prev = P;
+        dP_prev = dP;
+        d2P_prev = d2P;
+        P = P_next;
+        dP = dP_next;
+        d2P = d2P_next;
+    }
+}
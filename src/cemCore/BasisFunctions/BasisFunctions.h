@@ -30,11 +30,26 @@ public:
     cemDOUBLE SilvesterPolynomialDeriv(const cemINT& index,
                                        const cemDOUBLE& ksi) const;
 
+    // Multiple point evaluation of Silvester polynomial and derivative:
+    void SilvesterPolynomials(const cemINT& index,
+                              const cemINT& num_points,
+                              const cemDOUBLE* ksi,
+                              cemDOUBLE* values,
+                              cemDOUBLE* derivs) const;
+
 protected:
     cemINT order_;  //!< Polynomial order of the shape function.
+    std::vector<cemDOUBLE> factorials_;     //!< index! of each polynomial, 0 <= index <= order_.
+
+    void EvaluateSilvester(const cemINT& index,
+                           const cemINT& num_points,
+                           const cemDOUBLE* ksi,
+                           cemDOUBLE* values,
+                           cemDOUBLE* derivs) const;
 
 private:
     // Private member functions:
+    void setUpFactorials();
     ShapeFunction(); // Default constructor private so only parameterized constructor can be used.
 };
 
@@ -89,12 +104,67 @@ public:
                                             const std::vector<cemDOUBLE>& ksi,
                                             const std::vector<cemDOUBLE>& eta) const;
 
+    // Batch evaluation of shape function and derivatives together:
+    void EvaluateBatch(const cemINT& index_i,
+                       const cemINT& index_j,
+                       const cemINT& index_k,
+                       const cemINT& num_points,
+                       const cemDOUBLE* ksi,
+                       const cemDOUBLE* eta,
+                       cemDOUBLE* values,
+                       cemDOUBLE* ksi_derivs,
+                       cemDOUBLE* eta_derivs) const;
+
+    static const cemINT BLOCK_SIZE = 64;    //!< Points evaluated together by EvaluateBatch.
+
 private:
     // Private member functions:
     TriShapeFunction(); // Default constructor private so only parameterized constructor can be used.
 };
 
 
+//************************************************************************************************//
+/**
+ * @brief The TriHierarchicalShapeFunction class : Hierarchical basis functions of the triangle.
+ *
+ * Functions are numbered by degree, so the (p+1)(p+2)/2 functions of order p are the first ones
+ * and the functions of order p-1 are a subset of them: the 3 vertex functions \f$ \lambda_a \f$
+ * first, and then, for each degree k = 2, 3, ..., one function per edge (0-1, 1-2, 2-0) and k-2
+ * interior functions. With barycentric coordinates \f$ \lambda_0 = \xi \f$,
+ * \f$ \lambda_1 = \eta \f$, \f$ \lambda_2 = 1-\xi-\eta \f$:
+ * - edge (a,b): \f$ \lambda_a \lambda_b L'_{k-1}(\lambda_b - \lambda_a) \f$, i.e. integrated
+ *   Legendre (Jacobi (1,1)) functions, oriented from vertex a to vertex b;
+ * - interior (i+j = k-3): \f$ \lambda_0 \lambda_1 \lambda_2 L_i(\lambda_1 - \lambda_0)
+ *   L_j(2\lambda_2 - 1) \f$;
+ * where \f$ L_n \f$ is the Legendre polynomial of degree n. Edge functions of odd degree change
+ * sign with the direction of the edge, so neighboring elements must agree on it: SolverTriangle
+ * and TriMatrixFreeOperator orient them along a global order of the vertices.
+ */
+//************************************************************************************************//
+class TriHierarchicalShapeFunction
+{
+public:
+    static cemINT NumFunctions(const cemINT& order);
+    static cemINT Degree(const cemINT& index);
+
+    // Batch evaluation of shape function and derivatives together:
+    static void EvaluateBatch(const cemINT& index,
+                              const cemINT& num_points,
+                              const cemDOUBLE* ksi,
+                              const cemDOUBLE* eta,
+                              cemDOUBLE* values,
+                              cemDOUBLE* ksi_derivs,
+                              cemDOUBLE* eta_derivs);
+
+private:
+    static void Legendre(const cemINT& degree,
+                         const cemDOUBLE& x,
+                         cemDOUBLE& P,
+                         cemDOUBLE& dP,
+                         cemDOUBLE& d2P);
+};
+
+
 }
 
 
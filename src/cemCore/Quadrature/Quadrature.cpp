@@ -27,6 +27,17 @@ cemINT Quadrature::getNumPointsForPolyOrder(const cemINT& order) const
 }
 
 
+//************************************************************************************************//
+/** @brief Quadrature::getMaxPolyOrder : Gets the highest polynomial order that can be integrated
+ * exactly with the rules available.
+ * @return : order_to_num_points_.rbegin()->first */
+//************************************************************************************************//
+cemINT Quadrature::getMaxPolyOrder() const
+{
+    return order_to_num_points_.rbegin()->first;
+}
+
+
 //************************************************************************************************//
 /** @brief Quadrature::getNumPointsAbove : Gets the number of points in the quadrature rule whose
  * number of points is greater than the number provided. If there is no such rule, this function
@@ -1277,3 +1288,112 @@ void TriQuadrature::initialize()
 
 
 
+//************************************************************************************************//
+// CLASS: TetraQuadrature
+//************************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TetraQuadrature::initialize : Sets quadrature rules for TETRAHEDRON elements.
+ *
+ * Rules are conical products of the Gauss rules of LineQuadrature with 2, 3, 5, 7, and 9 points:
+ * the unit cube (a,b,c) is collapsed onto the reference tetrahedron with
+ * \f$ \xi = a(1-b)(1-c) \f$, \f$ \eta = b(1-c) \f$, \f$ \zeta = c \f$, whose Jacobian
+ * \f$ (1-b)(1-c)^2 \f$ raises the polynomial order by 2. Weights add up to 1/6, which is the
+ * volume of the unit reference tetrahedron. */
+//************************************************************************************************//
+void TetraQuadrature::initialize()
+{
+    using_ksi_ = true;
+    using_eta_ = true;
+    using_zeta_ = true;
+
+    LineQuadrature line;
+    const cemINT LINE_POINTS[5] = {2, 3, 5, 7, 9};
+    for (cemINT r=0; r<5; ++r)
+    {
+        cemINT n = LINE_POINTS[r];
+        const std::vector<cemDOUBLE>& x = line.getKsiCoordinates(n);
+        const std::vector<cemDOUBLE>& w = line.getWeights(n);
+
+        cemINT num_points = n*n*n;
+        order_to_num_points_[2*n-3] = num_points;
+        ksi_[num_points].resize(num_points);
+        eta_[num_points].resize(num_points);
+        zeta_[num_points].resize(num_points);
+        weight_[num_points].resize(num_points);
+
+        cemINT t = 0;
+        for (cemINT i=0; i<n; ++i)
+        {
+            cemDOUBLE a = 0.5*(1.0 + x[i]);
+            for (cemINT j=0; j<n; ++j)
+            {
+                cemDOUBLE b = 0.5*(1.0 + x[j]);
+                for (cemINT k=0; k<n; ++k, ++t)
+                {
+                    cemDOUBLE c = 0.5*(1.0 + x[k]);
+                    ksi_[num_points][t] = a*(1.0-b)*(1.0-c);
+                    eta_[num_points][t] = b*(1.0-c);
+                    zeta_[num_points][t] = c;
+                    weight_[num_points][t] = 0.125*w[i]*w[j]*w[k]*(1.0-b)*(1.0-c)*(1.0-c);
+                }
+            }
+        }
+    }
+}
+
+
+
+
+//************************************************************************************************//
+// CLASS: PrismQuadrature
+//************************************************************************************************//
+
+//************************************************************************************************//
+/** @brief PrismQuadrature::initialize : Sets quadrature rules for PRISM elements.
+ *
+ * Rules are products of each rule of TriQuadrature (in ksi and eta) with the Gauss rule of
+ * LineQuadrature of the same order (in zeta, from -1 to 1). Weights add up to 1, which is the
+ * volume of the reference prism. */
+//************************************************************************************************//
+void PrismQuadrature::initialize()
+{
+    using_ksi_ = true;
+    using_eta_ = true;
+    using_zeta_ = true;
+
+    TriQuadrature triangle;
+    LineQuadrature line;
+    for (cemINT order=1; order<=triangle.getMaxPolyOrder(); ++order)
+    {
+        cemINT num_tri_points = triangle.getNumPointsForPolyOrder(order);
+        cemINT num_line_points = line.getNumPointsForPolyOrder(order);
+        cemINT num_points = num_tri_points*num_line_points;
+        order_to_num_points_[order] = num_points;
+        if (weight_.count(num_points) > 0)
+            continue;
+
+        const std::vector<cemDOUBLE>& tri_ksi = triangle.getKsiCoordinates(num_tri_points);
+        const std::vector<cemDOUBLE>& tri_eta = triangle.getEtaCoordinates(num_tri_points);
+        const std::vector<cemDOUBLE>& tri_w = triangle.getWeights(num_tri_points);
+        const std::vector<cemDOUBLE>& line_x = line.getKsiCoordinates(num_line_points);
+        const std::vector<cemDOUBLE>& line_w = line.getWeights(num_line_points);
+
+        ksi_[num_points].resize(num_points);
+        eta_[num_points].resize(num_points);
+        zeta_[num_points].resize(num_points);
+        weight_[num_points].resize(num_points);
+
+        cemINT t = 0;
+        for (cemINT k=0; k<num_line_points; ++k)
+        {
+            for (cemINT i=0; i<num_tri_points; ++i, ++t)
+            {
+                ksi_[num_points][t] = tri_ksi[i];
+                eta_[num_points][t] = tri_eta[i];
+                zeta_[num_points][t] = line_x[k];
+                weight_[num_points][t] = tri_w[i]*line_w[k];
+            }
+        }
+    }
+}
@@ -23,6 +23,7 @@ public:
     }
 
     cemINT getNumPointsForPolyOrder(const cemINT& order) const;
+    cemINT getMaxPolyOrder() const;
     cemINT getNumPointsAbove(const cemINT& number) const ;
     cemINT getNumPointsBelow(const cemINT& number) const;
     cemINT getNumberOfRules() const;
@@ -90,7 +91,10 @@ private:
 
 
 //************************************************************************************************//
-/** @brief The TetraQuadrature class : Quadrature rules for Tetrahedra. */
+/** @brief The TetraQuadrature class : Quadrature rules for Tetrahedra.
+ *
+ * Rules are for the unit reference tetrahedron with vertices (0,0,0), (1,0,0), (0,1,0) and
+ * (0,0,1) (Volume = 1/6). */
 //************************************************************************************************//
 class TetraQuadrature : public Quadrature
 {
@@ -116,7 +120,10 @@ private:
 
 
 //************************************************************************************************//
-/** @brief The PrismQuadrature class : Quadrature rules for Prisms. */
+/** @brief The PrismQuadrature class : Quadrature rules for Prisms.
+ *
+ * Rules are for the reference prism made of the unit reference triangle (in ksi and eta) times
+ * the interval [-1,1] (in zeta) (Volume = 1). */
 //************************************************************************************************//
 class PrismQuadrature : public Quadrature
 {
@@ -0,0 +1,475 @@
+#include "SolidTabulation.h"
+#include "SolverElement.h"
+#include "cemError.h"
+#include "cemUtils.h"
+#include "Quadrature/Quadrature.h"
+#include "BasisFunctions/BasisFunctions.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+
+///***********************************************************************************************//
+/// CLASS SolidTabulation:
+///***********************************************************************************************//
+const cemINT SolidTabulation::PRISM_EXTRA_ORDER;
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::SolidTabulation : Constructor with parameters.
+ *
+ * Evaluates all basis functions, their derivatives, all coefficient functions and the
+ * derivatives of the geometry functions at the quadrature points. Use SolidTabulation::Get() to
+ * share the result among all elements.
+ * @param [in] type : Element::TET or Element::PRISM
+ * @param [in] basis_order : polynomial order of basis functions (>= 1)
+ * @param [in] coefficient_order : polynomial order of coefficient functions (>= 0) */
+//************************************************************************************************//
+SolidTabulation::SolidTabulation(const Element::ElementType& type,
+                                 const cemINT& basis_order,
+                                 const cemINT& coefficient_order)
+{
+    if (basis_order < 1)
+        throw(Exception("INPUT ERROR","basis_order must be > 0"));
+
+    if (coefficient_order < 0)
+        throw(Exception("INPUT ERROR","coefficient_order must be >= 0"));
+
+    type_ = type;
+    basis_order_ = basis_order;
+    coefficient_order_ = coefficient_order;
+
+    if (type_ == Element::TET)
+        TabulateTetrahedron();
+    else if (type_ == Element::PRISM)
+        TabulatePrism();
+    else
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Tetrahedron (TET) or a Prism (PRISM)"));
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::Get : Gets the shared tabulation for an element type and set of orders.
+ *
+ * Functions are tabulated the first time a set is requested and kept for the rest of the run.
+ * Thread-safe, in the same way as TriTabulation::Get().
+ * @param [in] type : Element::TET or Element::PRISM
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions
+ * @return : Tabulation for (type,basis_order,coefficient_order) */
+//************************************************************************************************//
+const SolidTabulation& SolidTabulation::Get(const Element::ElementType& type,
+                                            const cemINT& basis_order,
+                                            const cemINT& coefficient_order)
+{
+    typedef std::pair< cemINT,std::pair<cemINT,cemINT> > Key;
+    static std::map< Key,SolidTabulation > cache;
+
+    Key key(static_cast<cemINT>(type),std::make_pair(basis_order,coefficient_order));
+    const SolidTabulation* found = NULL;
+    #pragma omp critical(SolidTabulation_cache)
+    {
+        std::map< Key,SolidTabulation >::iterator it = cache.find(key);
+        if (it != cache.end())
+            found = &it->second;
+    }
+    if (found != NULL)
+        return *found;
+
+    SolidTabulation tabulation(type,basis_order,coefficient_order);
+    #pragma omp critical(SolidTabulation_cache)
+    found = &cache.insert(std::make_pair(key,tabulation)).first->second;
+
+    return *found;
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::type : Gets type of element.
+ * @return : type_ */
+//************************************************************************************************//
+Element::ElementType SolidTabulation::type() const {return type_;}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::basis_order : Gets polynomial order of basis functions.
+ * @return : basis_order_ */
+//************************************************************************************************//
+cemINT SolidTabulation::basis_order() const {return basis_order_;}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::coefficient_order : Gets polynomial order of coefficients.
+ * @return : coefficient_order_ */
+//************************************************************************************************//
+cemINT SolidTabulation::coefficient_order() const {return coefficient_order_;}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::num_basis_functions : Gets number of basis functions.
+ * @return : num_basis_functions_ */
+//************************************************************************************************//
+cemINT SolidTabulation::num_basis_functions() const {return num_basis_functions_;}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::num_coefficient_functions : Gets number of coefficient functions.
+ * @return : num_coefficient_functions_ */
+//************************************************************************************************//
+cemINT SolidTabulation::num_coefficient_functions() const {return num_coefficient_functions_;}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::num_geometry_functions : Gets number of geometry functions (vertices).
+ * @return : num_geometry_functions_ */
+//************************************************************************************************//
+cemINT SolidTabulation::num_geometry_functions() const {return num_geometry_functions_;}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::num_points : Gets number of quadrature points.
+ * @return : num_points_ */
+//************************************************************************************************//
+cemINT SolidTabulation::num_points() const {return num_points_;}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::weights : Gets quadrature weights.
+ * @return : pointer to num_points() weights */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::weights() const {return &weights_[0];}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::basis : Gets all basis functions at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_basis_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::basis(const cemINT& point_index) const
+{
+    return &basis_[point_index*num_basis_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::basis_ksi_deriv : Gets \f$ \xi \f$-derivatives of all basis functions
+ * at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_basis_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::basis_ksi_deriv(const cemINT& point_index) const
+{
+    return &basis_ksi_[point_index*num_basis_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::basis_eta_deriv : Gets \f$ \eta \f$-derivatives of all basis functions
+ * at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_basis_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::basis_eta_deriv(const cemINT& point_index) const
+{
+    return &basis_eta_[point_index*num_basis_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::basis_zeta_deriv : Gets \f$ \zeta \f$-derivatives of all basis
+ * functions at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_basis_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::basis_zeta_deriv(const cemINT& point_index) const
+{
+    return &basis_zeta_[point_index*num_basis_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::coefficients : Gets all coefficient functions at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_coefficient_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::coefficients(const cemINT& point_index) const
+{
+    return &coefficients_[point_index*num_coefficient_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::geometry_ksi_deriv : Gets \f$ \xi \f$-derivative of a geometry function.
+ * @param [in] function_index : index of the vertex
+ * @return : pointer to num_points() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::geometry_ksi_deriv(const cemINT& function_index) const
+{
+    return &geometry_ksi_[function_index*num_points_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::geometry_eta_deriv : Gets \f$ \eta \f$-derivative of a geometry function.
+ * @param [in] function_index : index of the vertex
+ * @return : pointer to num_points() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::geometry_eta_deriv(const cemINT& function_index) const
+{
+    return &geometry_eta_[function_index*num_points_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::geometry_zeta_deriv : Gets \f$ \zeta \f$-derivative of a geometry
+ * function.
+ * @param [in] function_index : index of the vertex
+ * @return : pointer to num_points() values */
+//************************************************************************************************//
+const cemDOUBLE* SolidTabulation::geometry_zeta_deriv(const cemINT& function_index) const
+{
+    return &geometry_zeta_[function_index*num_points_];
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::TabulateTetrahedron : Evaluates all functions of a tetrahedron at the
+ * quadrature points.
+ *
+ * Vertex 0 is at the origin of the reference tetrahedron and vertices 1, 2 and 3 are at the end
+ * of the \f$ \xi \f$, \f$ \eta \f$ and \f$ \zeta \f$ axes, as in cemMesh.h. */
+//************************************************************************************************//
+void SolidTabulation::TabulateTetrahedron()
+{
+    num_basis_functions_ = (basis_order_+1)*(basis_order_+2)*(basis_order_+3)/6;
+    num_coefficient_functions_ = (coefficient_order_+1)*(coefficient_order_+2)*
+                                 (coefficient_order_+3)/6;
+    num_geometry_functions_ = 4;
+
+    // Get quadrature:
+    TetraQuadrature quadrature;
+    cemINT poly_order = coefficient_order_ + 2*basis_order_;
+    if (poly_order > quadrature.getMaxPolyOrder())
+        throw(Exception("FEATURE NOT IMPLEMENTED","No quadrature rule of order " +
+                        cem_utils::NumberToString<cemINT>(poly_order)));
+
+    num_points_ = quadrature.getNumPointsForPolyOrder(poly_order);
+    ksi_ = quadrature.getKsiCoordinates(num_points_);
+    eta_ = quadrature.getEtaCoordinates(num_points_);
+    zeta_ = quadrature.getZetaCoordinates(num_points_);
+    weights_ = quadrature.getWeights(num_points_);
+
+    // Basis functions and their derivatives:
+    cemINT n = num_basis_functions_;
+    basis_.resize(num_points_*n);
+    basis_ksi_.resize(num_points_*n);
+    basis_eta_.resize(num_points_*n);
+    basis_zeta_.resize(num_points_*n);
+    std::vector<cemDOUBLE> values(num_points_),ksi_derivs(num_points_);
+    std::vector<cemDOUBLE> eta_derivs(num_points_),zeta_derivs(num_points_);
+    cemINT indices[4];
+    for (cemINT i=0; i<n; ++i)
+    {
+        SolverTetrahedron::GetShapeFunctionIndices(basis_order_,i,indices[0],indices[1],
+                                                   indices[2],indices[3]);
+        EvaluateTetrahedron(basis_order_,indices,&values[0],&ksi_derivs[0],&eta_derivs[0],
+                            &zeta_derivs[0]);
+        for (cemINT t=0; t<num_points_; ++t)
+        {
+            basis_[t*n + i] = values[t];
+            basis_ksi_[t*n + i] = ksi_derivs[t];
+            basis_eta_[t*n + i] = eta_derivs[t];
+            basis_zeta_[t*n + i] = zeta_derivs[t];
+        }
+    }
+
+    // Coefficient functions:
+    cemINT m = num_coefficient_functions_;
+    coefficients_.resize(num_points_*m);
+    for (cemINT k=0; k<m; ++k)
+    {
+        SolverTetrahedron::GetShapeFunctionIndices(coefficient_order_,k,indices[0],indices[1],
+                                                   indices[2],indices[3]);
+        EvaluateTetrahedron(coefficient_order_,indices,&values[0],NULL,NULL,NULL);
+        for (cemINT t=0; t<num_points_; ++t)
+            coefficients_[t*m + k] = values[t];
+    }
+
+    // Geometry functions (1-ksi-eta-zeta, ksi, eta, zeta) have constant derivatives:
+    geometry_ksi_.assign(num_geometry_functions_*num_points_,0.0);
+    geometry_eta_.assign(num_geometry_functions_*num_points_,0.0);
+    geometry_zeta_.assign(num_geometry_functions_*num_points_,0.0);
+    for (cemINT t=0; t<num_points_; ++t)
+    {
+        geometry_ksi_[t] = -1.0;
+        geometry_eta_[t] = -1.0;
+        geometry_zeta_[t] = -1.0;
+        geometry_ksi_[num_points_ + t] = 1.0;
+        geometry_eta_[2*num_points_ + t] = 1.0;
+        geometry_zeta_[3*num_points_ + t] = 1.0;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::TabulatePrism : Evaluates all functions of a prism at the quadrature
+ * points.
+ *
+ * The triangle (in \f$ \xi \f$ and \f$ \eta \f$) is the reference triangle of SolverTriangle,
+ * with vertex 0 at \f$ \xi = 1 \f$ and vertex 1 at \f$ \eta = 1 \f$. Vertices 0, 1 and 2 of the
+ * prism are at \f$ \zeta = -1 \f$, and vertices 3, 4 and 5 above them at \f$ \zeta = 1 \f$. */
+//************************************************************************************************//
+void SolidTabulation::TabulatePrism()
+{
+    cemINT num_tri_coefficients = (coefficient_order_+1)*(coefficient_order_+2)/2;
+    num_basis_functions_ = (basis_order_+1)*(basis_order_+1)*(basis_order_+2)/2;
+    num_coefficient_functions_ = num_tri_coefficients*(coefficient_order_+1);
+    num_geometry_functions_ = 6;
+
+    // Get quadrature:
+    PrismQuadrature quadrature;
+    cemINT poly_order = coefficient_order_ + 2*basis_order_;
+    if (poly_order > quadrature.getMaxPolyOrder())
+        throw(Exception("FEATURE NOT IMPLEMENTED","No quadrature rule of order " +
+                        cem_utils::NumberToString<cemINT>(poly_order)));
+
+    poly_order += PRISM_EXTRA_ORDER;
+    if (poly_order > quadrature.getMaxPolyOrder())
+        poly_order = quadrature.getMaxPolyOrder();
+
+    num_points_ = quadrature.getNumPointsForPolyOrder(poly_order);
+    ksi_ = quadrature.getKsiCoordinates(num_points_);
+    eta_ = quadrature.getEtaCoordinates(num_points_);
+    zeta_ = quadrature.getZetaCoordinates(num_points_);
+    weights_ = quadrature.getWeights(num_points_);
+
+    // Products of a triangle function and a 1D Lagrange polynomial in zeta:
+    cemINT n = num_basis_functions_;
+    basis_.resize(num_points_*n);
+    basis_ksi_.resize(num_points_*n);
+    basis_eta_.resize(num_points_*n);
+    basis_zeta_.resize(num_points_*n);
+    TriShapeFunction shape_function(basis_order_);
+    std::vector<cemDOUBLE> values(num_points_),ksi_derivs(num_points_),eta_derivs(num_points_);
+    std::vector<cemDOUBLE> L((basis_order_+1)*num_points_),dL((basis_order_+1)*num_points_);
+    SolverQuadrangle::EvaluateLagrange(basis_order_,num_points_,&zeta_[0],&L[0],&dL[0]);
+    cemINT index_i,index_j,index_k,triangle_index,line_index;
+    for (cemINT i=0; i<n; ++i)
+    {
+        SolverPrism::GetShapeFunctionIndices(basis_order_,i,triangle_index,line_index);
+        SolverTriangle::GetShapeFunctionIndices(basis_order_,triangle_index,index_i,index_j,index_k);
+        shape_function.EvaluateBatch(index_i,index_j,index_k,num_points_,&ksi_[0],&eta_[0],
+                                     &values[0],&ksi_derivs[0],&eta_derivs[0]);
+        const cemDOUBLE* L_l = &L[line_index*num_points_];
+        const cemDOUBLE* dL_l = &dL[line_index*num_points_];
+        for (cemINT t=0; t<num_points_; ++t)
+        {
+            basis_[t*n + i] = values[t]*L_l[t];
+            basis_ksi_[t*n + i] = ksi_derivs[t]*L_l[t];
+            basis_eta_[t*n + i] = eta_derivs[t]*L_l[t];
+            basis_zeta_[t*n + i] = values[t]*dL_l[t];
+        }
+    }
+
+    // Coefficient functions (triangle function k%m' times polynomial k/m' in zeta):
+    cemINT m = num_coefficient_functions_;
+    coefficients_.resize(num_points_*m);
+    shape_function.set_order(coefficient_order_);
+    L.resize((coefficient_order_+1)*num_points_);
+    SolverQuadrangle::EvaluateLagrange(coefficient_order_,num_points_,&zeta_[0],&L[0],NULL);
+    for (cemINT k=0; k<m; ++k)
+    {
+        SolverTriangle::GetShapeFunctionIndices(coefficient_order_,k%num_tri_coefficients,
+                                                index_i,index_j,index_k);
+        shape_function.EvaluateBatch(index_i,index_j,index_k,num_points_,&ksi_[0],&eta_[0],
+                                     &values[0],NULL,NULL);
+        const cemDOUBLE* L_l = &L[(k/num_tri_coefficients)*num_points_];
+        for (cemINT t=0; t<num_points_; ++t)
+            coefficients_[t*m + k] = values[t]*L_l[t];
+    }
+
+    // Geometry functions: (ksi, eta, 1-ksi-eta) times (1-zeta)/2 or (1+zeta)/2:
+    cemINT g = num_geometry_functions_;
+    geometry_ksi_.resize(g*num_points_);
+    geometry_eta_.resize(g*num_points_);
+    geometry_zeta_.resize(g*num_points_);
+    for (cemINT t=0; t<num_points_; ++t)
+    {
+        cemDOUBLE lambda[3] = {ksi_[t], eta_[t], 1.0 - ksi_[t] - eta_[t]};
+        cemDOUBLE lambda_ksi[3] = {1.0, 0.0, -1.0};
+        cemDOUBLE lambda_eta[3] = {0.0, 1.0, -1.0};
+        for (cemINT level=0; level<2; ++level)
+        {
+            cemDOUBLE sign = (level == 0) ? -1.0 : 1.0;
+            cemDOUBLE height = 0.5*(1.0 + sign*zeta_[t]);
+            for (cemINT a=0; a<3; ++a)
+            {
+                cemINT vertex = 3*level + a;
+                geometry_ksi_[vertex*num_points_ + t] = lambda_ksi[a]*height;
+                geometry_eta_[vertex*num_points_ + t] = lambda_eta[a]*height;
+                geometry_zeta_[vertex*num_points_ + t] = 0.5*sign*lambda[a];
+            }
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolidTabulation::EvaluateTetrahedron : Evaluates a Silvester function of a tetrahedron
+ * (and its derivatives) at all quadrature points.
+ *
+ * The function is the product of four Silvester polynomials, one in each barycentric coordinate
+ * \f$ (1-\xi-\eta-\zeta, \xi, \eta, \zeta) \f$, and its derivatives follow from the product rule.
+ * @param [in] order : polynomial order of the function (>= 0)
+ * @param [in] indices : index of each of the four Silvester polynomials
+ * @param [out] values : num_points_ values
+ * @param [out] ksi_derivs : \f$ \xi \f$-derivatives (can be NULL, then all derivatives are)
+ * @param [out] eta_derivs : \f$ \eta \f$-derivatives
+ * @param [out] zeta_derivs : \f$ \zeta \f$-derivatives */
+//************************************************************************************************//
+void SolidTabulation::EvaluateTetrahedron(const cemINT& order,
+                                          const cemINT* indices,
+                                          cemDOUBLE* values,
+                                          cemDOUBLE* ksi_derivs,
+                                          cemDOUBLE* eta_derivs,
+                                          cemDOUBLE* zeta_derivs) const
+{
+    ShapeFunction shape_function(1);
+    shape_function.set_order(order);
+
+    std::vector<cemDOUBLE> lambda(4*num_points_);
+    for (cemINT t=0; t<num_points_; ++t)
+    {
+        lambda[t] = 1.0 - ksi_[t] - eta_[t] - zeta_[t];
+        lambda[num_points_ + t] = ksi_[t];
+        lambda[2*num_points_ + t] = eta_[t];
+        lambda[3*num_points_ + t] = zeta_[t];
+    }
+
+    std::vector<cemDOUBLE> R(4*num_points_),dR(4*num_points_);
+    for (cemINT v=0; v<4; ++v)
+        shape_function.SilvesterPolynomials(indices[v],num_points_,&lambda[v*num_points_],
+                                            &R[v*num_points_],&dR[v*num_points_]);
+
+    const cemDOUBLE* R0 = &R[0];
+    const cemDOUBLE* R1 = &R[num_points_];
+    const cemDOUBLE* R2 = &R[2*num_points_];
+    const cemDOUBLE* R3 = &R[3*num_points_];
+    for (cemINT t=0; t<num_points_; ++t)
+        values[t] = R0[t]*R1[t]*R2[t]*R3[t];
+
+    if (ksi_derivs == NULL)
+        return;
+
+    const cemDOUBLE* dR0 = &dR[0];
+    const cemDOUBLE* dR1 = &dR[num_points_];
+    const cemDOUBLE* dR2 = &dR[2*num_points_];
+    const cemDOUBLE* dR3 = &dR[3*num_points_];
+    for (cemINT t=0; t<num_points_; ++t)
+    {
+        cemDOUBLE d0 = dR0[t]*R1[t]*R2[t]*R3[t];
+        ksi_derivs[t] = R0[t]*dR1[t]*R2[t]*R3[t] - d0;
+        eta_derivs[t] = R0[t]*R1[t]*dR2[t]*R3[t] - d0;
+        zeta_derivs[t] = R0[t]*R1[t]*R2[t]*dR3[t] - d0;
+    }
+}
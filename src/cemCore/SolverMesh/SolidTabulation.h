@@ -0,0 +1,100 @@
+#ifndef SOLID_TABULATION_H
+#define SOLID_TABULATION_H
+
+#include <map>
+#include <vector>
+#include "cemTypes.h"
+#include "cemMesh.h"
+
+using namespace cem_def;
+using cem_mesh::Element;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The SolidTabulation class : Basis, coefficient and geometry functions of a 3D element
+ * (tetrahedron or prism) tabulated at the quadrature points of the reference element.
+ *
+ * This is the 3D counterpart of TriTabulation, and uses the same layout: basis functions, their
+ * three derivatives and coefficient functions are stored point by point (the i-th function at
+ * point t is found at t*n + i), while the derivatives of the first-order geometry (vertex)
+ * functions are stored function by function, so that Jacobians can be built with loops over
+ * points.
+ *
+ * Tetrahedra are affine, so their rule integrates polynomials of order 2p+q exactly. The mapping
+ * of a prism is not affine, so its rule is PRISM_EXTRA_ORDER orders higher.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SolidTabulation
+{
+public:
+    static const cemINT PRISM_EXTRA_ORDER = 2;  //!< Order added to the rule of prisms.
+
+    // Constructor with parameters:
+    SolidTabulation(const Element::ElementType& type,
+                    const cemINT& basis_order,
+                    const cemINT& coefficient_order);
+
+    // Shared instance for a given element type and set of orders:
+    static const SolidTabulation& Get(const Element::ElementType& type,
+                                      const cemINT& basis_order,
+                                      const cemINT& coefficient_order);
+
+    // Get data members:
+    Element::ElementType type() const;
+    cemINT basis_order() const;
+    cemINT coefficient_order() const;
+    cemINT num_basis_functions() const;
+    cemINT num_coefficient_functions() const;
+    cemINT num_geometry_functions() const;
+    cemINT num_points() const;
+
+    const cemDOUBLE* weights() const;
+    const cemDOUBLE* basis(const cemINT& point_index) const;
+    const cemDOUBLE* basis_ksi_deriv(const cemINT& point_index) const;
+    const cemDOUBLE* basis_eta_deriv(const cemINT& point_index) const;
+    const cemDOUBLE* basis_zeta_deriv(const cemINT& point_index) const;
+    const cemDOUBLE* coefficients(const cemINT& point_index) const;
+    const cemDOUBLE* geometry_ksi_deriv(const cemINT& function_index) const;
+    const cemDOUBLE* geometry_eta_deriv(const cemINT& function_index) const;
+    const cemDOUBLE* geometry_zeta_deriv(const cemINT& function_index) const;
+
+private:
+    Element::ElementType type_;             //!< TET or PRISM.
+    cemINT basis_order_;                    //!< Polynomial order of the basis functions.
+    cemINT coefficient_order_;              //!< Polynomial order of the coefficient functions.
+    cemINT num_basis_functions_;            //!< Number of basis functions.
+    cemINT num_coefficient_functions_;      //!< Number of coefficient functions.
+    cemINT num_geometry_functions_;         //!< Number of vertices.
+    cemINT num_points_;                     //!< Number of quadrature points.
+
+    std::vector<cemDOUBLE> ksi_;            //!< \f$ \xi \f$ coordinate of quadrature points.
+    std::vector<cemDOUBLE> eta_;            //!< \f$ \eta \f$ coordinate of quadrature points.
+    std::vector<cemDOUBLE> zeta_;           //!< \f$ \zeta \f$ coordinate of quadrature points.
+    std::vector<cemDOUBLE> weights_;        //!< Quadrature weights.
+    std::vector<cemDOUBLE> basis_;          //!< Basis functions at all points.
+    std::vector<cemDOUBLE> basis_ksi_;      //!< \f$ \xi \f$-derivative of basis functions.
+    std::vector<cemDOUBLE> basis_eta_;      //!< \f$ \eta \f$-derivative of basis functions.
+    std::vector<cemDOUBLE> basis_zeta_;     //!< \f$ \zeta \f$-derivative of basis functions.
+    std::vector<cemDOUBLE> coefficients_;   //!< Coefficient functions at all points.
+    std::vector<cemDOUBLE> geometry_ksi_;   //!< \f$ \xi \f$-derivative of geometry functions.
+    std::vector<cemDOUBLE> geometry_eta_;   //!< \f$ \eta \f$-derivative of geometry functions.
+    std::vector<cemDOUBLE> geometry_zeta_;  //!< \f$ \zeta \f$-derivative of geometry functions.
+
+    // Private member functions:
+    void TabulateTetrahedron();
+    void TabulatePrism();
+    void EvaluateTetrahedron(const cemINT& order,
+                             const cemINT* indices,
+                             cemDOUBLE* values,
+                             cemDOUBLE* ksi_derivs,
+                             cemDOUBLE* eta_derivs,
+                             cemDOUBLE* zeta_derivs) const;
+    SolidTabulation(); // Only parameterized constructor can be used.
+};
+
+
+}
+
+
+#endif // SOLID_TABULATION_H
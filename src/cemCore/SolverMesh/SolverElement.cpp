@@ -1,11 +1,36 @@
+#include <cmath>
+#include <algorithm>
+#include <functional>
 #include "SolverElement.h"
 #include "cemError.h"
+#include "cemUtils.h"
 #include "Quadrature/Quadrature.h"
 #include "BasisFunctions/BasisFunctions.h"
+#include "TriReferenceTensors.h"
+#include "TriTabulation.h"
+#include "TriKernels.h"
+#include "SolidTabulation.h"
 
 using namespace cem_core;
 using cemcommon::Exception;
 
+
+//************************************************************************************************//
+/** @brief NodeBefore : Global order of two nodes, used to orient the edges of hierarchical
+ * functions the same way in every element (by node_id(), or by address if the ids are equal,
+ * e.g. for nodes that are not read from a mesh file).
+ * @param [in] a : first node
+ * @param [in] b : second node
+ * @return : true if a comes before b */
+//************************************************************************************************//
+static cemBOOL NodeBefore(const cem_mesh::Node* a, const cem_mesh::Node* b)
+{
+    if (a->node_id() != b->node_id())
+        return a->node_id() < b->node_id();
+
+    return std::less<const cem_mesh::Node*>()(a,b);
+}
+
 ///***********************************************************************************************//
 /// CLASS SolverElement:
 ///***********************************************************************************************//
@@ -20,6 +45,7 @@ void SolverElement::initialize()
     basis_function_field_ = SCALAR;
     basis_function_type_ = INTERPOLATORY;
     coefficient_order_ = 0;
+    matrices_are_Up_ = false;
 }
 
 
@@ -34,35 +60,13 @@ void SolverElement::copy(const SolverElement &other)
     basis_function_field_ = other.basis_function_field_;
     basis_function_type_ = other.basis_function_type_;
     coefficient_order_ = other.coefficient_order_;
+    matrices_are_Up_ = other.matrices_are_Up_;
 
-    // Make sure matrices are cleared before copying:
-    matrix_N_NxNx_.clear();
-    matrix_N_NyNy_.clear();
-    matrix_N_NN_.clear();
-
-    if (!other.matrix_N_NxNx_.empty())
-    {
-        cemINT N = matrix_N_NxNx_.size();
-        matrix_N_NxNx_.resize(N);
-        for (cemINT i=0; i<N; ++i)
-            matrix_N_NxNx_[i] = other.matrix_N_NxNx_[i];
-    }
-
-    if (!other.matrix_N_NyNy_.empty())
-    {
-        cemINT N = matrix_N_NyNy_.size();
-        matrix_N_NyNy_.resize(N);
-        for (cemINT i=0; i<N; ++i)
-            matrix_N_NyNy_[i] = other.matrix_N_NyNy_[i];
-    }
-
-    if (!other.matrix_N_NN_.empty())
-    {
-        cemINT N = matrix_N_NN_.size();
-        matrix_N_NN_.resize(N);
-        for (cemINT i=0; i<N; ++i)
-            matrix_N_NN_[i] = other.matrix_N_NN_[i];
-    }
+    // Vectors of matrices are copied element-wise by std::vector:
+    matrix_N_NxNx_ = other.matrix_N_NxNx_;
+    matrix_N_NyNy_ = other.matrix_N_NyNy_;
+    matrix_N_NN_ = other.matrix_N_NN_;
+    matrix_N_GradGrad_ = other.matrix_N_GradGrad_;
 }
 
 
@@ -87,19 +91,20 @@ SolverElement::SolverElement(const cemINT& basis_order,
     if (basis_order < 1)
         throw(Exception("INPUT ERROR","basis_order must be > 0"));
 
-    if (basis_order > 3)
-        throw(Exception("FEATURE NOT INPLEMENTED","basis_order > 3 not implemented"));
+    if (basis_order > 6)
+        throw(Exception("FEATURE NOT INPLEMENTED","basis_order > 6 not implemented"));
 
     if (coefficient_order < 0)
         throw(Exception("INPUT ERROR","coefficient_order must be >= 0"));
 
-    if (coefficient_order > 1)
-        throw(Exception("FEATURE NOT INPLEMENTED","Coefficient order > 1 not implemented"));
+    if (coefficient_order > 3)
+        throw(Exception("FEATURE NOT INPLEMENTED","Coefficient order > 3 not implemented"));
 
     basis_function_order_ = basis_order;
     basis_function_field_ = function_field;
     basis_function_type_ = function_type;
     coefficient_order_ = coefficient_order;
+    matrices_are_Up_ = false;
 }
 
 
@@ -115,7 +120,11 @@ SolverElement::SolverElement(const SolverElement &other) {copy(other);}
  * @param [in] other : SolverElement to be copied
  * @return : A new SolverElement, identical to the one given */
 //************************************************************************************************//
-SolverElement& SolverElement::operator = (const SolverElement& other) {copy(other);}
+SolverElement& SolverElement::operator = (const SolverElement& other)
+{
+    copy(other);
+    return *this;
+}
 
 
 //************************************************************************************************//
@@ -154,14 +163,25 @@ BasisFunctionType SolverElement::basis_function_type() const {return basis_funct
 cemINT SolverElement::coefficient_order() const {return coefficient_order_;}
 
 
+//************************************************************************************************//
+/** @brief SolverElement::num_coefficient_functions : Gets number of coefficient functions, which
+ * is the number of matrices in each family. Elements that are not simplices override it.
+ * @return : (q+1)(q+2)/2 */
+//************************************************************************************************//
+cemINT SolverElement::num_coefficient_functions() const
+{
+    return (coefficient_order_+1)*(coefficient_order_+2)/2;
+}
+
+
 //************************************************************************************************//
 /** @brief SolverElement::matrix_N_NxNx : Gets i-th NxNx matrix.
  * @param [in] i : index of matrix to be returned
  * @return : matrix_N_NxNx_[i] */
 //************************************************************************************************//
-const DenseMatrix<cemDOUBLE>& SolverElement::matrix_N_NxNx(cemINT i) const
+const SymmetricMatrix<cemDOUBLE>& SolverElement::matrix_N_NxNx(cemINT i) const
 {
-    if (i >= (coefficient_order_+1)*(coefficient_order_+2)/2)
+    if (i >= num_coefficient_functions())
         throw(Exception("INPUT ERROR","Input is higher than number of matrices"));
 
     return matrix_N_NxNx_[i];
@@ -173,9 +193,9 @@ const DenseMatrix<cemDOUBLE>& SolverElement::matrix_N_NxNx(cemINT i) const
  * @param [in] i : index of matrix to be returned
  * @return : matrix_N_NyNy_[i] */
 //************************************************************************************************//
-const DenseMatrix<cemDOUBLE>& SolverElement::matrix_N_NyNy(cemINT i) const
+const SymmetricMatrix<cemDOUBLE>& SolverElement::matrix_N_NyNy(cemINT i) const
 {
-    if (i >= (coefficient_order_+1)*(coefficient_order_+2)/2)
+    if (i >= num_coefficient_functions())
         throw(Exception("INPUT ERROR","Input is higher than number of matrices"));
 
     return matrix_N_NyNy_[i];
@@ -187,28 +207,45 @@ const DenseMatrix<cemDOUBLE>& SolverElement::matrix_N_NyNy(cemINT i) const
  * @param [in] i : index of matrix to be returned
  * @return : matrix_N_NN_[i] */
 //************************************************************************************************//
-const DenseMatrix<cemDOUBLE>& SolverElement::matrix_N_NN(cemINT i) const
+const SymmetricMatrix<cemDOUBLE>& SolverElement::matrix_N_NN(cemINT i) const
 {
-    if (i >= (coefficient_order_+1)*(coefficient_order_+2)/2)
+    if (i >= num_coefficient_functions())
         throw(Exception("INPUT ERROR","Input is higher than number of matrices"));
 
     return matrix_N_NN_[i];
 }
 
 
+//************************************************************************************************//
+/** @brief SolverElement::matrix_N_GradGrad : Gets i-th GradGrad matrix (N_NxNx + N_NyNy).
+ *
+ * Only available after setUp_matrices() has been called.
+ * @param [in] i : index of matrix to be returned
+ * @return : matrix_N_GradGrad_[i] */
+//************************************************************************************************//
+const SymmetricMatrix<cemDOUBLE>& SolverElement::matrix_N_GradGrad(cemINT i) const
+{
+    if (i >= num_coefficient_functions())
+        throw(Exception("INPUT ERROR","Input is higher than number of matrices"));
+
+    return matrix_N_GradGrad_[i];
+}
+
+
 //************************************************************************************************//
 /** @brief SolverElement::set_basis_function_order : Sets polynomial order of basis functions.
- * @param [in] order : polynomial order (between 1 and 3)  */
+ * @param [in] order : polynomial order (between 1 and 6)  */
 //************************************************************************************************//
 void SolverElement::set_basis_function_order(const cemINT& order)
 {
     if (order < 1)
         throw(Exception("INPUT ERROR","basis_order must be > 0"));
 
-    if (order > 3)
-        throw(Exception("FEATURE NOT INPLEMENTED","basis_order > 3 not implemented"));
+    if (order > 6)
+        throw(Exception("FEATURE NOT INPLEMENTED","basis_order > 6 not implemented"));
 
     basis_function_order_ = order;
+    matrices_are_Up_ = false;
 }
 
 
@@ -229,22 +266,115 @@ void SolverElement::set_basis_function_field(const BasisFunctionField& function_
 void SolverElement::set_basis_function_type(const BasisFunctionType& function_type)
 {
     basis_function_type_ = function_type;
+    matrices_are_Up_ = false;
 }
 
 
 //************************************************************************************************//
 /** @brief SolverElement::set_coefficient_order : Sets polynomial order of the coefficients.
- * @param [in] order : polynomial order (0 or 1) */
+ * @param [in] order : polynomial order (between 0 and 3) */
 //************************************************************************************************//
 void SolverElement::set_coefficient_order(const cemINT &order)
 {
     if (order < 0)
         throw(Exception("INPUT ERROR","coefficient_order must be >= 0"));
 
-    if (order > 1)
-        throw(Exception("FEATURE NOT INPLEMENTED","Coefficient order > 1 not implemented"));
+    if (order > 3)
+        throw(Exception("FEATURE NOT INPLEMENTED","Coefficient order > 3 not implemented"));
 
     coefficient_order_ = order;
+    matrices_are_Up_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverElement::setUp_matrices : Set up N_NxNx, N_NyNy, N_NN and N_GradGrad matrices.
+ *
+ * Generic version: sets up each family on its own, then adds N_NxNx and N_NyNy. Derived classes
+ * override it with a single pass over the element whenever they can.
+ * @param [in] force_numerical_integration : use numerical integration for every family */
+//************************************************************************************************//
+void SolverElement::setUp_matrices(cemBOOL force_numerical_integration)
+{
+    setUp_matrix_N_NxNx(force_numerical_integration);
+    setUp_matrix_N_NyNy(force_numerical_integration);
+    setUp_matrix_N_NN(force_numerical_integration);
+
+    cemINT num_matrices = matrix_N_NxNx_.size();
+    matrix_N_GradGrad_.resize(num_matrices);
+    for (cemINT k=0; k<num_matrices; ++k)
+    {
+        cemINT n = matrix_N_NxNx_[k].num_rows();
+        matrix_N_GradGrad_[k].resize(n,n);
+        for (cemINT j=0; j<n; ++j)
+        {
+            for (cemINT i=j; i<n; ++i)
+                matrix_N_GradGrad_[k](i,j) = matrix_N_NxNx_[k](i,j) + matrix_N_NyNy_[k](i,j);
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverElement::ContractMatrices : Gets the matrices of each family contracted with the
+ * coefficients of a field, \f$ \sum_k \beta_k M_k \f$.
+ *
+ * Generic version: sets up the matrices of every coefficient function (unless they already are)
+ * and adds them up. Derived classes override it to contract while integrating, without ever
+ * storing one matrix per coefficient function.
+ * @param [in] coefficients : \f$ \beta_k \f$, num_coefficient_functions() values
+ * @param [out] N_NxNx : contracted N_NxNx matrix (or NULL)
+ * @param [out] N_NyNy : contracted N_NyNy matrix (or NULL)
+ * @param [out] N_NN : contracted N_NN matrix (or NULL)
+ * @param [out] N_GradGrad : contracted N_GradGrad matrix (or NULL) */
+//************************************************************************************************//
+void SolverElement::ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                                     SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                                     SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                                     SymmetricMatrix<cemDOUBLE>* N_NN,
+                                     SymmetricMatrix<cemDOUBLE>* N_GradGrad)
+{
+    cemINT num_matrices = num_coefficient_functions();
+    if (static_cast<cemINT>(coefficients.size()) != num_matrices)
+        throw(Exception("INPUT ERROR","Expected one coefficient per coefficient function"));
+
+    if (static_cast<cemINT>(matrix_N_NN_.size()) != num_matrices ||
+        static_cast<cemINT>(matrix_N_GradGrad_.size()) != num_matrices)
+        setUp_matrices(false);
+
+    if (N_NxNx != NULL)
+        Contract(matrix_N_NxNx_,coefficients,*N_NxNx);
+    if (N_NyNy != NULL)
+        Contract(matrix_N_NyNy_,coefficients,*N_NyNy);
+    if (N_NN != NULL)
+        Contract(matrix_N_NN_,coefficients,*N_NN);
+    if (N_GradGrad != NULL)
+        Contract(matrix_N_GradGrad_,coefficients,*N_GradGrad);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverElement::Contract : Adds up a family of matrices scaled by coefficients.
+ * @param [in] matrices : one matrix per coefficient function
+ * @param [in] coefficients : one coefficient per matrix
+ * @param [out] contracted : \f$ \sum_k \beta_k M_k \f$ */
+//************************************************************************************************//
+void SolverElement::Contract(const std::vector< SymmetricMatrix<cemDOUBLE> >& matrices,
+                             const std::vector<cemDOUBLE>& coefficients,
+                             SymmetricMatrix<cemDOUBLE>& contracted)
+{
+    cemINT n = matrices[0].num_rows();
+    cemINT size = n*(n+1)/2;
+    contracted.resize(n,n);
+    contracted.initialize();
+
+    cemDOUBLE* out = &contracted(0,0);
+    for (size_t k=0; k<matrices.size(); ++k)
+    {
+        const cemDOUBLE* in = &matrices[k](0,0);
+        for (cemINT m=0; m<size; ++m)
+            out[m] += coefficients[k]*in[m];
+    }
 }
 
 
@@ -252,6 +382,8 @@ void SolverElement::set_coefficient_order(const cemINT &order)
 ///***********************************************************************************************//
 /// CLASS SolverTriangle:
 ///***********************************************************************************************//
+const cemINT SolverTriangle::CURVILINEAR_EXTRA_ORDER;
+
 
 //************************************************************************************************//
 /** @brief SolverTriangle::SolverTriangle : Constructor with parameters.
@@ -275,7 +407,11 @@ SolverTriangle::SolverTriangle(const cem_mesh::Element* element_ptr,
     if (element_ptr->type() != Element::TRI)
         throw(Exception("WRONG ELEMENT TYPE","Expected a Triangle (TRI)"));
 
+    CheckQuadratureOrder(basis_order,coefficient_order);
+
     element_ptr_ = element_ptr;
+    geometry_is_Up_ = false;
+    is_curvilinear_ = false;
 }
 
 
@@ -291,6 +427,8 @@ void SolverTriangle::set_element_ptr(const cem_mesh::Element *element_ptr)
 
     element_ptr_ = element_ptr;
     geometry_is_Up_ = false;
+    matrices_are_Up_ = false;
+    is_curvilinear_ = false;
 }
 
 
@@ -303,6 +441,20 @@ void SolverTriangle::setUp_matrix_N_NxNx(cemBOOL force_numerical_integration)
     // Pre-compute common terms if they haven't been computed yet:
     setUpGeometry();
 
+    // Curvilinear triangles and hierarchical functions are integrated numerically, all families
+    // at once, so only the first of the setUp_matrix_* calls integrates:
+    if (is_curvilinear_ || basis_function_type_ == HIERARCHICAL)
+    {
+        if (matrices_are_Up_)
+            return;
+
+        if (is_curvilinear_)
+            Compute_matrices_curvilinear();
+        else
+            Compute_matrices_numerically();
+        return;
+    }
+
     // Number of matrices depends on the polynomial order of the coefficients:
     cemINT num_matrices = (coefficient_order_+1)*(coefficient_order_+2)/2;
     matrix_N_NxNx_.resize(num_matrices);
@@ -310,6 +462,9 @@ void SolverTriangle::setUp_matrix_N_NxNx(cemBOOL force_numerical_integration)
     if (coefficient_order_ <= 1 && basis_function_order_ <= 3 && !force_numerical_integration)
         Compute_N_NxNx_matrix_analytically();
 
+    else if (!force_numerical_integration)
+        Compute_N_NxNx_matrix_from_reference();
+
     else
     {
         for (cemINT i=0; i<num_matrices; ++i)
@@ -327,6 +482,20 @@ void SolverTriangle::setUp_matrix_N_NyNy(cemBOOL force_numerical_integration)
     // Pre-compute common terms if they haven't been computed yet:
     setUpGeometry();
 
+    // Curvilinear triangles and hierarchical functions are integrated numerically, all families
+    // at once, so only the first of the setUp_matrix_* calls integrates:
+    if (is_curvilinear_ || basis_function_type_ == HIERARCHICAL)
+    {
+        if (matrices_are_Up_)
+            return;
+
+        if (is_curvilinear_)
+            Compute_matrices_curvilinear();
+        else
+            Compute_matrices_numerically();
+        return;
+    }
+
     // Number of matrices depends on the polynomial order of the coefficients:
     cemINT num_matrices = (coefficient_order_+1)*(coefficient_order_+2)/2;
     matrix_N_NyNy_.resize(num_matrices);
@@ -334,6 +503,9 @@ void SolverTriangle::setUp_matrix_N_NyNy(cemBOOL force_numerical_integration)
     if (coefficient_order_ <= 1 && basis_function_order_ <= 3 && !force_numerical_integration)
         Compute_N_NyNy_matrix_analytically();
 
+    else if (!force_numerical_integration)
+        Compute_N_NyNy_matrix_from_reference();
+
     else
     {
         for (cemINT i=0; i<num_matrices; ++i)
@@ -351,6 +523,20 @@ void SolverTriangle::setUp_matrix_N_NN(cemBOOL force_numerical_integration)
     // Pre-compute common terms if they haven't been computed yet:
     setUpGeometry();
 
+    // Curvilinear triangles and hierarchical functions are integrated numerically, all families
+    // at once, so only the first of the setUp_matrix_* calls integrates:
+    if (is_curvilinear_ || basis_function_type_ == HIERARCHICAL)
+    {
+        if (matrices_are_Up_)
+            return;
+
+        if (is_curvilinear_)
+            Compute_matrices_curvilinear();
+        else
+            Compute_matrices_numerically();
+        return;
+    }
+
     // Number of matrices depends on the polynomial order of the coefficients:
     cemINT num_matrices = (coefficient_order_+1)*(coefficient_order_+2)/2;
     matrix_N_NN_.resize(num_matrices);
@@ -358,6 +544,9 @@ void SolverTriangle::setUp_matrix_N_NN(cemBOOL force_numerical_integration)
     if (coefficient_order_ <= 1 && basis_function_order_ <= 3 && !force_numerical_integration)
         Compute_N_NN_matrix_analytically();
 
+    else if (!force_numerical_integration)
+        Compute_N_NN_matrix_from_reference();
+
     else
     {
         for (cemINT i=0; i<num_matrices; ++i)
@@ -366,6 +555,206 @@ void SolverTriangle::setUp_matrix_N_NN(cemBOOL force_numerical_integration)
 }
 
 
+//************************************************************************************************//
+/** @brief SolverTriangle::setUp_matrices : Set up N_NxNx, N_NyNy, N_NN and N_GradGrad matrices
+ * in a single pass.
+ *
+ * Callers that need every family should use this instead of the individual setUp_matrix_*
+ * functions: the geometry is set up once, and each basis and coefficient function is evaluated
+ * once per quadrature point (or each reference tensor entry is read once) for all four families.
+ * @param [in] force_numerical_integration : use numerical integration for every family
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+void SolverTriangle::setUp_matrices(cemBOOL force_numerical_integration)
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    // Curvilinear triangles are always integrated numerically:
+    if (is_curvilinear_)
+    {
+        Compute_matrices_curvilinear();
+        return;
+    }
+
+    // Number of matrices depends on the polynomial order of the coefficients:
+    cemINT num_matrices = (coefficient_order_+1)*(coefficient_order_+2)/2;
+    matrix_N_NxNx_.resize(num_matrices);
+    matrix_N_NyNy_.resize(num_matrices);
+    matrix_N_NN_.resize(num_matrices);
+    matrix_N_GradGrad_.resize(num_matrices);
+
+    if (basis_function_type_ == HIERARCHICAL)
+        Compute_matrices_numerically();
+
+    else if (coefficient_order_ <= 1 && basis_function_order_ <= 3 && !force_numerical_integration)
+    {
+        Compute_N_NxNx_matrix_analytically();
+        Compute_N_NyNy_matrix_analytically();
+        Compute_N_NN_matrix_analytically();
+
+        cemINT n = matrix_N_NxNx_[0].num_rows();
+        for (cemINT k=0; k<num_matrices; ++k)
+        {
+            matrix_N_GradGrad_[k].resize(n,n);
+            for (cemINT j=0; j<n; ++j)
+            {
+                for (cemINT i=j; i<n; ++i)
+                    matrix_N_GradGrad_[k](i,j) = matrix_N_NxNx_[k](i,j) + matrix_N_NyNy_[k](i,j);
+            }
+        }
+    }
+
+    else if (!force_numerical_integration)
+        Compute_matrices_from_reference();
+
+    else
+        Compute_matrices_numerically();
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::UpdateBasisFunctionOrder : Changes the order of the basis functions
+ * and updates the matrices.
+ *
+ * Hierarchical functions of order p-1 are the leading functions of order p, so the matrices of
+ * order p-1 are the leading blocks of the matrices of order p. When the matrices of a flat
+ * triangle with hierarchical functions are already set up, raising the order only integrates the
+ * new rows (and columns), and lowering it only drops them. The kept rows were integrated with the
+ * rule of the other order, which is only exact because both rules integrate the polynomial
+ * integrands of a flat triangle exactly. Curvilinear triangles have rational integrands, so their
+ * matrices, like those of any other case, are set up again with setUp_matrices() at the new
+ * order.
+ * @param [in] order : new polynomial order of the basis functions (>= 1)
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+void SolverTriangle::UpdateBasisFunctionOrder(const cemINT& order)
+{
+    if (order < 1)
+        throw(Exception("INPUT ERROR","order must be > 0"));
+
+    CheckQuadratureOrder(order,coefficient_order_);
+
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    // Check that the matrices of the current order are there:
+    cemINT num_matrices = num_coefficient_functions();
+    cemINT n_old = TriHierarchicalShapeFunction::NumFunctions(basis_function_order_);
+    cemBOOL is_set_up = (matrix_N_NxNx_.size() == static_cast<size_t>(num_matrices) &&
+                         matrix_N_NyNy_.size() == static_cast<size_t>(num_matrices) &&
+                         matrix_N_NN_.size() == static_cast<size_t>(num_matrices) &&
+                         matrix_N_GradGrad_.size() == static_cast<size_t>(num_matrices));
+    for (cemINT k=0; k<num_matrices && is_set_up; ++k)
+    {
+        is_set_up = (static_cast<cemINT>(matrix_N_NxNx_[k].num_rows()) == n_old &&
+                     static_cast<cemINT>(matrix_N_NyNy_[k].num_rows()) == n_old &&
+                     static_cast<cemINT>(matrix_N_NN_[k].num_rows()) == n_old &&
+                     static_cast<cemINT>(matrix_N_GradGrad_[k].num_rows()) == n_old);
+    }
+
+    // Reuse is exact for flat triangles only (see above):
+    if (basis_function_type_ != HIERARCHICAL || is_curvilinear_ || !is_set_up)
+    {
+        basis_function_order_ = order;
+        setUp_matrices(false);
+        return;
+    }
+
+    if (order > basis_function_order_)
+    {
+        basis_function_order_ = order;
+        Compute_matrices_numerically(n_old);
+    }
+
+    else if (order < basis_function_order_)
+    {
+        // Keep the leading blocks only:
+        cemINT n = TriHierarchicalShapeFunction::NumFunctions(order);
+        std::vector< SymmetricMatrix<cemDOUBLE> >* families[4] = {&matrix_N_NxNx_,&matrix_N_NyNy_,
+                                                                  &matrix_N_NN_,&matrix_N_GradGrad_};
+        SymmetricMatrix<cemDOUBLE> block(n,n);
+        for (cemINT f=0; f<4; ++f)
+        {
+            for (cemINT k=0; k<num_matrices; ++k)
+            {
+                SymmetricMatrix<cemDOUBLE>& matrix = (*families[f])[k];
+                for (cemINT j=0; j<n; ++j)
+                {
+                    for (cemINT i=j; i<n; ++i)
+                        block(i,j) = matrix(i,j);
+                }
+                matrix = block;
+            }
+        }
+        basis_function_order_ = order;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::ContractMatrices : Gets the matrices of each family contracted with the
+ * coefficients of a field, \f$ \sum_k \beta_k M_k \f$.
+ *
+ * The contraction is fused with the integration: flat triangles contract the reference tensors
+ * first and apply the geometry factors once, while curvilinear triangles and hierarchical
+ * functions add up the coefficient functions at each quadrature point. Either way only one
+ * matrix per family is built, and the matrices of this element (matrix_N_NxNx() and the rest)
+ * are left untouched.
+ * @param [in] coefficients : \f$ \beta_k \f$, num_coefficient_functions() values
+ * @param [out] N_NxNx : contracted N_NxNx matrix (or NULL)
+ * @param [out] N_NyNy : contracted N_NyNy matrix (or NULL)
+ * @param [out] N_NN : contracted N_NN matrix (or NULL)
+ * @param [out] N_GradGrad : contracted N_GradGrad matrix (or NULL)
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+void SolverTriangle::ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                                      SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                                      SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                                      SymmetricMatrix<cemDOUBLE>* N_NN,
+                                      SymmetricMatrix<cemDOUBLE>* N_GradGrad)
+{
+    if (static_cast<cemINT>(coefficients.size()) != num_coefficient_functions())
+        throw(Exception("INPUT ERROR","Expected one coefficient per coefficient function"));
+
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    std::vector<cemDOUBLE> K_x,K_y,M;
+    if (is_curvilinear_ || basis_function_type_ == HIERARCHICAL)
+        Contract_matrices_numerically(coefficients,K_x,K_y,M);
+    else
+        Contract_matrices_from_reference(coefficients,K_x,K_y,M);
+
+    cemINT n = (basis_function_order_+1)*(basis_function_order_+2)/2;
+    OrientEdgeFunctions(n,0,&K_x[0]);
+    OrientEdgeFunctions(n,0,&K_y[0]);
+    OrientEdgeFunctions(n,0,&M[0]);
+
+    // Copy packed entries out:
+    cemINT size = n*(n+1)/2;
+    SymmetricMatrix<cemDOUBLE>* outputs[3] = {N_NxNx, N_NyNy, N_NN};
+    const std::vector<cemDOUBLE>* values[3] = {&K_x, &K_y, &M};
+    for (cemINT f=0; f<3; ++f)
+    {
+        if (outputs[f] == NULL)
+            continue;
+
+        outputs[f]->resize(n,n);
+        cemDOUBLE* out = &(*outputs[f])(0,0);
+        for (cemINT m=0; m<size; ++m)
+            out[m] = (*values[f])[m];
+    }
+    if (N_GradGrad != NULL)
+    {
+        N_GradGrad->resize(n,n);
+        cemDOUBLE* out = &(*N_GradGrad)(0,0);
+        for (cemINT m=0; m<size; ++m)
+            out[m] = K_x[m] + K_y[m];
+    }
+}
+
+
 //************************************************************************************************//
 /** @brief SolverTriangle::Compute_N_NxNx_matrix_analytically : Computes all N_NxNx matrices using
  * analytic integration.
@@ -2526,118 +2915,444 @@ void SolverTriangle::Compute_N_NN_matrix_analytically()
 
 
 //************************************************************************************************//
-/** @brief SolverTriangle::Compute_N_NxNx_matrix_numerically : Computes a single N_NxNx matrix
- * for the given coefficient function, using numerical integration.
+/** @brief SolverTriangle::Compute_N_NxNx_matrix_from_reference : Computes all N_NxNx matrices by
+ * contracting the reference tensors of the triangle with its geometry factors.
  *
- * As far as this function concerns, there is no limit on the polynomial order of the basis
- * functions or the coefficient functions. There could be, however, a limit due to quadrature
- * rules or other functions used.
- * @param [in] coefficient_index : index of the coefficient function */
+ * The reference tensors (see TriReferenceTensors) are integrated once per pair of orders, so
+ * this is as fast as the analytical expressions for any order of basis and coefficient
+ * functions supported by the quadrature rules. */
 //************************************************************************************************//
-void SolverTriangle::Compute_N_NxNx_matrix_numerically(const cemINT& coefficient_index)
+void SolverTriangle::Compute_N_NxNx_matrix_from_reference()
 {
     // Pre-compute common terms if they haven't been computed yet:
     setUpGeometry();
 
-    cemINT num_basis_functions = (basis_function_order_+1)*(basis_function_order_+2)/2;
-    cemINT matrix_index = 0;
-    if (coefficient_order_ > 0)
-        matrix_index = coefficient_index;
-
-    matrix_N_NxNx_[matrix_index].resize(num_basis_functions,num_basis_functions);
-    for (cemINT j=0; j<num_basis_functions; ++j)
+    const TriReferenceTensors& tensors = TriReferenceTensors::Get(basis_function_order_,
+                                                                  coefficient_order_);
+    cemINT num_basis_functions = tensors.num_basis_functions();
+    for (cemINT k=0; k<tensors.num_coefficient_functions(); ++k)
     {
-        for (cemINT i=0; i<num_basis_functions; ++i)
-            matrix_N_NxNx_[matrix_index](i,j) = Compute_N_NxNx_matrix_entry(coefficient_index,i,j);
+        matrix_N_NxNx_[k].resize(num_basis_functions,num_basis_functions);
+        tensors.Compute_N_NdNd_matrix(b1_,b2_,delta_,k,&matrix_N_NxNx_[k](0,0));
     }
 }
 
 
 //************************************************************************************************//
-/** @brief SolverTriangle::Compute_N_NyNy_matrix_numerically :  Computes a single N_NyNy matrix
- * for the given coefficient function, using numerical integration.
- *
- * As far as this function concerns, there is no limit on the polynomial order of the basis
- * functions or the coefficient functions. There could be, however, a limit due to quadrature
- * rules or other functions used.
- * @param [in] coefficient_index : index of the coefficient function */
+/** @brief SolverTriangle::Compute_N_NyNy_matrix_from_reference : Computes all N_NyNy matrices by
+ * contracting the reference tensors of the triangle with its geometry factors. */
 //************************************************************************************************//
-void SolverTriangle::Compute_N_NyNy_matrix_numerically(const cemINT& coefficient_index)
+void SolverTriangle::Compute_N_NyNy_matrix_from_reference()
 {
     // Pre-compute common terms if they haven't been computed yet:
     setUpGeometry();
 
-    cemINT num_basis_functions = (basis_function_order_+1)*(basis_function_order_+2)/2;
-    cemINT matrix_index = 0;
-    if (coefficient_order_ > 0)
-        matrix_index = coefficient_index;
+    const TriReferenceTensors& tensors = TriReferenceTensors::Get(basis_function_order_,
+                                                                  coefficient_order_);
+    cemINT num_basis_functions = tensors.num_basis_functions();
+    for (cemINT k=0; k<tensors.num_coefficient_functions(); ++k)
+    {
+        matrix_N_NyNy_[k].resize(num_basis_functions,num_basis_functions);
+        tensors.Compute_N_NdNd_matrix(c1_,c2_,delta_,k,&matrix_N_NyNy_[k](0,0));
+    }
+}
 
-    matrix_N_NyNy_[matrix_index].resize(num_basis_functions,num_basis_functions);
-    for (cemINT j=0; j<num_basis_functions; ++j)
+
+//************************************************************************************************//
+/** @brief SolverTriangle::Compute_N_NN_matrix_from_reference : Computes all N_NN matrices by
+ * scaling the reference mass tensors with the area of the triangle. */
+//************************************************************************************************//
+void SolverTriangle::Compute_N_NN_matrix_from_reference()
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    const TriReferenceTensors& tensors = TriReferenceTensors::Get(basis_function_order_,
+                                                                  coefficient_order_);
+    cemINT num_basis_functions = tensors.num_basis_functions();
+    for (cemINT k=0; k<tensors.num_coefficient_functions(); ++k)
     {
-        for (cemINT i=0; i<num_basis_functions; ++i)
-            matrix_N_NyNy_[matrix_index](i,j) = Compute_N_NyNy_matrix_entry(coefficient_index,i,j);
+        matrix_N_NN_[k].resize(num_basis_functions,num_basis_functions);
+        tensors.Compute_N_NN_matrix(delta_,k,&matrix_N_NN_[k](0,0));
     }
 }
 
 
 //************************************************************************************************//
-/** @brief SolverTriangle::Compute_N_NN_matrix_numerically :  Computes a single N_NN matrix
- * for the given coefficient function, using numerical integration.
- *
- * As far as this function concerns, there is no limit on the polynomial order of the basis
- * functions or the coefficient functions. There could be, however, a limit due to quadrature
- * rules or other functions used.
- * @param [in] coefficient_index : index of the coefficient function */
+/** @brief SolverTriangle::Compute_matrices_from_reference : Computes all N_NxNx, N_NyNy, N_NN
+ * and N_GradGrad matrices in one sweep over the reference tensors. */
 //************************************************************************************************//
-void SolverTriangle::Compute_N_NN_matrix_numerically(const cemINT& coefficient_index)
+void SolverTriangle::Compute_matrices_from_reference()
 {
     // Pre-compute common terms if they haven't been computed yet:
     setUpGeometry();
 
-    cemINT num_basis_functions = (basis_function_order_+1)*(basis_function_order_+2)/2;
-    cemINT matrix_index = 0;
-    if (coefficient_order_ > 0)
-        matrix_index = coefficient_index;
+    const TriReferenceTensors& tensors = TriReferenceTensors::Get(basis_function_order_,
+                                                                  coefficient_order_);
+    cemINT num_basis_functions = tensors.num_basis_functions();
+    cemINT size = tensors.num_packed_entries();
 
-    matrix_N_NN_[matrix_index].resize(num_basis_functions,num_basis_functions);
-    for (cemINT j=0; j<num_basis_functions; ++j)
+    // Use the specialized kernel of these orders if there is one:
+    TriKernels::ReferenceKernel kernel = TriKernels::GetReferenceKernel(basis_function_order_,
+                                                                        coefficient_order_);
+    if (kernel != NULL)
     {
-        for (cemINT i=0; i<num_basis_functions; ++i)
-            matrix_N_NN_[matrix_index](i,j) = Compute_N_NN_matrix_entry(coefficient_index,i,j);
+        for (cemINT k=0; k<tensors.num_coefficient_functions(); ++k)
+        {
+            matrix_N_NxNx_[k].resize(num_basis_functions,num_basis_functions);
+            matrix_N_NyNy_[k].resize(num_basis_functions,num_basis_functions);
+            matrix_N_NN_[k].resize(num_basis_functions,num_basis_functions);
+            matrix_N_GradGrad_[k].resize(num_basis_functions,num_basis_functions);
+            kernel(tensors,k,b1_,b2_,c1_,c2_,delta_,
+                   &matrix_N_NxNx_[k](0,0),&matrix_N_NyNy_[k](0,0),
+                   &matrix_N_NN_[k](0,0),&matrix_N_GradGrad_[k](0,0));
+        }
+        return;
+    }
+
+    // Geometry factors:
+    cemDOUBLE inverse_two_delta = 0.5/delta_;
+    cemDOUBLE gx_ksi_ksi = b1_*b1_*inverse_two_delta;
+    cemDOUBLE gx_ksi_eta = b1_*b2_*inverse_two_delta;
+    cemDOUBLE gx_eta_eta = b2_*b2_*inverse_two_delta;
+    cemDOUBLE gy_ksi_ksi = c1_*c1_*inverse_two_delta;
+    cemDOUBLE gy_ksi_eta = c1_*c2_*inverse_two_delta;
+    cemDOUBLE gy_eta_eta = c2_*c2_*inverse_two_delta;
+    cemDOUBLE two_delta = 2.0*delta_;
+
+    for (cemINT k=0; k<tensors.num_coefficient_functions(); ++k)
+    {
+        matrix_N_NxNx_[k].resize(num_basis_functions,num_basis_functions);
+        matrix_N_NyNy_[k].resize(num_basis_functions,num_basis_functions);
+        matrix_N_NN_[k].resize(num_basis_functions,num_basis_functions);
+        matrix_N_GradGrad_[k].resize(num_basis_functions,num_basis_functions);
+
+        const cemDOUBLE* A = tensors.tensor_ksi_ksi(k);
+        const cemDOUBLE* B = tensors.tensor_ksi_eta(k);
+        const cemDOUBLE* C = tensors.tensor_eta_eta(k);
+        const cemDOUBLE* M = tensors.tensor_mass(k);
+        cemDOUBLE* N_NxNx = &matrix_N_NxNx_[k](0,0);
+        cemDOUBLE* N_NyNy = &matrix_N_NyNy_[k](0,0);
+        cemDOUBLE* N_NN = &matrix_N_NN_[k](0,0);
+        cemDOUBLE* N_GradGrad = &matrix_N_GradGrad_[k](0,0);
+        for (cemINT m=0; m<size; ++m)
+        {
+            N_NxNx[m] = gx_ksi_ksi*A[m] + gx_ksi_eta*B[m] + gx_eta_eta*C[m];
+            N_NyNy[m] = gy_ksi_ksi*A[m] + gy_ksi_eta*B[m] + gy_eta_eta*C[m];
+            N_NN[m] = two_delta*M[m];
+            N_GradGrad[m] = N_NxNx[m] + N_NyNy[m];
+        }
     }
 }
 
 
 //************************************************************************************************//
-/** @brief SolverTriangle::Compute_N_NxNx_matrix_entry : Computes single matrix entry using
- * numerical integration.
+/** @brief SolverTriangle::Compute_matrices_numerically : Computes all N_NxNx, N_NyNy, N_NN and
+ * N_GradGrad matrices in one pass over the quadrature points.
  *
- * Computes \f[
- *  \iint\limits_{\Omega^{e}} \alpha_{k}^{e}\frac{\partial N_{i}^{e}}{\partial x}
- * \frac{\partial N_{j}^{e}}{\partial x}dxdy \f] using
- * quadrature rules. \f$ \beta_{k}^{e} \f$ is the \f$ k \f$-th coefficient function, and
- * \f$ N_{i}^{e} \f$ and \f$ N_{j}^{e} \f$ are the \f$ i \f$-th and \f$ j \f$-th basis functions
- * respectively.
- * @param [in] coefficient_index : index \f$ k \f$ of the coefficient function.
- * @param [in] test_function_index : index \f$ i \f$ of the test basis function.
- * @param [in] source_function_index : index \f$ j \f$ of the source basis function.
- * @return \f$ \iint\limits_{\Omega^{e}} \alpha_{k}^{e}\frac{\partial N_{i}^{e}}{\partial x}
- * \frac{\partial N_{j}^{e}}{\partial x}dxdy \f$ */
+ * Basis functions, their derivatives and the coefficient functions are taken from the shared
+ * TriTabulation, so nothing is evaluated per element. At each quadrature point the physical
+ * derivatives are formed once and accumulated into every matrix.
+ *
+ * With hierarchical functions, the matrices may already hold the leading blocks of a lower
+ * order: then only the rows from first_new_row on are integrated, and the leading blocks are
+ * kept as they are.
+ * @param [in] first_new_row : number of leading rows already computed (0 to compute all) */
 //************************************************************************************************//
-cemDOUBLE SolverTriangle::Compute_N_NxNx_matrix_entry(const cemINT& coefficient_index,
-                                                      const cemINT& test_function_index,
-                                                      const cemINT& source_function_index) const
+void SolverTriangle::Compute_matrices_numerically(const cemINT& first_new_row)
 {
-    // Get quadrature:
-    cem_core::TriQuadrature quadrature;
-    cemINT num_points = quadrature.getNumPointsForPolyOrder(coefficient_order_ + 2*basis_function_order_);
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
 
-    const std::vector<cemDOUBLE>& ksi_points = quadrature.getKsiCoordinates(num_points);
-    const std::vector<cemDOUBLE>& eta_points = quadrature.getEtaCoordinates(num_points);
-    const std::vector<cemDOUBLE>& weights = quadrature.getWeights(num_points);
+    const TriTabulation& tabulation = TriTabulation::Get(basis_function_order_,
+                                                         coefficient_order_,
+                                                         0,
+                                                         basis_function_type_);
+    cemINT n = tabulation.num_basis_functions();
+    cemINT num_coefficients = tabulation.num_coefficient_functions();
+    cemINT num_points = tabulation.num_points();
+    const cemDOUBLE* weights = tabulation.weights();
+
+    matrix_N_NxNx_.resize(num_coefficients);
+    matrix_N_NyNy_.resize(num_coefficients);
+    matrix_N_NN_.resize(num_coefficients);
+    matrix_N_GradGrad_.resize(num_coefficients);
+
+    // Use the specialized kernel of these orders if there is one:
+    TriKernels::NumericalKernel kernel = TriKernels::GetNumericalKernel(basis_function_order_,
+                                                                        coefficient_order_);
+    if (kernel != NULL && first_new_row == 0)
+    {
+        cemDOUBLE* N_NxNx[TriKernels::MAX_COEFFICIENTS];
+        cemDOUBLE* N_NyNy[TriKernels::MAX_COEFFICIENTS];
+        cemDOUBLE* N_NN[TriKernels::MAX_COEFFICIENTS];
+        cemDOUBLE* N_GradGrad[TriKernels::MAX_COEFFICIENTS];
+        for (cemINT k=0; k<num_coefficients; ++k)
+        {
+            matrix_N_NxNx_[k].resize(n,n);
+            matrix_N_NyNy_[k].resize(n,n);
+            matrix_N_NN_[k].resize(n,n);
+            matrix_N_GradGrad_[k].resize(n,n);
+            N_NxNx[k] = &matrix_N_NxNx_[k](0,0);
+            N_NyNy[k] = &matrix_N_NyNy_[k](0,0);
+            N_NN[k] = &matrix_N_NN_[k](0,0);
+            N_GradGrad[k] = &matrix_N_GradGrad_[k](0,0);
+        }
+        kernel(tabulation,&inverse_jacobian_matrix_(0,0),jacobian_matrix_.determinant(),
+               N_NxNx,N_NyNy,N_NN,N_GradGrad);
+        for (cemINT k=0; k<num_coefficients; ++k)
+        {
+            OrientEdgeFunctions(n,0,N_NxNx[k]);
+            OrientEdgeFunctions(n,0,N_NyNy[k]);
+            OrientEdgeFunctions(n,0,N_NN[k]);
+            OrientEdgeFunctions(n,0,N_GradGrad[k]);
+        }
+        matrices_are_Up_ = true;
+        return;
+    }
 
-    // Prepare to evaluate:
+    // Keep the leading blocks already computed:
+    std::vector< SymmetricMatrix<cemDOUBLE> > old_NxNx,old_NyNy,old_NN;
+    if (first_new_row > 0)
+    {
+        old_NxNx = matrix_N_NxNx_;
+        old_NyNy = matrix_N_NyNy_;
+        old_NN = matrix_N_NN_;
+    }
+
+    for (cemINT k=0; k<num_coefficients; ++k)
+    {
+        matrix_N_NxNx_[k].resize(n,n);
+        matrix_N_NyNy_[k].resize(n,n);
+        matrix_N_NN_[k].resize(n,n);
+        matrix_N_NxNx_[k].initialize();
+        matrix_N_NyNy_[k].initialize();
+        matrix_N_NN_[k].initialize();
+        for (cemINT j=0; j<first_new_row; ++j)
+        {
+            for (cemINT i=j; i<first_new_row; ++i)
+            {
+                matrix_N_NxNx_[k](i,j) = old_NxNx[k](i,j);
+                matrix_N_NyNy_[k](i,j) = old_NyNy[k](i,j);
+                matrix_N_NN_[k](i,j) = old_NN[k](i,j);
+            }
+        }
+    }
+
+    // Add contributions of each quadrature point (matrices are packed, see SymmetricMatrix):
+    cemDOUBLE dksi_dx = inverse_jacobian_matrix_(0,0);
+    cemDOUBLE deta_dx = inverse_jacobian_matrix_(0,1);
+    cemDOUBLE dksi_dy = inverse_jacobian_matrix_(1,0);
+    cemDOUBLE deta_dy = inverse_jacobian_matrix_(1,1);
+    cemDOUBLE determinant = jacobian_matrix_.determinant();
+    std::vector<cemDOUBLE> N_x(n),N_y(n);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        const cemDOUBLE* N = tabulation.basis(t);
+        const cemDOUBLE* N_ksi = tabulation.basis_ksi_deriv(t);
+        const cemDOUBLE* N_eta = tabulation.basis_eta_deriv(t);
+        const cemDOUBLE* coefficients = tabulation.coefficients(t);
+        for (cemINT i=0; i<n; ++i)
+        {
+            N_x[i] = dksi_dx*N_ksi[i] + deta_dx*N_eta[i];
+            N_y[i] = dksi_dy*N_ksi[i] + deta_dy*N_eta[i];
+        }
+
+        for (cemINT k=0; k<num_coefficients; ++k)
+        {
+            cemDOUBLE w = weights[t]*coefficients[k]*determinant;
+            cemDOUBLE* N_NxNx = &matrix_N_NxNx_[k](0,0);
+            cemDOUBLE* N_NyNy = &matrix_N_NyNy_[k](0,0);
+            cemDOUBLE* N_NN = &matrix_N_NN_[k](0,0);
+            for (cemINT j=0; j<n; ++j)
+            {
+                // Column j starts at j*n - j*(j-1)/2; skip the rows already computed:
+                cemINT first = (j > first_new_row) ? j : first_new_row;
+                cemINT m = j*n - j*(j-1)/2 + (first-j);
+                for (cemINT i=first; i<n; ++i, ++m)
+                {
+                    N_NxNx[m] += w*N_x[i]*N_x[j];
+                    N_NyNy[m] += w*N_y[i]*N_y[j];
+                    N_NN[m] += w*N[i]*N[j];
+                }
+            }
+        }
+    }
+
+    // Orient edge functions, and add up gradients:
+    for (cemINT k=0; k<num_coefficients; ++k)
+    {
+        OrientEdgeFunctions(n,first_new_row,&matrix_N_NxNx_[k](0,0));
+        OrientEdgeFunctions(n,first_new_row,&matrix_N_NyNy_[k](0,0));
+        OrientEdgeFunctions(n,first_new_row,&matrix_N_NN_[k](0,0));
+        matrix_N_GradGrad_[k] = matrix_N_NxNx_[k];
+        matrix_N_GradGrad_[k] += matrix_N_NyNy_[k];
+    }
+    matrices_are_Up_ = true;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::OrientEdgeFunctions : Orients the hierarchical edge functions of odd
+ * degree along the global direction of their edge.
+ *
+ * Edge functions of odd degree change sign with the direction of the edge (see
+ * TriHierarchicalShapeFunction), so the function of edge (a,b) is negated unless node a comes
+ * before node b (NodeBefore). Neighboring elements then share the same function on their common
+ * edge, whatever their local vertex order. Entry (i,j) is multiplied by \f$ s_i s_j \f$ in the
+ * rows from first_new_row on. Does nothing for interpolatory functions.
+ * @param [in] n : number of basis functions (rows of the matrix)
+ * @param [in] first_new_row : rows before it are already oriented
+ * @param [in,out] packed : packed symmetric matrix (see SymmetricMatrix) */
+//************************************************************************************************//
+void SolverTriangle::OrientEdgeFunctions(const cemINT& n,
+                                         const cemINT& first_new_row,
+                                         cemDOUBLE* packed) const
+{
+    if (basis_function_type_ != HIERARCHICAL)
+        return;
+
+    // Functions of degree k start at NumFunctions(k-1), edge functions (0-1, 1-2, 2-0) first:
+    std::vector<cemDOUBLE> sign(n,1.0);
+    cemBOOL is_flipped = false;
+    for (cemINT k=3; k<=basis_function_order_; k+=2)
+    {
+        cemINT first = TriHierarchicalShapeFunction::NumFunctions(k-1);
+        for (cemINT e=0; e<3; ++e)
+        {
+            if (!NodeBefore(element_ptr_->node(e),element_ptr_->node((e+1)%3)))
+            {
+                sign[first + e] = -1.0;
+                is_flipped = true;
+            }
+        }
+    }
+    if (!is_flipped)
+        return;
+
+    for (cemINT j=0; j<n; ++j)
+    {
+        cemINT first = (j > first_new_row) ? j : first_new_row;
+        cemINT m = j*n - j*(j-1)/2 + (first-j);
+        for (cemINT i=first; i<n; ++i, ++m)
+            packed[m] *= sign[i]*sign[j];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::Compute_N_NxNx_matrix_numerically : Computes a single N_NxNx matrix
+ * for the given coefficient function, using numerical integration.
+ *
+ * As far as this function concerns, there is no limit on the polynomial order of the basis
+ * functions or the coefficient functions. There could be, however, a limit due to quadrature
+ * rules or other functions used.
+ * @param [in] coefficient_index : index of the coefficient function */
+//************************************************************************************************//
+void SolverTriangle::Compute_N_NxNx_matrix_numerically(const cemINT& coefficient_index)
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    cemINT num_basis_functions = (basis_function_order_+1)*(basis_function_order_+2)/2;
+    cemINT matrix_index = 0;
+    if (coefficient_order_ > 0)
+        matrix_index = coefficient_index;
+
+    matrix_N_NxNx_[matrix_index].resize(num_basis_functions,num_basis_functions);
+    for (cemINT j=0; j<num_basis_functions; ++j)
+    {
+        for (cemINT i=j; i<num_basis_functions; ++i)
+            matrix_N_NxNx_[matrix_index](i,j) = Compute_N_NxNx_matrix_entry(coefficient_index,i,j);
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::Compute_N_NyNy_matrix_numerically :  Computes a single N_NyNy matrix
+ * for the given coefficient function, using numerical integration.
+ *
+ * As far as this function concerns, there is no limit on the polynomial order of the basis
+ * functions or the coefficient functions. There could be, however, a limit due to quadrature
+ * rules or other functions used.
+ * @param [in] coefficient_index : index of the coefficient function */
+//************************************************************************************************//
+void SolverTriangle::Compute_N_NyNy_matrix_numerically(const cemINT& coefficient_index)
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    cemINT num_basis_functions = (basis_function_order_+1)*(basis_function_order_+2)/2;
+    cemINT matrix_index = 0;
+    if (coefficient_order_ > 0)
+        matrix_index = coefficient_index;
+
+    matrix_N_NyNy_[matrix_index].resize(num_basis_functions,num_basis_functions);
+    for (cemINT j=0; j<num_basis_functions; ++j)
+    {
+        for (cemINT i=j; i<num_basis_functions; ++i)
+            matrix_N_NyNy_[matrix_index](i,j) = Compute_N_NyNy_matrix_entry(coefficient_index,i,j);
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::Compute_N_NN_matrix_numerically :  Computes a single N_NN matrix
+ * for the given coefficient function, using numerical integration.
+ *
+ * As far as this function concerns, there is no limit on the polynomial order of the basis
+ * functions or the coefficient functions. There could be, however, a limit due to quadrature
+ * rules or other functions used.
+ * @param [in] coefficient_index : index of the coefficient function */
+//************************************************************************************************//
+void SolverTriangle::Compute_N_NN_matrix_numerically(const cemINT& coefficient_index)
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    cemINT num_basis_functions = (basis_function_order_+1)*(basis_function_order_+2)/2;
+    cemINT matrix_index = 0;
+    if (coefficient_order_ > 0)
+        matrix_index = coefficient_index;
+
+    matrix_N_NN_[matrix_index].resize(num_basis_functions,num_basis_functions);
+    for (cemINT j=0; j<num_basis_functions; ++j)
+    {
+        for (cemINT i=j; i<num_basis_functions; ++i)
+            matrix_N_NN_[matrix_index](i,j) = Compute_N_NN_matrix_entry(coefficient_index,i,j);
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::Compute_N_NxNx_matrix_entry : Computes single matrix entry using
+ * numerical integration.
+ *
+ * Computes \f[
+ *  \iint\limits_{\Omega^{e}} \alpha_{k}^{e}\frac{\partial N_{i}^{e}}{\partial x}
+ * \frac{\partial N_{j}^{e}}{\partial x}dxdy \f] using
+ * quadrature rules. \f$ \beta_{k}^{e} \f$ is the \f$ k \f$-th coefficient function, and
+ * \f$ N_{i}^{e} \f$ and \f$ N_{j}^{e} \f$ are the \f$ i \f$-th and \f$ j \f$-th basis functions
+ * respectively.
+ * @param [in] coefficient_index : index \f$ k \f$ of the coefficient function.
+ * @param [in] test_function_index : index \f$ i \f$ of the test basis function.
+ * @param [in] source_function_index : index \f$ j \f$ of the source basis function.
+ * @return \f$ \iint\limits_{\Omega^{e}} \alpha_{k}^{e}\frac{\partial N_{i}^{e}}{\partial x}
+ * \frac{\partial N_{j}^{e}}{\partial x}dxdy \f$ */
+//************************************************************************************************//
+cemDOUBLE SolverTriangle::Compute_N_NxNx_matrix_entry(const cemINT& coefficient_index,
+                                                      const cemINT& test_function_index,
+                                                      const cemINT& source_function_index) const
+{
+    // Get quadrature:
+    cem_core::TriQuadrature quadrature;
+    cemINT num_points = quadrature.getNumPointsForPolyOrder(coefficient_order_ + 2*basis_function_order_);
+
+    const std::vector<cemDOUBLE>& ksi_points = quadrature.getKsiCoordinates(num_points);
+    const std::vector<cemDOUBLE>& eta_points = quadrature.getEtaCoordinates(num_points);
+    const std::vector<cemDOUBLE>& weights = quadrature.getWeights(num_points);
+
+    // Prepare to evaluate:
     TriShapeFunction shape_function(basis_function_order_);
     std::vector<cemDOUBLE> test_ksi_deriv,test_eta_deriv;
     std::vector<cemDOUBLE> source_ksi_deriv,source_eta_deriv;
@@ -2803,6 +3518,291 @@ cemDOUBLE SolverTriangle::Compute_N_NN_matrix_entry(const cemINT& coefficient_in
 }
 
 
+//************************************************************************************************//
+/** @brief SolverTriangle::Compute_matrices_curvilinear : Computes all N_NxNx, N_NyNy, N_NN and
+ * N_GradGrad matrices of a curvilinear (second-order) triangle.
+ *
+ * The geometry is mapped with the six node functions, so the Jacobian, its determinant and its
+ * inverse change from one quadrature point to the next. They are computed for all points first
+ * (loops over points are innermost), and then used as in Compute_matrices_numerically. The
+ * integrands are not polynomials anymore, so the rule is CURVILINEAR_EXTRA_ORDER orders higher
+ * than for flat triangles (less when 2p+q is close to the highest rule, see TriTabulation).
+ * All families are filled in this one pass, and setUp_matrix_* reuse them. */
+//************************************************************************************************//
+void SolverTriangle::Compute_matrices_curvilinear()
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    const TriTabulation& tabulation = TriTabulation::Get(basis_function_order_,
+                                                         coefficient_order_,
+                                                         CURVILINEAR_EXTRA_ORDER,
+                                                         basis_function_type_);
+    cemINT n = tabulation.num_basis_functions();
+    cemINT num_coefficients = tabulation.num_coefficient_functions();
+    cemINT num_points = tabulation.num_points();
+    const cemDOUBLE* weights = tabulation.weights();
+
+    // Determinant and inverse Jacobian at every quadrature point:
+    std::vector<cemDOUBLE> determinant,dksi_dx,deta_dx,dksi_dy,deta_dy;
+    setUpCurvilinearJacobians(tabulation,determinant,dksi_dx,deta_dx,dksi_dy,deta_dy);
+
+    cemINT num_matrices = (coefficient_order_+1)*(coefficient_order_+2)/2;
+    matrix_N_NxNx_.resize(num_matrices);
+    matrix_N_NyNy_.resize(num_matrices);
+    matrix_N_NN_.resize(num_matrices);
+    matrix_N_GradGrad_.resize(num_matrices);
+    for (cemINT k=0; k<num_coefficients; ++k)
+    {
+        matrix_N_NxNx_[k].resize(n,n);
+        matrix_N_NyNy_[k].resize(n,n);
+        matrix_N_NN_[k].resize(n,n);
+        matrix_N_NxNx_[k].initialize();
+        matrix_N_NyNy_[k].initialize();
+        matrix_N_NN_[k].initialize();
+    }
+
+    // Add contributions of each quadrature point (matrices are packed, see SymmetricMatrix):
+    std::vector<cemDOUBLE> N_x(n),N_y(n);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        const cemDOUBLE* N = tabulation.basis(t);
+        const cemDOUBLE* N_ksi = tabulation.basis_ksi_deriv(t);
+        const cemDOUBLE* N_eta = tabulation.basis_eta_deriv(t);
+        const cemDOUBLE* coefficients = tabulation.coefficients(t);
+        for (cemINT i=0; i<n; ++i)
+        {
+            N_x[i] = dksi_dx[t]*N_ksi[i] + deta_dx[t]*N_eta[i];
+            N_y[i] = dksi_dy[t]*N_ksi[i] + deta_dy[t]*N_eta[i];
+        }
+
+        for (cemINT k=0; k<num_coefficients; ++k)
+        {
+            cemDOUBLE w = weights[t]*coefficients[k]*determinant[t];
+            cemDOUBLE* N_NxNx = &matrix_N_NxNx_[k](0,0);
+            cemDOUBLE* N_NyNy = &matrix_N_NyNy_[k](0,0);
+            cemDOUBLE* N_NN = &matrix_N_NN_[k](0,0);
+            cemINT m = 0;
+            for (cemINT j=0; j<n; ++j)
+            {
+                for (cemINT i=j; i<n; ++i, ++m)
+                {
+                    N_NxNx[m] += w*N_x[i]*N_x[j];
+                    N_NyNy[m] += w*N_y[i]*N_y[j];
+                    N_NN[m] += w*N[i]*N[j];
+                }
+            }
+        }
+    }
+
+    // Orient edge functions, and add up gradients:
+    for (cemINT k=0; k<num_coefficients; ++k)
+    {
+        OrientEdgeFunctions(n,0,&matrix_N_NxNx_[k](0,0));
+        OrientEdgeFunctions(n,0,&matrix_N_NyNy_[k](0,0));
+        OrientEdgeFunctions(n,0,&matrix_N_NN_[k](0,0));
+        matrix_N_GradGrad_[k] = matrix_N_NxNx_[k];
+        matrix_N_GradGrad_[k] += matrix_N_NyNy_[k];
+    }
+    matrices_are_Up_ = true;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::setUpCurvilinearJacobians : Computes the Jacobian of a curvilinear
+ * (second-order) triangle at every quadrature point.
+ *
+ * Loops over points are innermost. A Jacobian that is singular, or changes sign, at any point
+ * means the triangle is folded.
+ * @param [in] tabulation : tabulated functions (its geometry functions are used)
+ * @param [out] determinant : determinant of the Jacobian at each point
+ * @param [out] dksi_dx, deta_dx, dksi_dy, deta_dy : inverse Jacobian at each point */
+//************************************************************************************************//
+void SolverTriangle::setUpCurvilinearJacobians(const TriTabulation& tabulation,
+                                               std::vector<cemDOUBLE>& determinant,
+                                               std::vector<cemDOUBLE>& dksi_dx,
+                                               std::vector<cemDOUBLE>& deta_dx,
+                                               std::vector<cemDOUBLE>& dksi_dy,
+                                               std::vector<cemDOUBLE>& deta_dy) const
+{
+    cemINT num_points = tabulation.num_points();
+
+    // Jacobian at every quadrature point:
+    std::vector<cemDOUBLE> x_ksi(num_points,0.0),y_ksi(num_points,0.0);
+    std::vector<cemDOUBLE> x_eta(num_points,0.0),y_eta(num_points,0.0);
+    for (cemINT a=0; a<TriTabulation::NUM_GEOMETRY_FUNCTIONS; ++a)
+    {
+        const cemDOUBLE* N_ksi = tabulation.geometry_ksi_deriv(a);
+        const cemDOUBLE* N_eta = tabulation.geometry_eta_deriv(a);
+        cemDOUBLE x = curved_x_[a];
+        cemDOUBLE y = curved_y_[a];
+        for (cemINT t=0; t<num_points; ++t)
+        {
+            x_ksi[t] += x*N_ksi[t];
+            y_ksi[t] += y*N_ksi[t];
+            x_eta[t] += x*N_eta[t];
+            y_eta[t] += y*N_eta[t];
+        }
+    }
+
+    // Determinant and inverse Jacobian at every quadrature point:
+    determinant.resize(num_points);
+    dksi_dx.resize(num_points);
+    deta_dx.resize(num_points);
+    dksi_dy.resize(num_points);
+    deta_dy.resize(num_points);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        determinant[t] = x_ksi[t]*y_eta[t] - y_ksi[t]*x_eta[t];
+        dksi_dx[t] = y_eta[t]/determinant[t];
+        deta_dx[t] = -y_ksi[t]/determinant[t];
+        dksi_dy[t] = -x_eta[t]/determinant[t];
+        deta_dy[t] = x_ksi[t]/determinant[t];
+    }
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        if (!(determinant[t]*determinant[0] > 0.0))
+            throw(Exception("INVALID ELEMENT","Jacobian of curvilinear triangle is singular"));
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::Contract_matrices_from_reference : Computes the N_NxNx, N_NyNy and N_NN
+ * matrices of a flat triangle contracted with the coefficients of a field.
+ *
+ * The reference tensors of all coefficient functions are contracted first, so the geometry
+ * factors are applied once per entry instead of once per entry and coefficient function.
+ * @param [in] coefficients : \f$ \beta_k \f$ of each coefficient function
+ * @param [out] N_NxNx : packed contracted N_NxNx matrix
+ * @param [out] N_NyNy : packed contracted N_NyNy matrix
+ * @param [out] N_NN : packed contracted N_NN matrix */
+//************************************************************************************************//
+void SolverTriangle::Contract_matrices_from_reference(const std::vector<cemDOUBLE>& coefficients,
+                                                      std::vector<cemDOUBLE>& N_NxNx,
+                                                      std::vector<cemDOUBLE>& N_NyNy,
+                                                      std::vector<cemDOUBLE>& N_NN) const
+{
+    const TriReferenceTensors& tensors = TriReferenceTensors::Get(basis_function_order_,
+                                                                  coefficient_order_);
+    cemINT size = tensors.num_packed_entries();
+
+    // Contract the reference tensors:
+    std::vector<cemDOUBLE> A(size,0.0),B(size,0.0),C(size,0.0),M(size,0.0);
+    for (cemINT k=0; k<tensors.num_coefficient_functions(); ++k)
+    {
+        cemDOUBLE beta = coefficients[k];
+        const cemDOUBLE* A_k = tensors.tensor_ksi_ksi(k);
+        const cemDOUBLE* B_k = tensors.tensor_ksi_eta(k);
+        const cemDOUBLE* C_k = tensors.tensor_eta_eta(k);
+        const cemDOUBLE* M_k = tensors.tensor_mass(k);
+        for (cemINT m=0; m<size; ++m)
+        {
+            A[m] += beta*A_k[m];
+            B[m] += beta*B_k[m];
+            C[m] += beta*C_k[m];
+            M[m] += beta*M_k[m];
+        }
+    }
+
+    // Geometry factors (as in Compute_matrices_from_reference):
+    cemDOUBLE inverse_two_delta = 0.5/delta_;
+    cemDOUBLE gx_ksi_ksi = b1_*b1_*inverse_two_delta;
+    cemDOUBLE gx_ksi_eta = b1_*b2_*inverse_two_delta;
+    cemDOUBLE gx_eta_eta = b2_*b2_*inverse_two_delta;
+    cemDOUBLE gy_ksi_ksi = c1_*c1_*inverse_two_delta;
+    cemDOUBLE gy_ksi_eta = c1_*c2_*inverse_two_delta;
+    cemDOUBLE gy_eta_eta = c2_*c2_*inverse_two_delta;
+    cemDOUBLE two_delta = 2.0*delta_;
+
+    N_NxNx.resize(size);
+    N_NyNy.resize(size);
+    N_NN.resize(size);
+    for (cemINT m=0; m<size; ++m)
+    {
+        N_NxNx[m] = gx_ksi_ksi*A[m] + gx_ksi_eta*B[m] + gx_eta_eta*C[m];
+        N_NyNy[m] = gy_ksi_ksi*A[m] + gy_ksi_eta*B[m] + gy_eta_eta*C[m];
+        N_NN[m] = two_delta*M[m];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::Contract_matrices_numerically : Computes the N_NxNx, N_NyNy and N_NN
+ * matrices contracted with the coefficients of a field, by numerical integration.
+ *
+ * The field \f$ \sum_k \beta_k \phi_k \f$ is evaluated once per quadrature point and a single
+ * matrix per family is accumulated. Used for curvilinear triangles and hierarchical functions.
+ * @param [in] coefficients : \f$ \beta_k \f$ of each coefficient function
+ * @param [out] N_NxNx : packed contracted N_NxNx matrix
+ * @param [out] N_NyNy : packed contracted N_NyNy matrix
+ * @param [out] N_NN : packed contracted N_NN matrix */
+//************************************************************************************************//
+void SolverTriangle::Contract_matrices_numerically(const std::vector<cemDOUBLE>& coefficients,
+                                                   std::vector<cemDOUBLE>& N_NxNx,
+                                                   std::vector<cemDOUBLE>& N_NyNy,
+                                                   std::vector<cemDOUBLE>& N_NN) const
+{
+    const TriTabulation& tabulation = TriTabulation::Get(basis_function_order_,
+                                                         coefficient_order_,
+                                                         is_curvilinear_ ? CURVILINEAR_EXTRA_ORDER : 0,
+                                                         basis_function_type_);
+    cemINT n = tabulation.num_basis_functions();
+    cemINT num_coefficients = tabulation.num_coefficient_functions();
+    cemINT num_points = tabulation.num_points();
+    const cemDOUBLE* weights = tabulation.weights();
+
+    // Determinant and inverse Jacobian at every quadrature point:
+    std::vector<cemDOUBLE> determinant,dksi_dx,deta_dx,dksi_dy,deta_dy;
+    if (is_curvilinear_)
+        setUpCurvilinearJacobians(tabulation,determinant,dksi_dx,deta_dx,dksi_dy,deta_dy);
+    else
+    {
+        determinant.assign(num_points,jacobian_matrix_.determinant());
+        dksi_dx.assign(num_points,inverse_jacobian_matrix_(0,0));
+        deta_dx.assign(num_points,inverse_jacobian_matrix_(0,1));
+        dksi_dy.assign(num_points,inverse_jacobian_matrix_(1,0));
+        deta_dy.assign(num_points,inverse_jacobian_matrix_(1,1));
+    }
+
+    cemINT size = n*(n+1)/2;
+    N_NxNx.assign(size,0.0);
+    N_NyNy.assign(size,0.0);
+    N_NN.assign(size,0.0);
+
+    // Add contributions of each quadrature point (matrices are packed, see SymmetricMatrix):
+    std::vector<cemDOUBLE> N_x(n),N_y(n);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        const cemDOUBLE* N = tabulation.basis(t);
+        const cemDOUBLE* N_ksi = tabulation.basis_ksi_deriv(t);
+        const cemDOUBLE* N_eta = tabulation.basis_eta_deriv(t);
+        const cemDOUBLE* coefficient_functions = tabulation.coefficients(t);
+        for (cemINT i=0; i<n; ++i)
+        {
+            N_x[i] = dksi_dx[t]*N_ksi[i] + deta_dx[t]*N_eta[i];
+            N_y[i] = dksi_dy[t]*N_ksi[i] + deta_dy[t]*N_eta[i];
+        }
+
+        cemDOUBLE field = 0.0;
+        for (cemINT k=0; k<num_coefficients; ++k)
+            field += coefficients[k]*coefficient_functions[k];
+
+        cemDOUBLE w = weights[t]*field*determinant[t];
+        cemINT m = 0;
+        for (cemINT j=0; j<n; ++j)
+        {
+            for (cemINT i=j; i<n; ++i, ++m)
+            {
+                N_NxNx[m] += w*N_x[i]*N_x[j];
+                N_NyNy[m] += w*N_y[i]*N_y[j];
+                N_NN[m] += w*N[i]*N[j];
+            }
+        }
+    }
+}
+
+
 //************************************************************************************************//
 /** @brief SolverTriangle::GetShapeFunctionIndices : Get three indices needed to evaluate ShapeFunction.
  *
@@ -2819,135 +3819,40 @@ void SolverTriangle::GetShapeFunctionIndices(const cemINT& shape_function_order,
                                              const cemINT& basis_function_index,
                                              cemINT& index_i,
                                              cemINT& index_j,
-                                             cemINT& index_k) const
+                                             cemINT& index_k)
 {
-    if (shape_function_order == 0)
-    {
-        index_i = 0;
-        index_j = 0;
-        index_k = 0;
-    }
-    if (shape_function_order == 1)
-    {
-        switch (basis_function_index)
-        {
-        case 0:
-            index_i = 1;
-            index_j = 0;
-            index_k = 0;
-            break;
-        case 1:
-            index_i = 0;
-            index_j = 1;
-            index_k = 0;
-            break;
-        case 2:
-            index_i = 0;
-            index_j = 0;
-            index_k = 1;
-            break;
-        default:
-            throw(Exception("INPUT ERROR","basisfunction_index must be from 1 to 3"));
-            break;
-        }
-    }
-    if (shape_function_order == 2)
+    cemINT num_functions = (shape_function_order+1)*(shape_function_order+2)/2;
+    if (basis_function_index < 0 || basis_function_index >= num_functions)
     {
-        switch (basis_function_index)
-        {
-        case 0:
-            index_i = 2;
-            index_j = 0;
-            index_k = 0;
-            break;
-        case 1:
-            index_i = 0;
-            index_j = 2;
-            index_k = 0;
-            break;
-        case 2:
-            index_i = 0;
-            index_j = 0;
-            index_k = 2;
-            break;
-        case 3:
-            index_i = 1;
-            index_j = 1;
-            index_k = 0;
-            break;
-        case 4:
-            index_i = 0;
-            index_j = 1;
-            index_k = 1;
-            break;
-        case 5:
-            index_i = 1;
-            index_j = 0;
-            index_k = 1;
-            break;
-        default:
-            throw(Exception("INPUT ERROR","basisfunction_index must be from 1 to 6"));
-            break;
-        }
+        std::string temp = cem_utils::NumberToString<cemINT>(num_functions);
+        throw(Exception("INPUT ERROR","basisfunction_index must be from 1 to " + temp));
     }
-    if (shape_function_order == 3)
+
+    const cemINT* ijk = TriIndexTables::Get(shape_function_order) + 3*basis_function_index;
+    index_i = ijk[0];
+    index_j = ijk[1];
+    index_k = ijk[2];
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::CheckQuadratureOrder : Checks that the element matrices of a pair of
+ * orders can be integrated: they need a quadrature rule of order 2p+q.
+ * @param [in] basis_order : polynomial order of basis functions (p)
+ * @param [in] coefficient_order : polynomial order of coefficient functions (q) */
+//************************************************************************************************//
+void SolverTriangle::CheckQuadratureOrder(const cemINT& basis_order,
+                                          const cemINT& coefficient_order)
+{
+    TriQuadrature quadrature;
+    if (2*basis_order + coefficient_order > quadrature.getMaxPolyOrder())
     {
-        switch (basis_function_index)
-        {
-        case 0:
-            index_i = 3;
-            index_j = 0;
-            index_k = 0;
-            break;
-        case 1:
-            index_i = 0;
-            index_j = 3;
-            index_k = 0;
-            break;
-        case 2:
-            index_i = 0;
-            index_j = 0;
-            index_k = 3;
-            break;
-        case 3:
-            index_i = 2;
-            index_j = 1;
-            index_k = 0;
-            break;
-        case 4:
-            index_i = 1;
-            index_j = 2;
-            index_k = 0;
-            break;
-        case 5:
-            index_i = 0;
-            index_j = 2;
-            index_k = 1;
-            break;
-        case 6:
-            index_i = 0;
-            index_j = 1;
-            index_k = 2;
-            break;
-        case 7:
-            index_i = 1;
-            index_j = 0;
-            index_k = 2;
-            break;
-        case 8:
-            index_i = 2;
-            index_j = 0;
-            index_k = 1;
-            break;
-        case 9:
-            index_i = 1;
-            index_j = 1;
-            index_k = 1;
-            break;
-        default:
-            throw(Exception("INPUT ERROR","basisfunction_index must be from 1 to 10"));
-            break;
-        }
+        std::string max_order = cem_utils::NumberToString<cemINT>(quadrature.getMaxPolyOrder());
+        throw(Exception("FEATURE NOT IMPLEMENTED",
+                        "basis_order=" + cem_utils::NumberToString<cemINT>(basis_order) +
+                        " with coefficient_order=" +
+                        cem_utils::NumberToString<cemINT>(coefficient_order) +
+                        " needs a quadrature rule of order 2p+q > " + max_order));
     }
 }
 
@@ -2959,24 +3864,48 @@ void SolverTriangle::setUpGeometry()
 {
     if (!geometry_is_Up_)
     {
-        // Check that the element is a flat triangle: (anything else is not supported yet):
-        if (element_ptr_->order() != 1)
-            throw(Exception("FEATURE NOT IMPLEMENTED","Curvilinear triangles not supported"));
+        // Check that the element is a flat or a second-order triangle (nothing else is supported yet):
+        if (element_ptr_->order() > 2)
+            throw(Exception("FEATURE NOT IMPLEMENTED","Curvilinear triangles of order > 2 not supported"));
+
+        cemINT num_nodes = (element_ptr_->order() == 2) ? 6 : 3;
+        if (static_cast<cemINT>(element_ptr_->node_ptrs().size()) < num_nodes)
+            throw(Exception("INPUT ERROR","Second-order triangle must have 6 nodes"));
 
-        // Check that the element is in the X-Y plane:
+        // Check whether the element is in a plane parallel to X-Y:
         z1_ = element_ptr_->node(0)->operator [](2);
         z2_ = element_ptr_->node(1)->operator [](2);
         z3_ = element_ptr_->node(2)->operator [](2);
-        if (z1_-z2_ != 0.0 || z1_-z3_ != 0.0)
-            throw(Exception("FEATURE NOT IMPLEMENTED","Triangle must be in the XY plane"));
+        cemBOOL in_XY_plane = (z1_-z2_ == 0.0 && z1_-z3_ == 0.0);
+        for (cemINT a=3; a<num_nodes; ++a)
+        {
+            if (z1_-element_ptr_->node(a)->operator [](2) != 0.0)
+                in_XY_plane = false;
+        }
 
-        // Get XY coordinates of nodes:
-        x1_ = element_ptr_->node(0)->operator [](0);
-        x2_ = element_ptr_->node(1)->operator [](0);
-        x3_ = element_ptr_->node(2)->operator [](0);
-        y1_ = element_ptr_->node(0)->operator [](1);
-        y2_ = element_ptr_->node(1)->operator [](1);
-        y3_ = element_ptr_->node(2)->operator [](1);
+        if (in_XY_plane)
+        {
+            // Get XY coordinates of nodes:
+            x1_ = element_ptr_->node(0)->operator [](0);
+            x2_ = element_ptr_->node(1)->operator [](0);
+            x3_ = element_ptr_->node(2)->operator [](0);
+            y1_ = element_ptr_->node(0)->operator [](1);
+            y2_ = element_ptr_->node(1)->operator [](1);
+            y3_ = element_ptr_->node(2)->operator [](1);
+
+            if (num_nodes == 6)
+            {
+                curved_x_.resize(6);
+                curved_y_.resize(6);
+                for (cemINT a=0; a<6; ++a)
+                {
+                    curved_x_[a] = element_ptr_->node(a)->operator [](0);
+                    curved_y_[a] = element_ptr_->node(a)->operator [](1);
+                }
+            }
+        }
+        else
+            setUpLocalFrame(num_nodes);
 
         // Parameters for analytical integration of basis functions:
         a1_ = x2_*y3_ - y3_*x3_;
@@ -2999,6 +3928,1287 @@ void SolverTriangle::setUpGeometry()
         jacobian_matrix_(1,1) = y2_ - y3_;
         inverse_jacobian_matrix_ = jacobian_matrix_.inverse();
 
-        geometry_is_Up_ = true;
+        // A second-order triangle is curvilinear unless its edge nodes are at the midpoints:
+        is_curvilinear_ = false;
+        if (num_nodes == 6)
+        {
+            cemDOUBLE tolerance = 1.0e-12*(std::fabs(b1_) + std::fabs(b2_) + std::fabs(b3_) +
+                                           std::fabs(c1_) + std::fabs(c2_) + std::fabs(c3_));
+            for (cemINT e=0; e<3; ++e)
+            {
+                cemINT v0 = e;
+                cemINT v1 = (e+1)%3;
+                if (std::fabs(curved_x_[3+e] - 0.5*(curved_x_[v0] + curved_x_[v1])) > tolerance ||
+                    std::fabs(curved_y_[3+e] - 0.5*(curved_y_[v0] + curved_y_[v1])) > tolerance)
+                    is_curvilinear_ = true;
+            }
+        }
+
+        geometry_is_Up_ = true;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangle::setUpLocalFrame : Computes the coordinates of the nodes in a local 2D
+ * frame, for a triangle that is not parallel to the X-Y plane.
+ *
+ * The frame has its origin at node 1, its first axis along the edge from node 1 to node 2, and
+ * its normal (the cross product of two edges) following the orientation of the nodes, so that
+ * delta_ is positive. Gradients, N_GradGrad and N_NN are therefore the same as for the
+ * triangle in 3D; N_NxNx and N_NyNy refer to the local axes.
+ * @param [in] num_nodes : number of nodes of the element (3 or 6) */
+//************************************************************************************************//
+void SolverTriangle::setUpLocalFrame(const cemINT& num_nodes)
+{
+    const cem_mesh::Node& origin = *element_ptr_->node(0);
+    const cem_mesh::Node& node2 = *element_ptr_->node(1);
+    const cem_mesh::Node& node3 = *element_ptr_->node(2);
+    V3D edge1(node2[0]-origin[0], node2[1]-origin[1], node2[2]-origin[2]);
+    V3D edge2(node3[0]-origin[0], node3[1]-origin[1], node3[2]-origin[2]);
+
+    V3D normal = edge1.Cross(edge2);
+    cemDOUBLE normal_norm = normal.Norm();
+    cemDOUBLE edge_norm = edge1.Norm();
+    if (normal_norm == 0.0)
+        throw(Exception("INVALID ELEMENT","Triangle is degenerate"));
+
+    // Orthonormal frame:
+    normal *= 1.0/normal_norm;
+    V3D axis1(edge1);
+    axis1 *= 1.0/edge_norm;
+    V3D axis2 = normal.Cross(axis1);
+
+    std::vector<cemDOUBLE> x(num_nodes),y(num_nodes);
+    for (cemINT a=0; a<num_nodes; ++a)
+    {
+        const cem_mesh::Node& node = *element_ptr_->node(a);
+        V3D d(node[0]-origin[0], node[1]-origin[1], node[2]-origin[2]);
+        x[a] = d.Dot(axis1);
+        y[a] = d.Dot(axis2);
+
+        // Edge nodes of a curvilinear triangle must lie in the plane of its vertices:
+        if (std::fabs(d.Dot(normal)) > 1.0e-12*edge_norm)
+            throw(Exception("FEATURE NOT IMPLEMENTED","Curvilinear triangle must be planar"));
+    }
+
+    x1_ = x[0];
+    x2_ = x[1];
+    x3_ = x[2];
+    y1_ = y[0];
+    y2_ = y[1];
+    y3_ = y[2];
+    if (num_nodes == 6)
+    {
+        curved_x_ = x;
+        curved_y_ = y;
+    }
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS SolverQuadrangle:
+///***********************************************************************************************//
+const cemINT SolverQuadrangle::BILINEAR_EXTRA_ORDER;
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::SolverQuadrangle : Constructor with parameters.
+ * @param [in] element_ptr : pointer to element in mesh
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] function_field : basis function field (scalar or vector)
+ * @param [in] function_type : basis function type (interpolatory or hierarchical)
+ * @param [in] coefficient_order : polynomial order of coefficients */
+//************************************************************************************************//
+SolverQuadrangle::SolverQuadrangle(const cem_mesh::Element* element_ptr,
+                                   const cemINT& basis_order,
+                                   const BasisFunctionField& function_field,
+                                   const BasisFunctionType& function_type,
+                                   const cemINT& coefficient_order) : SolverElement(basis_order,
+                                                                                    function_field,
+                                                                                    function_type,
+                                                                                    coefficient_order)
+{
+    // Check that element is a quadrangle:
+    if (element_ptr->type() != Element::QUAD)
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Quadrangle (QUAD)"));
+
+    element_ptr_ = element_ptr;
+    geometry_is_Up_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::num_coefficient_functions : Gets number of coefficient functions.
+ * @return : (q+1)^2 */
+//************************************************************************************************//
+cemINT SolverQuadrangle::num_coefficient_functions() const
+{
+    return (coefficient_order_+1)*(coefficient_order_+1);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::set_element_ptr : Sets pointer to mesh element (quadrangle)
+ * @param [in] element_ptr : pointer to element in mesh */
+//************************************************************************************************//
+void SolverQuadrangle::set_element_ptr(const cem_mesh::Element *element_ptr)
+{
+    // Check that element is a quadrangle:
+    if (element_ptr->type() != Element::QUAD)
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Quadrangle (QUAD)"));
+
+    element_ptr_ = element_ptr;
+    geometry_is_Up_ = false;
+    matrices_are_Up_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::setUp_matrix_N_NxNx : Set up vector of matrices N_NxNx.
+ *
+ * Quadrangles are always integrated numerically (with sum factorization), all families at once,
+ * so only the first of the setUp_matrix_* calls integrates.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverQuadrangle::setUp_matrix_N_NxNx(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    if (!matrices_are_Up_)
+        Compute_matrices_sum_factorized();
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::setUp_matrix_N_NyNy : Set up vector of matrices N_NyNy.
+ *
+ * Quadrangles are always integrated numerically (with sum factorization), all families at once,
+ * so only the first of the setUp_matrix_* calls integrates.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverQuadrangle::setUp_matrix_N_NyNy(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    if (!matrices_are_Up_)
+        Compute_matrices_sum_factorized();
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::setUp_matrix_N_NN : Set up vector of matrices N_NN.
+ *
+ * Quadrangles are always integrated numerically (with sum factorization), all families at once,
+ * so only the first of the setUp_matrix_* calls integrates.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverQuadrangle::setUp_matrix_N_NN(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    if (!matrices_are_Up_)
+        Compute_matrices_sum_factorized();
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::setUp_matrices : Set up N_NxNx, N_NyNy, N_NN and N_GradGrad matrices
+ * in a single pass over the quadrature points.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverQuadrangle::setUp_matrices(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    Compute_matrices_sum_factorized();
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::ContractMatrices : Gets the matrices of each family contracted with
+ * the coefficients of a field, \f$ \sum_k \beta_k M_k \f$.
+ *
+ * The coefficient functions are added up at each quadrature point before sum factorization, so
+ * only one matrix per family is integrated, and the matrices of this element (matrix_N_NxNx() and
+ * the rest) are left untouched.
+ * @param [in] coefficients : \f$ \beta_k \f$, num_coefficient_functions() values
+ * @param [out] N_NxNx : contracted N_NxNx matrix (or NULL)
+ * @param [out] N_NyNy : contracted N_NyNy matrix (or NULL)
+ * @param [out] N_NN : contracted N_NN matrix (or NULL)
+ * @param [out] N_GradGrad : contracted N_GradGrad matrix (or NULL) */
+//************************************************************************************************//
+void SolverQuadrangle::ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                                        SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                                        SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                                        SymmetricMatrix<cemDOUBLE>* N_NN,
+                                        SymmetricMatrix<cemDOUBLE>* N_GradGrad)
+{
+    if (static_cast<cemINT>(coefficients.size()) != num_coefficient_functions())
+        throw(Exception("INPUT ERROR","Expected one coefficient per coefficient function"));
+
+    // Derivative families are needed for N_GradGrad too:
+    std::vector< SymmetricMatrix<cemDOUBLE> > K_x,K_y,M;
+    cemBOOL derivatives = N_NxNx != NULL || N_NyNy != NULL || N_GradGrad != NULL;
+    std::vector< SymmetricMatrix<cemDOUBLE> >* families[3] = {NULL, NULL, NULL};
+    if (derivatives)
+    {
+        families[0] = &K_x;
+        families[1] = &K_y;
+    }
+    if (N_NN != NULL)
+        families[2] = &M;
+    Integrate_sum_factorized(&coefficients,families);
+
+    if (N_NxNx != NULL)
+        *N_NxNx = K_x[0];
+    if (N_NyNy != NULL)
+        *N_NyNy = K_y[0];
+    if (N_NN != NULL)
+        *N_NN = M[0];
+    if (N_GradGrad != NULL)
+    {
+        *N_GradGrad = K_x[0];
+        *N_GradGrad += K_y[0];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::GetShapeFunctionIndices : Get the two 1D indices of a basis function.
+ *
+ * Basis function m is \f$ L_u(\xi) L_v(\eta) \f$, where \f$ L_a \f$ is the 1D Lagrange
+ * polynomial of node \f$ -1 + 2a/p \f$. Functions follow the numbering of cemMesh.h: the four
+ * vertices counter-clockwise from (-1,-1), then the inner nodes of edges 0-1, 1-2, 2-3 and 3-0
+ * (each one from its first to its last vertex), then the interior nodes, numbered in the same way
+ * as a quadrangle of order p-2.
+ * @param [in] shape_function_order : polynomial order p of the basis functions
+ * @param [in] basis_function_index : index of the basis function within the quadrangle
+ * @param [out] index_u : index of the 1D Lagrange polynomial in the \f$ \xi \f$ variable
+ * @param [out] index_v : index of the 1D Lagrange polynomial in the \f$ \eta \f$ variable */
+//************************************************************************************************//
+void SolverQuadrangle::GetShapeFunctionIndices(const cemINT& shape_function_order,
+                                               const cemINT& basis_function_index,
+                                               cemINT& index_u,
+                                               cemINT& index_v)
+{
+    cemINT num_functions = (shape_function_order+1)*(shape_function_order+1);
+    if (basis_function_index < 0 || basis_function_index >= num_functions)
+    {
+        std::string temp = cem_utils::NumberToString<cemINT>(num_functions);
+        throw(Exception("INPUT ERROR","basisfunction_index must be from 1 to " + temp));
+    }
+
+    // Peel off the outer ring of nodes until the index falls on one:
+    cemINT index = basis_function_index;
+    cemINT offset = 0;
+    cemINT order = shape_function_order;
+    while (true)
+    {
+        if (order == 0)
+        {
+            index_u = offset;
+            index_v = offset;
+            return;
+        }
+
+        if (index < 4)
+        {
+            index_u = offset + ((index == 1 || index == 2) ? order : 0);
+            index_v = offset + ((index == 2 || index == 3) ? order : 0);
+            return;
+        }
+        index -= 4;
+
+        if (index < 4*(order-1))
+        {
+            cemINT edge = index/(order-1);
+            cemINT t = index%(order-1) + 1;
+            switch (edge)
+            {
+            case 0: index_u = t;          index_v = 0;          break;
+            case 1: index_u = order;      index_v = t;          break;
+            case 2: index_u = order - t;  index_v = order;      break;
+            default: index_u = 0;         index_v = order - t;  break;
+            }
+            index_u += offset;
+            index_v += offset;
+            return;
+        }
+        index -= 4*(order-1);
+
+        offset += 1;
+        order -= 2;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::EvaluateLagrange : Evaluates the 1D Lagrange polynomials on order+1
+ * equispaced nodes of [-1,1] at several points.
+ * @param [in] order : polynomial order (0 gives the constant 1)
+ * @param [in] num_points : number of points
+ * @param [in] ksi : points, in [-1,1]
+ * @param [out] values : values[a*num_points + t] is polynomial a at point t
+ * @param [out] derivs : derivatives, same layout as values (can be NULL) */
+//************************************************************************************************//
+void SolverQuadrangle::EvaluateLagrange(const cemINT& order,
+                                        const cemINT& num_points,
+                                        const cemDOUBLE* ksi,
+                                        cemDOUBLE* values,
+                                        cemDOUBLE* derivs)
+{
+    for (cemINT a=0; a<=order; ++a)
+    {
+        cemDOUBLE* value = values + a*num_points;
+        cemDOUBLE* deriv = (derivs != NULL) ? derivs + a*num_points : NULL;
+        for (cemINT t=0; t<num_points; ++t)
+            value[t] = 1.0;
+        if (deriv != NULL)
+        {
+            for (cemINT t=0; t<num_points; ++t)
+                deriv[t] = 0.0;
+        }
+
+        // Product of (ksi - node_m)/(node_a - node_m), derivative by the product rule:
+        cemDOUBLE node_a = (order > 0) ? -1.0 + 2.0*a/order : 0.0;
+        for (cemINT m=0; m<=order; ++m)
+        {
+            if (m == a)
+                continue;
+
+            cemDOUBLE node_m = -1.0 + 2.0*m/order;
+            cemDOUBLE scale = 1.0/(node_a - node_m);
+            for (cemINT t=0; t<num_points; ++t)
+            {
+                cemDOUBLE factor = (ksi[t] - node_m)*scale;
+                if (deriv != NULL)
+                    deriv[t] = deriv[t]*factor + value[t]*scale;
+                value[t] *= factor;
+            }
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::Compute_matrices_sum_factorized : Computes all N_NxNx, N_NyNy, N_NN
+ * and N_GradGrad matrices with a tensor-product Gauss rule and sum factorization (see
+ * Integrate_sum_factorized()). */
+//************************************************************************************************//
+void SolverQuadrangle::Compute_matrices_sum_factorized()
+{
+    std::vector< SymmetricMatrix<cemDOUBLE> >* families[3] = {&matrix_N_NxNx_,
+                                                              &matrix_N_NyNy_,
+                                                              &matrix_N_NN_};
+    Integrate_sum_factorized(NULL,families);
+
+    // Add up gradients:
+    cemINT num_coefficients = num_coefficient_functions();
+    matrix_N_GradGrad_.resize(num_coefficients);
+    for (cemINT k=0; k<num_coefficients; ++k)
+    {
+        matrix_N_GradGrad_[k] = matrix_N_NxNx_[k];
+        matrix_N_GradGrad_[k] += matrix_N_NyNy_[k];
+    }
+    matrices_are_Up_ = true;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::Integrate_sum_factorized : Integrates the N_NxNx, N_NyNy and N_NN
+ * families with a tensor-product Gauss rule and sum factorization.
+ *
+ * With \f$ N_i = L_a(\xi) L_b(\eta) \f$, every term of the integrands is a geometric factor G
+ * (weights, coefficient, determinant and inverse Jacobian at each point) times a product of 1D
+ * tables, e.g. \f$ L'_a L'_c (\xi) \, L_b L_d (\eta) \f$ for \f$ N_{i,\xi} N_{j,\xi} \f$. See
+ * SumFactorize(). The mapping is bilinear, so G is not constant, and the rule is
+ * BILINEAR_EXTRA_ORDER orders higher than the polynomial order of the integrand. The Jacobians
+ * are computed once for all families.
+ *
+ * Without coefficients, each family gets one matrix per coefficient function. With them, the
+ * coefficient functions are added up at each point first, so each family gets a single matrix
+ * and the cost is that of one coefficient function.
+ * @param [in] coefficients : \f$ \beta_k \f$, num_coefficient_functions() values (or NULL)
+ * @param [out] families : N_NxNx, N_NyNy and N_NN matrices (or NULL, if not needed) */
+//************************************************************************************************//
+void SolverQuadrangle::Integrate_sum_factorized(const std::vector<cemDOUBLE>* coefficients,
+                                                std::vector< SymmetricMatrix<cemDOUBLE> >* families[3])
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    cemINT p = basis_function_order_;
+    cemINT q = coefficient_order_;
+    cemINT num_1D_functions = p+1;
+    cemINT n = num_1D_functions*num_1D_functions;
+    cemINT num_coefficients = num_coefficient_functions();
+
+    // 1D Gauss rule:
+    static const cem_core::LineQuadrature quadrature;
+    cemINT num_1D_points = quadrature.getNumPointsForPolyOrder(2*p + q + BILINEAR_EXTRA_ORDER);
+    const std::vector<cemDOUBLE>& points = quadrature.getKsiCoordinates(num_1D_points);
+    const std::vector<cemDOUBLE>& weights = quadrature.getWeights(num_1D_points);
+    cemINT num_points = num_1D_points*num_1D_points;
+
+    // 1D tables of basis and coefficient functions:
+    std::vector<cemDOUBLE> L(num_1D_functions*num_1D_points);
+    std::vector<cemDOUBLE> dL(num_1D_functions*num_1D_points);
+    std::vector<cemDOUBLE> C((q+1)*num_1D_points);
+    EvaluateLagrange(p,num_1D_points,&points[0],&L[0],&dL[0]);
+    EvaluateLagrange(q,num_1D_points,&points[0],&C[0],NULL);
+
+    std::vector<cemINT> index_u(n),index_v(n);
+    for (cemINT i=0; i<n; ++i)
+        GetShapeFunctionIndices(p,i,index_u[i],index_v[i]);
+
+    // Determinant and inverse Jacobian at every point (g along ksi, h along eta):
+    std::vector<cemDOUBLE> determinant(num_points);
+    std::vector<cemDOUBLE> dksi_dx(num_points),deta_dx(num_points);
+    std::vector<cemDOUBLE> dksi_dy(num_points),deta_dy(num_points);
+    for (cemINT g=0; g<num_1D_points; ++g)
+    {
+        for (cemINT h=0; h<num_1D_points; ++h)
+        {
+            cemINT t = g*num_1D_points + h;
+            cemDOUBLE u = points[g];
+            cemDOUBLE v = points[h];
+            cemDOUBLE x_ksi = 0.25*((x_[1]-x_[0])*(1.0-v) + (x_[2]-x_[3])*(1.0+v));
+            cemDOUBLE y_ksi = 0.25*((y_[1]-y_[0])*(1.0-v) + (y_[2]-y_[3])*(1.0+v));
+            cemDOUBLE x_eta = 0.25*((x_[3]-x_[0])*(1.0-u) + (x_[2]-x_[1])*(1.0+u));
+            cemDOUBLE y_eta = 0.25*((y_[3]-y_[0])*(1.0-u) + (y_[2]-y_[1])*(1.0+u));
+            determinant[t] = x_ksi*y_eta - y_ksi*x_eta;
+            dksi_dx[t] = y_eta/determinant[t];
+            deta_dx[t] = -y_ksi/determinant[t];
+            dksi_dy[t] = -x_eta/determinant[t];
+            deta_dy[t] = x_ksi/determinant[t];
+        }
+    }
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        if (!(determinant[t]*determinant[0] > 0.0))
+            throw(Exception("INVALID ELEMENT","Jacobian of quadrangle is singular"));
+    }
+
+    cemINT num_sets = (coefficients == NULL) ? num_coefficients : 1;
+    for (cemINT family=0; family<3; ++family)
+    {
+        if (families[family] != NULL)
+            families[family]->resize(num_sets);
+    }
+
+    // Geometric factors of each term, and workspace of SumFactorize():
+    std::vector<cemDOUBLE> W(num_points);
+    std::vector<cemDOUBLE> G_kk(num_points),G_ke(num_points),G_ee(num_points);
+    std::vector<cemDOUBLE> workspace;
+    for (cemINT s=0; s<num_sets; ++s)
+    {
+        // Weights times coefficient (function s, or the field) times determinant:
+        std::fill(W.begin(),W.end(),0.0);
+        for (cemINT k=0; k<num_coefficients; ++k)
+        {
+            cemDOUBLE beta = (coefficients == NULL) ? (k == s ? 1.0 : 0.0) : (*coefficients)[k];
+            if (beta == 0.0)
+                continue;
+
+            cemINT k_u,k_v;
+            GetShapeFunctionIndices(q,k,k_u,k_v);
+            for (cemINT g=0; g<num_1D_points; ++g)
+            {
+                for (cemINT h=0; h<num_1D_points; ++h)
+                    W[g*num_1D_points + h] += beta*C[k_u*num_1D_points + g]*
+                                              C[k_v*num_1D_points + h];
+            }
+        }
+        for (cemINT g=0; g<num_1D_points; ++g)
+        {
+            for (cemINT h=0; h<num_1D_points; ++h)
+            {
+                cemINT t = g*num_1D_points + h;
+                W[t] *= weights[g]*weights[h]*determinant[t];
+            }
+        }
+
+        for (cemINT family=0; family<3; ++family)
+        {
+            if (families[family] == NULL)
+                continue;
+
+            SymmetricMatrix<cemDOUBLE>* matrix = &(*families[family])[s];
+            const std::vector<cemDOUBLE>* d_dx = NULL;
+            const std::vector<cemDOUBLE>* e_dx = NULL;
+            if (family == 0)
+            {
+                d_dx = &dksi_dx;
+                e_dx = &deta_dx;
+            }
+            else if (family == 1)
+            {
+                d_dx = &dksi_dy;
+                e_dx = &deta_dy;
+            }
+
+            matrix->resize(n,n);
+            matrix->initialize();
+            cemDOUBLE* packed = &(*matrix)(0,0);
+
+            if (family == 2)
+            {
+                SumFactorize(num_1D_functions,num_1D_points,index_u,index_v,&W[0],
+                             &L[0],&L[0],&L[0],&L[0],workspace,packed);
+                continue;
+            }
+
+            // N_x = dksi_dx*N_ksi + deta_dx*N_eta, so N_x*N_x has four terms:
+            for (cemINT t=0; t<num_points; ++t)
+            {
+                G_kk[t] = W[t]*(*d_dx)[t]*(*d_dx)[t];
+                G_ke[t] = W[t]*(*d_dx)[t]*(*e_dx)[t];
+                G_ee[t] = W[t]*(*e_dx)[t]*(*e_dx)[t];
+            }
+            SumFactorize(num_1D_functions,num_1D_points,index_u,index_v,&G_kk[0],
+                         &dL[0],&dL[0],&L[0],&L[0],workspace,packed);
+            SumFactorize(num_1D_functions,num_1D_points,index_u,index_v,&G_ke[0],
+                         &dL[0],&L[0],&L[0],&dL[0],workspace,packed);
+            SumFactorize(num_1D_functions,num_1D_points,index_u,index_v,&G_ke[0],
+                         &L[0],&dL[0],&dL[0],&L[0],workspace,packed);
+            SumFactorize(num_1D_functions,num_1D_points,index_u,index_v,&G_ee[0],
+                         &L[0],&L[0],&dL[0],&dL[0],workspace,packed);
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::SumFactorize : Adds one sum-factorized term to a packed matrix.
+ *
+ * Entry (i,j), with test function \f$ i=(a,b) \f$ and source function \f$ j=(c,d) \f$, gets
+ * \f$ \sum_g U_{test}[a,g] U_{source}[c,g] \sum_h G[g,h] V_{test}[b,h] V_{source}[d,h] \f$.
+ * The inner sums are computed once for every (b,d) pair, and reused by every (a,c) pair, so the
+ * cost of the matrix is \f$ O(p^5) \f$ instead of the \f$ O(p^6) \f$ of a plain loop over all
+ * points for every entry.
+ * @param [in] num_1D_functions : number of 1D functions (p+1)
+ * @param [in] num_1D_points : number of points of the 1D rule
+ * @param [in] index_u : 1D index in the ksi variable of each basis function
+ * @param [in] index_v : 1D index in the eta variable of each basis function
+ * @param [in] G : geometric factor at each point, G[g*num_1D_points + h]
+ * @param [in] U_test : 1D table in ksi for the test function (values or derivatives)
+ * @param [in] U_source : 1D table in ksi for the source function
+ * @param [in] V_test : 1D table in eta for the test function
+ * @param [in] V_source : 1D table in eta for the source function
+ * @param [in,out] workspace : scratch memory, resized as needed
+ * @param [in,out] matrix : packed matrix (see SymmetricMatrix) the term is added to */
+//************************************************************************************************//
+void SolverQuadrangle::SumFactorize(const cemINT& num_1D_functions,
+                                    const cemINT& num_1D_points,
+                                    const std::vector<cemINT>& index_u,
+                                    const std::vector<cemINT>& index_v,
+                                    const cemDOUBLE* G,
+                                    const cemDOUBLE* U_test,
+                                    const cemDOUBLE* U_source,
+                                    const cemDOUBLE* V_test,
+                                    const cemDOUBLE* V_source,
+                                    std::vector<cemDOUBLE>& workspace,
+                                    cemDOUBLE* matrix)
+{
+    cemINT P = num_1D_functions;
+    cemINT Q = num_1D_points;
+    cemINT n = index_u.size();
+    workspace.resize(2*P*P*Q);
+    cemDOUBLE* T = &workspace[0];           // T[(b*P + d)*Q + g]: contraction over eta
+    cemDOUBLE* UU = &workspace[P*P*Q];      // UU[(a*P + c)*Q + g]: products of ksi tables
+
+    for (cemINT b=0; b<P; ++b)
+    {
+        for (cemINT d=0; d<P; ++d)
+        {
+            cemDOUBLE* T_bd = T + (b*P + d)*Q;
+            for (cemINT g=0; g<Q; ++g)
+            {
+                const cemDOUBLE* G_g = G + g*Q;
+                cemDOUBLE sum = 0.0;
+                for (cemINT h=0; h<Q; ++h)
+                    sum += G_g[h]*V_test[b*Q + h]*V_source[d*Q + h];
+                T_bd[g] = sum;
+            }
+        }
+    }
+
+    for (cemINT a=0; a<P; ++a)
+    {
+        for (cemINT c=0; c<P; ++c)
+        {
+            for (cemINT g=0; g<Q; ++g)
+                UU[(a*P + c)*Q + g] = U_test[a*Q + g]*U_source[c*Q + g];
+        }
+    }
+
+    // Contraction over ksi, for the lower triangle only:
+    cemINT m = 0;
+    for (cemINT j=0; j<n; ++j)
+    {
+        for (cemINT i=j; i<n; ++i, ++m)
+        {
+            const cemDOUBLE* UU_ac = UU + (index_u[i]*P + index_u[j])*Q;
+            const cemDOUBLE* T_bd = T + (index_v[i]*P + index_v[j])*Q;
+            cemDOUBLE sum = 0.0;
+            for (cemINT g=0; g<Q; ++g)
+                sum += UU_ac[g]*T_bd[g];
+            matrix[m] += sum;
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverQuadrangle::setUpGeometry : Gets the coordinates of the vertices. */
+//************************************************************************************************//
+void SolverQuadrangle::setUpGeometry()
+{
+    if (!geometry_is_Up_)
+    {
+        // Check that the element is a flat bilinear quadrangle (nothing else is supported yet):
+        if (element_ptr_->order() != 1)
+            throw(Exception("FEATURE NOT IMPLEMENTED","Curvilinear quadrangles not supported"));
+
+        if (static_cast<cemINT>(element_ptr_->node_ptrs().size()) < 4)
+            throw(Exception("INPUT ERROR","Quadrangle must have 4 nodes"));
+
+        cemDOUBLE z = element_ptr_->node(0)->operator [](2);
+        for (cemINT a=0; a<4; ++a)
+        {
+            x_[a] = element_ptr_->node(a)->operator [](0);
+            y_[a] = element_ptr_->node(a)->operator [](1);
+            if (element_ptr_->node(a)->operator [](2) - z != 0.0)
+                throw(Exception("FEATURE NOT IMPLEMENTED","Quadrangle must be in the XY plane"));
+        }
+
+        // Jacobian Matrix of mapping from reference to actual quadrangle, at its center:
+        jacobian_matrix_.resize(2,2);
+        jacobian_matrix_(0,0) = 0.25*(x_[1] - x_[0] + x_[2] - x_[3]);
+        jacobian_matrix_(0,1) = 0.25*(y_[1] - y_[0] + y_[2] - y_[3]);
+        jacobian_matrix_(1,0) = 0.25*(x_[3] - x_[0] + x_[2] - x_[1]);
+        jacobian_matrix_(1,1) = 0.25*(y_[3] - y_[0] + y_[2] - y_[1]);
+        inverse_jacobian_matrix_ = jacobian_matrix_.inverse();
+
+        geometry_is_Up_ = true;
+    }
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS SolverSolidElement:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::SolverSolidElement : Constructor with parameters.
+ * @param [in] element_ptr : pointer to element in mesh
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] function_field : basis function field (scalar or vector)
+ * @param [in] function_type : basis function type (interpolatory or hierarchical)
+ * @param [in] coefficient_order : polynomial order of coefficients */
+//************************************************************************************************//
+SolverSolidElement::SolverSolidElement(const cem_mesh::Element* element_ptr,
+                                       const cemINT& basis_order,
+                                       const BasisFunctionField& function_field,
+                                       const BasisFunctionType& function_type,
+                                       const cemINT& coefficient_order) : SolverElement(basis_order,
+                                                                                        function_field,
+                                                                                        function_type,
+                                                                                        coefficient_order)
+{
+    element_ptr_ = element_ptr;
+    geometry_is_Up_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::matrix_N_NzNz : Gets i-th NzNz matrix.
+ * @param [in] i : index of matrix to be returned
+ * @return : matrix_N_NzNz_[i] */
+//************************************************************************************************//
+const SymmetricMatrix<cemDOUBLE>& SolverSolidElement::matrix_N_NzNz(cemINT i) const
+{
+    if (i >= num_coefficient_functions())
+        throw(Exception("INPUT ERROR","Input is higher than number of matrices"));
+
+    return matrix_N_NzNz_[i];
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::setUp_matrix_N_NxNx : Set up vector of matrices N_NxNx.
+ *
+ * 3D elements are always integrated numerically.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverSolidElement::setUp_matrix_N_NxNx(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    Compute_matrices(true,false,false,false);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::setUp_matrix_N_NyNy : Set up vector of matrices N_NyNy.
+ *
+ * 3D elements are always integrated numerically.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverSolidElement::setUp_matrix_N_NyNy(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    Compute_matrices(false,true,false,false);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::setUp_matrix_N_NzNz : Set up vector of matrices N_NzNz.
+ *
+ * 3D elements are always integrated numerically.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverSolidElement::setUp_matrix_N_NzNz(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    Compute_matrices(false,false,true,false);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::setUp_matrix_N_NN : Set up vector of matrices N_NN.
+ *
+ * 3D elements are always integrated numerically.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverSolidElement::setUp_matrix_N_NN(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    Compute_matrices(false,false,false,true);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::setUp_matrices : Set up N_NxNx, N_NyNy, N_NzNz, N_NN and
+ * N_GradGrad (N_NxNx + N_NyNy + N_NzNz) matrices in a single pass over the quadrature points.
+ * @param [in] force_numerical_integration : not used */
+//************************************************************************************************//
+void SolverSolidElement::setUp_matrices(cemBOOL force_numerical_integration)
+{
+    (void)force_numerical_integration;
+    Compute_matrices(true,true,true,true);
+
+    // Add up gradients:
+    cemINT num_matrices = num_coefficient_functions();
+    matrix_N_GradGrad_.resize(num_matrices);
+    for (cemINT k=0; k<num_matrices; ++k)
+    {
+        matrix_N_GradGrad_[k] = matrix_N_NxNx_[k];
+        matrix_N_GradGrad_[k] += matrix_N_NyNy_[k];
+        matrix_N_GradGrad_[k] += matrix_N_NzNz_[k];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::ContractMatrices : Gets the matrices of each family contracted with
+ * the coefficients of a field, \f$ \sum_k \beta_k M_k \f$.
+ *
+ * The coefficient functions are added up at each quadrature point, so only one matrix per family
+ * is integrated, and the matrices of this element (matrix_N_NxNx() and the rest) are left
+ * untouched. N_GradGrad adds up the three derivatives.
+ * @param [in] coefficients : \f$ \beta_k \f$, num_coefficient_functions() values
+ * @param [out] N_NxNx : contracted N_NxNx matrix (or NULL)
+ * @param [out] N_NyNy : contracted N_NyNy matrix (or NULL)
+ * @param [out] N_NN : contracted N_NN matrix (or NULL)
+ * @param [out] N_GradGrad : contracted N_GradGrad matrix (or NULL) */
+//************************************************************************************************//
+void SolverSolidElement::ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                                          SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                                          SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                                          SymmetricMatrix<cemDOUBLE>* N_NN,
+                                          SymmetricMatrix<cemDOUBLE>* N_GradGrad)
+{
+    if (static_cast<cemINT>(coefficients.size()) != num_coefficient_functions())
+        throw(Exception("INPUT ERROR","Expected one coefficient per coefficient function"));
+
+    std::vector< SymmetricMatrix<cemDOUBLE> > K_x,K_y,K_z,M;
+    std::vector< SymmetricMatrix<cemDOUBLE> >* families[4] = {NULL, NULL, NULL, NULL};
+    if (N_NxNx != NULL || N_GradGrad != NULL)
+        families[0] = &K_x;
+    if (N_NyNy != NULL || N_GradGrad != NULL)
+        families[1] = &K_y;
+    if (N_GradGrad != NULL)
+        families[2] = &K_z;
+    if (N_NN != NULL)
+        families[3] = &M;
+    Integrate_matrices(&coefficients,families);
+
+    if (N_NxNx != NULL)
+        *N_NxNx = K_x[0];
+    if (N_NyNy != NULL)
+        *N_NyNy = K_y[0];
+    if (N_NN != NULL)
+        *N_NN = M[0];
+    if (N_GradGrad != NULL)
+    {
+        *N_GradGrad = K_x[0];
+        *N_GradGrad += K_y[0];
+        *N_GradGrad += K_z[0];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::Compute_matrices : Computes the requested families of matrices by
+ * numerical integration, one matrix per coefficient function.
+ * @param [in] compute_N_NxNx : compute N_NxNx matrices
+ * @param [in] compute_N_NyNy : compute N_NyNy matrices
+ * @param [in] compute_N_NzNz : compute N_NzNz matrices
+ * @param [in] compute_N_NN : compute N_NN matrices */
+//************************************************************************************************//
+void SolverSolidElement::Compute_matrices(const cemBOOL& compute_N_NxNx,
+                                          const cemBOOL& compute_N_NyNy,
+                                          const cemBOOL& compute_N_NzNz,
+                                          const cemBOOL& compute_N_NN)
+{
+    std::vector< SymmetricMatrix<cemDOUBLE> >* families[4] = {NULL, NULL, NULL, NULL};
+    if (compute_N_NxNx) families[0] = &matrix_N_NxNx_;
+    if (compute_N_NyNy) families[1] = &matrix_N_NyNy_;
+    if (compute_N_NzNz) families[2] = &matrix_N_NzNz_;
+    if (compute_N_NN) families[3] = &matrix_N_NN_;
+    Integrate_matrices(NULL,families);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::Integrate_matrices : Integrates the requested families of matrices
+ * numerically.
+ *
+ * Without coefficients, each family gets one matrix per coefficient function. With them, the
+ * coefficient functions are added up at each quadrature point first, so each family gets a single
+ * matrix.
+ * @param [in] coefficients : \f$ \beta_k \f$, num_coefficient_functions() values (or NULL)
+ * @param [out] families : N_NxNx, N_NyNy, N_NzNz and N_NN matrices (or NULL, if not needed) */
+//************************************************************************************************//
+void SolverSolidElement::Integrate_matrices(const std::vector<cemDOUBLE>* coefficients,
+                                            std::vector< SymmetricMatrix<cemDOUBLE> >* families[4])
+{
+    // Pre-compute common terms if they haven't been computed yet:
+    setUpGeometry();
+
+    const SolidTabulation& tabulation = SolidTabulation::Get(element_ptr_->type(),
+                                                             basis_function_order_,
+                                                             coefficient_order_);
+    cemINT n = tabulation.num_basis_functions();
+    cemINT num_coefficients = tabulation.num_coefficient_functions();
+    cemINT num_points = tabulation.num_points();
+    const cemDOUBLE* weights = tabulation.weights();
+
+    // Jacobian at every quadrature point, J[(3*r + c)*num_points + t] = d(x_c)/d(ksi_r):
+    std::vector<cemDOUBLE> J(9*num_points,0.0);
+    for (cemINT a=0; a<tabulation.num_geometry_functions(); ++a)
+    {
+        const cemDOUBLE* dN[3] = {tabulation.geometry_ksi_deriv(a),
+                                  tabulation.geometry_eta_deriv(a),
+                                  tabulation.geometry_zeta_deriv(a)};
+        cemDOUBLE X[3] = {x_[a], y_[a], z_[a]};
+        for (cemINT r=0; r<3; ++r)
+        {
+            for (cemINT c=0; c<3; ++c)
+            {
+                cemDOUBLE* J_rc = &J[(3*r + c)*num_points];
+                for (cemINT t=0; t<num_points; ++t)
+                    J_rc[t] += X[c]*dN[r][t];
+            }
+        }
+    }
+
+    // Determinant and inverse Jacobian (cofactors) at every quadrature point, with
+    // inverse[(3*c + r)*num_points + t] = d(ksi_r)/d(x_c):
+    std::vector<cemDOUBLE> determinant(num_points);
+    std::vector<cemDOUBLE> inverse(9*num_points);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        cemDOUBLE A[3][3];
+        for (cemINT r=0; r<3; ++r)
+        {
+            for (cemINT c=0; c<3; ++c)
+                A[r][c] = J[(3*r + c)*num_points + t];
+        }
+
+        cemDOUBLE C[3][3];
+        C[0][0] = A[1][1]*A[2][2] - A[1][2]*A[2][1];
+        C[0][1] = A[0][2]*A[2][1] - A[0][1]*A[2][2];
+        C[0][2] = A[0][1]*A[1][2] - A[0][2]*A[1][1];
+        C[1][0] = A[1][2]*A[2][0] - A[1][0]*A[2][2];
+        C[1][1] = A[0][0]*A[2][2] - A[0][2]*A[2][0];
+        C[1][2] = A[0][2]*A[1][0] - A[0][0]*A[1][2];
+        C[2][0] = A[1][0]*A[2][1] - A[1][1]*A[2][0];
+        C[2][1] = A[0][1]*A[2][0] - A[0][0]*A[2][1];
+        C[2][2] = A[0][0]*A[1][1] - A[0][1]*A[1][0];
+        determinant[t] = A[0][0]*C[0][0] + A[0][1]*C[1][0] + A[0][2]*C[2][0];
+        for (cemINT r=0; r<3; ++r)
+        {
+            for (cemINT c=0; c<3; ++c)
+                inverse[(3*r + c)*num_points + t] = C[r][c]/determinant[t];
+        }
+    }
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        if (!(determinant[t]*determinant[0] > 0.0))
+            throw(Exception("INVALID ELEMENT","Jacobian of 3D element is singular"));
+    }
+
+    // Families requested:
+    cemINT num_sets = (coefficients == NULL) ? num_coefficients : 1;
+    for (cemINT f=0; f<4; ++f)
+    {
+        if (families[f] == NULL)
+            continue;
+
+        families[f]->resize(num_sets);
+        for (cemINT k=0; k<num_sets; ++k)
+        {
+            (*families[f])[k].resize(n,n);
+            (*families[f])[k].initialize();
+        }
+    }
+
+    // Add contributions of each quadrature point (matrices are packed, see SymmetricMatrix):
+    std::vector<cemDOUBLE> N_d(3*n);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        const cemDOUBLE* N = tabulation.basis(t);
+        const cemDOUBLE* N_ksi[3] = {tabulation.basis_ksi_deriv(t),
+                                     tabulation.basis_eta_deriv(t),
+                                     tabulation.basis_zeta_deriv(t)};
+        const cemDOUBLE* coefficient_functions = tabulation.coefficients(t);
+
+        // Derivatives with respect to x, y and z:
+        for (cemINT c=0; c<3; ++c)
+        {
+            cemDOUBLE dksi_dc = inverse[3*c*num_points + t];
+            cemDOUBLE deta_dc = inverse[(3*c + 1)*num_points + t];
+            cemDOUBLE dzeta_dc = inverse[(3*c + 2)*num_points + t];
+            for (cemINT i=0; i<n; ++i)
+                N_d[c*n + i] = dksi_dc*N_ksi[0][i] + deta_dc*N_ksi[1][i] + dzeta_dc*N_ksi[2][i];
+        }
+
+        // Coefficient function k, or the field, at this point:
+        cemDOUBLE field = 0.0;
+        if (coefficients != NULL)
+        {
+            for (cemINT k=0; k<num_coefficients; ++k)
+                field += (*coefficients)[k]*coefficient_functions[k];
+        }
+
+        for (cemINT k=0; k<num_sets; ++k)
+        {
+            cemDOUBLE value = (coefficients == NULL) ? coefficient_functions[k] : field;
+            cemDOUBLE w = weights[t]*value*std::fabs(determinant[t]);
+            for (cemINT f=0; f<4; ++f)
+            {
+                if (families[f] == NULL)
+                    continue;
+
+                const cemDOUBLE* V = (f < 3) ? &N_d[f*n] : N;
+                cemDOUBLE* matrix = &(*families[f])[k](0,0);
+                cemINT m = 0;
+                for (cemINT j=0; j<n; ++j)
+                {
+                    cemDOUBLE wV_j = w*V[j];
+                    for (cemINT i=j; i<n; ++i, ++m)
+                        matrix[m] += wV_j*V[i];
+                }
+            }
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverSolidElement::setUpGeometry : Gets the coordinates of the vertices, and the
+ * Jacobian Matrix (and its inverse) at the centroid of the reference element. */
+//************************************************************************************************//
+void SolverSolidElement::setUpGeometry()
+{
+    if (!geometry_is_Up_)
+    {
+        // Check that the element has straight edges (nothing else is supported yet):
+        if (element_ptr_->order() != 1)
+            throw(Exception("FEATURE NOT IMPLEMENTED","Curvilinear 3D elements not supported"));
+
+        cemINT num_vertices = (element_ptr_->type() == Element::TET) ? 4 : 6;
+        if (static_cast<cemINT>(element_ptr_->node_ptrs().size()) < num_vertices)
+            throw(Exception("INPUT ERROR","Element does not have all its vertices"));
+
+        x_.resize(num_vertices);
+        y_.resize(num_vertices);
+        z_.resize(num_vertices);
+        for (cemINT a=0; a<num_vertices; ++a)
+        {
+            x_[a] = element_ptr_->node(a)->operator [](0);
+            y_[a] = element_ptr_->node(a)->operator [](1);
+            z_[a] = element_ptr_->node(a)->operator [](2);
+        }
+
+        // Jacobian Matrix of mapping from reference to actual element, at the centroid:
+        jacobian_matrix_.resize(3,3);
+        const std::vector<cemDOUBLE>* X[3] = {&x_, &y_, &z_};
+        for (cemINT c=0; c<3; ++c)
+        {
+            const std::vector<cemDOUBLE>& v = *X[c];
+            if (num_vertices == 4)
+            {
+                jacobian_matrix_(0,c) = v[1] - v[0];
+                jacobian_matrix_(1,c) = v[2] - v[0];
+                jacobian_matrix_(2,c) = v[3] - v[0];
+            }
+            else
+            {
+                jacobian_matrix_(0,c) = 0.5*(v[0] - v[2] + v[3] - v[5]);
+                jacobian_matrix_(1,c) = 0.5*(v[1] - v[2] + v[4] - v[5]);
+                jacobian_matrix_(2,c) = (v[3] + v[4] + v[5] - v[0] - v[1] - v[2])/6.0;
+            }
+        }
+        if (jacobian_matrix_.determinant() == 0.0)
+            throw(Exception("INVALID ELEMENT","3D element is degenerate"));
+        inverse_jacobian_matrix_ = jacobian_matrix_.inverse();
+
+        geometry_is_Up_ = true;
+    }
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS SolverTetrahedron:
+///***********************************************************************************************//
+const cemINT SolverTetrahedron::MAX_BASIS_ORDER;
+
+
+//************************************************************************************************//
+/** @brief SolverTetrahedron::SolverTetrahedron : Constructor with parameters.
+ * @param [in] element_ptr : pointer to element in mesh
+ * @param [in] basis_order : polynomial order of basis functions (between 1 and 3)
+ * @param [in] function_field : basis function field (scalar or vector)
+ * @param [in] function_type : basis function type (interpolatory or hierarchical)
+ * @param [in] coefficient_order : polynomial order of coefficients */
+//************************************************************************************************//
+SolverTetrahedron::SolverTetrahedron(const cem_mesh::Element* element_ptr,
+                                     const cemINT& basis_order,
+                                     const BasisFunctionField& function_field,
+                                     const BasisFunctionType& function_type,
+                                     const cemINT& coefficient_order) :
+    SolverSolidElement(element_ptr,basis_order,function_field,function_type,coefficient_order)
+{
+    // Check that element is a tetrahedron:
+    if (element_ptr->type() != Element::TET)
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Tetrahedron (TET)"));
+
+    if (basis_order > MAX_BASIS_ORDER)
+        throw(Exception("FEATURE NOT IMPLEMENTED","basis_order > 3 not implemented for tetrahedra"));
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTetrahedron::num_coefficient_functions : Gets number of coefficient functions.
+ * @return : (q+1)(q+2)(q+3)/6 */
+//************************************************************************************************//
+cemINT SolverTetrahedron::num_coefficient_functions() const
+{
+    return (coefficient_order_+1)*(coefficient_order_+2)*(coefficient_order_+3)/6;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTetrahedron::set_element_ptr : Sets pointer to mesh element (tetrahedron)
+ * @param [in] element_ptr : pointer to element in mesh */
+//************************************************************************************************//
+void SolverTetrahedron::set_element_ptr(const cem_mesh::Element *element_ptr)
+{
+    // Check that element is a tetrahedron:
+    if (element_ptr->type() != Element::TET)
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Tetrahedron (TET)"));
+
+    element_ptr_ = element_ptr;
+    geometry_is_Up_ = false;
+    matrices_are_Up_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTetrahedron::GetShapeFunctionIndices : Get four indices needed to evaluate a
+ * basis function of a tetrahedron.
+ *
+ * Each basis function is a product of four Silvester Polynomials, one in the barycentric
+ * coordinate of each vertex. Functions follow the numbering of cemMesh.h: vertices, then the
+ * inner nodes of edges 0-1, 1-2, 2-0, 3-0, 3-2 and 3-1 (from the first to the second vertex),
+ * then the nodes of faces 0-2-1, 0-1-3, 0-3-2 and 3-1-2 (one each for order 3).
+ * @param [in] shape_function_order : polynomial order of ShapeFunction (0 to 3)
+ * @param [in] basis_function_index : index of the basis function within the tetrahedron
+ * @param [out] index_i : index of the Silvester Polynomial in \f$ 1-\xi-\eta-\zeta \f$ (vertex 0)
+ * @param [out] index_j : index of the Silvester Polynomial in \f$ \xi \f$ (vertex 1)
+ * @param [out] index_k : index of the Silvester Polynomial in \f$ \eta \f$ (vertex 2)
+ * @param [out] index_l : index of the Silvester Polynomial in \f$ \zeta \f$ (vertex 3) */
+//************************************************************************************************//
+void SolverTetrahedron::GetShapeFunctionIndices(const cemINT& shape_function_order,
+                                                const cemINT& basis_function_index,
+                                                cemINT& index_i,
+                                                cemINT& index_j,
+                                                cemINT& index_k,
+                                                cemINT& index_l)
+{
+    if (shape_function_order > MAX_BASIS_ORDER)
+        throw(Exception("FEATURE NOT IMPLEMENTED","Tetrahedra of order > 3 not implemented"));
+
+    cemINT order = shape_function_order;
+    cemINT num_functions = (order+1)*(order+2)*(order+3)/6;
+    if (basis_function_index < 0 || basis_function_index >= num_functions)
+    {
+        std::string temp = cem_utils::NumberToString<cemINT>(num_functions);
+        throw(Exception("INPUT ERROR","basisfunction_index must be from 1 to " + temp));
+    }
+
+    const cemINT EDGES[6][2] = {{0,1}, {1,2}, {2,0}, {3,0}, {3,2}, {3,1}};
+    const cemINT FACES[4][3] = {{0,2,1}, {0,1,3}, {0,3,2}, {3,1,2}};
+    cemINT ijkl[4] = {0, 0, 0, 0};
+    cemINT index = basis_function_index;
+    // The only function of order 0 is the constant 1 (all indices 0):
+    if (order > 0)
+    {
+        if (index < 4)
+            ijkl[index] = order;
+        else if (index < 4 + 6*(order-1))
+        {
+            index -= 4;
+            cemINT edge = index/(order-1);
+            cemINT t = index%(order-1) + 1;
+            ijkl[EDGES[edge][0]] = order - t;
+            ijkl[EDGES[edge][1]] = t;
+        }
+        else
+        {
+            const cemINT* face = FACES[index - 4 - 6*(order-1)];
+            ijkl[face[0]] = 1;
+            ijkl[face[1]] = 1;
+            ijkl[face[2]] = 1;
+        }
+    }
+
+    index_i = ijkl[0];
+    index_j = ijkl[1];
+    index_k = ijkl[2];
+    index_l = ijkl[3];
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS SolverPrism:
+///***********************************************************************************************//
+const cemINT SolverPrism::MAX_BASIS_ORDER;
+
+
+//************************************************************************************************//
+/** @brief SolverPrism::SolverPrism : Constructor with parameters.
+ * @param [in] element_ptr : pointer to element in mesh
+ * @param [in] basis_order : polynomial order of basis functions (1 or 2)
+ * @param [in] function_field : basis function field (scalar or vector)
+ * @param [in] function_type : basis function type (interpolatory or hierarchical)
+ * @param [in] coefficient_order : polynomial order of coefficients */
+//************************************************************************************************//
+SolverPrism::SolverPrism(const cem_mesh::Element* element_ptr,
+                         const cemINT& basis_order,
+                         const BasisFunctionField& function_field,
+                         const BasisFunctionType& function_type,
+                         const cemINT& coefficient_order) :
+    SolverSolidElement(element_ptr,basis_order,function_field,function_type,coefficient_order)
+{
+    // Check that element is a prism:
+    if (element_ptr->type() != Element::PRISM)
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Prism (PRISM)"));
+
+    if (basis_order > MAX_BASIS_ORDER)
+        throw(Exception("FEATURE NOT IMPLEMENTED","basis_order > 2 not implemented for prisms"));
+}
+
+
+//************************************************************************************************//
+/** @brief SolverPrism::num_coefficient_functions : Gets number of coefficient functions.
+ *
+ * Coefficient k is the product of triangle function k%m and 1D polynomial k/m in the axis of the
+ * prism, with m = (q+1)(q+2)/2.
+ * @return : (q+1)^2 (q+2)/2 */
+//************************************************************************************************//
+cemINT SolverPrism::num_coefficient_functions() const
+{
+    return (coefficient_order_+1)*(coefficient_order_+1)*(coefficient_order_+2)/2;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverPrism::set_element_ptr : Sets pointer to mesh element (prism)
+ * @param [in] element_ptr : pointer to element in mesh */
+//************************************************************************************************//
+void SolverPrism::set_element_ptr(const cem_mesh::Element *element_ptr)
+{
+    // Check that element is a prism:
+    if (element_ptr->type() != Element::PRISM)
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Prism (PRISM)"));
+
+    element_ptr_ = element_ptr;
+    geometry_is_Up_ = false;
+    matrices_are_Up_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverPrism::GetShapeFunctionIndices : Get the two indices of a basis function of a
+ * prism.
+ *
+ * Basis function m is the product of a basis function of the triangle (numbered as in
+ * SolverTriangle::GetShapeFunctionIndices) and the 1D Lagrange polynomial of node
+ * \f$ -1 + 2l/p \f$ along the axis. Functions follow the numbering of cemMesh.h (Prism6 and
+ * Prism18): vertices, then edges 0-1, 0-2, 0-3, 1-2, 1-4, 2-5, 3-4, 3-5 and 4-5, then the
+ * quadrangular faces 0-1-4-3, 0-2-5-3 and 1-2-5-4.
+ * @param [in] shape_function_order : polynomial order of the basis functions (0 to 2)
+ * @param [in] basis_function_index : index of the basis function within the prism
+ * @param [out] triangle_index : index of the basis function of the triangle
+ * @param [out] line_index : index l of the 1D Lagrange polynomial */
+//************************************************************************************************//
+void SolverPrism::GetShapeFunctionIndices(const cemINT& shape_function_order,
+                                          const cemINT& basis_function_index,
+                                          cemINT& triangle_index,
+                                          cemINT& line_index)
+{
+    if (shape_function_order > MAX_BASIS_ORDER)
+        throw(Exception("FEATURE NOT IMPLEMENTED","Prisms of order > 2 not implemented"));
+
+    cemINT order = shape_function_order;
+    cemINT num_functions = (order+1)*(order+1)*(order+2)/2;
+    if (basis_function_index < 0 || basis_function_index >= num_functions)
+    {
+        std::string temp = cem_utils::NumberToString<cemINT>(num_functions);
+        throw(Exception("INPUT ERROR","basisfunction_index must be from 1 to " + temp));
+    }
+
+    // (triangle_index, line_index) of the 18 nodes of a second-order prism:
+    const cemINT PRISM18[18][2] = {{0,0}, {1,0}, {2,0}, {0,2}, {1,2}, {2,2},
+                                   {3,0}, {5,0}, {0,1}, {4,0}, {1,1}, {2,1},
+                                   {3,2}, {5,2}, {4,2}, {3,1}, {5,1}, {4,1}};
+    if (order == 0)
+    {
+        triangle_index = 0;
+        line_index = 0;
+    }
+    else if (order == 1)
+    {
+        triangle_index = basis_function_index%3;
+        line_index = basis_function_index/3;
+    }
+    else
+    {
+        triangle_index = PRISM18[basis_function_index][0];
+        line_index = PRISM18[basis_function_index][1];
     }
 }
@@ -5,13 +5,17 @@
 #include <iostream>
 #include "cemMesh.h"
 #include "Matrix/DenseMatrix.h"
+#include "Matrix/SymmetricMatrix.h"
 
 
 using cem_mesh::Element;
 using cem_math::DenseMatrix;
+using cem_math::SymmetricMatrix;
 
 namespace cem_core {
 
+class TriTabulation;
+
 /** @brief The BasisFunctionType enum : Defines the type of basis function */
 enum BasisFunctionType
 {
@@ -45,9 +49,11 @@ public:
     BasisFunctionField basis_function_field() const;
     BasisFunctionType basis_function_type() const;
     cemINT coefficient_order() const;
-    const DenseMatrix<cemDOUBLE>& matrix_N_NxNx(cemINT i) const;
-    const DenseMatrix<cemDOUBLE>& matrix_N_NyNy(cemINT i) const;
-    const DenseMatrix<cemDOUBLE>& matrix_N_NN(cemINT i) const;
+    virtual cemINT num_coefficient_functions() const;
+    const SymmetricMatrix<cemDOUBLE>& matrix_N_NxNx(cemINT i) const;
+    const SymmetricMatrix<cemDOUBLE>& matrix_N_NyNy(cemINT i) const;
+    const SymmetricMatrix<cemDOUBLE>& matrix_N_NN(cemINT i) const;
+    const SymmetricMatrix<cemDOUBLE>& matrix_N_GradGrad(cemINT i) const;
 
     // Set data members:
     void set_basis_function_order(const cemINT& order);
@@ -59,7 +65,14 @@ public:
     virtual void setUp_matrix_N_NxNx(cemBOOL force_numerical_integration) = 0;
     virtual void setUp_matrix_N_NyNy(cemBOOL force_numerical_integration) = 0;
     virtual void setUp_matrix_N_NN(cemBOOL force_numerical_integration) = 0;
+    virtual void setUp_matrices(cemBOOL force_numerical_integration);
 
+    // Matrices contracted with the coefficients of a field:
+    virtual void ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                                  SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                                  SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                                  SymmetricMatrix<cemDOUBLE>* N_NN,
+                                  SymmetricMatrix<cemDOUBLE>* N_GradGrad);
 
 
 protected:
@@ -70,16 +83,23 @@ protected:
     cemINT              coefficient_order_;     //!< Polynomial order of the coefficients
                                                 //!< scalling the basis functions.
 
-    std::vector< DenseMatrix<cemDOUBLE> > matrix_N_NxNx_;   //!< Product of x-derivatives.
-    std::vector< DenseMatrix<cemDOUBLE> > matrix_N_NyNy_;   //!< Product of y-derivatives.
-    std::vector< DenseMatrix<cemDOUBLE> > matrix_N_NN_;     //!< Product of functions.
+    std::vector< SymmetricMatrix<cemDOUBLE> > matrix_N_NxNx_;       //!< Product of x-derivatives.
+    std::vector< SymmetricMatrix<cemDOUBLE> > matrix_N_NyNy_;       //!< Product of y-derivatives.
+    std::vector< SymmetricMatrix<cemDOUBLE> > matrix_N_NN_;         //!< Product of functions.
+    std::vector< SymmetricMatrix<cemDOUBLE> > matrix_N_GradGrad_;   //!< Product of gradients.
 
     DenseMatrix<cemDOUBLE> jacobian_matrix_;            //!< Jacobian Matrix of spatial mapping.
     DenseMatrix<cemDOUBLE> inverse_jacobian_matrix_;    //!< Inverse of Jacobian Matrix.
 
+    cemBOOL matrices_are_Up_;   //!< TRUE if all families were computed in one pass for the current
+                                //!< element and orders (setUp_matrix_* then reuse them).
+
     // Protected member functions:
     void initialize();
     void copy(const SolverElement& other);
+    static void Contract(const std::vector< SymmetricMatrix<cemDOUBLE> >& matrices,
+                         const std::vector<cemDOUBLE>& coefficients,
+                         SymmetricMatrix<cemDOUBLE>& contracted);
 
     // Default constructor:
     SolverElement();
@@ -102,7 +122,7 @@ class SolverTriangle : public SolverElement
 {
 public:
     /** @brief SolverTriangle : Default constructor. */
-    SolverTriangle() : SolverElement() {}
+    SolverTriangle() : SolverElement() {geometry_is_Up_ = false; is_curvilinear_ = false;}
 
     // Constructor with parameters:
     SolverTriangle(const Element* element_ptr,
@@ -118,8 +138,24 @@ public:
     void setUp_matrix_N_NxNx(cemBOOL force_numerical_integration);
     void setUp_matrix_N_NyNy(cemBOOL force_numerical_integration);
     void setUp_matrix_N_NN(cemBOOL force_numerical_integration);
+    void setUp_matrices(cemBOOL force_numerical_integration);
+    void UpdateBasisFunctionOrder(const cemINT& order);
+    void ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                          SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                          SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                          SymmetricMatrix<cemDOUBLE>* N_NN,
+                          SymmetricMatrix<cemDOUBLE>* N_GradGrad);
+
+    // Numbering of basis functions:
+    static void GetShapeFunctionIndices(const cemINT& shape_function_order,
+                                        const cemINT& basis_function_index,
+                                        cemINT& index_i,
+                                        cemINT& index_j,
+                                        cemINT& index_k);
 
 private:
+    static const cemINT CURVILINEAR_EXTRA_ORDER = 2;    //!< Order added to curvilinear rules.
+
     cemBOOL geometry_is_Up_;    //!< TRUE if setUpGeometry() has been run succesfully
 
     cemDOUBLE x1_;      //!< X-coordinate of node 1
@@ -142,8 +178,14 @@ private:
     cemDOUBLE c3_;      //!< \f$ c_3 = x_2 - x_1 \f$
     cemDOUBLE delta_;   //!< \f$ delta_ = (b_1*c_2 - b_2*c_1)/2 \f$
 
+    cemBOOL is_curvilinear_;            //!< TRUE if the triangle has curved (second-order) edges
+    std::vector<cemDOUBLE> curved_x_;   //!< X-coordinates of the 6 nodes of a curvilinear triangle
+    std::vector<cemDOUBLE> curved_y_;   //!< Y-coordinates of the 6 nodes of a curvilinear triangle
+
     // Private member functions:
+    static void CheckQuadratureOrder(const cemINT& basis_order, const cemINT& coefficient_order);
     void setUpGeometry();
+    void setUpLocalFrame(const cemINT& num_nodes);
 
     cemDOUBLE Compute_N_NxNx_matrix_entry(const cemINT& coefficient_index,
                                           const cemINT& test_function_index,
@@ -165,14 +207,248 @@ private:
     void Compute_N_NyNy_matrix_analytically();
     void Compute_N_NN_matrix_analytically();
 
-    void GetShapeFunctionIndices(const cemINT& shape_function_order,
-                                 const cemINT& basis_function_index,
-                                 cemINT& index_i,
-                                 cemINT& index_j,
-                                 cemINT& index_k) const;
+    void Compute_N_NxNx_matrix_from_reference();
+    void Compute_N_NyNy_matrix_from_reference();
+    void Compute_N_NN_matrix_from_reference();
+
+    void Compute_matrices_numerically(const cemINT& first_new_row = 0);
+    void Compute_matrices_from_reference();
+    void Compute_matrices_curvilinear();
+
+    void Contract_matrices_from_reference(const std::vector<cemDOUBLE>& coefficients,
+                                          std::vector<cemDOUBLE>& N_NxNx,
+                                          std::vector<cemDOUBLE>& N_NyNy,
+                                          std::vector<cemDOUBLE>& N_NN) const;
+    void Contract_matrices_numerically(const std::vector<cemDOUBLE>& coefficients,
+                                       std::vector<cemDOUBLE>& N_NxNx,
+                                       std::vector<cemDOUBLE>& N_NyNy,
+                                       std::vector<cemDOUBLE>& N_NN) const;
+    void OrientEdgeFunctions(const cemINT& n, const cemINT& first_new_row, cemDOUBLE* packed) const;
+
+    void setUpCurvilinearJacobians(const TriTabulation& tabulation,
+                                   std::vector<cemDOUBLE>& determinant,
+                                   std::vector<cemDOUBLE>& dksi_dx,
+                                   std::vector<cemDOUBLE>& deta_dx,
+                                   std::vector<cemDOUBLE>& dksi_dy,
+                                   std::vector<cemDOUBLE>& deta_dy) const;
+};
+
+
+//************************************************************************************************//
+/** @brief The SolverQuadrangle class : Bilinear quadrangle with tensor-product basis functions.
+ *
+ * The reference element is \f$ [-1,1]^2 \f$ and the basis functions of order p are products of
+ * 1D Lagrange polynomials on p+1 equispaced nodes, numbered as the nodes of cemMesh.h (vertices,
+ * then edges, then interior). Coefficients are expanded in the same way, with (q+1)^2 functions.
+ *
+ * Matrices are integrated with tensor-product Gauss rules and sum factorization: the integrand is
+ * first contracted over the points of the \f$ \eta \f$ rule, and then over the points of the
+ * \f$ \xi \f$ rule, which only involves 1D tables of basis functions.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SolverQuadrangle : public SolverElement
+{
+public:
+    /** @brief SolverQuadrangle : Default constructor. */
+    SolverQuadrangle() : SolverElement() {geometry_is_Up_ = false;}
+
+    // Constructor with parameters:
+    SolverQuadrangle(const Element* element_ptr,
+                     const cemINT& basis_order,
+                     const BasisFunctionField& function_field,
+                     const BasisFunctionType& function_type,
+                     const cemINT& coefficient_order);
+
+    // Get data members:
+    cemINT num_coefficient_functions() const;
+
+    // Set data members:
+    void set_element_ptr(const Element* element_ptr);
+
+    // Matrices:
+    void setUp_matrix_N_NxNx(cemBOOL force_numerical_integration);
+    void setUp_matrix_N_NyNy(cemBOOL force_numerical_integration);
+    void setUp_matrix_N_NN(cemBOOL force_numerical_integration);
+    void setUp_matrices(cemBOOL force_numerical_integration);
+
+    // Matrices contracted with the coefficients of a field:
+    void ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                          SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                          SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                          SymmetricMatrix<cemDOUBLE>* N_NN,
+                          SymmetricMatrix<cemDOUBLE>* N_GradGrad);
+
+    // Numbering of basis functions:
+    static void GetShapeFunctionIndices(const cemINT& shape_function_order,
+                                        const cemINT& basis_function_index,
+                                        cemINT& index_u,
+                                        cemINT& index_v);
+
+    // 1D Lagrange polynomials on equispaced nodes:
+    static void EvaluateLagrange(const cemINT& order,
+                                 const cemINT& num_points,
+                                 const cemDOUBLE* ksi,
+                                 cemDOUBLE* values,
+                                 cemDOUBLE* derivs);
+
+private:
+    static const cemINT BILINEAR_EXTRA_ORDER = 2;   //!< Order added to the rules of bilinear maps.
+
+    cemBOOL geometry_is_Up_;    //!< TRUE if setUpGeometry() has been run succesfully
+
+    cemDOUBLE x_[4];    //!< X-coordinates of the vertices
+    cemDOUBLE y_[4];    //!< Y-coordinates of the vertices
+
+    // Private member functions:
+    void setUpGeometry();
+
+    void Compute_matrices_sum_factorized();
+    void Integrate_sum_factorized(const std::vector<cemDOUBLE>* coefficients,
+                                  std::vector< SymmetricMatrix<cemDOUBLE> >* families[3]);
+
+    static void SumFactorize(const cemINT& num_1D_functions,
+                             const cemINT& num_1D_points,
+                             const std::vector<cemINT>& index_u,
+                             const std::vector<cemINT>& index_v,
+                             const cemDOUBLE* G,
+                             const cemDOUBLE* U_test,
+                             const cemDOUBLE* U_source,
+                             const cemDOUBLE* V_test,
+                             const cemDOUBLE* V_source,
+                             std::vector<cemDOUBLE>& workspace,
+                             cemDOUBLE* matrix);
 };
 
 
+
+//************************************************************************************************//
+/** @brief The SolverSolidElement class : Common part of the 3D elements (tetrahedra and prisms).
+ *
+ * 3D elements have a fourth family of matrices, N_NzNz, and their N_GradGrad matrices add up
+ * the three derivatives. Matrices are integrated numerically with the shared SolidTabulation of
+ * the element type and orders: the 3x3 Jacobian, its determinant and its inverse are computed at
+ * all quadrature points first (loops over points are innermost), and then every tabulated basis
+ * function is read once per point for all families.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SolverSolidElement : public SolverElement
+{
+public:
+    // Get data members:
+    const SymmetricMatrix<cemDOUBLE>& matrix_N_NzNz(cemINT i) const;
+
+    // Matrices:
+    void setUp_matrix_N_NxNx(cemBOOL force_numerical_integration);
+    void setUp_matrix_N_NyNy(cemBOOL force_numerical_integration);
+    void setUp_matrix_N_NzNz(cemBOOL force_numerical_integration);
+    void setUp_matrix_N_NN(cemBOOL force_numerical_integration);
+    void setUp_matrices(cemBOOL force_numerical_integration);
+
+    // Matrices contracted with the coefficients of a field:
+    void ContractMatrices(const std::vector<cemDOUBLE>& coefficients,
+                          SymmetricMatrix<cemDOUBLE>* N_NxNx,
+                          SymmetricMatrix<cemDOUBLE>* N_NyNy,
+                          SymmetricMatrix<cemDOUBLE>* N_NN,
+                          SymmetricMatrix<cemDOUBLE>* N_GradGrad);
+
+protected:
+    std::vector< SymmetricMatrix<cemDOUBLE> > matrix_N_NzNz_;       //!< Product of z-derivatives.
+
+    cemBOOL geometry_is_Up_;    //!< TRUE if setUpGeometry() has been run succesfully
+    std::vector<cemDOUBLE> x_;  //!< X-coordinates of the vertices
+    std::vector<cemDOUBLE> y_;  //!< Y-coordinates of the vertices
+    std::vector<cemDOUBLE> z_;  //!< Z-coordinates of the vertices
+
+    /** @brief SolverSolidElement : Default constructor. */
+    SolverSolidElement() : SolverElement() {geometry_is_Up_ = false;}
+
+    // Constructor with parameters:
+    SolverSolidElement(const Element* element_ptr,
+                       const cemINT& basis_order,
+                       const BasisFunctionField& function_field,
+                       const BasisFunctionType& function_type,
+                       const cemINT& coefficient_order);
+
+    // Protected member functions:
+    void setUpGeometry();
+    void Compute_matrices(const cemBOOL& compute_N_NxNx,
+                          const cemBOOL& compute_N_NyNy,
+                          const cemBOOL& compute_N_NzNz,
+                          const cemBOOL& compute_N_NN);
+    void Integrate_matrices(const std::vector<cemDOUBLE>* coefficients,
+                            std::vector< SymmetricMatrix<cemDOUBLE> >* families[4]);
+};
+
+
+//************************************************************************************************//
+/** @brief The SolverTetrahedron class : Flat tetrahedron with Silvester (interpolatory) basis
+ * functions of order 1 to 3.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SolverTetrahedron : public SolverSolidElement
+{
+public:
+    static const cemINT MAX_BASIS_ORDER = 3;    //!< Highest order with a node numbering.
+
+    /** @brief SolverTetrahedron : Default constructor. */
+    SolverTetrahedron() : SolverSolidElement() {}
+
+    // Constructor with parameters:
+    SolverTetrahedron(const Element* element_ptr,
+                      const cemINT& basis_order,
+                      const BasisFunctionField& function_field,
+                      const BasisFunctionType& function_type,
+                      const cemINT& coefficient_order);
+
+    // Get data members:
+    cemINT num_coefficient_functions() const;
+
+    // Set data members:
+    void set_element_ptr(const Element* element_ptr);
+
+    // Numbering of basis functions:
+    static void GetShapeFunctionIndices(const cemINT& shape_function_order,
+                                        const cemINT& basis_function_index,
+                                        cemINT& index_i,
+                                        cemINT& index_j,
+                                        cemINT& index_k,
+                                        cemINT& index_l);
+};
+
+
+//************************************************************************************************//
+/** @brief The SolverPrism class : Prism with basis functions of order 1 or 2, products of the
+ * functions of a triangle and 1D Lagrange polynomials along the axis of the prism.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SolverPrism : public SolverSolidElement
+{
+public:
+    static const cemINT MAX_BASIS_ORDER = 2;    //!< Highest order with a node numbering.
+
+    /** @brief SolverPrism : Default constructor. */
+    SolverPrism() : SolverSolidElement() {}
+
+    // Constructor with parameters:
+    SolverPrism(const Element* element_ptr,
+                const cemINT& basis_order,
+                const BasisFunctionField& function_field,
+                const BasisFunctionType& function_type,
+                const cemINT& coefficient_order);
+
+    // Get data members:
+    cemINT num_coefficient_functions() const;
+
+    // Set data members:
+    void set_element_ptr(const Element* element_ptr);
+
+    // Numbering of basis functions:
+    static void GetShapeFunctionIndices(const cemINT& shape_function_order,
+                                        const cemINT& basis_function_index,
+                                        cemINT& triangle_index,
+                                        cemINT& line_index);
+};
+
 }
 
 
@@ -0,0 +1,323 @@
+#include "SolverTriangleArena.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+
+///***********************************************************************************************//
+/// CLASS SolverTriangleArena:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::SolverTriangleArena : Constructor with parameters.
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions
+ * @param [in] elements_per_chunk : number of triangles allocated at once (>= 1) */
+//************************************************************************************************//
+SolverTriangleArena::SolverTriangleArena(const cemINT& basis_order,
+                                         const cemINT& coefficient_order,
+                                         const cemINT& elements_per_chunk)
+{
+    if (elements_per_chunk < 1)
+        throw(Exception("INPUT ERROR","elements_per_chunk must be > 0"));
+
+    tensors_ = &TriReferenceTensors::Get(basis_order,coefficient_order);
+    kernel_ = TriKernels::GetReferenceKernel(basis_order,coefficient_order);
+    elements_per_chunk_ = elements_per_chunk;
+    num_elements_ = 0;
+
+    record_size_ = tensors_->num_packed_entries();
+    record_size_ *= 4*tensors_->num_coefficient_functions();
+    record_size_ += GEOMETRY_SIZE;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::~SolverTriangleArena : Destructor. */
+//************************************************************************************************//
+SolverTriangleArena::~SolverTriangleArena()
+{
+    Clear();
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::basis_order : Gets polynomial order of basis functions.
+ * @return : basis order */
+//************************************************************************************************//
+cemINT SolverTriangleArena::basis_order() const {return tensors_->basis_order();}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::coefficient_order : Gets polynomial order of coefficients.
+ * @return : coefficient order */
+//************************************************************************************************//
+cemINT SolverTriangleArena::coefficient_order() const {return tensors_->coefficient_order();}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::num_basis_functions : Gets number of rows of each matrix.
+ * @return : (p+1)(p+2)/2 */
+//************************************************************************************************//
+cemINT SolverTriangleArena::num_basis_functions() const {return tensors_->num_basis_functions();}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::num_coefficient_functions : Gets number of matrices per family.
+ * @return : (q+1)(q+2)/2 */
+//************************************************************************************************//
+cemINT SolverTriangleArena::num_coefficient_functions() const
+{
+    return tensors_->num_coefficient_functions();
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::num_elements : Gets number of triangles in the arena.
+ * @return : num_elements_ */
+//************************************************************************************************//
+cemINT SolverTriangleArena::num_elements() const {return num_elements_;}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::record_size : Gets number of cemDOUBLE stored per triangle.
+ * @return : record_size_ */
+//************************************************************************************************//
+cemINT8 SolverTriangleArena::record_size() const {return record_size_;}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::element_capacity : Gets number of triangles the element list holds
+ * before Add() has to grow it.
+ * @return : capacity of the element list */
+//************************************************************************************************//
+cemINT SolverTriangleArena::element_capacity() const
+{
+    return static_cast<cemINT>(elements_.capacity());
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::element_ptr : Gets mesh element of a triangle.
+ * @param [in] element_index : index returned by Add()
+ * @return : pointer to mesh element */
+//************************************************************************************************//
+const Element* SolverTriangleArena::element_ptr(const cemINT& element_index) const
+{
+    return elements_[element_index];
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::geometry : Gets geometry values of a triangle.
+ * @param [in] element_index : index returned by Add()
+ * @return : pointer to GEOMETRY_SIZE values, indexed by the Geometry enum */
+//************************************************************************************************//
+const cemDOUBLE* SolverTriangleArena::geometry(const cemINT& element_index) const
+{
+    return record(element_index);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::matrix_N_NxNx : Gets k-th N_NxNx matrix of a triangle.
+ * @param [in] element_index : index returned by Add()
+ * @param [in] k : index of the coefficient function
+ * @return : pointer to n(n+1)/2 packed entries */
+//************************************************************************************************//
+const cemDOUBLE* SolverTriangleArena::matrix_N_NxNx(const cemINT& element_index,
+                                                    const cemINT& k) const
+{
+    return matrix(element_index,0,k);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::matrix_N_NyNy : Gets k-th N_NyNy matrix of a triangle.
+ * @param [in] element_index : index returned by Add()
+ * @param [in] k : index of the coefficient function
+ * @return : pointer to n(n+1)/2 packed entries */
+//************************************************************************************************//
+const cemDOUBLE* SolverTriangleArena::matrix_N_NyNy(const cemINT& element_index,
+                                                    const cemINT& k) const
+{
+    return matrix(element_index,1,k);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::matrix_N_NN : Gets k-th N_NN matrix of a triangle.
+ * @param [in] element_index : index returned by Add()
+ * @param [in] k : index of the coefficient function
+ * @return : pointer to n(n+1)/2 packed entries */
+//************************************************************************************************//
+const cemDOUBLE* SolverTriangleArena::matrix_N_NN(const cemINT& element_index,
+                                                  const cemINT& k) const
+{
+    return matrix(element_index,2,k);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::matrix_N_GradGrad : Gets k-th N_GradGrad matrix of a triangle.
+ * @param [in] element_index : index returned by Add()
+ * @param [in] k : index of the coefficient function
+ * @return : pointer to n(n+1)/2 packed entries */
+//************************************************************************************************//
+const cemDOUBLE* SolverTriangleArena::matrix_N_GradGrad(const cemINT& element_index,
+                                                        const cemINT& k) const
+{
+    return matrix(element_index,3,k);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::Reserve : Allocates memory for a number of triangles in advance.
+ *
+ * Chunks are added until num_elements triangles fit, and the element list is sized for them. Use
+ * it when the number of triangles is known, so that Add() never allocates.
+ * @param [in] num_elements : total number of triangles expected */
+//************************************************************************************************//
+void SolverTriangleArena::Reserve(const cemINT& num_elements)
+{
+    elements_.reserve(num_elements);
+    AddChunks(num_elements);
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::Add : Adds a triangle and computes its geometry and matrices.
+ * @param [in] element_ptr : pointer to a flat triangle in the XY plane
+ * @return : index of the new triangle */
+//************************************************************************************************//
+cemINT SolverTriangleArena::Add(const Element* element_ptr)
+{
+    // Check that the element is a flat triangle in the XY plane:
+    if (element_ptr->type() != Element::TRI)
+        throw(Exception("WRONG ELEMENT TYPE","Expected a Triangle (TRI)"));
+    if (element_ptr->order() != 1)
+        throw(Exception("FEATURE NOT IMPLEMENTED","Curvilinear triangles not supported"));
+
+    const cem_mesh::Node& node1 = *element_ptr->node(0);
+    const cem_mesh::Node& node2 = *element_ptr->node(1);
+    const cem_mesh::Node& node3 = *element_ptr->node(2);
+    if (node1[2]-node2[2] != 0.0 || node1[2]-node3[2] != 0.0)
+        throw(Exception("FEATURE NOT IMPLEMENTED","Triangle must be in the XY plane"));
+
+    // Take next record (the element list grows geometrically):
+    AddChunks(num_elements_+1);
+    cemINT element_index = num_elements_++;
+    elements_.push_back(element_ptr);
+    cemDOUBLE* data = record(element_index);
+
+    // Geometry:
+    data[B1] = node2[1] - node3[1];
+    data[B2] = node3[1] - node1[1];
+    data[B3] = node1[1] - node2[1];
+    data[C1] = node3[0] - node2[0];
+    data[C2] = node1[0] - node3[0];
+    data[C3] = node2[0] - node1[0];
+    data[DELTA] = 0.5*(data[B1]*data[C2] - data[B2]*data[C1]);
+    data[GEOMETRY_SIZE-1] = 0.0;
+
+    // Matrices:
+    cemINT size = tensors_->num_packed_entries();
+    cemINT num_coefficients = tensors_->num_coefficient_functions();
+    for (cemINT k=0; k<num_coefficients; ++k)
+    {
+        cemDOUBLE* N_NxNx = data + GEOMETRY_SIZE + k*size;
+        cemDOUBLE* N_NyNy = N_NxNx + num_coefficients*size;
+        cemDOUBLE* N_NN = N_NyNy + num_coefficients*size;
+        cemDOUBLE* N_GradGrad = N_NN + num_coefficients*size;
+
+        if (kernel_ != NULL)
+        {
+            kernel_(*tensors_,k,data[B1],data[B2],data[C1],data[C2],data[DELTA],
+                    N_NxNx,N_NyNy,N_NN,N_GradGrad);
+            continue;
+        }
+
+        tensors_->Compute_N_NdNd_matrix(data[B1],data[B2],data[DELTA],k,N_NxNx);
+        tensors_->Compute_N_NdNd_matrix(data[C1],data[C2],data[DELTA],k,N_NyNy);
+        tensors_->Compute_N_NN_matrix(data[DELTA],k,N_NN);
+        for (cemINT m=0; m<size; ++m)
+            N_GradGrad[m] = N_NxNx[m] + N_NyNy[m];
+    }
+
+    return element_index;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::Clear : Removes all triangles and frees all memory. */
+//************************************************************************************************//
+void SolverTriangleArena::Clear()
+{
+    for (cemINT i=0; i<static_cast<cemINT>(chunks_.size()); ++i)
+        CLEAN_ARRAY(chunks_[i]);
+
+    chunks_.clear();
+    std::vector<const Element*>().swap(elements_);
+    num_elements_ = 0;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::AddChunks : Adds chunks until a number of triangles fit.
+ * @param [in] num_elements : number of triangles that must fit */
+//************************************************************************************************//
+void SolverTriangleArena::AddChunks(const cemINT& num_elements)
+{
+    cemINT8 chunk_size = record_size_*elements_per_chunk_;
+    while (static_cast<cemINT8>(chunks_.size())*elements_per_chunk_ < num_elements)
+    {
+        try
+        {
+            chunks_.push_back(new cemDOUBLE[chunk_size]);
+        }
+        catch (std::bad_alloc)
+        {
+            cemUINT memory = chunk_size*sizeof(cemDOUBLE)/1024/1024;
+            std::string temp = cem_utils::NumberToString<cemUINT>(memory);
+            throw(Exception("MEMORY OVERFLOW", "Requested memory=" + temp + "Mb"));
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::record : Gets the record of a triangle.
+ * @param [in] element_index : index returned by Add()
+ * @return : pointer to record_size() values */
+//************************************************************************************************//
+cemDOUBLE* SolverTriangleArena::record(const cemINT& element_index) const
+{
+    if (element_index < 0 || element_index >= num_elements_)
+        throw(Exception("INPUT ERROR","Element index out of range"));
+
+    cemINT8 offset = element_index%elements_per_chunk_;
+    offset *= record_size_;
+    return chunks_[element_index/elements_per_chunk_] + offset;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTriangleArena::matrix : Gets the k-th matrix of a family.
+ * @param [in] element_index : index returned by Add()
+ * @param [in] family : 0 (N_NxNx), 1 (N_NyNy), 2 (N_NN) or 3 (N_GradGrad)
+ * @param [in] k : index of the coefficient function
+ * @return : pointer to n(n+1)/2 packed entries */
+//************************************************************************************************//
+const cemDOUBLE* SolverTriangleArena::matrix(const cemINT& element_index,
+                                             const cemINT& family,
+                                             const cemINT& k) const
+{
+    cemINT num_coefficients = tensors_->num_coefficient_functions();
+    if (k < 0 || k >= num_coefficients)
+        throw(Exception("INPUT ERROR","Input is higher than number of matrices"));
+
+    return record(element_index) + GEOMETRY_SIZE +
+           (family*num_coefficients + k)*tensors_->num_packed_entries();
+}
@@ -0,0 +1,99 @@
+#ifndef SOLVER_TRIANGLE_ARENA_H
+#define SOLVER_TRIANGLE_ARENA_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "cemMesh.h"
+#include "TriReferenceTensors.h"
+#include "TriKernels.h"
+
+using namespace cem_def;
+using cem_mesh::Element;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The SolverTriangleArena class : Geometry and element matrices of many triangles, all
+ * in one arena.
+ *
+ * Every triangle takes a fixed-size record, whose size only depends on the basis and coefficient
+ * orders: GEOMETRY_SIZE geometry values followed by the packed (see SymmetricMatrix) N_NxNx,
+ * N_NyNy, N_NN and N_GradGrad matrices of each coefficient function. Records are bump-allocated
+ * from chunks of elements_per_chunk triangles, so adding a triangle never calls malloc (except
+ * when a chunk is full) and never moves existing records: indices and pointers stay valid until
+ * Clear() releases everything at once.
+ *
+ * Matrices are computed from the shared TriReferenceTensors, as in SolverTriangle, with the
+ * TriKernel of the two orders when there is one.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SolverTriangleArena
+{
+public:
+    /** @brief The Geometry enum : Position of each geometry value inside a record. */
+    enum Geometry
+    {
+        B1=0,
+        B2=1,
+        B3=2,
+        C1=3,
+        C2=4,
+        C3=5,
+        DELTA=6,
+        GEOMETRY_SIZE=8,    //!< Geometry values per record (the last one is unused).
+    };
+
+    // Constructor with parameters:
+    SolverTriangleArena(const cemINT& basis_order,
+                        const cemINT& coefficient_order,
+                        const cemINT& elements_per_chunk = 4096);
+
+    // Destructor:
+    ~SolverTriangleArena();
+
+    // Get data members:
+    cemINT basis_order() const;
+    cemINT coefficient_order() const;
+    cemINT num_basis_functions() const;
+    cemINT num_coefficient_functions() const;
+    cemINT num_elements() const;
+    cemINT8 record_size() const;
+    cemINT element_capacity() const;
+    const Element* element_ptr(const cemINT& element_index) const;
+    const cemDOUBLE* geometry(const cemINT& element_index) const;
+    const cemDOUBLE* matrix_N_NxNx(const cemINT& element_index, const cemINT& k) const;
+    const cemDOUBLE* matrix_N_NyNy(const cemINT& element_index, const cemINT& k) const;
+    const cemDOUBLE* matrix_N_NN(const cemINT& element_index, const cemINT& k) const;
+    const cemDOUBLE* matrix_N_GradGrad(const cemINT& element_index, const cemINT& k) const;
+
+    // Set data members:
+    void Reserve(const cemINT& num_elements);
+    cemINT Add(const Element* element_ptr);
+    void Clear();
+
+private:
+    const TriReferenceTensors* tensors_;    //!< Shared reference tensors of the element.
+    TriKernels::ReferenceKernel kernel_;    //!< Specialized kernel of the orders (or NULL).
+    cemINT elements_per_chunk_;             //!< Number of records in each chunk.
+    cemINT num_elements_;                   //!< Number of records in use.
+    cemINT8 record_size_;                   //!< Number of cemDOUBLE in each record.
+
+    std::vector<cemDOUBLE*> chunks_;        //!< Arena memory, elements_per_chunk_ records each.
+    std::vector<const Element*> elements_;  //!< Mesh element of each record.
+
+    // Private member functions:
+    void AddChunks(const cemINT& num_elements);
+    cemDOUBLE* record(const cemINT& element_index) const;
+    const cemDOUBLE* matrix(const cemINT& element_index,
+                            const cemINT& family,
+                            const cemINT& k) const;
+    SolverTriangleArena(); // Only parameterized constructor can be used.
+    SolverTriangleArena(const SolverTriangleArena&); // Not copyable.
+    SolverTriangleArena& operator = (const SolverTriangleArena&);
+};
+
+
+}
+
+
+#endif // SOLVER_TRIANGLE_ARENA_H
@@ -0,0 +1,520 @@
+#include <algorithm>
+#include "SparseAssembler.h"
+#include "cemError.h"
+#include "cemUtils.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+const cemINT SparseAssembler::REDUCTION_BLOCK;
+
+
+
+///***********************************************************************************************//
+/// CLASS SparseAssembler:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SparseAssembler::SparseAssembler : Default constructor (empty pattern). */
+//************************************************************************************************//
+SparseAssembler::SparseAssembler()
+{
+    num_dofs_ = 0;
+    num_elements_ = 0;
+    element_offsets_.assign(1,0);
+    row_offsets_.assign(1,0);
+    slot_offsets_.assign(1,0);
+    color_offsets_.assign(1,0);
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::num_dofs : Gets number of global degrees of freedom.
+ * @return : num_dofs_ */
+//************************************************************************************************//
+cemINT SparseAssembler::num_dofs() const {return num_dofs_;}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::num_elements : Gets number of elements.
+ * @return : num_elements_ */
+//************************************************************************************************//
+cemINT SparseAssembler::num_elements() const {return num_elements_;}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::num_entries : Gets number of entries of the global pattern.
+ * @return : row_offsets_[num_dofs_] */
+//************************************************************************************************//
+cemINT8 SparseAssembler::num_entries() const {return row_offsets_[num_dofs_];}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::row_offsets : Gets CSR row offsets of the global pattern.
+ * @return : row_offsets_ */
+//************************************************************************************************//
+const std::vector<cemINT8>& SparseAssembler::row_offsets() const {return row_offsets_;}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::column_indices : Gets CSR columns of the global pattern.
+ * @return : column_indices_ */
+//************************************************************************************************//
+const std::vector<cemINT>& SparseAssembler::column_indices() const {return column_indices_;}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::num_colors : Gets number of element colors.
+ * @return : number of colors */
+//************************************************************************************************//
+cemINT SparseAssembler::num_colors() const
+{
+    return static_cast<cemINT>(color_offsets_.size()) - 1;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::num_buffer_values : Gets number of values in the THREAD_REDUCTION buffers
+ * of all threads (set up by the last THREAD_REDUCTION assembly, 0 before it).
+ * @return : number of buffer values */
+//************************************************************************************************//
+cemINT8 SparseAssembler::num_buffer_values() const
+{
+    return thread_offsets_.empty() ? 0 : thread_offsets_.back();
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::color_offsets : Gets first entry of each color in color_elements().
+ * @return : color_offsets_ (num_colors()+1 values) */
+//************************************************************************************************//
+const std::vector<cemINT>& SparseAssembler::color_offsets() const {return color_offsets_;}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::color_elements : Gets elements sorted by color (increasing index within
+ * each color).
+ * @return : color_elements_ */
+//************************************************************************************************//
+const std::vector<cemINT>& SparseAssembler::color_elements() const {return color_elements_;}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::SetUpPattern : Symbolic phase, builds the global pattern and the
+ * position in it of every entry of every element matrix.
+ *
+ * Each row is built from the elements that contain its degree of freedom: the columns are
+ * collected with a marker array (so each one is added once) and sorted. The slots of the element
+ * entries are then found once with a binary search in the sorted rows.
+ * @param [in] num_dofs : number of global degrees of freedom
+ * @param [in] element_offsets : first entry of each element in element_dofs (num_elements+1)
+ * @param [in] element_dofs : global degree of freedom of each local basis function of each
+ * element (negative values are skipped) */
+//************************************************************************************************//
+void SparseAssembler::SetUpPattern(const cemINT& num_dofs,
+                                   const std::vector<cemINT>& element_offsets,
+                                   const std::vector<cemINT>& element_dofs)
+{
+    if (num_dofs < 0 || element_offsets.empty() || element_offsets[0] != 0 ||
+        element_offsets.back() != static_cast<cemINT>(element_dofs.size()))
+        throw(Exception("INPUT ERROR","element_offsets do not match element_dofs"));
+
+    cemINT num_elements = static_cast<cemINT>(element_offsets.size()) - 1;
+    for (cemINT e=0; e<num_elements; ++e)
+    {
+        if (element_offsets[e+1] < element_offsets[e])
+            throw(Exception("INPUT ERROR","element_offsets must be increasing"));
+    }
+
+    for (size_t k=0; k<element_dofs.size(); ++k)
+    {
+        if (element_dofs[k] >= num_dofs)
+            throw(Exception("INPUT ERROR","Degree of freedom " +
+                            cem_utils::NumberToString<cemINT>(element_dofs[k]) +
+                            " is larger than the number of degrees of freedom"));
+    }
+
+    num_dofs_ = num_dofs;
+    num_elements_ = num_elements;
+    element_offsets_ = element_offsets;
+    element_dofs_ = element_dofs;
+
+    // Elements of each degree of freedom (transpose of the connectivity):
+    std::vector<cemINT> dof_offsets(num_dofs_+1,0);
+    for (size_t k=0; k<element_dofs_.size(); ++k)
+    {
+        if (element_dofs_[k] >= 0)
+            ++dof_offsets[element_dofs_[k]+1];
+    }
+
+    for (cemINT d=0; d<num_dofs_; ++d)
+        dof_offsets[d+1] += dof_offsets[d];
+
+    std::vector<cemINT> dof_elements(dof_offsets[num_dofs_]);
+    std::vector<cemINT> position(dof_offsets.begin(),dof_offsets.end()-1);
+    for (cemINT e=0; e<num_elements_; ++e)
+    {
+        for (cemINT k=element_offsets_[e]; k<element_offsets_[e+1]; ++k)
+        {
+            if (element_dofs_[k] >= 0)
+                dof_elements[position[element_dofs_[k]]++] = e;
+        }
+    }
+
+    // Rows of the pattern:
+    std::vector<cemINT> marker(num_dofs_,-1);
+    row_offsets_.assign(num_dofs_+1,0);
+    column_indices_.clear();
+    for (cemINT d=0; d<num_dofs_; ++d)
+    {
+        for (cemINT k=dof_offsets[d]; k<dof_offsets[d+1]; ++k)
+        {
+            cemINT e = dof_elements[k];
+            for (cemINT l=element_offsets_[e]; l<element_offsets_[e+1]; ++l)
+            {
+                cemINT column = element_dofs_[l];
+                if (column >= 0 && marker[column] != d)
+                {
+                    marker[column] = d;
+                    column_indices_.push_back(column);
+                }
+            }
+        }
+
+        row_offsets_[d+1] = column_indices_.size();
+        std::sort(column_indices_.begin() + row_offsets_[d],column_indices_.end());
+    }
+
+    // Slots of the element entries, in the packed order of SymmetricMatrix:
+    slot_offsets_.assign(num_elements_+1,0);
+    for (cemINT e=0; e<num_elements_; ++e)
+    {
+        cemINT8 n = element_offsets_[e+1] - element_offsets_[e];
+        slot_offsets_[e+1] = slot_offsets_[e] + n*(n+1);
+    }
+
+    slots_.assign(slot_offsets_[num_elements_],-1);
+    const cemINT* columns = column_indices_.empty() ? NULL : &column_indices_[0];
+    for (cemINT e=0; e<num_elements_; ++e)
+    {
+        const cemINT* dofs = &element_dofs_[0] + element_offsets_[e];
+        cemINT n = element_offsets_[e+1] - element_offsets_[e];
+        cemINT8* slot = &slots_[0] + slot_offsets_[e];
+        for (cemINT j=0; j<n; ++j)
+        {
+            for (cemINT i=j; i<n; ++i, slot+=2)
+            {
+                if (dofs[i] < 0 || dofs[j] < 0)
+                    continue;
+
+                slot[0] = std::lower_bound(columns + row_offsets_[dofs[i]],
+                                           columns + row_offsets_[dofs[i]+1],
+                                           dofs[j]) - columns;
+                if (i != j)
+                    slot[1] = std::lower_bound(columns + row_offsets_[dofs[j]],
+                                               columns + row_offsets_[dofs[j]+1],
+                                               dofs[i]) - columns;
+            }
+        }
+    }
+
+    SetUpColors(dof_offsets,dof_elements);
+    thread_offsets_.clear();
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::SetUpColors : Splits the elements into colors so that no two elements
+ * of a color share a degree of freedom.
+ *
+ * Greedy coloring in element order: each element takes the first color not used by any element
+ * it shares a degree of freedom with.
+ * @param [in] dof_offsets : first entry of each dof in dof_elements
+ * @param [in] dof_elements : elements of each degree of freedom */
+//************************************************************************************************//
+void SparseAssembler::SetUpColors(const std::vector<cemINT>& dof_offsets,
+                                  const std::vector<cemINT>& dof_elements)
+{
+    std::vector<cemINT> element_color(num_elements_,-1);
+    std::vector<cemINT> used_by;    // Last element that found each color in a neighbor.
+    std::vector<cemINT> color_sizes;
+    for (cemINT e=0; e<num_elements_; ++e)
+    {
+        for (cemINT l=element_offsets_[e]; l<element_offsets_[e+1]; ++l)
+        {
+            cemINT d = element_dofs_[l];
+            if (d < 0)
+                continue;
+
+            for (cemINT k=dof_offsets[d]; k<dof_offsets[d+1]; ++k)
+            {
+                cemINT color = element_color[dof_elements[k]];
+                if (color >= 0)
+                    used_by[color] = e;
+            }
+        }
+
+        cemINT color = 0;
+        while (color < static_cast<cemINT>(used_by.size()) && used_by[color] == e)
+            ++color;
+
+        if (color == static_cast<cemINT>(used_by.size()))
+        {
+            used_by.push_back(-1);
+            color_sizes.push_back(0);
+        }
+
+        element_color[e] = color;
+        ++color_sizes[color];
+    }
+
+    color_offsets_.assign(color_sizes.size()+1,0);
+    for (size_t c=0; c<color_sizes.size(); ++c)
+        color_offsets_[c+1] = color_offsets_[c] + color_sizes[c];
+
+    color_elements_.resize(num_elements_);
+    std::vector<cemINT> position(color_offsets_.begin(),color_offsets_.end()-1);
+    for (cemINT e=0; e<num_elements_; ++e)
+        color_elements_[position[element_color[e]]++] = e;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::SetUpMatrix : Gives the global pattern to a matrix (all values zero).
+ * @param [out] global : global matrix */
+//************************************************************************************************//
+void SparseAssembler::SetUpMatrix(SparseMatrix<cemDOUBLE>& global) const
+{
+    global.set_pattern(num_dofs_,num_dofs_,row_offsets_,column_indices_);
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::AddElementMatrix : Numeric phase, adds an element matrix to the
+ * global matrix through the precomputed slots.
+ * @param [in] element : index of the element
+ * @param [in] local : element matrix, one row per local degree of freedom
+ * @param [in,out] global : global matrix with the pattern of SetUpMatrix() */
+//************************************************************************************************//
+void SparseAssembler::AddElementMatrix(const cemINT& element,
+                                       const SymmetricMatrix<cemDOUBLE>& local,
+                                       SparseMatrix<cemDOUBLE>& global) const
+{
+    CheckElement(element,local.num_rows());
+    CheckMatrix(global);
+    AddPacked(element,local,slots_,global.values());
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::AddElementVector : Adds an element vector to the global vector.
+ * @param [in] element : index of the element
+ * @param [in] local : element vector, one value per local degree of freedom
+ * @param [in,out] global : global vector (num_dofs() values) */
+//************************************************************************************************//
+void SparseAssembler::AddElementVector(const cemINT& element,
+                                       const cemDOUBLE* local,
+                                       cemDOUBLE* global) const
+{
+    CheckElement(element,-1);
+    for (cemINT k=element_offsets_[element]; k<element_offsets_[element+1]; ++k)
+    {
+        if (element_dofs_[k] >= 0)
+            global[element_dofs_[k]] += local[k - element_offsets_[element]];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::Assemble : Numeric phase for all elements, using threads.
+ *
+ * The element matrices are added to the values already in the global matrix (call
+ * global.initialize() first to assemble from zero).
+ * @param [in] local : matrix of each element (num_elements() matrices)
+ * @param [in,out] global : global matrix with the pattern of SetUpMatrix()
+ * @param [in] mode : COLORED or THREAD_REDUCTION */
+//************************************************************************************************//
+void SparseAssembler::Assemble(const std::vector<SymmetricMatrix<cemDOUBLE> >& local,
+                               SparseMatrix<cemDOUBLE>& global,
+                               const AssemblyMode& mode) const
+{
+    if (static_cast<cemINT>(local.size()) != num_elements_)
+        throw(Exception("INPUT ERROR","One matrix per element is needed"));
+
+    for (cemINT e=0; e<num_elements_; ++e)
+        CheckElement(e,local[e].num_rows());
+    CheckMatrix(global);
+
+    cemDOUBLE* values = global.values();
+    if (mode == COLORED)
+    {
+        #pragma omp parallel
+        {
+            for (cemINT c=0; c<num_colors(); ++c)
+            {
+                #pragma omp for schedule(static)
+                for (cemINT k=color_offsets_[c]; k<color_offsets_[c+1]; ++k)
+                    AddPacked(color_elements_[k],local[color_elements_[k]],slots_,values);
+            }
+        }
+        return;
+    }
+
+    cemINT num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    SetUpThreadBuffers(num_threads);
+
+    cemINT8 num_blocks = (num_entries() + REDUCTION_BLOCK - 1)/REDUCTION_BLOCK;
+    #pragma omp parallel num_threads(num_threads)
+    {
+        // Partial sums of each range of elements, on the entries it touches:
+        #pragma omp for schedule(static)
+        for (cemINT t=0; t<num_threads; ++t)
+        {
+            std::fill(thread_values_.begin() + thread_offsets_[t],
+                      thread_values_.begin() + thread_offsets_[t+1],0.0);
+
+            cemINT first = static_cast<cemINT8>(t)*num_elements_/num_threads;
+            cemINT last = static_cast<cemINT8>(t+1)*num_elements_/num_threads;
+            for (cemINT e=first; e<last; ++e)
+                AddPacked(e,local[e],buffer_slots_,&thread_values_[0]);
+        }
+
+        // Reduction, one block of entries at a time:
+        #pragma omp for schedule(static)
+        for (cemINT8 b=0; b<num_blocks; ++b)
+        {
+            cemINT8 block_first = b*REDUCTION_BLOCK;
+            cemINT8 block_last = std::min(block_first + REDUCTION_BLOCK,num_entries());
+            for (cemINT t=0; t<num_threads; ++t)
+            {
+                const cemINT8* entry = &thread_entries_[0];
+                const cemINT8* end = entry + thread_offsets_[t+1];
+                const cemINT8* it = std::lower_bound(entry + thread_offsets_[t],end,block_first);
+                for (; it != end && *it < block_last; ++it)
+                    values[*it] += thread_values_[it - entry];
+            }
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::SetUpThreadBuffers : Finds the CSR entries touched by the range of
+ * elements of each thread, and the buffer value of each slot (only when the number of threads
+ * changes).
+ *
+ * Each buffer holds only the entries its range touches (sorted, without repetitions), so the
+ * buffers of all threads add up to num_entries() values plus the entries shared by several
+ * ranges, whatever the element numbering.
+ * @param [in] num_threads : number of threads */
+//************************************************************************************************//
+void SparseAssembler::SetUpThreadBuffers(const cemINT& num_threads) const
+{
+    if (static_cast<cemINT>(thread_offsets_.size()) == num_threads+1)
+        return;
+
+    // Entries touched by each range of elements:
+    std::vector< std::vector<cemINT8> > entries(num_threads);
+    #pragma omp parallel for schedule(static)
+    for (cemINT t=0; t<num_threads; ++t)
+    {
+        cemINT first = static_cast<cemINT8>(t)*num_elements_/num_threads;
+        cemINT last = static_cast<cemINT8>(t+1)*num_elements_/num_threads;
+        for (cemINT8 k=slot_offsets_[first]; k<slot_offsets_[last]; ++k)
+            if (slots_[k] >= 0)
+                entries[t].push_back(slots_[k]);
+
+        std::sort(entries[t].begin(),entries[t].end());
+        entries[t].erase(std::unique(entries[t].begin(),entries[t].end()),entries[t].end());
+    }
+
+    thread_offsets_.assign(num_threads+1,0);
+    for (cemINT t=0; t<num_threads; ++t)
+        thread_offsets_[t+1] = thread_offsets_[t] + static_cast<cemINT8>(entries[t].size());
+
+    thread_entries_.resize(thread_offsets_[num_threads] > 0 ? thread_offsets_[num_threads] : 1);
+    for (cemINT t=0; t<num_threads; ++t)
+        std::copy(entries[t].begin(),entries[t].end(),thread_entries_.begin() + thread_offsets_[t]);
+
+    // Buffer value of each slot:
+    buffer_slots_.resize(slots_.size());
+    #pragma omp parallel for schedule(static)
+    for (cemINT t=0; t<num_threads; ++t)
+    {
+        cemINT first = static_cast<cemINT8>(t)*num_elements_/num_threads;
+        cemINT last = static_cast<cemINT8>(t+1)*num_elements_/num_threads;
+        for (cemINT8 k=slot_offsets_[first]; k<slot_offsets_[last]; ++k)
+        {
+            buffer_slots_[k] = -1;
+            if (slots_[k] >= 0)
+                buffer_slots_[k] = thread_offsets_[t] +
+                                   (std::lower_bound(entries[t].begin(),entries[t].end(),slots_[k]) -
+                                    entries[t].begin());
+        }
+    }
+
+    thread_values_.resize(thread_offsets_[num_threads] > 0 ? thread_offsets_[num_threads] : 1);
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::AddPacked : Adds the entries of an element matrix through its slots.
+ * @param [in] element : index of the element
+ * @param [in] local : element matrix (already checked)
+ * @param [in] slots : slots_ (CSR entries) or buffer_slots_ (thread buffer values)
+ * @param [in,out] values : values the slots point to */
+//************************************************************************************************//
+void SparseAssembler::AddPacked(const cemINT& element,
+                                const SymmetricMatrix<cemDOUBLE>& local,
+                                const std::vector<cemINT8>& slots,
+                                cemDOUBLE* values) const
+{
+    cemINT n = local.num_rows();
+    cemINT num_packed = n*(n+1)/2;
+    if (num_packed == 0)
+        return;
+
+    const cemDOUBLE* entry = &local(0,0);
+    const cemINT8* slot = &slots[0] + slot_offsets_[element];
+    for (cemINT k=0; k<num_packed; ++k, slot+=2)
+    {
+        if (slot[0] >= 0)
+            values[slot[0]] += entry[k];
+        if (slot[1] >= 0)
+            values[slot[1]] += entry[k];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::CheckMatrix : Checks that a matrix has the pattern of the assembler.
+ * @param [in] global : global matrix */
+//************************************************************************************************//
+void SparseAssembler::CheckMatrix(const SparseMatrix<cemDOUBLE>& global) const
+{
+    if (global.num_entries() != num_entries() || static_cast<cemINT>(global.num_rows()) != num_dofs_)
+        throw(Exception("INPUT ERROR","Global matrix does not have the assembler pattern"));
+}
+
+
+//************************************************************************************************//
+/** @brief SparseAssembler::CheckElement : Checks the element index and its number of dofs.
+ * @param [in] element : index of the element
+ * @param [in] num_local : number of local degrees of freedom (not checked if negative) */
+//************************************************************************************************//
+void SparseAssembler::CheckElement(const cemINT& element, const cemINT& num_local) const
+{
+    if (element < 0 || element >= num_elements_)
+        throw(Exception("OUT OF RANGE","Element " + cem_utils::NumberToString<cemINT>(element) +
+                        " is not in the assembler"));
+
+    if (num_local >= 0 && num_local != element_offsets_[element+1] - element_offsets_[element])
+        throw(Exception("INPUT ERROR","Element matrix does not match the degrees of freedom of "
+                        "element " + cem_utils::NumberToString<cemINT>(element)));
+}
@@ -0,0 +1,120 @@
+#ifndef SPARSE_ASSEMBLER_H
+#define SPARSE_ASSEMBLER_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/SymmetricMatrix.h"
+#include "Matrix/SparseMatrix.h"
+
+using namespace cem_def;
+using cem_math::SymmetricMatrix;
+using cem_math::SparseMatrix;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The SparseAssembler class : Assembles element matrices into a global CSR matrix.
+ *
+ * Assembly is split into two phases. The symbolic phase, SetUpPattern(), takes the connectivity
+ * (the global degrees of freedom of each element) and builds the sparsity pattern of the global
+ * matrix, with the columns of each row sorted and without repetitions. It also stores, for every
+ * entry of every element matrix, the position (slot) of that entry in the CSR arrays. The numeric
+ * phase, AddElementMatrix(), then adds each element matrix through these slots, so assembling
+ * again with new values (e.g. new material properties) needs no search and no allocation.
+ *
+ * Both triangles of the global matrix are stored, so it can be used directly by solvers. Negative
+ * degrees of freedom (e.g. fixed values) are skipped, as in SymmetricMatrix::scatter_add.
+ *
+ * Assemble() adds the matrices of all elements using threads (when the library is built with
+ * OpenMP), in one of two modes:
+ * - COLORED: elements are split into colors so that no two elements of a color share a degree of
+ *   freedom. The elements of a color write to different rows, so they are added in parallel with
+ *   plain stores, one color after the other. The result does not depend on the number of threads.
+ * - THREAD_REDUCTION: each thread adds a contiguous range of elements into its own buffer, which
+ *   only holds the CSR entries touched by that range (a sorted list of entries, and the buffer
+ *   value of every slot), and the buffers are then added into the matrix in parallel over entries.
+ *
+ * COLORED is the default because its result does not depend on the number of threads, while
+ * THREAD_REDUCTION adds the buffers in an order set by the thread ranges. Neither mode is
+ * consistently faster: on an unstructured mesh of 480000 triangles in random order (see
+ * TestSparseAssemblyBenchmark, single core), colored/reduction took 0.059/0.040 s (p=1),
+ * 0.26/0.21 s (p=2) and 0.46/0.52 s (p=3), so THREAD_REDUCTION is left as an option for low
+ * orders.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SparseAssembler
+{
+public:
+    /** @brief The AssemblyMode enum : How Assemble() avoids write conflicts between threads. */
+    enum AssemblyMode
+    {
+        COLORED=0,
+        THREAD_REDUCTION=1,
+    };
+
+    // Default constructor:
+    SparseAssembler();
+
+    // Get data members:
+    cemINT num_dofs() const;
+    cemINT num_elements() const;
+    cemINT8 num_entries() const;
+    const std::vector<cemINT8>& row_offsets() const;
+    const std::vector<cemINT>& column_indices() const;
+    cemINT num_colors() const;
+    cemINT8 num_buffer_values() const;
+    const std::vector<cemINT>& color_offsets() const;
+    const std::vector<cemINT>& color_elements() const;
+
+    // Symbolic phase:
+    void SetUpPattern(const cemINT& num_dofs,
+                      const std::vector<cemINT>& element_offsets,
+                      const std::vector<cemINT>& element_dofs);
+    void SetUpMatrix(SparseMatrix<cemDOUBLE>& global) const;
+
+    // Numeric phase:
+    void AddElementMatrix(const cemINT& element,
+                          const SymmetricMatrix<cemDOUBLE>& local,
+                          SparseMatrix<cemDOUBLE>& global) const;
+    void AddElementVector(const cemINT& element,
+                          const cemDOUBLE* local,
+                          cemDOUBLE* global) const;
+    void Assemble(const std::vector<SymmetricMatrix<cemDOUBLE> >& local,
+                  SparseMatrix<cemDOUBLE>& global,
+                  const AssemblyMode& mode = COLORED) const;
+
+private:
+    cemINT num_dofs_;                       //!< Number of rows (and columns) of the matrix.
+    cemINT num_elements_;                   //!< Number of elements.
+    std::vector<cemINT> element_offsets_;   //!< First dof of each element (num_elements_+1).
+    std::vector<cemINT> element_dofs_;      //!< Global dofs of all elements.
+    std::vector<cemINT8> row_offsets_;      //!< CSR row offsets (num_dofs_+1).
+    std::vector<cemINT> column_indices_;    //!< CSR columns, sorted within each row.
+    std::vector<cemINT8> slot_offsets_;     //!< First slot pair of each element.
+    std::vector<cemINT8> slots_;            //!< CSR slots of (i,j) and (j,i), packed order.
+    std::vector<cemINT> color_offsets_;     //!< First element of each color in color_elements_.
+    std::vector<cemINT> color_elements_;    //!< Elements sorted by color.
+
+    static const cemINT REDUCTION_BLOCK = 4096;     //!< Entries merged together by one thread.
+    mutable std::vector<cemINT8> thread_offsets_;   //!< First value of each thread buffer.
+    mutable std::vector<cemINT8> thread_entries_;   //!< CSR entry of each buffer value.
+    mutable std::vector<cemINT8> buffer_slots_;     //!< Buffer values of (i,j) and (j,i).
+    mutable std::vector<cemDOUBLE> thread_values_;  //!< Partial sums of all threads.
+
+    // Private member functions:
+    void SetUpColors(const std::vector<cemINT>& dof_offsets,
+                     const std::vector<cemINT>& dof_elements);
+    void SetUpThreadBuffers(const cemINT& num_threads) const;
+    void CheckElement(const cemINT& element, const cemINT& num_local) const;
+    void CheckMatrix(const SparseMatrix<cemDOUBLE>& global) const;
+    void AddPacked(const cemINT& element,
+                   const SymmetricMatrix<cemDOUBLE>& local,
+                   const std::vector<cemINT8>& slots,
+                   cemDOUBLE* values) const;
+};
+
+
+}
+
+
+#endif // SPARSE_ASSEMBLER_H
@@ -0,0 +1,193 @@
+#include "SparseSystem.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+
+
+///***********************************************************************************************//
+/// CLASS SparseSystem:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SparseSystem::SparseSystem : Default constructor (empty system). */
+//************************************************************************************************//
+SparseSystem::SparseSystem()
+{
+    mode_ = SparseAssembler::COLORED;
+    coefficient_offsets_.assign(1,0);
+    num_assemblies_ = 0;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::num_dofs : Gets number of global degrees of freedom.
+ * @return : number of rows of the matrix */
+//************************************************************************************************//
+cemINT SparseSystem::num_dofs() const {return assembler_.num_dofs();}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::num_elements : Gets number of elements.
+ * @return : number of solver elements */
+//************************************************************************************************//
+cemINT SparseSystem::num_elements() const {return static_cast<cemINT>(elements_.size());}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::num_assemblies : Gets number of calls to Assemble() since SetUp().
+ * @return : num_assemblies_ */
+//************************************************************************************************//
+cemINT SparseSystem::num_assemblies() const {return num_assemblies_;}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::num_coefficients : Gets number of coefficients of an element in the
+ * vectors given to Assemble().
+ * @param [in] element : index of the element
+ * @return : num_coefficient_functions() of the element */
+//************************************************************************************************//
+cemINT SparseSystem::num_coefficients(const cemINT& element) const
+{
+    return coefficient_offsets_[element+1] - coefficient_offsets_[element];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::assembler : Gets the assembler with the cached pattern.
+ * @return : assembler_ */
+//************************************************************************************************//
+const SparseAssembler& SparseSystem::assembler() const {return assembler_;}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::matrix : Gets the global matrix of the last Assemble().
+ * @return : matrix_ */
+//************************************************************************************************//
+const SparseMatrix<cemDOUBLE>& SparseSystem::matrix() const {return matrix_;}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::SetUp : Symbolic phase, done once per mesh.
+ * @param [in] num_dofs : number of global degrees of freedom
+ * @param [in] elements : solver element of each element (kept, must outlive the system)
+ * @param [in] element_offsets : first entry of each element in element_dofs (num_elements+1)
+ * @param [in] element_dofs : global degree of freedom of each basis function of each element
+ * (negative values are skipped)
+ * @param [in] mode : parallel assembly mode */
+//************************************************************************************************//
+void SparseSystem::SetUp(const cemINT& num_dofs,
+                         const std::vector<SolverElement*>& elements,
+                         const std::vector<cemINT>& element_offsets,
+                         const std::vector<cemINT>& element_dofs,
+                         const SparseAssembler::AssemblyMode& mode)
+{
+    if (elements.size()+1 != element_offsets.size())
+        throw(Exception("INPUT ERROR","One solver element per element is needed"));
+
+    cemINT num_elements = static_cast<cemINT>(elements.size());
+    coefficient_offsets_.assign(num_elements+1,0);
+    for (cemINT e=0; e<num_elements; ++e)
+    {
+        if (elements[e] == NULL)
+            throw(Exception("INPUT ERROR","Solver element " +
+                            cem_utils::NumberToString<cemINT>(e) + " is NULL"));
+
+        coefficient_offsets_[e+1] = coefficient_offsets_[e] + elements[e]->num_coefficient_functions();
+    }
+
+    assembler_.SetUpPattern(num_dofs,element_offsets,element_dofs);
+    assembler_.SetUpMatrix(matrix_);
+    elements_ = elements;
+    mode_ = mode;
+    element_matrices_.assign(num_elements,SymmetricMatrix<cemDOUBLE>());
+    num_assemblies_ = 0;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::Assemble : Numeric phase, fills the global matrix with new coefficients.
+ *
+ * The matrix of element e is \f$ \sum_k \alpha_k^e N\_GradGrad_k + \sum_k \beta_k^e N\_NN_k \f$.
+ * Element matrices are contracted in parallel; the data shared by all elements (tabulations,
+ * reference tensors) is set up by the first element that needs it, through thread-safe caches.
+ * An error in any element (e.g. a degenerate triangle) is caught inside the parallel region and
+ * thrown afterwards, with the index of the lowest failing element.
+ * @param [in] stiffness_coefficients : \f$ \alpha_k^e \f$, num_coefficients(e) values per element
+ * @param [in] mass_coefficients : \f$ \beta_k^e \f$, same layout (or empty for no mass term) */
+//************************************************************************************************//
+void SparseSystem::Assemble(const std::vector<cemDOUBLE>& stiffness_coefficients,
+                            const std::vector<cemDOUBLE>& mass_coefficients)
+{
+    cemINT num_elements = static_cast<cemINT>(elements_.size());
+    if (static_cast<cemINT>(stiffness_coefficients.size()) != coefficient_offsets_[num_elements] ||
+        (!mass_coefficients.empty() &&
+         static_cast<cemINT>(mass_coefficients.size()) != coefficient_offsets_[num_elements]))
+        throw(Exception("INPUT ERROR","Expected " +
+                        cem_utils::NumberToString<cemINT>(coefficient_offsets_[num_elements]) +
+                        " coefficients"));
+
+    cemINT failed = -1;
+    std::vector<Exception> error;
+    #pragma omp parallel
+    {
+        std::vector<cemDOUBLE> coefficients;
+        SymmetricMatrix<cemDOUBLE> mass;
+
+        #pragma omp for schedule(static)
+        for (cemINT e=0; e<num_elements; ++e)
+        {
+            try
+            {
+                ContractElement(e,stiffness_coefficients,mass_coefficients,coefficients,mass);
+            }
+            catch (Exception& exception)
+            {
+                #pragma omp critical
+                if (failed < 0 || e < failed)
+                {
+                    failed = e;
+                    error.assign(1,exception);
+                }
+            }
+        }
+    }
+
+    if (failed >= 0)
+        throw(Exception(error[0].tag(),"Solver element " +
+                        cem_utils::NumberToString<cemINT>(failed) + ": " + error[0].problem()));
+
+    matrix_.initialize();
+    assembler_.Assemble(element_matrices_,matrix_,mode_);
+    ++num_assemblies_;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseSystem::ContractElement : Contracts the matrix of one element.
+ * @param [in] element : index of the element
+ * @param [in] stiffness_coefficients : coefficients of N_GradGrad of all elements
+ * @param [in] mass_coefficients : coefficients of N_NN of all elements (or empty)
+ * @param [in,out] coefficients : workspace for the coefficients of the element
+ * @param [in,out] mass : workspace for the N_NN matrix of the element */
+//************************************************************************************************//
+void SparseSystem::ContractElement(const cemINT& element,
+                                   const std::vector<cemDOUBLE>& stiffness_coefficients,
+                                   const std::vector<cemDOUBLE>& mass_coefficients,
+                                   std::vector<cemDOUBLE>& coefficients,
+                                   SymmetricMatrix<cemDOUBLE>& mass)
+{
+    cemINT first = coefficient_offsets_[element];
+    cemINT last = coefficient_offsets_[element+1];
+    coefficients.assign(stiffness_coefficients.begin() + first,stiffness_coefficients.begin() + last);
+    elements_[element]->ContractMatrices(coefficients,NULL,NULL,NULL,&element_matrices_[element]);
+
+    if (mass_coefficients.empty())
+        return;
+
+    coefficients.assign(mass_coefficients.begin() + first,mass_coefficients.begin() + last);
+    elements_[element]->ContractMatrices(coefficients,NULL,NULL,&mass,NULL);
+    element_matrices_[element] += mass;
+}
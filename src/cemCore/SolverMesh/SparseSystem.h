@@ -0,0 +1,71 @@
+#ifndef SPARSE_SYSTEM_H
+#define SPARSE_SYSTEM_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "SolverElement.h"
+#include "SparseAssembler.h"
+
+using namespace cem_def;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The SparseSystem class : Global sparse system of a mesh, assembled many times with new
+ * coefficients.
+ *
+ * In an electro-thermal run the conductivity depends on the temperature, so the same mesh is
+ * solved again and again with new coefficients. SetUp() does everything that only depends on the
+ * mesh once: the sparsity pattern, the slots of the element entries and the element colors (all
+ * in the SparseAssembler), and the storage of the global and element matrices. Assemble() then
+ * only contracts the element matrices with the new coefficients (SolverElement::ContractMatrices)
+ * and adds them through the stored slots, writing over the values of the same global matrix.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SparseSystem
+{
+public:
+    // Default constructor:
+    SparseSystem();
+
+    // Get data members:
+    cemINT num_dofs() const;
+    cemINT num_elements() const;
+    cemINT num_assemblies() const;
+    cemINT num_coefficients(const cemINT& element) const;
+    const SparseAssembler& assembler() const;
+    const SparseMatrix<cemDOUBLE>& matrix() const;
+
+    // Symbolic phase (once per mesh):
+    void SetUp(const cemINT& num_dofs,
+               const std::vector<SolverElement*>& elements,
+               const std::vector<cemINT>& element_offsets,
+               const std::vector<cemINT>& element_dofs,
+               const SparseAssembler::AssemblyMode& mode = SparseAssembler::COLORED);
+
+    // Numeric phase (every iteration):
+    void Assemble(const std::vector<cemDOUBLE>& stiffness_coefficients,
+                  const std::vector<cemDOUBLE>& mass_coefficients);
+
+private:
+    std::vector<SolverElement*> elements_;          //!< Solver elements of the mesh.
+    SparseAssembler assembler_;                     //!< Pattern, slots and colors.
+    SparseAssembler::AssemblyMode mode_;            //!< Mode of the parallel assembly.
+    SparseMatrix<cemDOUBLE> matrix_;                //!< Global matrix.
+    std::vector<cemINT> coefficient_offsets_;       //!< First coefficient of each element.
+    std::vector< SymmetricMatrix<cemDOUBLE> > element_matrices_;   //!< Contracted matrices.
+    cemINT num_assemblies_;                         //!< Assemblies since the last SetUp().
+
+    // Private member functions:
+    void ContractElement(const cemINT& element,
+                         const std::vector<cemDOUBLE>& stiffness_coefficients,
+                         const std::vector<cemDOUBLE>& mass_coefficients,
+                         std::vector<cemDOUBLE>& coefficients,
+                         SymmetricMatrix<cemDOUBLE>& mass);
+};
+
+
+}
+
+
+#endif // SPARSE_SYSTEM_H
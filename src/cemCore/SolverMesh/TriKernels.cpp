@@ -0,0 +1,380 @@
+#include <map>
+#include "TriKernels.h"
+#include "cemError.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+
+///***********************************************************************************************//
+/// Index tables (numbering of cemMesh.h):
+///***********************************************************************************************//
+const cemINT TriIndexTable<0>::ijk[1][3] = {{0,0,0}};
+
+const cemINT TriIndexTable<1>::ijk[3][3] = {{1,0,0}, {0,1,0}, {0,0,1}};
+
+const cemINT TriIndexTable<2>::ijk[6][3] = {{2,0,0}, {0,2,0}, {0,0,2},
+                                            {1,1,0}, {0,1,1}, {1,0,1}};
+
+const cemINT TriIndexTable<3>::ijk[10][3] = {{3,0,0}, {0,3,0}, {0,0,3},
+                                             {2,1,0}, {1,2,0}, {0,2,1},
+                                             {0,1,2}, {1,0,2}, {2,0,1},
+                                             {1,1,1}};
+
+const cemINT TriIndexTable<4>::ijk[15][3] = {{4,0,0}, {0,4,0}, {0,0,4},
+                                             {3,1,0}, {2,2,0}, {1,3,0},
+                                             {0,3,1}, {0,2,2}, {0,1,3},
+                                             {1,0,3}, {2,0,2}, {3,0,1},
+                                             {2,1,1}, {1,2,1}, {1,1,2}};
+
+const cemINT TriIndexTable<5>::ijk[21][3] = {{5,0,0}, {0,5,0}, {0,0,5},
+                                             {4,1,0}, {3,2,0}, {2,3,0},
+                                             {1,4,0}, {0,4,1}, {0,3,2},
+                                             {0,2,3}, {0,1,4}, {1,0,4},
+                                             {2,0,3}, {3,0,2}, {4,0,1},
+                                             {3,1,1}, {1,3,1}, {1,1,3},
+                                             {2,2,1}, {1,2,2}, {2,1,2}};
+
+const cemINT TriIndexTable<6>::ijk[28][3] = {{6,0,0}, {0,6,0}, {0,0,6},
+                                             {5,1,0}, {4,2,0}, {3,3,0},
+                                             {2,4,0}, {1,5,0}, {0,5,1},
+                                             {0,4,2}, {0,3,3}, {0,2,4},
+                                             {0,1,5}, {1,0,5}, {2,0,4},
+                                             {3,0,3}, {4,0,2}, {5,0,1},
+                                             {4,1,1}, {1,4,1}, {1,1,4},
+                                             {3,2,1}, {2,3,1}, {1,3,2},
+                                             {1,2,3}, {2,1,3}, {3,1,2},
+                                             {2,2,2}};
+
+
+
+///***********************************************************************************************//
+/// CLASS TriIndexTables:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TriIndexTables::Get : Gets the index table of an order.
+ *
+ * Tables above MAX_CONSTANT_ORDER are generated on the first call for each order and cached;
+ * thread-safe, in the same way as TriTabulation::Get().
+ * @param [in] order : polynomial order of the shape functions (>= 0)
+ * @return : pointer to 3*(order+1)*(order+2)/2 indices */
+//************************************************************************************************//
+const cemINT* TriIndexTables::Get(const cemINT& order)
+{
+    switch (order)
+    {
+    case 0: return TriIndexTable<0>::ijk[0];
+    case 1: return TriIndexTable<1>::ijk[0];
+    case 2: return TriIndexTable<2>::ijk[0];
+    case 3: return TriIndexTable<3>::ijk[0];
+    case 4: return TriIndexTable<4>::ijk[0];
+    case 5: return TriIndexTable<5>::ijk[0];
+    case 6: return TriIndexTable<6>::ijk[0];
+    default: break;
+    }
+
+    if (order < 0)
+        throw(Exception("INPUT ERROR","Shape function order must be >= 0"));
+
+    static std::map< cemINT,std::vector<cemINT> > cache;
+    const cemINT* found = NULL;
+    #pragma omp critical(TriIndexTables_cache)
+    {
+        std::map< cemINT,std::vector<cemINT> >::iterator it = cache.find(order);
+        if (it != cache.end())
+            found = &it->second[0];
+    }
+    if (found != NULL)
+        return found;
+
+    std::vector<cemINT> table;
+    Generate(order,table);
+    #pragma omp critical(TriIndexTables_cache)
+    found = &cache.insert(std::make_pair(order,table)).first->second[0];
+
+    return found;
+}
+
+
+//************************************************************************************************//
+/** @brief TriIndexTables::Generate : Generates the index table of an order.
+ *
+ * Follows the numbering of cemMesh.h: the three vertices (P,0,0), (0,P,0) and (0,0,P), then the
+ * internal points of edges 0-1, 1-2 and 2-0 (each one oriented as in the element), and finally
+ * the interior points, numbered recursively as a triangle of order P-3 shifted by (1,1,1).
+ * @param [in] order : polynomial order of the shape functions (>= 0)
+ * @param [out] ijk : 3*(order+1)*(order+2)/2 indices */
+//************************************************************************************************//
+void TriIndexTables::Generate(const cemINT& order, std::vector<cemINT>& ijk)
+{
+    if (order < 0)
+        throw(Exception("INPUT ERROR","Shape function order must be >= 0"));
+
+    ijk.clear();
+    ijk.reserve(3*(order+1)*(order+2)/2);
+    Generate(order,0,ijk);
+}
+
+
+//************************************************************************************************//
+/** @brief TriIndexTables::Generate : Appends the indices of a (sub-)triangle of an order.
+ * @param [in] order : polynomial order of the (sub-)triangle
+ * @param [in] offset : value added to every index
+ * @param [in,out] ijk : indices */
+//************************************************************************************************//
+void TriIndexTables::Generate(const cemINT& order,
+                              const cemINT& offset,
+                              std::vector<cemINT>& ijk)
+{
+    if (order < 0)
+        return;
+
+    if (order == 0)
+    {
+        ijk.push_back(offset);
+        ijk.push_back(offset);
+        ijk.push_back(offset);
+        return;
+    }
+
+    // Vertices:
+    cemINT vertices[3][3] = {{order,0,0}, {0,order,0}, {0,0,order}};
+    for (cemINT v=0; v<3; ++v)
+    {
+        for (cemINT d=0; d<3; ++d)
+            ijk.push_back(offset + vertices[v][d]);
+    }
+
+    // Edges (the index of the first vertex decreases, the index of the second one increases):
+    cemINT edges[3][2] = {{0,1}, {1,2}, {2,0}};
+    for (cemINT e=0; e<3; ++e)
+    {
+        for (cemINT t=1; t<order; ++t)
+        {
+            cemINT indices[3] = {0,0,0};
+            indices[edges[e][0]] = order - t;
+            indices[edges[e][1]] = t;
+            for (cemINT d=0; d<3; ++d)
+                ijk.push_back(offset + indices[d]);
+        }
+    }
+
+    // Interior:
+    Generate(order-3,offset+1,ijk);
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS TriKernel:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TriKernel<P,Q>::ContractReference : Computes the k-th N_NxNx, N_NyNy, N_NN and
+ * N_GradGrad matrices from the reference tensors.
+ *
+ * Same contraction as TriReferenceTensors::Compute_N_NdNd_matrix, with NUM_PACKED known at
+ * compile time and all four families written in the same sweep.
+ * @param [in] tensors : reference tensors of orders (P,Q)
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @param [in] b1,b2,c1,c2 : geometry factors of the triangle
+ * @param [in] delta : (signed) area of the triangle
+ * @param [out] N_NxNx : NUM_PACKED entries
+ * @param [out] N_NyNy : NUM_PACKED entries
+ * @param [out] N_NN : NUM_PACKED entries
+ * @param [out] N_GradGrad : NUM_PACKED entries */
+//************************************************************************************************//
+template <cemINT P, cemINT Q>
+void TriKernel<P,Q>::ContractReference(const TriReferenceTensors& tensors,
+                                       const cemINT& coefficient_index,
+                                       const cemDOUBLE& b1,
+                                       const cemDOUBLE& b2,
+                                       const cemDOUBLE& c1,
+                                       const cemDOUBLE& c2,
+                                       const cemDOUBLE& delta,
+                                       cemDOUBLE* N_NxNx,
+                                       cemDOUBLE* N_NyNy,
+                                       cemDOUBLE* N_NN,
+                                       cemDOUBLE* N_GradGrad)
+{
+    const cemDOUBLE inverse_two_delta = 0.5/delta;
+    const cemDOUBLE gx_ksi_ksi = b1*b1*inverse_two_delta;
+    const cemDOUBLE gx_ksi_eta = b1*b2*inverse_two_delta;
+    const cemDOUBLE gx_eta_eta = b2*b2*inverse_two_delta;
+    const cemDOUBLE gy_ksi_ksi = c1*c1*inverse_two_delta;
+    const cemDOUBLE gy_ksi_eta = c1*c2*inverse_two_delta;
+    const cemDOUBLE gy_eta_eta = c2*c2*inverse_two_delta;
+    const cemDOUBLE two_delta = 2.0*delta;
+
+    const cemDOUBLE* A = tensors.tensor_ksi_ksi(coefficient_index);
+    const cemDOUBLE* B = tensors.tensor_ksi_eta(coefficient_index);
+    const cemDOUBLE* C = tensors.tensor_eta_eta(coefficient_index);
+    const cemDOUBLE* M = tensors.tensor_mass(coefficient_index);
+    for (cemINT m=0; m<NUM_PACKED; ++m)
+    {
+        cemDOUBLE K_x = gx_ksi_ksi*A[m] + gx_ksi_eta*B[m] + gx_eta_eta*C[m];
+        cemDOUBLE K_y = gy_ksi_ksi*A[m] + gy_ksi_eta*B[m] + gy_eta_eta*C[m];
+        N_NxNx[m] = K_x;
+        N_NyNy[m] = K_y;
+        N_NN[m] = two_delta*M[m];
+        N_GradGrad[m] = K_x + K_y;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief TriKernel<P,Q>::IntegrateNumerically : Computes all N_NxNx, N_NyNy, N_NN and
+ * N_GradGrad matrices in one pass over the quadrature points.
+ *
+ * Sums are kept in fixed-size arrays on the stack and written out once at the end.
+ * @param [in] tabulation : tabulated functions of orders (P,Q)
+ * @param [in] inverse_jacobian : 2x2 inverse Jacobian of the triangle, stored column-wise
+ * @param [in] determinant : determinant of the Jacobian
+ * @param [out] N_NxNx : NUM_COEFFICIENTS pointers to NUM_PACKED entries
+ * @param [out] N_NyNy : NUM_COEFFICIENTS pointers to NUM_PACKED entries
+ * @param [out] N_NN : NUM_COEFFICIENTS pointers to NUM_PACKED entries
+ * @param [out] N_GradGrad : NUM_COEFFICIENTS pointers to NUM_PACKED entries */
+//************************************************************************************************//
+template <cemINT P, cemINT Q>
+void TriKernel<P,Q>::IntegrateNumerically(const TriTabulation& tabulation,
+                                          const cemDOUBLE* inverse_jacobian,
+                                          const cemDOUBLE& determinant,
+                                          cemDOUBLE* const* N_NxNx,
+                                          cemDOUBLE* const* N_NyNy,
+                                          cemDOUBLE* const* N_NN,
+                                          cemDOUBLE* const* N_GradGrad)
+{
+    const cemDOUBLE dksi_dx = inverse_jacobian[0];
+    const cemDOUBLE dksi_dy = inverse_jacobian[1];
+    const cemDOUBLE deta_dx = inverse_jacobian[2];
+    const cemDOUBLE deta_dy = inverse_jacobian[3];
+
+    cemDOUBLE K_x[NUM_COEFFICIENTS][NUM_PACKED] = {{0.0}};
+    cemDOUBLE K_y[NUM_COEFFICIENTS][NUM_PACKED] = {{0.0}};
+    cemDOUBLE M[NUM_COEFFICIENTS][NUM_PACKED] = {{0.0}};
+    cemDOUBLE N_x[NUM_BASIS], N_y[NUM_BASIS];
+
+    const cemDOUBLE* weights = tabulation.weights();
+    for (cemINT t=0; t<tabulation.num_points(); ++t)
+    {
+        const cemDOUBLE* N = tabulation.basis(t);
+        const cemDOUBLE* N_ksi = tabulation.basis_ksi_deriv(t);
+        const cemDOUBLE* N_eta = tabulation.basis_eta_deriv(t);
+        const cemDOUBLE* coefficients = tabulation.coefficients(t);
+        for (cemINT i=0; i<NUM_BASIS; ++i)
+        {
+            N_x[i] = dksi_dx*N_ksi[i] + deta_dx*N_eta[i];
+            N_y[i] = dksi_dy*N_ksi[i] + deta_dy*N_eta[i];
+        }
+
+        for (cemINT k=0; k<NUM_COEFFICIENTS; ++k)
+        {
+            cemDOUBLE w = weights[t]*coefficients[k]*determinant;
+            cemINT m = 0;
+            for (cemINT j=0; j<NUM_BASIS; ++j)
+            {
+                for (cemINT i=j; i<NUM_BASIS; ++i, ++m)
+                {
+                    K_x[k][m] += w*N_x[i]*N_x[j];
+                    K_y[k][m] += w*N_y[i]*N_y[j];
+                    M[k][m] += w*N[i]*N[j];
+                }
+            }
+        }
+    }
+
+    for (cemINT k=0; k<NUM_COEFFICIENTS; ++k)
+    {
+        for (cemINT m=0; m<NUM_PACKED; ++m)
+        {
+            N_NxNx[k][m] = K_x[k][m];
+            N_NyNy[k][m] = K_y[k][m];
+            N_NN[k][m] = M[k][m];
+            N_GradGrad[k][m] = K_x[k][m] + K_y[k][m];
+        }
+    }
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS TriKernels:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TriKernels::GetReferenceKernel : Gets the reference contraction kernel of a pair of
+ * orders.
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions
+ * @return : TriKernel<P,Q>::ContractReference, or NULL if there is no kernel for (P,Q) */
+//************************************************************************************************//
+TriKernels::ReferenceKernel TriKernels::GetReferenceKernel(const cemINT& basis_order,
+                                                           const cemINT& coefficient_order)
+{
+    static const ReferenceKernel kernels[MAX_BASIS_ORDER][MAX_COEFFICIENT_ORDER+1] =
+    {
+        {&TriKernel<1,0>::ContractReference,
+         &TriKernel<1,1>::ContractReference,
+         &TriKernel<1,2>::ContractReference},
+        {&TriKernel<2,0>::ContractReference,
+         &TriKernel<2,1>::ContractReference,
+         &TriKernel<2,2>::ContractReference},
+        {&TriKernel<3,0>::ContractReference,
+         &TriKernel<3,1>::ContractReference,
+         &TriKernel<3,2>::ContractReference}
+    };
+
+    if (basis_order < 1 || basis_order > MAX_BASIS_ORDER ||
+        coefficient_order < 0 || coefficient_order > MAX_COEFFICIENT_ORDER)
+        return NULL;
+
+    return kernels[basis_order-1][coefficient_order];
+}
+
+
+//************************************************************************************************//
+/** @brief TriKernels::GetNumericalKernel : Gets the numerical integration kernel of a pair of
+ * orders.
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions
+ * @return : TriKernel<P,Q>::IntegrateNumerically, or NULL if there is no kernel for (P,Q) */
+//************************************************************************************************//
+TriKernels::NumericalKernel TriKernels::GetNumericalKernel(const cemINT& basis_order,
+                                                           const cemINT& coefficient_order)
+{
+    static const NumericalKernel kernels[MAX_BASIS_ORDER][MAX_COEFFICIENT_ORDER+1] =
+    {
+        {&TriKernel<1,0>::IntegrateNumerically,
+         &TriKernel<1,1>::IntegrateNumerically,
+         &TriKernel<1,2>::IntegrateNumerically},
+        {&TriKernel<2,0>::IntegrateNumerically,
+         &TriKernel<2,1>::IntegrateNumerically,
+         &TriKernel<2,2>::IntegrateNumerically},
+        {&TriKernel<3,0>::IntegrateNumerically,
+         &TriKernel<3,1>::IntegrateNumerically,
+         &TriKernel<3,2>::IntegrateNumerically}
+    };
+
+    if (basis_order < 1 || basis_order > MAX_BASIS_ORDER ||
+        coefficient_order < 0 || coefficient_order > MAX_COEFFICIENT_ORDER)
+        return NULL;
+
+    return kernels[basis_order-1][coefficient_order];
+}
+
+
+
+
+//************************************************************************************************//
+// Class Instantiations:
+//************************************************************************************************//
+template class TriKernel<1,0>;
+template class TriKernel<1,1>;
+template class TriKernel<1,2>;
+template class TriKernel<2,0>;
+template class TriKernel<2,1>;
+template class TriKernel<2,2>;
+template class TriKernel<3,0>;
+template class TriKernel<3,1>;
+template class TriKernel<3,2>;
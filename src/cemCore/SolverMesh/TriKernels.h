@@ -0,0 +1,183 @@
+#ifndef TRI_KERNELS_H
+#define TRI_KERNELS_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "TriReferenceTensors.h"
+#include "TriTabulation.h"
+
+using namespace cem_def;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The TriIndexTable struct : Silvester indices (i,j,k) of each shape function of order P.
+ *
+ * Row m of ijk holds the indices of the m-th function in the numbering of cemMesh.h (vertices,
+ * then edges, then interior). Orders 0 to 6 are specialized with constant tables, which follow
+ * the rule of TriIndexTables::Generate(). Use TriIndexTables::Get() for an order known only at
+ * runtime. */
+//************************************************************************************************//
+template <cemINT P>
+struct TriIndexTable;
+
+template <>
+struct TriIndexTable<0>
+{
+    static const cemINT NUM_FUNCTIONS = 1;
+    static const cemINT ijk[1][3];
+};
+
+template <>
+struct TriIndexTable<1>
+{
+    static const cemINT NUM_FUNCTIONS = 3;
+    static const cemINT ijk[3][3];
+};
+
+template <>
+struct TriIndexTable<2>
+{
+    static const cemINT NUM_FUNCTIONS = 6;
+    static const cemINT ijk[6][3];
+};
+
+template <>
+struct TriIndexTable<3>
+{
+    static const cemINT NUM_FUNCTIONS = 10;
+    static const cemINT ijk[10][3];
+};
+
+template <>
+struct TriIndexTable<4>
+{
+    static const cemINT NUM_FUNCTIONS = 15;
+    static const cemINT ijk[15][3];
+};
+
+template <>
+struct TriIndexTable<5>
+{
+    static const cemINT NUM_FUNCTIONS = 21;
+    static const cemINT ijk[21][3];
+};
+
+template <>
+struct TriIndexTable<6>
+{
+    static const cemINT NUM_FUNCTIONS = 28;
+    static const cemINT ijk[28][3];
+};
+
+
+//************************************************************************************************//
+/** @brief The TriIndexTables class : Silvester index tables of any order, chosen at runtime.
+ *
+ * Each table holds 3*(P+1)*(P+2)/2 values: the (i,j,k) indices of every shape function of order
+ * P, one function after the other. Orders up to MAX_CONSTANT_ORDER come from the constant
+ * TriIndexTable arrays; higher orders are generated the first time they are requested and kept
+ * for the rest of the run.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class TriIndexTables
+{
+public:
+    static const cemINT MAX_CONSTANT_ORDER = 6;     //!< Highest order with a constant table.
+
+    static const cemINT* Get(const cemINT& order);
+
+    static void Generate(const cemINT& order, std::vector<cemINT>& ijk);
+
+private:
+    static void Generate(const cemINT& order, const cemINT& offset, std::vector<cemINT>& ijk);
+};
+
+
+//************************************************************************************************//
+/** @brief The TriKernel class : Element matrix kernels of a flat triangle with basis order P and
+ * coefficient order Q fixed at compile time.
+ *
+ * All loop bounds are compile-time constants and all temporaries are fixed-size arrays on the
+ * stack, so the compiler can fully unroll and vectorize the 3x3, 6x6 and 10x10 cases. Matrices
+ * are packed as in SymmetricMatrix. Use TriKernels to pick an instantiation at runtime.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+template <cemINT P, cemINT Q>
+class TriKernel
+{
+public:
+    static const cemINT NUM_BASIS = (P+1)*(P+2)/2;                 //!< Rows of each matrix.
+    static const cemINT NUM_COEFFICIENTS = (Q+1)*(Q+2)/2;          //!< Matrices per family.
+    static const cemINT NUM_PACKED = NUM_BASIS*(NUM_BASIS+1)/2;    //!< Entries per matrix.
+
+    static void ContractReference(const TriReferenceTensors& tensors,
+                                  const cemINT& coefficient_index,
+                                  const cemDOUBLE& b1,
+                                  const cemDOUBLE& b2,
+                                  const cemDOUBLE& c1,
+                                  const cemDOUBLE& c2,
+                                  const cemDOUBLE& delta,
+                                  cemDOUBLE* N_NxNx,
+                                  cemDOUBLE* N_NyNy,
+                                  cemDOUBLE* N_NN,
+                                  cemDOUBLE* N_GradGrad);
+
+    static void IntegrateNumerically(const TriTabulation& tabulation,
+                                     const cemDOUBLE* inverse_jacobian,
+                                     const cemDOUBLE& determinant,
+                                     cemDOUBLE* const* N_NxNx,
+                                     cemDOUBLE* const* N_NyNy,
+                                     cemDOUBLE* const* N_NN,
+                                     cemDOUBLE* const* N_GradGrad);
+};
+
+
+//************************************************************************************************//
+/** @brief The TriKernels class : Runtime dispatcher of the TriKernel instantiations.
+ *
+ * Kernels exist for basis orders 1 to 3 and coefficient orders 0 to 2. For any other pair the
+ * getters return NULL and the caller keeps its generic path.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class TriKernels
+{
+public:
+    static const cemINT MAX_BASIS_ORDER = 3;        //!< Highest basis order with a kernel.
+    static const cemINT MAX_COEFFICIENT_ORDER = 2;  //!< Highest coefficient order with a kernel.
+    static const cemINT MAX_COEFFICIENTS = 6;       //!< Matrices per family at most.
+
+    /** @brief ReferenceKernel : TriKernel<P,Q>::ContractReference */
+    typedef void (*ReferenceKernel)(const TriReferenceTensors& tensors,
+                                    const cemINT& coefficient_index,
+                                    const cemDOUBLE& b1,
+                                    const cemDOUBLE& b2,
+                                    const cemDOUBLE& c1,
+                                    const cemDOUBLE& c2,
+                                    const cemDOUBLE& delta,
+                                    cemDOUBLE* N_NxNx,
+                                    cemDOUBLE* N_NyNy,
+                                    cemDOUBLE* N_NN,
+                                    cemDOUBLE* N_GradGrad);
+
+    /** @brief NumericalKernel : TriKernel<P,Q>::IntegrateNumerically */
+    typedef void (*NumericalKernel)(const TriTabulation& tabulation,
+                                    const cemDOUBLE* inverse_jacobian,
+                                    const cemDOUBLE& determinant,
+                                    cemDOUBLE* const* N_NxNx,
+                                    cemDOUBLE* const* N_NyNy,
+                                    cemDOUBLE* const* N_NN,
+                                    cemDOUBLE* const* N_GradGrad);
+
+    static ReferenceKernel GetReferenceKernel(const cemINT& basis_order,
+                                              const cemINT& coefficient_order);
+
+    static NumericalKernel GetNumericalKernel(const cemINT& basis_order,
+                                              const cemINT& coefficient_order);
+};
+
+
+}
+
+
+#endif // TRI_KERNELS_H
@@ -0,0 +1,227 @@
+#include "TriMatrixBatch.h"
+#include "cemError.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+const cemINT TriMatrixBatch::LANES;
+
+
+///***********************************************************************************************//
+/// CLASS TriMatrixBatch:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::TriMatrixBatch : Constructor with parameters.
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions */
+//************************************************************************************************//
+TriMatrixBatch::TriMatrixBatch(const cemINT& basis_order, const cemINT& coefficient_order)
+{
+    tensors_ = &TriReferenceTensors::Get(basis_order,coefficient_order);
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::num_basis_functions : Gets number of rows of each element matrix.
+ * @return : (p+1)(p+2)/2 */
+//************************************************************************************************//
+cemINT TriMatrixBatch::num_basis_functions() const {return tensors_->num_basis_functions();}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::num_coefficient_functions : Gets number of matrices per family.
+ * @return : (q+1)(q+2)/2 */
+//************************************************************************************************//
+cemINT TriMatrixBatch::num_coefficient_functions() const
+{
+    return tensors_->num_coefficient_functions();
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::block_size : Gets number of entries written per block and family.
+ * @return : LANES*(q+1)(q+2)/2*n(n+1)/2 */
+//************************************************************************************************//
+cemINT TriMatrixBatch::block_size() const
+{
+    return LANES*tensors_->num_coefficient_functions()*tensors_->num_packed_entries();
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::buffer_size : Gets size of the buffer needed per family by Compute().
+ *
+ * The last block is always written in full, so the buffer is rounded up to a number of blocks.
+ * @param [in] num_triangles : number of triangles
+ * @return : number of cemDOUBLE entries */
+//************************************************************************************************//
+cemINT8 TriMatrixBatch::buffer_size(const cemINT& num_triangles) const
+{
+    cemINT8 num_blocks = (num_triangles + LANES - 1)/LANES;
+    return num_blocks*block_size();
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::ComputeBlock : Computes the matrices of up to LANES triangles.
+ *
+ * If less than LANES triangles are given, the remaining lanes repeat the last triangle so that
+ * every lane holds valid geometry. Any output pointer can be NULL to skip that family.
+ * @param [in] num_triangles : number of triangles in the block (1 to LANES)
+ * @param [in] x1,y1,x2,y2,x3,y3 : node coordinates, one entry per triangle
+ * @param [out] N_NxNx : block_size() entries, or NULL
+ * @param [out] N_NyNy : block_size() entries, or NULL
+ * @param [out] N_NN : block_size() entries, or NULL */
+//************************************************************************************************//
+void TriMatrixBatch::ComputeBlock(const cemINT& num_triangles,
+                                  const cemDOUBLE* x1, const cemDOUBLE* y1,
+                                  const cemDOUBLE* x2, const cemDOUBLE* y2,
+                                  const cemDOUBLE* x3, const cemDOUBLE* y3,
+                                  cemDOUBLE* N_NxNx,
+                                  cemDOUBLE* N_NyNy,
+                                  cemDOUBLE* N_NN) const
+{
+    if (num_triangles < 1 || num_triangles > LANES)
+        throw(Exception("INPUT ERROR","num_triangles must be from 1 to LANES"));
+
+    // Geometry factors, one per lane:
+    cemDOUBLE gx_ksi_ksi[LANES], gx_ksi_eta[LANES], gx_eta_eta[LANES];
+    cemDOUBLE gy_ksi_ksi[LANES], gy_ksi_eta[LANES], gy_eta_eta[LANES];
+    cemDOUBLE two_delta[LANES];
+    for (cemINT l=0; l<LANES; ++l)
+    {
+        cemINT t = l < num_triangles ? l : num_triangles-1;
+        cemDOUBLE b1 = y2[t] - y3[t];
+        cemDOUBLE b2 = y3[t] - y1[t];
+        cemDOUBLE c1 = x3[t] - x2[t];
+        cemDOUBLE c2 = x1[t] - x3[t];
+        cemDOUBLE inverse_two_delta = 1.0/(b1*c2 - b2*c1);
+
+        gx_ksi_ksi[l] = b1*b1*inverse_two_delta;
+        gx_ksi_eta[l] = b1*b2*inverse_two_delta;
+        gx_eta_eta[l] = b2*b2*inverse_two_delta;
+        gy_ksi_ksi[l] = c1*c1*inverse_two_delta;
+        gy_ksi_eta[l] = c1*c2*inverse_two_delta;
+        gy_eta_eta[l] = c2*c2*inverse_two_delta;
+        two_delta[l] = b1*c2 - b2*c1;
+    }
+
+    // Contract reference tensors, lanes innermost:
+    cemINT size = tensors_->num_packed_entries();
+    for (cemINT k=0; k<tensors_->num_coefficient_functions(); ++k)
+    {
+        const cemDOUBLE* A = tensors_->tensor_ksi_ksi(k);
+        const cemDOUBLE* B = tensors_->tensor_ksi_eta(k);
+        const cemDOUBLE* C = tensors_->tensor_eta_eta(k);
+        const cemDOUBLE* M = tensors_->tensor_mass(k);
+        cemINT offset = k*size*LANES;
+
+        if (N_NxNx != NULL)
+        {
+            for (cemINT m=0; m<size; ++m)
+            {
+                cemDOUBLE* out = &N_NxNx[offset + m*LANES];
+                for (cemINT l=0; l<LANES; ++l)
+                    out[l] = gx_ksi_ksi[l]*A[m] + gx_ksi_eta[l]*B[m] + gx_eta_eta[l]*C[m];
+            }
+        }
+        if (N_NyNy != NULL)
+        {
+            for (cemINT m=0; m<size; ++m)
+            {
+                cemDOUBLE* out = &N_NyNy[offset + m*LANES];
+                for (cemINT l=0; l<LANES; ++l)
+                    out[l] = gy_ksi_ksi[l]*A[m] + gy_ksi_eta[l]*B[m] + gy_eta_eta[l]*C[m];
+            }
+        }
+        if (N_NN != NULL)
+        {
+            for (cemINT m=0; m<size; ++m)
+            {
+                cemDOUBLE* out = &N_NN[offset + m*LANES];
+                for (cemINT l=0; l<LANES; ++l)
+                    out[l] = two_delta[l]*M[m];
+            }
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::Compute : Computes the matrices of any number of triangles.
+ *
+ * Triangles are split in blocks of LANES. Each output buffer must hold buffer_size() entries,
+ * or be NULL to skip that family.
+ * @param [in] num_triangles : number of triangles
+ * @param [in] x1,y1,x2,y2,x3,y3 : node coordinates, num_triangles entries each
+ * @param [out] N_NxNx : buffer_size(num_triangles) entries, or NULL
+ * @param [out] N_NyNy : buffer_size(num_triangles) entries, or NULL
+ * @param [out] N_NN : buffer_size(num_triangles) entries, or NULL */
+//************************************************************************************************//
+void TriMatrixBatch::Compute(const cemINT& num_triangles,
+                             const cemDOUBLE* x1, const cemDOUBLE* y1,
+                             const cemDOUBLE* x2, const cemDOUBLE* y2,
+                             const cemDOUBLE* x3, const cemDOUBLE* y3,
+                             cemDOUBLE* N_NxNx,
+                             cemDOUBLE* N_NyNy,
+                             cemDOUBLE* N_NN) const
+{
+    cemINT8 stride = block_size();
+    cemINT num_blocks = (num_triangles + LANES - 1)/LANES;
+
+    for (cemINT b=0; b<num_blocks; ++b)
+    {
+        cemINT first = b*LANES;
+        cemINT count = num_triangles - first < LANES ? num_triangles - first : LANES;
+        ComputeBlock(count,
+                     &x1[first],&y1[first],&x2[first],&y2[first],&x3[first],&y3[first],
+                     N_NxNx != NULL ? &N_NxNx[b*stride] : NULL,
+                     N_NyNy != NULL ? &N_NyNy[b*stride] : NULL,
+                     N_NN != NULL ? &N_NN[b*stride] : NULL);
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::GetMatrix : Extracts the matrix of a single triangle from a buffer.
+ * @param [in] buffer : buffer written by Compute()
+ * @param [in] triangle_index : index of the triangle, as given to Compute()
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @param [out] matrix : \f$ n \times n \f$ element matrix */
+//************************************************************************************************//
+void TriMatrixBatch::GetMatrix(const cemDOUBLE* buffer,
+                               const cemINT& triangle_index,
+                               const cemINT& coefficient_index,
+                               SymmetricMatrix<cemDOUBLE>& matrix) const
+{
+    cemINT n = tensors_->num_basis_functions();
+    cemINT size = tensors_->num_packed_entries();
+    cemINT8 block = triangle_index/LANES;
+    cemINT lane = triangle_index%LANES;
+    const cemDOUBLE* entries = &buffer[block*block_size() + coefficient_index*size*LANES + lane];
+
+    matrix.resize(n,n);
+    cemDOUBLE* packed = &matrix(0,0);
+    for (cemINT m=0; m<size; ++m)
+        packed[m] = entries[m*LANES];
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixBatch::GetMatrix : Extracts the matrix of a single triangle from a buffer,
+ * in full storage.
+ * @param [in] buffer : buffer written by Compute()
+ * @param [in] triangle_index : index of the triangle, as given to Compute()
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @param [out] matrix : \f$ n \times n \f$ element matrix */
+//************************************************************************************************//
+void TriMatrixBatch::GetMatrix(const cemDOUBLE* buffer,
+                               const cemINT& triangle_index,
+                               const cemINT& coefficient_index,
+                               DenseMatrix<cemDOUBLE>& matrix) const
+{
+    SymmetricMatrix<cemDOUBLE> packed;
+    GetMatrix(buffer,triangle_index,coefficient_index,packed);
+    matrix = packed;
+}
@@ -0,0 +1,81 @@
+#ifndef TRI_MATRIX_BATCH_H
+#define TRI_MATRIX_BATCH_H
+
+#include "cemTypes.h"
+#include "TriReferenceTensors.h"
+#include "Matrix/DenseMatrix.h"
+#include "Matrix/SymmetricMatrix.h"
+
+using namespace cem_def;
+using cem_math::DenseMatrix;
+using cem_math::SymmetricMatrix;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The TriMatrixBatch class : Element matrices of many affine triangles at once.
+ *
+ * Triangles are processed in blocks of LANES elements given in structure-of-arrays form (one
+ * array per node coordinate). Inside a block every arithmetic operation runs across the LANES
+ * triangles, so the inner loops map directly onto AVX2 (2x4 doubles) or AVX-512 (1x8 doubles)
+ * registers when the library is built with the corresponding CEM_SIMD_FLAGS.
+ *
+ * Output buffers are stored block by block. Inside a block, entry m of the k-th matrix of lane l
+ * is found at (k*n(n+1)/2 + m)*LANES + l, with m the index of the entry in the packed lower
+ * triangle (see SymmetricMatrix). Use GetMatrix() to extract the matrix of a single triangle.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class TriMatrixBatch
+{
+public:
+    static const cemINT LANES = 8;  //!< Number of triangles processed together.
+
+    // Constructor with parameters:
+    TriMatrixBatch(const cemINT& basis_order, const cemINT& coefficient_order);
+
+    // Get data members:
+    cemINT num_basis_functions() const;
+    cemINT num_coefficient_functions() const;
+    cemINT block_size() const;
+    cemINT8 buffer_size(const cemINT& num_triangles) const;
+
+    // Batched computation:
+    void ComputeBlock(const cemINT& num_triangles,
+                      const cemDOUBLE* x1, const cemDOUBLE* y1,
+                      const cemDOUBLE* x2, const cemDOUBLE* y2,
+                      const cemDOUBLE* x3, const cemDOUBLE* y3,
+                      cemDOUBLE* N_NxNx,
+                      cemDOUBLE* N_NyNy,
+                      cemDOUBLE* N_NN) const;
+
+    void Compute(const cemINT& num_triangles,
+                 const cemDOUBLE* x1, const cemDOUBLE* y1,
+                 const cemDOUBLE* x2, const cemDOUBLE* y2,
+                 const cemDOUBLE* x3, const cemDOUBLE* y3,
+                 cemDOUBLE* N_NxNx,
+                 cemDOUBLE* N_NyNy,
+                 cemDOUBLE* N_NN) const;
+
+    // Unpack a single matrix:
+    void GetMatrix(const cemDOUBLE* buffer,
+                   const cemINT& triangle_index,
+                   const cemINT& coefficient_index,
+                   SymmetricMatrix<cemDOUBLE>& matrix) const;
+
+    void GetMatrix(const cemDOUBLE* buffer,
+                   const cemINT& triangle_index,
+                   const cemINT& coefficient_index,
+                   DenseMatrix<cemDOUBLE>& matrix) const;
+
+private:
+    const TriReferenceTensors* tensors_;    //!< Shared reference tensors of the element.
+
+    // Private member functions:
+    TriMatrixBatch(); // Only parameterized constructor can be used.
+};
+
+
+}
+
+
+#endif // TRI_MATRIX_BATCH_H
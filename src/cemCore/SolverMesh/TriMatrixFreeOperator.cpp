@@ -0,0 +1,425 @@
+#include "TriMatrixFreeOperator.h"
+#include "BasisFunctions/BasisFunctions.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+const cemINT TriMatrixFreeOperator::LANES;
+
+
+///***********************************************************************************************//
+/// CLASS TriMatrixFreeOperator:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::TriMatrixFreeOperator : Constructor with parameters.
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions
+ * @param [in] basis_type : INTERPOLATORY or HIERARCHICAL basis functions */
+//************************************************************************************************//
+TriMatrixFreeOperator::TriMatrixFreeOperator(const cemINT& basis_order,
+                                             const cemINT& coefficient_order,
+                                             const BasisFunctionType& basis_type)
+{
+    tabulation_ = &TriTabulation::Get(basis_order,coefficient_order,0,basis_type);
+    num_triangles_ = 0;
+    num_blocks_ = 0;
+    num_dofs_ = 0;
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::num_basis_functions : Gets number of basis functions per triangle.
+ * @return : (p+1)(p+2)/2 */
+//************************************************************************************************//
+cemINT TriMatrixFreeOperator::num_basis_functions() const
+{
+    return tabulation_->num_basis_functions();
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::num_coefficient_functions : Gets number of coefficients per
+ * triangle and family.
+ * @return : (q+1)(q+2)/2 */
+//************************************************************************************************//
+cemINT TriMatrixFreeOperator::num_coefficient_functions() const
+{
+    return tabulation_->num_coefficient_functions();
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::num_triangles : Gets number of triangles.
+ * @return : num_triangles_ */
+//************************************************************************************************//
+cemINT TriMatrixFreeOperator::num_triangles() const {return num_triangles_;}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::num_dofs : Gets number of global degrees of freedom.
+ * @return : num_dofs_ (largest dof given to SetUp() plus one) */
+//************************************************************************************************//
+cemINT TriMatrixFreeOperator::num_dofs() const {return num_dofs_;}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::SetUp : Sets the triangles, their degrees of freedom and their
+ * coefficients.
+ *
+ * Only the inverse Jacobian and determinant of each triangle are kept; coordinates are not. The
+ * determinant keeps its sign, as in SolverTriangle, so a clockwise triangle contributes the same
+ * (negative) element matrix to Apply() as to the assembled system.
+ * @param [in] num_triangles : number of triangles (>= 1)
+ * @param [in] x1,y1,x2,y2,x3,y3 : node coordinates, num_triangles entries each
+ * @param [in] dofs : global dof of each basis function, n entries per triangle
+ * @param [in] stiffness_coefficients : \f$ \alpha_k \f$ of N_GradGrad, m entries per triangle
+ * @param [in] mass_coefficients : \f$ \beta_k \f$ of N_NN, m entries per triangle (or NULL) */
+//************************************************************************************************//
+void TriMatrixFreeOperator::SetUp(const cemINT& num_triangles,
+                                  const cemDOUBLE* x1, const cemDOUBLE* y1,
+                                  const cemDOUBLE* x2, const cemDOUBLE* y2,
+                                  const cemDOUBLE* x3, const cemDOUBLE* y3,
+                                  const cemINT* dofs,
+                                  const cemDOUBLE* stiffness_coefficients,
+                                  const cemDOUBLE* mass_coefficients)
+{
+    if (num_triangles < 1)
+        throw(Exception("INPUT ERROR","num_triangles must be > 0"));
+
+    cemINT n = num_basis_functions();
+    cemINT m = num_coefficient_functions();
+    num_triangles_ = num_triangles;
+    num_blocks_ = (num_triangles + LANES - 1)/LANES;
+
+    // Unused lanes of the last block have zero geometry, so they add nothing:
+    geometry_.assign(num_blocks_*GEOMETRY_SIZE*LANES,0.0);
+    stiffness_.assign(num_blocks_*m*LANES,0.0);
+    mass_.clear();
+    if (mass_coefficients != NULL)
+        mass_.assign(num_blocks_*m*LANES,0.0);
+    dofs_.assign(num_blocks_*n*LANES,-1);
+
+    num_dofs_ = 0;
+    for (cemINT e=0; e<num_triangles; ++e)
+    {
+        cemINT b = e/LANES;
+        cemINT l = e%LANES;
+
+        // Jacobian of the affine map (rows are d/dksi and d/deta):
+        cemDOUBLE x_ksi = x1[e] - x3[e];
+        cemDOUBLE y_ksi = y1[e] - y3[e];
+        cemDOUBLE x_eta = x2[e] - x3[e];
+        cemDOUBLE y_eta = y2[e] - y3[e];
+        cemDOUBLE determinant = x_ksi*y_eta - y_ksi*x_eta;
+        if (determinant == 0.0)
+            throw(Exception("INVALID ELEMENT","Triangle " + cem_utils::NumberToString<cemINT>(e) +
+                            " has zero area"));
+
+        cemDOUBLE* geometry = &geometry_[b*GEOMETRY_SIZE*LANES];
+        geometry[DKSI_DX*LANES + l] = y_eta/determinant;
+        geometry[DKSI_DY*LANES + l] = -x_eta/determinant;
+        geometry[DETA_DX*LANES + l] = -y_ksi/determinant;
+        geometry[DETA_DY*LANES + l] = x_ksi/determinant;
+        geometry[DETERMINANT*LANES + l] = determinant;
+
+        for (cemINT k=0; k<m; ++k)
+        {
+            stiffness_[(b*m + k)*LANES + l] = stiffness_coefficients[e*m + k];
+            if (mass_coefficients != NULL)
+                mass_[(b*m + k)*LANES + l] = mass_coefficients[e*m + k];
+        }
+
+        for (cemINT i=0; i<n; ++i)
+        {
+            cemINT dof = dofs[e*n + i];
+            if (dof < 0)
+                throw(Exception("INPUT ERROR","dofs must be >= 0"));
+
+            dofs_[(b*n + i)*LANES + l] = dof;
+            if (dof >= num_dofs_)
+                num_dofs_ = dof + 1;
+        }
+    }
+
+    // Odd-degree hierarchical edge functions, from the lower to the higher vertex dof:
+    signs_.clear();
+    if (tabulation_->basis_type() == HIERARCHICAL && tabulation_->basis_order() >= 3)
+    {
+        signs_.assign(dofs_.size(),1.0);
+        for (cemINT e=0; e<num_triangles; ++e)
+        {
+            cemINT b = e/LANES;
+            cemINT l = e%LANES;
+            for (cemINT k=3; k<=tabulation_->basis_order(); k+=2)
+            {
+                cemINT first = TriHierarchicalShapeFunction::NumFunctions(k-1);
+                for (cemINT edge=0; edge<3; ++edge)
+                    if (dofs[e*n + edge] > dofs[e*n + (edge+1)%3])
+                        signs_[(b*n + first + edge)*LANES + l] = -1.0;
+            }
+        }
+    }
+
+    // Positions of each dof in the element buffer (which has the layout of dofs_):
+    dof_offsets_.assign(num_dofs_+1,0);
+    for (size_t p=0; p<dofs_.size(); ++p)
+    {
+        if (dofs_[p] >= 0)
+            ++dof_offsets_[dofs_[p]+1];
+    }
+    for (cemINT d=0; d<num_dofs_; ++d)
+        dof_offsets_[d+1] += dof_offsets_[d];
+
+    dof_entries_.resize(dof_offsets_[num_dofs_]);
+    std::vector<cemINT> next(dof_offsets_.begin(),dof_offsets_.end()-1);
+    for (size_t p=0; p<dofs_.size(); ++p)
+    {
+        if (dofs_[p] >= 0)
+            dof_entries_[next[dofs_[p]]++] = static_cast<cemINT>(p);
+    }
+
+    element_values_.resize(dofs_.size());
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::Apply : Adds the operator times a vector to another vector.
+ *
+ * The element buffer is shared, so a single Apply() or GetDiagonal() may run at a time on each
+ * operator (each of them is threaded internally).
+ * @param [in] x : num_dofs() entries
+ * @param [in,out] y : num_dofs() entries, \f$ y \mathrel{+}= Kx \f$ on exit */
+//************************************************************************************************//
+void TriMatrixFreeOperator::Apply(const cemDOUBLE* x, cemDOUBLE* y) const
+{
+    cemINT n = num_basis_functions();
+
+    #pragma omp parallel
+    {
+        std::vector<cemDOUBLE> x_local(n*LANES);
+
+        #pragma omp for schedule(static)
+        for (cemINT b=0; b<num_blocks_; ++b)
+            ApplyBlock(b,x,&x_local[0],&element_values_[b*n*LANES]);
+    }
+
+    AddElementValues(y);
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::GetDiagonal : Gets the diagonal of the operator (e.g. for a
+ * Jacobi preconditioner).
+ * @param [out] diagonal : num_dofs() entries */
+//************************************************************************************************//
+void TriMatrixFreeOperator::GetDiagonal(cemDOUBLE* diagonal) const
+{
+    cemINT n = num_basis_functions();
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT b=0; b<num_blocks_; ++b)
+        DiagonalBlock(b,&element_values_[b*n*LANES]);
+
+    for (cemINT d=0; d<num_dofs_; ++d)
+        diagonal[d] = 0.0;
+
+    AddElementValues(diagonal);
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::ApplyBlock : Computes \f$ K_e x_e \f$ for the triangles of a
+ * block.
+ *
+ * The gradient of the local field is interpolated at each quadrature point, mapped to x and y,
+ * scaled, mapped back and tested against the reference derivatives. This takes O(n) operations
+ * per point and triangle, instead of the O(n^2) entries of the element matrix.
+ * @param [in] block_index : index of the block
+ * @param [in] x : global vector
+ * @param [out] x_local : workspace of n*LANES entries
+ * @param [out] y_local : n*LANES entries of the element buffer */
+//************************************************************************************************//
+void TriMatrixFreeOperator::ApplyBlock(const cemINT& block_index,
+                                       const cemDOUBLE* x,
+                                       cemDOUBLE* x_local,
+                                       cemDOUBLE* y_local) const
+{
+    cemINT n = num_basis_functions();
+    cemINT m = num_coefficient_functions();
+    const cemDOUBLE* geometry = &geometry_[block_index*GEOMETRY_SIZE*LANES];
+    const cemDOUBLE* dksi_dx = &geometry[DKSI_DX*LANES];
+    const cemDOUBLE* dksi_dy = &geometry[DKSI_DY*LANES];
+    const cemDOUBLE* deta_dx = &geometry[DETA_DX*LANES];
+    const cemDOUBLE* deta_dy = &geometry[DETA_DY*LANES];
+    const cemDOUBLE* determinant = &geometry[DETERMINANT*LANES];
+    const cemDOUBLE* alpha = &stiffness_[block_index*m*LANES];
+    const cemDOUBLE* beta = mass_.empty() ? NULL : &mass_[block_index*m*LANES];
+    const cemINT* dofs = &dofs_[block_index*n*LANES];
+    const cemDOUBLE* signs = signs_.empty() ? NULL : &signs_[block_index*n*LANES];
+
+    // Gather (in the orientation of the element):
+    for (cemINT p=0; p<n*LANES; ++p)
+    {
+        x_local[p] = dofs[p] >= 0 ? x[dofs[p]] : 0.0;
+        y_local[p] = 0.0;
+    }
+    if (signs != NULL)
+    {
+        for (cemINT p=0; p<n*LANES; ++p)
+            x_local[p] *= signs[p];
+    }
+
+    const cemDOUBLE* weights = tabulation_->weights();
+    for (cemINT t=0; t<tabulation_->num_points(); ++t)
+    {
+        const cemDOUBLE* N = tabulation_->basis(t);
+        const cemDOUBLE* N_ksi = tabulation_->basis_ksi_deriv(t);
+        const cemDOUBLE* N_eta = tabulation_->basis_eta_deriv(t);
+        const cemDOUBLE* coefficients = tabulation_->coefficients(t);
+
+        // Field and reference gradient at the point:
+        cemDOUBLE u[LANES] = {0.0}, u_ksi[LANES] = {0.0}, u_eta[LANES] = {0.0};
+        for (cemINT i=0; i<n; ++i)
+        {
+            const cemDOUBLE* x_i = &x_local[i*LANES];
+            for (cemINT l=0; l<LANES; ++l)
+            {
+                u_ksi[l] += N_ksi[i]*x_i[l];
+                u_eta[l] += N_eta[i]*x_i[l];
+            }
+            if (beta != NULL)
+            {
+                for (cemINT l=0; l<LANES; ++l)
+                    u[l] += N[i]*x_i[l];
+            }
+        }
+
+        // Coefficients at the point:
+        cemDOUBLE a[LANES] = {0.0}, c[LANES] = {0.0};
+        for (cemINT k=0; k<m; ++k)
+        {
+            for (cemINT l=0; l<LANES; ++l)
+                a[l] += alpha[k*LANES + l]*coefficients[k];
+            if (beta != NULL)
+            {
+                for (cemINT l=0; l<LANES; ++l)
+                    c[l] += beta[k*LANES + l]*coefficients[k];
+            }
+        }
+
+        // Physical flux, mapped back to the reference derivatives:
+        cemDOUBLE f[LANES], f_ksi[LANES], f_eta[LANES];
+        for (cemINT l=0; l<LANES; ++l)
+        {
+            cemDOUBLE w = weights[t]*determinant[l];
+            cemDOUBLE u_x = (dksi_dx[l]*u_ksi[l] + deta_dx[l]*u_eta[l])*w*a[l];
+            cemDOUBLE u_y = (dksi_dy[l]*u_ksi[l] + deta_dy[l]*u_eta[l])*w*a[l];
+            f_ksi[l] = dksi_dx[l]*u_x + dksi_dy[l]*u_y;
+            f_eta[l] = deta_dx[l]*u_x + deta_dy[l]*u_y;
+            f[l] = w*c[l]*u[l];
+        }
+
+        // Test:
+        for (cemINT i=0; i<n; ++i)
+        {
+            cemDOUBLE* y_i = &y_local[i*LANES];
+            for (cemINT l=0; l<LANES; ++l)
+                y_i[l] += N_ksi[i]*f_ksi[l] + N_eta[i]*f_eta[l];
+            if (beta != NULL)
+            {
+                for (cemINT l=0; l<LANES; ++l)
+                    y_i[l] += N[i]*f[l];
+            }
+        }
+    }
+
+    // Back to the global orientation:
+    if (signs != NULL)
+    {
+        for (cemINT p=0; p<n*LANES; ++p)
+            y_local[p] *= signs[p];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::DiagonalBlock : Computes the diagonal of \f$ K_e \f$ for the
+ * triangles of a block.
+ * @param [in] block_index : index of the block
+ * @param [out] d_local : n*LANES entries of the element buffer */
+//************************************************************************************************//
+void TriMatrixFreeOperator::DiagonalBlock(const cemINT& block_index, cemDOUBLE* d_local) const
+{
+    cemINT n = num_basis_functions();
+    cemINT m = num_coefficient_functions();
+    const cemDOUBLE* geometry = &geometry_[block_index*GEOMETRY_SIZE*LANES];
+    const cemDOUBLE* dksi_dx = &geometry[DKSI_DX*LANES];
+    const cemDOUBLE* dksi_dy = &geometry[DKSI_DY*LANES];
+    const cemDOUBLE* deta_dx = &geometry[DETA_DX*LANES];
+    const cemDOUBLE* deta_dy = &geometry[DETA_DY*LANES];
+    const cemDOUBLE* determinant = &geometry[DETERMINANT*LANES];
+    const cemDOUBLE* alpha = &stiffness_[block_index*m*LANES];
+    const cemDOUBLE* beta = mass_.empty() ? NULL : &mass_[block_index*m*LANES];
+
+    for (cemINT p=0; p<n*LANES; ++p)
+        d_local[p] = 0.0;
+
+    const cemDOUBLE* weights = tabulation_->weights();
+    for (cemINT t=0; t<tabulation_->num_points(); ++t)
+    {
+        const cemDOUBLE* N = tabulation_->basis(t);
+        const cemDOUBLE* N_ksi = tabulation_->basis_ksi_deriv(t);
+        const cemDOUBLE* N_eta = tabulation_->basis_eta_deriv(t);
+        const cemDOUBLE* coefficients = tabulation_->coefficients(t);
+
+        cemDOUBLE wa[LANES] = {0.0}, wc[LANES] = {0.0};
+        for (cemINT k=0; k<m; ++k)
+        {
+            for (cemINT l=0; l<LANES; ++l)
+            {
+                wa[l] += alpha[k*LANES + l]*coefficients[k];
+                if (beta != NULL)
+                    wc[l] += beta[k*LANES + l]*coefficients[k];
+            }
+        }
+        for (cemINT l=0; l<LANES; ++l)
+        {
+            wa[l] *= weights[t]*determinant[l];
+            wc[l] *= weights[t]*determinant[l];
+        }
+
+        for (cemINT i=0; i<n; ++i)
+        {
+            cemDOUBLE* d_i = &d_local[i*LANES];
+            for (cemINT l=0; l<LANES; ++l)
+            {
+                cemDOUBLE N_x = dksi_dx[l]*N_ksi[i] + deta_dx[l]*N_eta[i];
+                cemDOUBLE N_y = dksi_dy[l]*N_ksi[i] + deta_dy[l]*N_eta[i];
+                d_i[l] += wa[l]*(N_x*N_x + N_y*N_y) + wc[l]*N[i]*N[i];
+            }
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief TriMatrixFreeOperator::AddElementValues : Adds the element buffer into a global vector.
+ *
+ * Each dof sums its own entries of the buffer, in a fixed order, so threads never write to the
+ * same entry of y.
+ * @param [in,out] y : num_dofs() entries */
+//************************************************************************************************//
+void TriMatrixFreeOperator::AddElementValues(cemDOUBLE* y) const
+{
+    #pragma omp parallel for schedule(static)
+    for (cemINT d=0; d<num_dofs_; ++d)
+    {
+        cemDOUBLE sum = 0.0;
+        for (cemINT p=dof_offsets_[d]; p<dof_offsets_[d+1]; ++p)
+            sum += element_values_[dof_entries_[p]];
+        y[d] += sum;
+    }
+}
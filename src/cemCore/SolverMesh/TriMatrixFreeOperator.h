@@ -0,0 +1,105 @@
+#ifndef TRI_MATRIX_FREE_OPERATOR_H
+#define TRI_MATRIX_FREE_OPERATOR_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "SolverElement.h"
+#include "TriTabulation.h"
+
+using namespace cem_def;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The TriMatrixFreeOperator class : Global operator of a mesh of affine triangles,
+ * applied without storing any element matrix.
+ *
+ * The operator is \f$ K = \sum_e P_e^T K_e P_e \f$, with \f$ K_e = \sum_k \alpha_k^e
+ * N\_GradGrad_k + \sum_k \beta_k^e N\_NN_k \f$ the matrix of element e and \f$ P_e \f$ the map
+ * from its local basis functions to the global degrees of freedom. Apply() computes
+ * \f$ y \mathrel{+}= Kx \f$ element by element: the local values of x are interpolated at the
+ * quadrature points with the shared TriTabulation, multiplied by the geometry factors and the
+ * coefficients, and tested against the basis functions again. Each element only keeps its
+ * inverse Jacobian, its coefficients and its degrees of freedom, so memory grows with the number
+ * of unknowns instead of with the number of elements times \f$ p^4 \f$.
+ *
+ * Triangles are processed in blocks of LANES, with lanes innermost as in TriMatrixBatch, and
+ * blocks are spread over threads when the library is built with OpenMP. Each block writes its
+ * own slice of an element buffer, which is then added into y one degree of freedom at a time,
+ * so threads never write to the same entry and the result does not depend on their number.
+ *
+ * Hierarchical edge functions of odd degree are oriented from the lower to the higher global dof
+ * of their two vertex functions, so neighboring triangles share them whatever their local vertex
+ * order (SolverTriangle does the same with the global order of the nodes).
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class TriMatrixFreeOperator
+{
+public:
+    static const cemINT LANES = 8;  //!< Number of triangles processed together.
+
+    /** @brief The Geometry enum : Position of each geometry factor inside a block. */
+    enum Geometry
+    {
+        DKSI_DX=0,
+        DKSI_DY=1,
+        DETA_DX=2,
+        DETA_DY=3,
+        DETERMINANT=4,
+        GEOMETRY_SIZE=5,    //!< Geometry factors per triangle.
+    };
+
+    // Constructor with parameters:
+    TriMatrixFreeOperator(const cemINT& basis_order,
+                          const cemINT& coefficient_order,
+                          const BasisFunctionType& basis_type = INTERPOLATORY);
+
+    // Get data members:
+    cemINT num_basis_functions() const;
+    cemINT num_coefficient_functions() const;
+    cemINT num_triangles() const;
+    cemINT num_dofs() const;
+
+    // Set up mesh:
+    void SetUp(const cemINT& num_triangles,
+               const cemDOUBLE* x1, const cemDOUBLE* y1,
+               const cemDOUBLE* x2, const cemDOUBLE* y2,
+               const cemDOUBLE* x3, const cemDOUBLE* y3,
+               const cemINT* dofs,
+               const cemDOUBLE* stiffness_coefficients,
+               const cemDOUBLE* mass_coefficients);
+
+    // Operator:
+    void Apply(const cemDOUBLE* x, cemDOUBLE* y) const;
+    void GetDiagonal(cemDOUBLE* diagonal) const;
+
+private:
+    const TriTabulation* tabulation_;           //!< Shared tabulation of the element.
+    cemINT num_triangles_;                      //!< Number of triangles.
+    cemINT num_blocks_;                         //!< Number of blocks of LANES triangles.
+    cemINT num_dofs_;                           //!< Number of global degrees of freedom.
+
+    std::vector<cemDOUBLE> geometry_;           //!< GEOMETRY_SIZE*LANES factors per block.
+    std::vector<cemDOUBLE> stiffness_;          //!< \f$ \alpha_k \f$, m*LANES per block.
+    std::vector<cemDOUBLE> mass_;               //!< \f$ \beta_k \f$, m*LANES per block (or empty).
+    std::vector<cemINT> dofs_;                  //!< Global dofs, n*LANES per block (-1 if unused).
+    std::vector<cemDOUBLE> signs_;              //!< Edge orientation, n*LANES per block (or empty).
+    std::vector<cemINT> dof_offsets_;           //!< First entry of each dof in dof_entries_.
+    std::vector<cemINT> dof_entries_;           //!< Positions in the element buffer of each dof.
+    mutable std::vector<cemDOUBLE> element_values_; //!< Local results, n*LANES per block.
+
+    // Private member functions:
+    void ApplyBlock(const cemINT& block_index,
+                    const cemDOUBLE* x,
+                    cemDOUBLE* x_local,
+                    cemDOUBLE* y_local) const;
+    void DiagonalBlock(const cemINT& block_index, cemDOUBLE* d_local) const;
+    void AddElementValues(cemDOUBLE* y) const;
+    TriMatrixFreeOperator(); // Only parameterized constructor can be used.
+};
+
+
+}
+
+
+#endif // TRI_MATRIX_FREE_OPERATOR_H
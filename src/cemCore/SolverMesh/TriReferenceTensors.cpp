@@ -0,0 +1,247 @@
+#include "TriReferenceTensors.h"
+#include "TriTabulation.h"
+#include "cemError.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+
+///***********************************************************************************************//
+/// CLASS TriReferenceTensors:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::TriReferenceTensors : Constructor with parameters.
+ *
+ * Integrates all reference tensors on the unit triangle. This is done once per pair of orders;
+ * use TriReferenceTensors::Get() to share the result among all elements.
+ * @param [in] basis_order : polynomial order of basis functions (>= 1)
+ * @param [in] coefficient_order : polynomial order of coefficient functions (>= 0) */
+//************************************************************************************************//
+TriReferenceTensors::TriReferenceTensors(const cemINT& basis_order,
+                                         const cemINT& coefficient_order)
+{
+    if (basis_order < 1)
+        throw(Exception("INPUT ERROR","basis_order must be > 0"));
+
+    if (coefficient_order < 0)
+        throw(Exception("INPUT ERROR","coefficient_order must be >= 0"));
+
+    basis_order_ = basis_order;
+    coefficient_order_ = coefficient_order;
+    num_basis_functions_ = (basis_order_+1)*(basis_order_+2)/2;
+    num_coefficient_functions_ = (coefficient_order_+1)*(coefficient_order_+2)/2;
+    num_packed_entries_ = num_basis_functions_*(num_basis_functions_+1)/2;
+
+    Integrate();
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::Get : Gets the shared reference tensors for a pair of orders.
+ *
+ * Tensors are integrated the first time a pair of orders is requested and kept for the rest of
+ * the run. Thread-safe, in the same way as TriTabulation::Get().
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions
+ * @return : Reference tensors for (basis_order,coefficient_order) */
+//************************************************************************************************//
+const TriReferenceTensors& TriReferenceTensors::Get(const cemINT& basis_order,
+                                                    const cemINT& coefficient_order)
+{
+    static std::map< std::pair<cemINT,cemINT>,TriReferenceTensors > cache;
+
+    std::pair<cemINT,cemINT> key(basis_order,coefficient_order);
+    const TriReferenceTensors* found = NULL;
+    #pragma omp critical(TriReferenceTensors_cache)
+    {
+        std::map< std::pair<cemINT,cemINT>,TriReferenceTensors >::iterator it = cache.find(key);
+        if (it != cache.end())
+            found = &it->second;
+    }
+    if (found != NULL)
+        return *found;
+
+    TriReferenceTensors tensors(basis_order,coefficient_order);
+    #pragma omp critical(TriReferenceTensors_cache)
+    found = &cache.insert(std::make_pair(key,tensors)).first->second;
+
+    return *found;
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::basis_order : Gets polynomial order of basis functions.
+ * @return : basis_order_ */
+//************************************************************************************************//
+cemINT TriReferenceTensors::basis_order() const {return basis_order_;}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::coefficient_order : Gets polynomial order of coefficients.
+ * @return : coefficient_order_ */
+//************************************************************************************************//
+cemINT TriReferenceTensors::coefficient_order() const {return coefficient_order_;}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::num_basis_functions : Gets number of basis functions (rows).
+ * @return : num_basis_functions_ */
+//************************************************************************************************//
+cemINT TriReferenceTensors::num_basis_functions() const {return num_basis_functions_;}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::num_coefficient_functions : Gets number of coefficient functions.
+ * @return : num_coefficient_functions_ */
+//************************************************************************************************//
+cemINT TriReferenceTensors::num_coefficient_functions() const {return num_coefficient_functions_;}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::num_packed_entries : Gets number of stored entries per tensor.
+ * @return : num_packed_entries_ */
+//************************************************************************************************//
+cemINT TriReferenceTensors::num_packed_entries() const {return num_packed_entries_;}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::tensor_ksi_ksi : Gets tensor \f$ A_k \f$.
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @return : pointer to the first (packed) entry of \f$ A_k \f$ */
+//************************************************************************************************//
+const cemDOUBLE* TriReferenceTensors::tensor_ksi_ksi(const cemINT& coefficient_index) const
+{
+    return &ksi_ksi_[coefficient_index*num_packed_entries_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::tensor_ksi_eta : Gets (symmetrized) tensor \f$ B_k \f$.
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @return : pointer to the first (packed) entry of \f$ B_k \f$ */
+//************************************************************************************************//
+const cemDOUBLE* TriReferenceTensors::tensor_ksi_eta(const cemINT& coefficient_index) const
+{
+    return &ksi_eta_[coefficient_index*num_packed_entries_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::tensor_eta_eta : Gets tensor \f$ C_k \f$.
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @return : pointer to the first (packed) entry of \f$ C_k \f$ */
+//************************************************************************************************//
+const cemDOUBLE* TriReferenceTensors::tensor_eta_eta(const cemINT& coefficient_index) const
+{
+    return &eta_eta_[coefficient_index*num_packed_entries_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::tensor_mass : Gets tensor \f$ M_k \f$.
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @return : pointer to the first (packed) entry of \f$ M_k \f$ */
+//************************************************************************************************//
+const cemDOUBLE* TriReferenceTensors::tensor_mass(const cemINT& coefficient_index) const
+{
+    return &mass_[coefficient_index*num_packed_entries_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::Compute_N_NdNd_matrix : Contracts the derivative tensors with the
+ * geometry factors of a triangle.
+ *
+ * Computes \f$ (d_1^2 A_k + d_1 d_2 B_k + d_2^2 C_k)/2\Delta \f$. With \f$ d = b \f$ this is the
+ * k-th N_NxNx matrix, and with \f$ d = c \f$ the k-th N_NyNy matrix.
+ * @param [in] d1 : \f$ b_1 \f$ or \f$ c_1 \f$ of the triangle
+ * @param [in] d2 : \f$ b_2 \f$ or \f$ c_2 \f$ of the triangle
+ * @param [in] delta : (signed) area of the triangle
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @param [out] matrix : num_packed_entries() entries, packed as in SymmetricMatrix */
+//************************************************************************************************//
+void TriReferenceTensors::Compute_N_NdNd_matrix(const cemDOUBLE& d1,
+                                                const cemDOUBLE& d2,
+                                                const cemDOUBLE& delta,
+                                                const cemINT& coefficient_index,
+                                                cemDOUBLE* matrix) const
+{
+    const cemDOUBLE inverse_two_delta = 0.5/delta;
+    const cemDOUBLE g_ksi_ksi = d1*d1*inverse_two_delta;
+    const cemDOUBLE g_ksi_eta = d1*d2*inverse_two_delta;
+    const cemDOUBLE g_eta_eta = d2*d2*inverse_two_delta;
+
+    const cemDOUBLE* A = tensor_ksi_ksi(coefficient_index);
+    const cemDOUBLE* B = tensor_ksi_eta(coefficient_index);
+    const cemDOUBLE* C = tensor_eta_eta(coefficient_index);
+
+    for (cemINT m=0; m<num_packed_entries_; ++m)
+        matrix[m] = g_ksi_ksi*A[m] + g_ksi_eta*B[m] + g_eta_eta*C[m];
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::Compute_N_NN_matrix : Scales the mass tensor with the area of a
+ * triangle.
+ *
+ * Computes \f$ 2\Delta M_k \f$, which is the k-th N_NN matrix.
+ * @param [in] delta : (signed) area of the triangle
+ * @param [in] coefficient_index : index k of the coefficient function
+ * @param [out] matrix : num_packed_entries() entries, packed as in SymmetricMatrix */
+//************************************************************************************************//
+void TriReferenceTensors::Compute_N_NN_matrix(const cemDOUBLE& delta,
+                                              const cemINT& coefficient_index,
+                                              cemDOUBLE* matrix) const
+{
+    const cemDOUBLE two_delta = 2.0*delta;
+    const cemDOUBLE* M = tensor_mass(coefficient_index);
+
+    for (cemINT m=0; m<num_packed_entries_; ++m)
+        matrix[m] = two_delta*M[m];
+}
+
+
+//************************************************************************************************//
+/** @brief TriReferenceTensors::Integrate : Integrates all reference tensors on the unit triangle.
+ *
+ * The integrands are polynomials of order 2p+q, so the quadrature rule of TriTabulation, which
+ * is exact up to that order, gives the tensors exactly (up to round-off). */
+//************************************************************************************************//
+void TriReferenceTensors::Integrate()
+{
+    // Basis and coefficient functions at quadrature points:
+    const TriTabulation& tabulation = TriTabulation::Get(basis_order_,coefficient_order_);
+    cemINT num_points = tabulation.num_points();
+    const cemDOUBLE* weights = tabulation.weights();
+
+    // Integrate lower triangles only:
+    cemINT n = num_basis_functions_;
+    cemINT num_coefficients = num_coefficient_functions_;
+    ksi_ksi_.assign(num_coefficients*num_packed_entries_,0.0);
+    ksi_eta_.assign(num_coefficients*num_packed_entries_,0.0);
+    eta_eta_.assign(num_coefficients*num_packed_entries_,0.0);
+    mass_.assign(num_coefficients*num_packed_entries_,0.0);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        const cemDOUBLE* N = tabulation.basis(t);
+        const cemDOUBLE* N_ksi = tabulation.basis_ksi_deriv(t);
+        const cemDOUBLE* N_eta = tabulation.basis_eta_deriv(t);
+        const cemDOUBLE* coefficients = tabulation.coefficients(t);
+        for (cemINT k=0; k<num_coefficients; ++k)
+        {
+            cemINT m = k*num_packed_entries_;
+            cemDOUBLE w = weights[t]*coefficients[k];
+            for (cemINT j=0; j<n; ++j)
+            {
+                for (cemINT i=j; i<n; ++i, ++m)
+                {
+                    ksi_ksi_[m] += w*N_ksi[i]*N_ksi[j];
+                    ksi_eta_[m] += w*(N_ksi[i]*N_eta[j] + N_eta[i]*N_ksi[j]);
+                    eta_eta_[m] += w*N_eta[i]*N_eta[j];
+                    mass_[m] += w*N[i]*N[j];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef TRI_REFERENCE_TENSORS_H
+#define TRI_REFERENCE_TENSORS_H
+
+#include <map>
+#include <vector>
+#include "cemTypes.h"
+
+using namespace cem_def;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The TriReferenceTensors class : Reference-element matrices of an affine triangle.
+ *
+ * For a flat triangle with straight sides the derivatives of the reference coordinates are
+ * constant: \f$ \partial\xi/\partial x = b_1/2\Delta \f$, \f$ \partial\eta/\partial x = b_2/2\Delta
+ * \f$, \f$ \partial\xi/\partial y = c_1/2\Delta \f$ and \f$ \partial\eta/\partial y = c_2/2\Delta
+ * \f$. Every element matrix is therefore a fixed linear combination of four reference tensors,
+ * computed once on the unit triangle for each coefficient function \f$ \beta_k \f$:
+ *
+ * \f$ A_k = \iint \beta_k N_{i,\xi} N_{j,\xi} \f$,
+ * \f$ B_k = \iint \beta_k (N_{i,\xi} N_{j,\eta} + N_{i,\eta} N_{j,\xi}) \f$,
+ * \f$ C_k = \iint \beta_k N_{i,\eta} N_{j,\eta} \f$ and
+ * \f$ M_k = \iint \beta_k N_{i} N_{j} \f$,
+ *
+ * so that \f$ N\_NxNx_k = (b_1^2 A_k + b_1 b_2 B_k + b_2^2 C_k)/2\Delta \f$, N_NyNy_k is the same
+ * expression with \f$ c_1,c_2 \f$, and \f$ N\_NN_k = 2\Delta M_k \f$.
+ *
+ * The tensors are symmetric, so only their lower triangle is stored, packed column-wise as in
+ * SymmetricMatrix: n(n+1)/2 entries per coefficient function.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class TriReferenceTensors
+{
+public:
+    // Constructor with parameters:
+    TriReferenceTensors(const cemINT& basis_order, const cemINT& coefficient_order);
+
+    // Shared instance for a given pair of orders:
+    static const TriReferenceTensors& Get(const cemINT& basis_order,
+                                          const cemINT& coefficient_order);
+
+    // Get data members:
+    cemINT basis_order() const;
+    cemINT coefficient_order() const;
+    cemINT num_basis_functions() const;
+    cemINT num_coefficient_functions() const;
+    cemINT num_packed_entries() const;
+
+    const cemDOUBLE* tensor_ksi_ksi(const cemINT& coefficient_index) const;
+    const cemDOUBLE* tensor_ksi_eta(const cemINT& coefficient_index) const;
+    const cemDOUBLE* tensor_eta_eta(const cemINT& coefficient_index) const;
+    const cemDOUBLE* tensor_mass(const cemINT& coefficient_index) const;
+
+    // Contraction with the geometry factors:
+    void Compute_N_NdNd_matrix(const cemDOUBLE& d1,
+                               const cemDOUBLE& d2,
+                               const cemDOUBLE& delta,
+                               const cemINT& coefficient_index,
+                               cemDOUBLE* matrix) const;
+
+    void Compute_N_NN_matrix(const cemDOUBLE& delta,
+                             const cemINT& coefficient_index,
+                             cemDOUBLE* matrix) const;
+
+private:
+    cemINT basis_order_;                    //!< Polynomial order of the basis functions.
+    cemINT coefficient_order_;              //!< Polynomial order of the coefficient functions.
+    cemINT num_basis_functions_;            //!< (p+1)(p+2)/2
+    cemINT num_coefficient_functions_;      //!< (q+1)(q+2)/2
+    cemINT num_packed_entries_;             //!< n(n+1)/2 stored entries per tensor.
+
+    std::vector<cemDOUBLE> ksi_ksi_;        //!< Tensor \f$ A_k \f$ for all k.
+    std::vector<cemDOUBLE> ksi_eta_;        //!< Tensor \f$ B_k \f$ (symmetrized) for all k.
+    std::vector<cemDOUBLE> eta_eta_;        //!< Tensor \f$ C_k \f$ for all k.
+    std::vector<cemDOUBLE> mass_;           //!< Tensor \f$ M_k \f$ for all k.
+
+    // Private member functions:
+    void Integrate();
+    TriReferenceTensors(); // Only parameterized constructor can be used.
+};
+
+
+}
+
+
+#endif // TRI_REFERENCE_TENSORS_H
@@ -0,0 +1,308 @@
+#include "TriTabulation.h"
+#include "SolverElement.h"
+#include "cemError.h"
+#include "cemUtils.h"
+#include "Quadrature/Quadrature.h"
+#include "BasisFunctions/BasisFunctions.h"
+
+using namespace cem_core;
+using cemcommon::Exception;
+
+
+///***********************************************************************************************//
+/// CLASS TriTabulation:
+///***********************************************************************************************//
+const cemINT TriTabulation::GEOMETRY_ORDER;
+const cemINT TriTabulation::NUM_GEOMETRY_FUNCTIONS;
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::TriTabulation : Constructor with parameters.
+ *
+ * Evaluates all basis functions, their derivatives and all coefficient functions at the
+ * quadrature points. Use TriTabulation::Get() to share the result among all elements.
+ * @param [in] basis_order : polynomial order of basis functions (>= 1)
+ * @param [in] coefficient_order : polynomial order of coefficient functions (>= 0)
+ * @param [in] extra_order : order added to the quadrature rule (>= 0)
+ * @param [in] basis_type : INTERPOLATORY or HIERARCHICAL basis functions */
+//************************************************************************************************//
+TriTabulation::TriTabulation(const cemINT& basis_order,
+                             const cemINT& coefficient_order,
+                             const cemINT& extra_order,
+                             const BasisFunctionType& basis_type)
+{
+    if (basis_order < 1)
+        throw(Exception("INPUT ERROR","basis_order must be > 0"));
+
+    if (coefficient_order < 0)
+        throw(Exception("INPUT ERROR","coefficient_order must be >= 0"));
+
+    if (extra_order < 0)
+        throw(Exception("INPUT ERROR","extra_order must be >= 0"));
+
+    basis_order_ = basis_order;
+    coefficient_order_ = coefficient_order;
+    extra_order_ = extra_order;
+    basis_type_ = basis_type;
+    num_basis_functions_ = (basis_order_+1)*(basis_order_+2)/2;
+    num_coefficient_functions_ = (coefficient_order_+1)*(coefficient_order_+2)/2;
+
+    Tabulate();
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::Get : Gets the shared tabulation for a set of orders.
+ *
+ * Functions are tabulated the first time a set of orders is requested and kept for the rest of
+ * the run. Thread-safe: the cache is only read and written inside a critical section, and the
+ * tabulation itself is computed outside of it (if two threads compute the same set, the first
+ * one inserted is kept).
+ * @param [in] basis_order : polynomial order of basis functions
+ * @param [in] coefficient_order : polynomial order of coefficient functions
+ * @param [in] extra_order : order added to the quadrature rule
+ * @param [in] basis_type : INTERPOLATORY or HIERARCHICAL basis functions
+ * @return : Tabulation for (basis_order,coefficient_order,extra_order,basis_type) */
+//************************************************************************************************//
+const TriTabulation& TriTabulation::Get(const cemINT& basis_order,
+                                        const cemINT& coefficient_order,
+                                        const cemINT& extra_order,
+                                        const BasisFunctionType& basis_type)
+{
+    typedef std::pair< std::pair<cemINT,cemINT>,std::pair<cemINT,cemINT> > Key;
+    static std::map< Key,TriTabulation > cache;
+
+    Key key(std::make_pair(basis_order,coefficient_order),
+            std::make_pair(extra_order,static_cast<cemINT>(basis_type)));
+    const TriTabulation* found = NULL;
+    #pragma omp critical(TriTabulation_cache)
+    {
+        std::map< Key,TriTabulation >::iterator it = cache.find(key);
+        if (it != cache.end())
+            found = &it->second;
+    }
+    if (found != NULL)
+        return *found;
+
+    TriTabulation tabulation(basis_order,coefficient_order,extra_order,basis_type);
+    #pragma omp critical(TriTabulation_cache)
+    found = &cache.insert(std::make_pair(key,tabulation)).first->second;
+
+    return *found;
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::basis_order : Gets polynomial order of basis functions.
+ * @return : basis_order_ */
+//************************************************************************************************//
+cemINT TriTabulation::basis_order() const {return basis_order_;}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::coefficient_order : Gets polynomial order of coefficients.
+ * @return : coefficient_order_ */
+//************************************************************************************************//
+cemINT TriTabulation::coefficient_order() const {return coefficient_order_;}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::extra_order : Gets order actually added to the quadrature rule, which is
+ * less than the one requested when 2p+q plus the requested order is above the highest rule.
+ * @return : extra_order_ */
+//************************************************************************************************//
+cemINT TriTabulation::extra_order() const {return extra_order_;}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::basis_type : Gets type of the basis functions.
+ * @return : basis_type_ */
+//************************************************************************************************//
+BasisFunctionType TriTabulation::basis_type() const {return basis_type_;}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::num_basis_functions : Gets number of basis functions.
+ * @return : num_basis_functions_ */
+//************************************************************************************************//
+cemINT TriTabulation::num_basis_functions() const {return num_basis_functions_;}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::num_coefficient_functions : Gets number of coefficient functions.
+ * @return : num_coefficient_functions_ */
+//************************************************************************************************//
+cemINT TriTabulation::num_coefficient_functions() const {return num_coefficient_functions_;}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::num_points : Gets number of quadrature points.
+ * @return : num_points_ */
+//************************************************************************************************//
+cemINT TriTabulation::num_points() const {return num_points_;}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::ksi : Gets \f$ \xi \f$ coordinates of the quadrature points.
+ * @return : pointer to num_points() coordinates */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::ksi() const {return &ksi_[0];}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::eta : Gets \f$ \eta \f$ coordinates of the quadrature points.
+ * @return : pointer to num_points() coordinates */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::eta() const {return &eta_[0];}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::weights : Gets quadrature weights.
+ * @return : pointer to num_points() weights */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::weights() const {return &weights_[0];}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::basis : Gets all basis functions at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_basis_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::basis(const cemINT& point_index) const
+{
+    return &basis_[point_index*num_basis_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::basis_ksi_deriv : Gets \f$ \xi \f$-derivatives of all basis functions at
+ * a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_basis_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::basis_ksi_deriv(const cemINT& point_index) const
+{
+    return &basis_ksi_[point_index*num_basis_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::basis_eta_deriv : Gets \f$ \eta \f$-derivatives of all basis functions
+ * at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_basis_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::basis_eta_deriv(const cemINT& point_index) const
+{
+    return &basis_eta_[point_index*num_basis_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::coefficients : Gets all coefficient functions at a quadrature point.
+ * @param [in] point_index : index of the quadrature point
+ * @return : pointer to num_coefficient_functions() values */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::coefficients(const cemINT& point_index) const
+{
+    return &coefficients_[point_index*num_coefficient_functions_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::geometry_ksi_deriv : Gets \f$ \xi \f$-derivative of a geometry function.
+ * @param [in] function_index : index of the node (0 to NUM_GEOMETRY_FUNCTIONS-1)
+ * @return : pointer to num_points() values */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::geometry_ksi_deriv(const cemINT& function_index) const
+{
+    return &geometry_ksi_[function_index*num_points_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::geometry_eta_deriv : Gets \f$ \eta \f$-derivative of a geometry function.
+ * @param [in] function_index : index of the node (0 to NUM_GEOMETRY_FUNCTIONS-1)
+ * @return : pointer to num_points() values */
+//************************************************************************************************//
+const cemDOUBLE* TriTabulation::geometry_eta_deriv(const cemINT& function_index) const
+{
+    return &geometry_eta_[function_index*num_points_];
+}
+
+
+//************************************************************************************************//
+/** @brief TriTabulation::Tabulate : Evaluates all functions at the quadrature points. */
+//************************************************************************************************//
+void TriTabulation::Tabulate()
+{
+    // Get quadrature:
+    TriQuadrature quadrature;
+    cemINT poly_order = coefficient_order_ + 2*basis_order_;
+    if (poly_order > quadrature.getMaxPolyOrder())
+        throw(Exception("FEATURE NOT IMPLEMENTED","No quadrature rule of order " +
+                        cem_utils::NumberToString<cemINT>(poly_order)));
+
+    // Extra order is clamped to the highest rule; extra_order() reports the order applied:
+    if (poly_order + extra_order_ > quadrature.getMaxPolyOrder())
+        extra_order_ = quadrature.getMaxPolyOrder() - poly_order;
+    poly_order += extra_order_;
+
+    num_points_ = quadrature.getNumPointsForPolyOrder(poly_order);
+    ksi_ = quadrature.getKsiCoordinates(num_points_);
+    eta_ = quadrature.getEtaCoordinates(num_points_);
+    weights_ = quadrature.getWeights(num_points_);
+
+    // Basis functions and their derivatives:
+    cemINT n = num_basis_functions_;
+    basis_.resize(num_points_*n);
+    basis_ksi_.resize(num_points_*n);
+    basis_eta_.resize(num_points_*n);
+    TriShapeFunction shape_function(basis_order_);
+    std::vector<cemDOUBLE> values(num_points_),ksi_derivs(num_points_),eta_derivs(num_points_);
+    cemINT index_i,index_j,index_k;
+    for (cemINT i=0; i<n; ++i)
+    {
+        if (basis_type_ == HIERARCHICAL)
+        {
+            TriHierarchicalShapeFunction::EvaluateBatch(i,num_points_,&ksi_[0],&eta_[0],
+                                                        &values[0],&ksi_derivs[0],&eta_derivs[0]);
+        }
+        else
+        {
+            SolverTriangle::GetShapeFunctionIndices(basis_order_,i,index_i,index_j,index_k);
+            shape_function.EvaluateBatch(index_i,index_j,index_k,num_points_,&ksi_[0],&eta_[0],
+                                         &values[0],&ksi_derivs[0],&eta_derivs[0]);
+        }
+        for (cemINT t=0; t<num_points_; ++t)
+        {
+            basis_[t*n + i] = values[t];
+            basis_ksi_[t*n + i] = ksi_derivs[t];
+            basis_eta_[t*n + i] = eta_derivs[t];
+        }
+    }
+
+    // Coefficient functions:
+    cemINT m = num_coefficient_functions_;
+    coefficients_.resize(num_points_*m);
+    shape_function.set_order(coefficient_order_);
+    for (cemINT k=0; k<m; ++k)
+    {
+        SolverTriangle::GetShapeFunctionIndices(coefficient_order_,k,index_i,index_j,index_k);
+        shape_function.EvaluateBatch(index_i,index_j,index_k,num_points_,&ksi_[0],&eta_[0],
+                                     &values[0],NULL,NULL);
+        for (cemINT t=0; t<num_points_; ++t)
+            coefficients_[t*m + k] = values[t];
+    }
+
+    // Geometry functions (function by function):
+    geometry_ksi_.resize(NUM_GEOMETRY_FUNCTIONS*num_points_);
+    geometry_eta_.resize(NUM_GEOMETRY_FUNCTIONS*num_points_);
+    shape_function.set_order(GEOMETRY_ORDER);
+    for (cemINT a=0; a<NUM_GEOMETRY_FUNCTIONS; ++a)
+    {
+        SolverTriangle::GetShapeFunctionIndices(GEOMETRY_ORDER,a,index_i,index_j,index_k);
+        shape_function.EvaluateBatch(index_i,index_j,index_k,num_points_,&ksi_[0],&eta_[0],NULL,
+                                     &geometry_ksi_[a*num_points_],&geometry_eta_[a*num_points_]);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef TRI_TABULATION_H
+#define TRI_TABULATION_H
+
+#include <map>
+#include <vector>
+#include "cemTypes.h"
+#include "SolverElement.h"
+
+using namespace cem_def;
+
+namespace cem_core {
+
+//************************************************************************************************//
+/** @brief The TriTabulation class : Basis and coefficient functions tabulated at the quadrature
+ * points of the reference triangle.
+ *
+ * The quadrature rule integrates polynomials of order 2p+q exactly, which is what every element
+ * matrix of a flat triangle needs. Values are stored point by point, so the functions needed at
+ * one quadrature point are contiguous: the i-th basis function at point t is found at t*n + i, and
+ * the k-th coefficient function at t*m + k, with n = (p+1)(p+2)/2 and m = (q+1)(q+2)/2.
+ *
+ * Curvilinear triangles need a few more points, since their integrands are no longer
+ * polynomials: extra_order raises the order of the rule as far as the rules available allow. It
+ * is clamped so that 2p+q+extra_order does not exceed the highest rule, and extra_order() returns
+ * the order actually applied (Get() still caches the tabulation under the requested one).
+ * The derivatives of the NUM_GEOMETRY_FUNCTIONS second-order geometry (node) functions are also
+ * tabulated, function by function, so that Jacobians can be built with loops over points.
+ *
+ * Basis functions are either interpolatory (Silvester) or hierarchical
+ * (TriHierarchicalShapeFunction). Coefficient and geometry functions are always interpolatory.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class TriTabulation
+{
+public:
+    static const cemINT GEOMETRY_ORDER = 2;             //!< Order of the geometry functions.
+    static const cemINT NUM_GEOMETRY_FUNCTIONS = 6;     //!< Nodes of a second-order triangle.
+
+    // Constructor with parameters:
+    TriTabulation(const cemINT& basis_order,
+                  const cemINT& coefficient_order,
+                  const cemINT& extra_order = 0,
+                  const BasisFunctionType& basis_type = INTERPOLATORY);
+
+    // Shared instance for a given set of orders:
+    static const TriTabulation& Get(const cemINT& basis_order,
+                                    const cemINT& coefficient_order,
+                                    const cemINT& extra_order = 0,
+                                    const BasisFunctionType& basis_type = INTERPOLATORY);
+
+    // Get data members:
+    cemINT basis_order() const;
+    cemINT coefficient_order() const;
+    cemINT extra_order() const;
+    BasisFunctionType basis_type() const;
+    cemINT num_basis_functions() const;
+    cemINT num_coefficient_functions() const;
+    cemINT num_points() const;
+
+    const cemDOUBLE* ksi() const;
+    const cemDOUBLE* eta() const;
+    const cemDOUBLE* weights() const;
+    const cemDOUBLE* basis(const cemINT& point_index) const;
+    const cemDOUBLE* basis_ksi_deriv(const cemINT& point_index) const;
+    const cemDOUBLE* basis_eta_deriv(const cemINT& point_index) const;
+    const cemDOUBLE* coefficients(const cemINT& point_index) const;
+    const cemDOUBLE* geometry_ksi_deriv(const cemINT& function_index) const;
+    const cemDOUBLE* geometry_eta_deriv(const cemINT& function_index) const;
+
+private:
+    cemINT basis_order_;                    //!< Polynomial order of the basis functions.
+    cemINT coefficient_order_;              //!< Polynomial order of the coefficient functions.
+    cemINT extra_order_;                    //!< Order added to the quadrature rule (applied).
+    BasisFunctionType basis_type_;          //!< Interpolatory or hierarchical basis functions.
+    cemINT num_basis_functions_;            //!< (p+1)(p+2)/2
+    cemINT num_coefficient_functions_;      //!< (q+1)(q+2)/2
+    cemINT num_points_;                     //!< Number of quadrature points.
+
+    std::vector<cemDOUBLE> ksi_;            //!< \f$ \xi \f$ coordinate of quadrature points.
+    std::vector<cemDOUBLE> eta_;            //!< \f$ \eta \f$ coordinate of quadrature points.
+    std::vector<cemDOUBLE> weights_;        //!< Quadrature weights.
+    std::vector<cemDOUBLE> basis_;          //!< Basis functions at all points.
+    std::vector<cemDOUBLE> basis_ksi_;      //!< \f$ \xi \f$-derivative of basis functions.
+    std::vector<cemDOUBLE> basis_eta_;      //!< \f$ \eta \f$-derivative of basis functions.
+    std::vector<cemDOUBLE> coefficients_;   //!< Coefficient functions at all points.
+    std::vector<cemDOUBLE> geometry_ksi_;   //!< \f$ \xi \f$-derivative of geometry functions.
+    std::vector<cemDOUBLE> geometry_eta_;   //!< \f$ \eta \f$-derivative of geometry functions.
+
+    // Private member functions:
+    void Tabulate();
+    TriTabulation(); // Only parameterized constructor can be used.
+};
+
+
+}
+
+
+#endif // TRI_TABULATION_H
@@ -0,0 +1,305 @@
+#include "BlasLevel3.h"
+#include <mkl.h>
+
+using namespace cem_math;
+
+
+//************************************************************************************************//
+/** @brief MKL_MatrixTimesMatrixTransposed : Product of a double precision matrix and the
+ * transpose of another. Computes \f$ C = AB^T \f$ (dgemm).
+ * @param [in] M : rows of A and C
+ * @param [in] N : rows of B, columns of C
+ * @param [in] K : columns of A and B
+ * @param [in] A : column-major M x K matrix
+ * @param [in] lda : leading dimension of A
+ * @param [in] B : column-major N x K matrix
+ * @param [in] ldb : leading dimension of B
+ * @param [out] C : column-major M x N matrix
+ * @param [in] ldc : leading dimension of C */
+//************************************************************************************************//
+void cem_math::MKL_MatrixTimesMatrixTransposed(const cemINT M, const cemINT N, const cemINT K,
+                                               const cemDOUBLE* A, const cemINT lda,
+                                               const cemDOUBLE* B, const cemINT ldb,
+                                               cemDOUBLE* C, const cemINT ldc)
+{
+    cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, M, N, K, 1.0, A, lda, B, ldb,
+                0.0, C, ldc);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_MatrixTimesMatrixTransposed : Product of a single precision matrix and the
+ * transpose of another. Computes \f$ C = AB^T \f$ (sgemm).
+ * @param [in] M : rows of A and C
+ * @param [in] N : rows of B, columns of C
+ * @param [in] K : columns of A and B
+ * @param [in] A : column-major M x K matrix
+ * @param [in] lda : leading dimension of A
+ * @param [in] B : column-major N x K matrix
+ * @param [in] ldb : leading dimension of B
+ * @param [out] C : column-major M x N matrix
+ * @param [in] ldc : leading dimension of C */
+//************************************************************************************************//
+void cem_math::MKL_MatrixTimesMatrixTransposed(const cemINT M, const cemINT N, const cemINT K,
+                                               const cemFLOAT* A, const cemINT lda,
+                                               const cemFLOAT* B, const cemINT ldb,
+                                               cemFLOAT* C, const cemINT ldc)
+{
+    cblas_sgemm(CblasColMajor, CblasNoTrans, CblasTrans, M, N, K, 1.0f, A, lda, B, ldb,
+                0.0f, C, ldc);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_MatrixMultiply : General product of double precision matrices.
+ * Computes \f$ C = \alpha\, op(A) B + \beta C \f$ with \f$ op(A) = A \f$ or \f$ A^T \f$ (dgemm).
+ * @param [in] transpose_a : true to use \f$ A^T \f$
+ * @param [in] M : rows of op(A) and C
+ * @param [in] N : columns of B and C
+ * @param [in] K : columns of op(A), rows of B
+ * @param [in] alpha : scalar
+ * @param [in] A : column-major matrix (M x K, or K x M if transposed)
+ * @param [in] lda : leading dimension of A
+ * @param [in] B : column-major K x N matrix
+ * @param [in] ldb : leading dimension of B
+ * @param [in] beta : scalar
+ * @param [in,out] C : column-major M x N matrix
+ * @param [in] ldc : leading dimension of C */
+//************************************************************************************************//
+void cem_math::MKL_MatrixMultiply(const cemBOOL transpose_a,
+                                  const cemINT M, const cemINT N, const cemINT K,
+                                  const cemDOUBLE alpha, const cemDOUBLE* A, const cemINT lda,
+                                  const cemDOUBLE* B, const cemINT ldb,
+                                  const cemDOUBLE beta, cemDOUBLE* C, const cemINT ldc)
+{
+    cblas_dgemm(CblasColMajor, transpose_a ? CblasTrans : CblasNoTrans, CblasNoTrans, M, N, K,
+                alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_MatrixMultiply : General product of single precision matrices.
+ * Computes \f$ C = \alpha\, op(A) B + \beta C \f$ with \f$ op(A) = A \f$ or \f$ A^T \f$ (sgemm).
+ * @param [in] transpose_a : true to use \f$ A^T \f$
+ * @param [in] M : rows of op(A) and C
+ * @param [in] N : columns of B and C
+ * @param [in] K : columns of op(A), rows of B
+ * @param [in] alpha : scalar
+ * @param [in] A : column-major matrix (M x K, or K x M if transposed)
+ * @param [in] lda : leading dimension of A
+ * @param [in] B : column-major K x N matrix
+ * @param [in] ldb : leading dimension of B
+ * @param [in] beta : scalar
+ * @param [in,out] C : column-major M x N matrix
+ * @param [in] ldc : leading dimension of C */
+//************************************************************************************************//
+void cem_math::MKL_MatrixMultiply(const cemBOOL transpose_a,
+                                  const cemINT M, const cemINT N, const cemINT K,
+                                  const cemFLOAT alpha, const cemFLOAT* A, const cemINT lda,
+                                  const cemFLOAT* B, const cemINT ldb,
+                                  const cemFLOAT beta, cemFLOAT* C, const cemINT ldc)
+{
+    cblas_sgemm(CblasColMajor, transpose_a ? CblasTrans : CblasNoTrans, CblasNoTrans, M, N, K,
+                alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_CholeskyFactorization : Cholesky factorization of a symmetric positive definite
+ * double precision matrix. Computes \f$ A = LL^T \f$ in the lower triangle of A (dpotrf).
+ * @param [in] N : rows and columns of A
+ * @param [in,out] A : column-major matrix (lower triangle used), L on exit
+ * @param [in] lda : leading dimension of A
+ * @return : 0 on success, k > 0 if the leading minor of order k is not positive definite */
+//************************************************************************************************//
+cemINT cem_math::MKL_CholeskyFactorization(const cemINT N, cemDOUBLE* A, const cemINT lda)
+{
+    char uplo = 'L';
+    cemINT n = N;
+    cemINT ld = lda;
+    cemINT info = 0;
+
+    dpotrf_(&uplo, &n, A, &ld, &info);
+    return info;
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_CholeskyFactorization : Cholesky factorization of a symmetric positive definite
+ * single precision matrix. Computes \f$ A = LL^T \f$ in the lower triangle of A (spotrf).
+ * @param [in] N : rows and columns of A
+ * @param [in,out] A : column-major matrix (lower triangle used), L on exit
+ * @param [in] lda : leading dimension of A
+ * @return : 0 on success, k > 0 if the leading minor of order k is not positive definite */
+//************************************************************************************************//
+cemINT cem_math::MKL_CholeskyFactorization(const cemINT N, cemFLOAT* A, const cemINT lda)
+{
+    char uplo = 'L';
+    cemINT n = N;
+    cemINT ld = lda;
+    cemINT info = 0;
+
+    spotrf_(&uplo, &n, A, &ld, &info);
+    return info;
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_LUFactorization : LU factorization of a general double precision matrix with
+ * partial pivoting. Computes \f$ PA = LU \f$ in place (dgetrf).
+ * @param [in] N : rows and columns of A
+ * @param [in,out] A : column-major matrix, L (unit diagonal not stored) and U on exit
+ * @param [in] lda : leading dimension of A
+ * @param [out] pivots : N row interchanges (1-based, as returned by LAPACK)
+ * @return : 0 on success, k > 0 if \f$ U_{kk} \f$ is exactly zero */
+//************************************************************************************************//
+cemINT cem_math::MKL_LUFactorization(const cemINT N, cemDOUBLE* A, const cemINT lda,
+                                     cemINT* pivots)
+{
+    cemINT n = N;
+    cemINT ld = lda;
+    cemINT info = 0;
+
+    dgetrf_(&n, &n, A, &ld, pivots, &info);
+    return info;
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_LUSolve : Solves a general system with the factors of MKL_LUFactorization().
+ * Computes \f$ X = A^{-1}X \f$ (dgetrs).
+ * @param [in] N : rows and columns of A
+ * @param [in] num_vectors : columns of X
+ * @param [in] LU : factors from MKL_LUFactorization()
+ * @param [in] ldlu : leading dimension of LU
+ * @param [in] pivots : row interchanges from MKL_LUFactorization()
+ * @param [in,out] X : column-major N x num_vectors matrix, the solution on exit
+ * @param [in] ldx : leading dimension of X */
+//************************************************************************************************//
+void cem_math::MKL_LUSolve(const cemINT N, const cemINT num_vectors,
+                           const cemDOUBLE* LU, const cemINT ldlu, const cemINT* pivots,
+                           cemDOUBLE* X, const cemINT ldx)
+{
+    char trans = 'N';
+    cemINT n = N;
+    cemINT nrhs = num_vectors;
+    cemINT ld = ldlu;
+    cemINT ldb = ldx;
+    cemINT info = 0;
+
+    dgetrs_(&trans, &n, &nrhs, LU, &ld, pivots, X, &ldb, &info);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_TriangularSolveRightTransposed : Solves a lower triangular system from the right.
+ * Computes \f$ B = BL^{-T} \f$ (dtrsm).
+ * @param [in] M : rows of B
+ * @param [in] N : columns of B, rows and columns of L
+ * @param [in] L : column-major lower triangular matrix
+ * @param [in] ldl : leading dimension of L
+ * @param [in,out] B : column-major M x N matrix
+ * @param [in] ldb : leading dimension of B */
+//************************************************************************************************//
+void cem_math::MKL_TriangularSolveRightTransposed(const cemINT M, const cemINT N,
+                                                  const cemDOUBLE* L, const cemINT ldl,
+                                                  cemDOUBLE* B, const cemINT ldb)
+{
+    cblas_dtrsm(CblasColMajor, CblasRight, CblasLower, CblasTrans, CblasNonUnit, M, N, 1.0,
+                L, ldl, B, ldb);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_TriangularSolveRightTransposed : Solves a single precision lower triangular system
+ * from the right. Computes \f$ B = BL^{-T} \f$ (strsm).
+ * @param [in] M : rows of B
+ * @param [in] N : columns of B, rows and columns of L
+ * @param [in] L : column-major lower triangular matrix
+ * @param [in] ldl : leading dimension of L
+ * @param [in,out] B : column-major M x N matrix
+ * @param [in] ldb : leading dimension of B */
+//************************************************************************************************//
+void cem_math::MKL_TriangularSolveRightTransposed(const cemINT M, const cemINT N,
+                                                  const cemFLOAT* L, const cemINT ldl,
+                                                  cemFLOAT* B, const cemINT ldb)
+{
+    cblas_strsm(CblasColMajor, CblasRight, CblasLower, CblasTrans, CblasNonUnit, M, N, 1.0f,
+                L, ldl, B, ldb);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_TriangularSolve : Solves a lower triangular system.
+ * Computes \f$ x = L^{-1}x \f$ or \f$ x = L^{-T}x \f$ (dtrsv).
+ * @param [in] N : rows and columns of L
+ * @param [in] L : column-major lower triangular matrix
+ * @param [in] ldl : leading dimension of L
+ * @param [in,out] x : vector of N values
+ * @param [in] transposed : true to solve with \f$ L^T \f$ */
+//************************************************************************************************//
+void cem_math::MKL_TriangularSolve(const cemINT N, const cemDOUBLE* L, const cemINT ldl,
+                                   cemDOUBLE* x, const cemBOOL transposed)
+{
+    cemINT incx = 1;
+    cblas_dtrsv(CblasColMajor, CblasLower, transposed ? CblasTrans : CblasNoTrans, CblasNonUnit,
+                N, L, ldl, x, incx);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_TriangularSolve : Solves a single precision lower triangular system.
+ * Computes \f$ x = L^{-1}x \f$ or \f$ x = L^{-T}x \f$ (strsv).
+ * @param [in] N : rows and columns of L
+ * @param [in] L : column-major lower triangular matrix
+ * @param [in] ldl : leading dimension of L
+ * @param [in,out] x : vector of N values
+ * @param [in] transposed : true to solve with \f$ L^T \f$ */
+//************************************************************************************************//
+void cem_math::MKL_TriangularSolve(const cemINT N, const cemFLOAT* L, const cemINT ldl,
+                                   cemFLOAT* x, const cemBOOL transposed)
+{
+    cemINT incx = 1;
+    cblas_strsv(CblasColMajor, CblasLower, transposed ? CblasTrans : CblasNoTrans, CblasNonUnit,
+                N, L, ldl, x, incx);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_TriangularSolve : Solves a lower triangular system with several right-hand sides.
+ * Computes \f$ X = L^{-1}X \f$ or \f$ X = L^{-T}X \f$ (dtrsm).
+ * @param [in] N : rows and columns of L, rows of X
+ * @param [in] num_vectors : columns of X
+ * @param [in] L : column-major lower triangular matrix
+ * @param [in] ldl : leading dimension of L
+ * @param [in,out] X : column-major N x num_vectors matrix
+ * @param [in] ldx : leading dimension of X
+ * @param [in] transposed : true to solve with \f$ L^T \f$ */
+//************************************************************************************************//
+void cem_math::MKL_TriangularSolve(const cemINT N, const cemINT num_vectors,
+                                   const cemDOUBLE* L, const cemINT ldl,
+                                   cemDOUBLE* X, const cemINT ldx, const cemBOOL transposed)
+{
+    cblas_dtrsm(CblasColMajor, CblasLeft, CblasLower, transposed ? CblasTrans : CblasNoTrans,
+                CblasNonUnit, N, num_vectors, 1.0, L, ldl, X, ldx);
+}
+
+
+//************************************************************************************************//
+/** @brief MKL_TriangularSolve : Solves a single precision lower triangular system with several
+ * right-hand sides. Computes \f$ X = L^{-1}X \f$ or \f$ X = L^{-T}X \f$ (strsm).
+ * @param [in] N : rows and columns of L, rows of X
+ * @param [in] num_vectors : columns of X
+ * @param [in] L : column-major lower triangular matrix
+ * @param [in] ldl : leading dimension of L
+ * @param [in,out] X : column-major N x num_vectors matrix
+ * @param [in] ldx : leading dimension of X
+ * @param [in] transposed : true to solve with \f$ L^T \f$ */
+//************************************************************************************************//
+void cem_math::MKL_TriangularSolve(const cemINT N, const cemINT num_vectors,
+                                   const cemFLOAT* L, const cemINT ldl,
+                                   cemFLOAT* X, const cemINT ldx, const cemBOOL transposed)
+{
+    cblas_strsm(CblasColMajor, CblasLeft, CblasLower, transposed ? CblasTrans : CblasNoTrans,
+                CblasNonUnit, N, num_vectors, 1.0f, L, ldl, X, ldx);
+}
@@ -0,0 +1,71 @@
+#ifndef BLASLEVEL3_H
+#define BLASLEVEL3_H
+#pragma once
+
+#include "cemTypes.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+// Dense kernels of the supernodal factorization, in double and single precision. Matrices are
+// column-major with leading dimension ld, triangular matrices are lower and non-unit.
+
+// Matrix-matrix product with the second matrix transposed, C = A*B^T (C is M x N, K columns):
+void MKL_MatrixTimesMatrixTransposed(const cemINT M, const cemINT N, const cemINT K,
+                                     const cemDOUBLE* A, const cemINT lda,
+                                     const cemDOUBLE* B, const cemINT ldb,
+                                     cemDOUBLE* C, const cemINT ldc);
+void MKL_MatrixTimesMatrixTransposed(const cemINT M, const cemINT N, const cemINT K,
+                                     const cemFLOAT* A, const cemINT lda,
+                                     const cemFLOAT* B, const cemINT ldb,
+                                     cemFLOAT* C, const cemINT ldc);
+
+// Matrix-matrix product, C = alpha*op(A)*B + beta*C with op(A) = A or A^T (C is M x N, K inner):
+void MKL_MatrixMultiply(const cemBOOL transpose_a, const cemINT M, const cemINT N, const cemINT K,
+                        const cemDOUBLE alpha, const cemDOUBLE* A, const cemINT lda,
+                        const cemDOUBLE* B, const cemINT ldb,
+                        const cemDOUBLE beta, cemDOUBLE* C, const cemINT ldc);
+void MKL_MatrixMultiply(const cemBOOL transpose_a, const cemINT M, const cemINT N, const cemINT K,
+                        const cemFLOAT alpha, const cemFLOAT* A, const cemINT lda,
+                        const cemFLOAT* B, const cemINT ldb,
+                        const cemFLOAT beta, cemFLOAT* C, const cemINT ldc);
+
+// Cholesky factorization A = L*L^T in place (returns 0, or k > 0 if the minor k is not positive):
+cemINT MKL_CholeskyFactorization(const cemINT N, cemDOUBLE* A, const cemINT lda);
+cemINT MKL_CholeskyFactorization(const cemINT N, cemFLOAT* A, const cemINT lda);
+
+// LU factorization with partial pivoting P*A = L*U in place (returns 0, or k > 0 if U(k,k) is 0):
+cemINT MKL_LUFactorization(const cemINT N, cemDOUBLE* A, const cemINT lda, cemINT* pivots);
+
+// Solve with the LU factors of MKL_LUFactorization, X = A^-1 X (X is N x num_vectors):
+void MKL_LUSolve(const cemINT N, const cemINT num_vectors,
+                 const cemDOUBLE* LU, const cemINT ldlu, const cemINT* pivots,
+                 cemDOUBLE* X, const cemINT ldx);
+
+// Triangular solve from the right, B = B*L^-T (B is M x N):
+void MKL_TriangularSolveRightTransposed(const cemINT M, const cemINT N,
+                                        const cemDOUBLE* L, const cemINT ldl,
+                                        cemDOUBLE* B, const cemINT ldb);
+void MKL_TriangularSolveRightTransposed(const cemINT M, const cemINT N,
+                                        const cemFLOAT* L, const cemINT ldl,
+                                        cemFLOAT* B, const cemINT ldb);
+
+// Triangular solve, x = L^-1 x or x = L^-T x:
+void MKL_TriangularSolve(const cemINT N, const cemDOUBLE* L, const cemINT ldl, cemDOUBLE* x,
+                         const cemBOOL transposed);
+void MKL_TriangularSolve(const cemINT N, const cemFLOAT* L, const cemINT ldl, cemFLOAT* x,
+                         const cemBOOL transposed);
+
+// Triangular solve with several vectors, X = L^-1 X or X = L^-T X (X is N x num_vectors):
+void MKL_TriangularSolve(const cemINT N, const cemINT num_vectors,
+                         const cemDOUBLE* L, const cemINT ldl,
+                         cemDOUBLE* X, const cemINT ldx, const cemBOOL transposed);
+void MKL_TriangularSolve(const cemINT N, const cemINT num_vectors,
+                         const cemFLOAT* L, const cemINT ldl,
+                         cemFLOAT* X, const cemINT ldx, const cemBOOL transposed);
+}
+
+
+#endif // BLASLEVEL3_H
@@ -55,7 +55,6 @@ DenseMatrix<T>::DenseMatrix(cemUINT n_rows, cemUINT n_columns)
 template <class T>
 void DenseMatrix<T>::copy(const DenseMatrix<T>& other)
 {
-    matrix_entries_ = NULL;
     resize(other.num_rows_,other.num_columns_);
 
     cemUINT8 size = num_rows_;
@@ -72,6 +71,7 @@ void DenseMatrix<T>::copy(const DenseMatrix<T>& other)
 template <class T>
 DenseMatrix<T>::DenseMatrix(const DenseMatrix<T>& other)
 {
+    matrix_entries_ = NULL;
     copy(other);
 }
 
@@ -84,7 +84,9 @@ DenseMatrix<T>::DenseMatrix(const DenseMatrix<T>& other)
 template <class T>
 DenseMatrix<T>& DenseMatrix<T>::operator = (const DenseMatrix<T>& other)
 {
-    copy(other);
+    if (this != &other)
+        copy(other);
+    return *this;
 }
 
 
@@ -253,15 +255,15 @@ void DenseMatrix<T>::multiply_by_scalar(const T& scalar)
 
 
 //************************************************************************************************//
-/** @brief DenseMatrix<T>::determinant : Computes the determinant of a 2 by 2 matrix.
+/** @brief DenseMatrix<T>::determinant : Computes the determinant of a matrix up to 3 by 3.
  * @return \f$ \det A \f$ */
 //************************************************************************************************//
 template <class T>
 T DenseMatrix<T>::determinant() const
 {
-    // Only for 2 by 2 matrices:
-    if (num_rows_ > 2 || num_columns_ > 2)
-        throw(Exception("FEATURE NOT IMPLEMENTED","Cannot compute determinant of a matrix bigger than 2 by 2"));
+    // Only up to 3 by 3 matrices:
+    if (num_rows_ > 3 || num_columns_ > 3)
+        throw(Exception("FEATURE NOT IMPLEMENTED","Cannot compute determinant of a matrix bigger than 3 by 3"));
     if (num_rows_ != num_columns_)
         throw(Exception("INPUT ERROR","Cannot compute determinant of a non-square matrix"));
 
@@ -270,27 +272,51 @@ T DenseMatrix<T>::determinant() const
 
     if (num_rows_ == 2)
         return (*this)(0,0)*(*this)(1,1) - (*this)(0,1)*(*this)(1,0);
+
+    // Expansion along the first row:
+    const DenseMatrix<T>& A = *this;
+    return A(0,0)*(A(1,1)*A(2,2) - A(1,2)*A(2,1)) -
+           A(0,1)*(A(1,0)*A(2,2) - A(1,2)*A(2,0)) +
+           A(0,2)*(A(1,0)*A(2,1) - A(1,1)*A(2,0));
 }
 
 
 //************************************************************************************************//
-/** @brief DenseMatrix<T>::inverse : Computes inverse of a 2 by 2 matrix.
+/** @brief DenseMatrix<T>::inverse : Computes inverse of a 2 by 2 or 3 by 3 matrix.
+ *
+ * The inverse is the transpose of the matrix of cofactors divided by the determinant, which is
+ * what Jacobian matrices of 2D and 3D elements need.
  * @return \f$ A^{-1} \f$ */
 //************************************************************************************************//
 template <class T>
 DenseMatrix<T> DenseMatrix<T>::inverse() const
 {
-    // Only for 2 by 2 matrices:
-    if (num_rows_ != 2 || num_columns_ != 2)
-        throw(Exception("FEATURE NOT IMPLEMENTED","Can only compute the inverse of 2 by 2 matrices"));
+    // Only for 2 by 2 and 3 by 3 matrices:
+    if (num_rows_ != num_columns_ || num_rows_ < 2 || num_rows_ > 3)
+        throw(Exception("FEATURE NOT IMPLEMENTED","Can only compute the inverse of 2 by 2 or 3 by 3 matrices"));
 
-    DenseMatrix<T> inverse(2,2);
+    const DenseMatrix<T>& A = *this;
     T det = this->determinant();
-    inverse(0,0) = (*this)(1,1)/det;
-    inverse(0,1) = -(*this)(0,1)/det;
-    inverse(1,0) = -(*this)(1,0)/det;
-    inverse(1,1) = (*this)(0,0)/det;
+    if (num_rows_ == 2)
+    {
+        DenseMatrix<T> inverse(2,2);
+        inverse(0,0) = A(1,1)/det;
+        inverse(0,1) = -A(0,1)/det;
+        inverse(1,0) = -A(1,0)/det;
+        inverse(1,1) = A(0,0)/det;
+        return inverse;
+    }
 
+    DenseMatrix<T> inverse(3,3);
+    inverse(0,0) = (A(1,1)*A(2,2) - A(1,2)*A(2,1))/det;
+    inverse(0,1) = (A(0,2)*A(2,1) - A(0,1)*A(2,2))/det;
+    inverse(0,2) = (A(0,1)*A(1,2) - A(0,2)*A(1,1))/det;
+    inverse(1,0) = (A(1,2)*A(2,0) - A(1,0)*A(2,2))/det;
+    inverse(1,1) = (A(0,0)*A(2,2) - A(0,2)*A(2,0))/det;
+    inverse(1,2) = (A(0,2)*A(1,0) - A(0,0)*A(1,2))/det;
+    inverse(2,0) = (A(1,0)*A(2,1) - A(1,1)*A(2,0))/det;
+    inverse(2,1) = (A(0,1)*A(2,0) - A(0,0)*A(2,1))/det;
+    inverse(2,2) = (A(0,0)*A(1,1) - A(0,1)*A(1,0))/det;
     return inverse;
 }
 
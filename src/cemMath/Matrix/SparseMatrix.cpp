@@ -0,0 +1,301 @@
+#include "SparseMatrix.h"
+#include "cemError.h"
+#include "cemUtils.h"
+#include <algorithm>
+
+using namespace cem_math;
+using namespace cem_def;
+using cemcommon::Exception;
+
+template <class T>
+const cemINT SparseMatrix<T>::VECTOR_BLOCK;
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix::SparseMatrix : Default constructor. */
+//************************************************************************************************//
+template <class T>
+SparseMatrix<T>::SparseMatrix()
+{
+    num_rows_ = 0;
+    num_columns_ = 0;
+    row_offsets_.assign(1,0);
+    zero_ = T(0);
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::SparseMatrix : Constructor with matrix size (and no entries).
+ * @param n_rows : Number of rows
+ * @param n_columns : Number of columns */
+//************************************************************************************************//
+template <class T>
+SparseMatrix<T>::SparseMatrix(cemUINT n_rows, cemUINT n_columns)
+{
+    zero_ = T(0);
+    resize(n_rows,n_columns);
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::num_rows : Gets number of rows.
+ * @return : num_rows_ */
+//************************************************************************************************//
+template <class T>
+cemUINT SparseMatrix<T>::num_rows() const {return num_rows_;}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::num_columns : Gets number of columns.
+ * @return : num_columns_ */
+//************************************************************************************************//
+template <class T>
+cemUINT SparseMatrix<T>::num_columns() const {return num_columns_;}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::num_entries : Gets number of stored entries.
+ * @return : row_offsets_[num_rows_] */
+//************************************************************************************************//
+template <class T>
+cemINT8 SparseMatrix<T>::num_entries() const {return row_offsets_[num_rows_];}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::row_offsets : Gets first entry of each row.
+ * @return : pointer to num_rows()+1 offsets */
+//************************************************************************************************//
+template <class T>
+const cemINT8* SparseMatrix<T>::row_offsets() const {return &row_offsets_[0];}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::column_indices : Gets column of each stored entry.
+ * @return : pointer to num_entries() indices (NULL if there are none) */
+//************************************************************************************************//
+template <class T>
+const cemINT* SparseMatrix<T>::column_indices() const
+{
+    return column_indices_.empty() ? NULL : &column_indices_[0];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::values : Gets value of each stored entry.
+ * @return : pointer to num_entries() values (NULL if there are none) */
+//************************************************************************************************//
+template <class T>
+const T* SparseMatrix<T>::values() const
+{
+    return values_.empty() ? NULL : &values_[0];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::values : Gets value of each stored entry, to be modified.
+ * @return : pointer to num_entries() values (NULL if there are none) */
+//************************************************************************************************//
+template <class T>
+T* SparseMatrix<T>::values()
+{
+    return values_.empty() ? NULL : &values_[0];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::find : Finds the position of an entry (binary search within the row).
+ * @param row : Row of the entry
+ * @param col : Column of the entry
+ * @return : position in column_indices() and values(), or -1 if the entry is not stored */
+//************************************************************************************************//
+template <class T>
+cemINT8 SparseMatrix<T>::find(cemINT row, cemINT col) const
+{
+    if (row < 0 || row >= num_rows_ || col < 0 || col >= num_columns_)
+        throw(Exception("OUT OF RANGE","Entry (" + cem_utils::NumberToString<cemINT>(row) + "," +
+                        cem_utils::NumberToString<cemINT>(col) + ") is out of the matrix"));
+
+    const cemINT* first = &column_indices_[0] + row_offsets_[row];
+    const cemINT* last = &column_indices_[0] + row_offsets_[row+1];
+    const cemINT* it = std::lower_bound(first,last,col);
+    if (it == last || *it != col)
+        return -1;
+
+    return it - &column_indices_[0];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::operator () : Random access operator.
+ * @param row : Row of the entry
+ * @param col : Column of the entry
+ * @return : Entry (row,col), or zero if it is not stored */
+//************************************************************************************************//
+template <class T>
+const T& SparseMatrix<T>::operator () (cemUINT row, cemUINT col) const
+{
+    cemINT8 position = find(row,col);
+    if (position < 0)
+        return zero_;
+
+    return values_[position];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::operator () : Random access assignment.
+ * @param row : Row of the entry
+ * @param col : Column of the entry (must be in the pattern)
+ * @return : Reference to entry (row,col) */
+//************************************************************************************************//
+template <class T>
+T& SparseMatrix<T>::operator () (cemUINT row, cemUINT col)
+{
+    cemINT8 position = find(row,col);
+    if (position < 0)
+        throw(Exception("OUT OF PATTERN","Entry (" + cem_utils::NumberToString<cemUINT>(row) + "," +
+                        cem_utils::NumberToString<cemUINT>(col) + ") is not stored"));
+
+    return values_[position];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::multiply : Sparse matrix-vector product, \f$ y = Ax \f$.
+ *
+ * Rows are split among threads when the library is built with OpenMP; each thread writes its own
+ * rows of y, so the result does not depend on the number of threads.
+ * @param x : num_columns() values
+ * @param y : num_rows() values (must not overlap x) */
+//************************************************************************************************//
+template <class T>
+void SparseMatrix<T>::multiply(const T* x, T* y) const
+{
+    const cemINT8* offsets = &row_offsets_[0];
+    const cemINT* columns = column_indices();
+    const T* entries = values();
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<num_rows_; ++i)
+    {
+        T sum = T(0);
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+            sum += entries[k]*x[columns[k]];
+        y[i] = sum;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::multiply : Sparse matrix product with several vectors, \f$ Y = AX \f$.
+ *
+ * The vectors are taken VECTOR_BLOCK at a time, so each entry of the matrix is read once per
+ * block instead of once per vector.
+ * @param num_vectors : number of columns of X and Y
+ * @param X : column-major num_columns() x num_vectors values (as in DenseMatrix)
+ * @param Y : column-major num_rows() x num_vectors values (must not overlap X) */
+//************************************************************************************************//
+template <class T>
+void SparseMatrix<T>::multiply(const cemINT& num_vectors, const T* X, T* Y) const
+{
+    const cemINT8* offsets = &row_offsets_[0];
+    const cemINT* columns = column_indices();
+    const T* entries = values();
+
+    for (cemINT first=0; first<num_vectors; first+=VECTOR_BLOCK)
+    {
+        cemINT block = std::min(VECTOR_BLOCK,num_vectors - first);
+        const T* x = X + static_cast<cemINT8>(first)*num_columns_;
+        T* y = Y + static_cast<cemINT8>(first)*num_rows_;
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT i=0; i<num_rows_; ++i)
+        {
+            T sums[VECTOR_BLOCK];
+            for (cemINT v=0; v<block; ++v)
+                sums[v] = T(0);
+
+            for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+            {
+                const T* x_k = x + columns[k];
+                for (cemINT v=0; v<block; ++v)
+                    sums[v] += entries[k]*x_k[static_cast<cemINT8>(v)*num_columns_];
+            }
+
+            for (cemINT v=0; v<block; ++v)
+                y[i + static_cast<cemINT8>(v)*num_rows_] = sums[v];
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::initialize : Sets all stored entries to zero (the pattern is kept). */
+//************************************************************************************************//
+template <class T>
+void SparseMatrix<T>::initialize()
+{
+    std::fill(values_.begin(),values_.end(),T(0));
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::resize : Sets the size of the matrix and removes all entries.
+ * @param n_rows : Number of rows
+ * @param n_columns : Number of columns */
+//************************************************************************************************//
+template <class T>
+void SparseMatrix<T>::resize(cemUINT n_rows, cemUINT n_columns)
+{
+    num_rows_ = n_rows;
+    num_columns_ = n_columns;
+    row_offsets_.assign(num_rows_+1,0);
+    column_indices_.clear();
+    values_.clear();
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMatrix<T>::set_pattern : Sets size and stored entries; all values are zero.
+ * @param n_rows : Number of rows
+ * @param n_columns : Number of columns
+ * @param row_offsets : First entry of each row (n_rows+1 values, starting at zero)
+ * @param column_indices : Column of each entry, sorted and without repetitions in each row */
+//************************************************************************************************//
+template <class T>
+void SparseMatrix<T>::set_pattern(cemUINT n_rows,
+                                  cemUINT n_columns,
+                                  const std::vector<cemINT8>& row_offsets,
+                                  const std::vector<cemINT>& column_indices)
+{
+    if (row_offsets.size() != n_rows+1 || row_offsets[0] != 0 ||
+        row_offsets[n_rows] != static_cast<cemINT8>(column_indices.size()))
+        throw(Exception("INPUT ERROR","row_offsets do not match column_indices"));
+
+    for (cemUINT i=0; i<n_rows; ++i)
+    {
+        for (cemINT8 p=row_offsets[i]; p<row_offsets[i+1]; ++p)
+        {
+            if (column_indices[p] < 0 || column_indices[p] >= static_cast<cemINT>(n_columns) ||
+                (p > row_offsets[i] && column_indices[p] <= column_indices[p-1]))
+                throw(Exception("INPUT ERROR","Columns must be sorted and within the matrix"));
+        }
+    }
+
+    num_rows_ = n_rows;
+    num_columns_ = n_columns;
+    row_offsets_ = row_offsets;
+    column_indices_ = column_indices;
+    values_.assign(column_indices.size(),T(0));
+}
+
+
+
+
+//************************************************************************************************//
+// Class Instantiations:
+//************************************************************************************************//
+template class SparseMatrix<cemFLOAT>;
+template class SparseMatrix<cemDOUBLE>;
+template class SparseMatrix<cemFCOMPLEX>;
+template class SparseMatrix<cemDCOMPLEX>;
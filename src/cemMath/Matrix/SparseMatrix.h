@@ -0,0 +1,69 @@
+#ifndef SPARSEMATRIX_H
+#define SPARSEMATRIX_H
+
+#include <vector>
+#include "Matrix.h"
+
+
+namespace cem_math
+{
+
+//************************************************************************************************//
+/** @brief The SparseMatrix class : Sparse matrix in compressed sparse row (CSR) storage.
+ *
+ * The entries of row i are found at positions row_offsets()[i] to row_offsets()[i+1]-1 of
+ * column_indices() and values(), with the columns of each row sorted in increasing order. The
+ * pattern (which entries exist) is set once with set_pattern(); after that only values change.
+ * Entries that are not in the pattern read as zero and cannot be written. */
+//************************************************************************************************//
+template <class T>
+class SparseMatrix : public Matrix<T>
+{
+public:
+    // Default constructor:
+    SparseMatrix();
+
+    // Constructor with parameters:
+    SparseMatrix(cemUINT n_rows, cemUINT n_columns);
+
+    // Get data members:
+    cemUINT num_rows() const;
+    cemUINT num_columns() const;
+    cemINT8 num_entries() const;
+    const cemINT8* row_offsets() const;
+    const cemINT* column_indices() const;
+    const T* values() const;
+    const T& operator () (cemUINT row, cemUINT col) const;
+    cemINT8 find(cemINT row, cemINT col) const;
+
+    // Operations:
+    void multiply(const T* x, T* y) const;
+    void multiply(const cemINT& num_vectors, const T* X, T* Y) const;
+
+    // Set data members:
+    T* values();
+    T& operator () (cemUINT row, cemUINT col);
+    void initialize();
+    void resize(cemUINT n_rows, cemUINT n_columns);
+    void set_pattern(cemUINT n_rows,
+                     cemUINT n_columns,
+                     const std::vector<cemINT8>& row_offsets,
+                     const std::vector<cemINT>& column_indices);
+
+private:
+    cemINT  num_rows_;                      /**< Number of rows of the matrix */
+    cemINT  num_columns_;                   /**< Number of columns of the matrix */
+    std::vector<cemINT8> row_offsets_;      /**< First entry of each row (num_rows_+1 values) */
+    std::vector<cemINT> column_indices_;    /**< Column of each entry, sorted within each row */
+    std::vector<T> values_;                 /**< Value of each entry */
+    T zero_;                                /**< Value of the entries that are not stored */
+
+    static const cemINT VECTOR_BLOCK = 8;   /**< Vectors multiplied per pass over the matrix */
+};
+
+
+}
+
+
+
+#endif // SPARSEMATRIX_H
@@ -0,0 +1,471 @@
+
+#include "SymmetricMatrix.h"
+#include "cemError.h"
+#include "cemUtils.h"
+#include "MKL/BlasLevel1.h"
+#include <cstring>
+
+using namespace cem_math;
+using namespace cem_def;
+using cemcommon::Exception;
+
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix::SymmetricMatrix : Default constructor. */
+//************************************************************************************************//
+template <class T>
+SymmetricMatrix<T>::SymmetricMatrix()
+{
+    num_rows_ = 0;
+    matrix_entries_ = NULL;
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::~SymmetricMatrix : Destructor. */
+//************************************************************************************************//
+template <class T>
+SymmetricMatrix<T>::~SymmetricMatrix()
+{
+    CLEAN_ARRAY(matrix_entries_);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::SymmetricMatrix : Constructor with matrix size.
+ * @param n_rows : Number of rows
+ * @param n_columns : Number of columns (must be equal to n_rows) */
+//************************************************************************************************//
+template <class T>
+SymmetricMatrix<T>::SymmetricMatrix(cemUINT n_rows, cemUINT n_columns)
+{
+    num_rows_ = 0;
+    matrix_entries_ = NULL;
+    resize(n_rows,n_columns);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::SymmetricMatrix : Packs the lower triangle of a square matrix.
+ *
+ * The upper triangle of the given matrix is not read.
+ * @param dense : Square matrix to be packed */
+//************************************************************************************************//
+template <class T>
+SymmetricMatrix<T>::SymmetricMatrix(const DenseMatrix<T>& dense)
+{
+    num_rows_ = 0;
+    matrix_entries_ = NULL;
+    resize(dense.num_rows(),dense.num_columns());
+
+    T* entry = matrix_entries_;
+    for (cemINT j=0; j<num_rows_; ++j)
+    {
+        for (cemINT i=j; i<num_rows_; ++i)
+            *entry++ = dense(i,j);
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::copy : Copies all data from another matrix.
+ * @param other : Matrix to be copied */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::copy(const SymmetricMatrix<T>& other)
+{
+    resize(other.num_rows_,other.num_rows_);
+
+    cemUINT8 size = num_entries();
+    for (cemUINT8 ii=0; ii<size; ++ii)
+        matrix_entries_[ii] = other.matrix_entries_[ii];
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::SymmetricMatrix : Copy constructor.
+ * @param other : Matrix to be copied. */
+//************************************************************************************************//
+template <class T>
+SymmetricMatrix<T>::SymmetricMatrix(const SymmetricMatrix<T>& other)
+{
+    num_rows_ = 0;
+    matrix_entries_ = NULL;
+    copy(other);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::operator = : Copy operator.
+ * @param other : Matrix to be copied
+ * @return : A new matrix, equal to the one given */
+//************************************************************************************************//
+template <class T>
+SymmetricMatrix<T>& SymmetricMatrix<T>::operator = (const SymmetricMatrix<T>& other)
+{
+    if (this != &other)
+        copy(other);
+    return *this;
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::operator DenseMatrix<T> : Unpacks matrix to full storage.
+ * @return : \f$ n \times n \f$ DenseMatrix with both triangles filled */
+//************************************************************************************************//
+template <class T>
+SymmetricMatrix<T>::operator DenseMatrix<T>() const
+{
+    DenseMatrix<T> dense(num_rows_,num_rows_);
+
+    const T* entry = matrix_entries_;
+    for (cemINT j=0; j<num_rows_; ++j)
+    {
+        dense(j,j) = *entry++;
+        for (cemINT i=j+1; i<num_rows_; ++i)
+        {
+            dense(i,j) = *entry;
+            dense(j,i) = *entry++;
+        }
+    }
+
+    return dense;
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::num_rows : Gets number of rows in matrix.
+ * @return : num_rows_ */
+//************************************************************************************************//
+template <class T>
+cemUINT SymmetricMatrix<T>::num_rows() const {return num_rows_;}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::num_columns : Gets number of columns in matrix.
+ * @return : num_rows_ */
+//************************************************************************************************//
+template <class T>
+cemUINT SymmetricMatrix<T>::num_columns() const {return num_rows_;}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::num_entries : Gets number of stored entries.
+ * @return : n(n+1)/2 */
+//************************************************************************************************//
+template <class T>
+cemUINT8 SymmetricMatrix<T>::num_entries() const
+{
+    cemUINT8 size = num_rows_;
+    size *= num_rows_ + 1;
+    return size/2;
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::location : Gets position of an entry in the packed array.
+ * @param row : row of matrix entry, from 0 to num_rows_ - 1
+ * @param col : column of matrix entry, from 0 to num_rows_ - 1
+ * @return : index of Matrix(row,col) in matrix_entries_ */
+//************************************************************************************************//
+template <class T>
+cemUINT8 SymmetricMatrix<T>::location(cemUINT row, cemUINT col) const
+{
+    if (row < col)
+    {
+        cemUINT temp = row;
+        row = col;
+        col = temp;
+    }
+
+    cemUINT8 location = 2*num_rows_ - col - 1;
+    location *= col;
+    location /= 2;
+    location += row;
+    return location;
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::operator () : Random access operator for read only purposes.
+ * @param row : row of matrix entry to get, from 0 to num_rows_ - 1
+ * @param col : column of matrix entry to get, from 0 to num_rows_ - 1
+ * @return : Matrix(row,col) */
+//************************************************************************************************//
+template <class T>
+const T& SymmetricMatrix<T>::operator () (cemUINT row, cemUINT col) const
+{
+    return(matrix_entries_[location(row,col)]);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::operator () : Random access operator for read-write purposes.
+ *
+ * Matrix(row,col) and Matrix(col,row) are the same entry.
+ * @param row : row of matrix entry to get, from 0 to num_rows_ - 1
+ * @param col : column of matrix entry to get, from 0 to num_rows_ - 1
+ * @return : Matrix(row,col) */
+//************************************************************************************************//
+template <class T>
+T& SymmetricMatrix<T>::operator () (cemUINT row, cemUINT col)
+{
+    return(matrix_entries_[location(row,col)]);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::initialize : Sets all matrix entries to zero. */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::initialize()
+{
+    std::memset(&matrix_entries_[0], 0, sizeof(T)*num_entries());
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::resize : Resize matrix to given numbers of rows and columns.
+ *
+ * Memory is only reallocated if the size changes.
+ * @param n_rows : Number of rows >= 1
+ * @param n_columns : Number of columns (must be equal to n_rows) */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::resize(cemUINT n_rows, cemUINT n_columns)
+{
+    if (n_rows != n_columns)
+        throw(Exception("INPUT ERROR","A symmetric matrix must be square"));
+
+    if (matrix_entries_ != NULL && num_rows_ == static_cast<cemINT>(n_rows))
+        return;
+
+    if (matrix_entries_ != NULL)
+        CLEAN_ARRAY(matrix_entries_);
+    num_rows_ = n_rows;
+
+    cemUINT8 size = num_entries();
+    try
+    {
+        matrix_entries_ = new T[size];
+    }
+    catch (std::bad_alloc)
+    {
+        cemUINT memory = size*sizeof(T)/1024/1024;
+        std::string temp = cem_utils::NumberToString<cemUINT>(memory);
+        throw(Exception("MEMORY OVERFLOW", "Requested memory=" + temp + "Mb"));
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::add : Adds two matrices of the same size.
+ * Computes \f$ A = A + B \f$ or equivalently, A += B
+ * @param [in] B : Matrix that is added to 'this' */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::add(const SymmetricMatrix<T>& B)
+{
+    if (num_rows_ != B.num_rows_)
+        throw(Exception("INVALID MATRIX OPERATION","Matrix size mismatch"));
+
+    MKL_VectorPlusEqualVector(num_entries(), matrix_entries_, B.matrix_entries_);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::operator += : Adds two matrices of the same size.
+ * @param [in] B : Matrix that is added to 'this'
+ * @return A = A + B */
+//************************************************************************************************//
+template <class T>
+const SymmetricMatrix<T>& SymmetricMatrix<T>::operator += (const SymmetricMatrix<T>& B)
+{
+    this->add(B);
+    return *this;
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::substract : Subtracts two matrices of the same size.
+ *
+ * Computes \f$ A = A - B \f$ or equivalently, A -= B
+ * @param [in] B : Matrix that is substracted to 'this' */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::substract(const SymmetricMatrix<T>& B)
+{
+    if (num_rows_ != B.num_rows_)
+        throw(Exception("INVALID MATRIX OPERATION","Matrix size mismatch"));
+
+    MKL_VectorMinusEqualVector(num_entries(), matrix_entries_, B.matrix_entries_);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::operator -= : Subtracts two matrices of the same size.
+ * @param [in] B : Matrix that is substracted to 'this'
+ * @return A = A - B */
+//************************************************************************************************//
+template <class T>
+const SymmetricMatrix<T>& SymmetricMatrix<T>::operator -= (const SymmetricMatrix<T>& B)
+{
+    this->substract(B);
+    return *this;
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::multiply_by_scalar : Multiplies matrix by a scalar.
+ *
+ * Computes \f$ A = aA \f$, with \f$ A \f$ being the matrix, and \f$ a \f$ the scalar.
+ * @param [in] scalar : scalar to be multiplied to 'this' */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::multiply_by_scalar(const T& scalar)
+{
+    MKL_ScalarTimesEqualVector(num_entries(), matrix_entries_, scalar);
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::scatter_add : Adds the matrix into a global matrix.
+ *
+ * Computes \f$ G(g_i,g_j) \mathrel{+}= A(i,j) \f$ for all i and j, with \f$ g_i \f$ the global
+ * index of local row i. Rows with a negative global index (e.g. fixed degrees of freedom) are
+ * skipped.
+ * @param [in] global_indices : global index of each local row (num_rows() entries)
+ * @param [in,out] global : global matrix, both triangles are updated */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::scatter_add(const std::vector<cemINT>& global_indices,
+                                     DenseMatrix<T>& global) const
+{
+    if (static_cast<cemINT>(global_indices.size()) != num_rows_)
+        throw(Exception("INPUT ERROR","One global index per row is needed"));
+
+    const T* entry = matrix_entries_;
+    for (cemINT j=0; j<num_rows_; ++j)
+    {
+        cemINT global_j = global_indices[j];
+        if (global_j < 0)
+        {
+            entry += num_rows_ - j;
+            continue;
+        }
+
+        global(global_j,global_j) += *entry++;
+        for (cemINT i=j+1; i<num_rows_; ++i, ++entry)
+        {
+            cemINT global_i = global_indices[i];
+            if (global_i < 0)
+                continue;
+
+            global(global_i,global_j) += *entry;
+            global(global_j,global_i) += *entry;
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::scatter_add : Adds the matrix into a global symmetric matrix.
+ *
+ * Same as the DenseMatrix version, but each stored entry is added only once.
+ * @param [in] global_indices : global index of each local row (num_rows() entries)
+ * @param [in,out] global : global symmetric matrix */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::scatter_add(const std::vector<cemINT>& global_indices,
+                                     SymmetricMatrix<T>& global) const
+{
+    if (static_cast<cemINT>(global_indices.size()) != num_rows_)
+        throw(Exception("INPUT ERROR","One global index per row is needed"));
+
+    const T* entry = matrix_entries_;
+    for (cemINT j=0; j<num_rows_; ++j)
+    {
+        cemINT global_j = global_indices[j];
+        if (global_j < 0)
+        {
+            entry += num_rows_ - j;
+            continue;
+        }
+
+        for (cemINT i=j; i<num_rows_; ++i, ++entry)
+        {
+            cemINT global_i = global_indices[i];
+            if (global_i >= 0)
+                global(global_i,global_j) += *entry;
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::gather : Extracts a local matrix from a global matrix.
+ *
+ * Computes \f$ A(i,j) = G(g_i,g_j) \f$ for \f$ i \geq j \f$. The matrix is resized to the number
+ * of global indices; entries of rows with a negative global index are set to zero.
+ * @param [in] global_indices : global index of each local row
+ * @param [in] global : global matrix, only the lower triangle of the selected block is read */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::gather(const std::vector<cemINT>& global_indices,
+                                const DenseMatrix<T>& global)
+{
+    resize(global_indices.size(),global_indices.size());
+
+    T* entry = matrix_entries_;
+    for (cemINT j=0; j<num_rows_; ++j)
+    {
+        cemINT global_j = global_indices[j];
+        for (cemINT i=j; i<num_rows_; ++i, ++entry)
+        {
+            cemINT global_i = global_indices[i];
+            if (global_i < 0 || global_j < 0)
+                *entry = T(0);
+            else
+                *entry = global(global_i,global_j);
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SymmetricMatrix<T>::gather : Extracts a local matrix from a global symmetric matrix.
+ * @param [in] global_indices : global index of each local row
+ * @param [in] global : global symmetric matrix */
+//************************************************************************************************//
+template <class T>
+void SymmetricMatrix<T>::gather(const std::vector<cemINT>& global_indices,
+                                const SymmetricMatrix<T>& global)
+{
+    resize(global_indices.size(),global_indices.size());
+
+    T* entry = matrix_entries_;
+    for (cemINT j=0; j<num_rows_; ++j)
+    {
+        cemINT global_j = global_indices[j];
+        for (cemINT i=j; i<num_rows_; ++i, ++entry)
+        {
+            cemINT global_i = global_indices[i];
+            if (global_i < 0 || global_j < 0)
+                *entry = T(0);
+            else
+                *entry = global(global_i,global_j);
+        }
+    }
+}
+
+
+
+
+//************************************************************************************************//
+// Class Instantiations:
+//************************************************************************************************//
+template class SymmetricMatrix<cemFLOAT>;
+template class SymmetricMatrix<cemDOUBLE>;
+template class SymmetricMatrix<cemFCOMPLEX>;
+template class SymmetricMatrix<cemDCOMPLEX>;
@@ -0,0 +1,78 @@
+#ifndef SYMMETRICMATRIX_H
+#define SYMMETRICMATRIX_H
+
+#include <vector>
+#include "Matrix.h"
+#include "DenseMatrix.h"
+
+
+namespace cem_math
+{
+
+//************************************************************************************************//
+/** @brief The SymmetricMatrix class : Square symmetric matrix in packed storage.
+ *
+ * Only the lower triangle is stored, column by column, so an \f$ n \times n \f$ matrix takes
+ * n(n+1)/2 entries. Entry (i,j) with \f$ i \geq j \f$ is found at \f$ j(2n-j-1)/2 + i \f$, which
+ * is LAPACK's 'L' packed format. Both (i,j) and (j,i) give access to the same entry, so writing
+ * one of them writes both. */
+//************************************************************************************************//
+template <class T>
+class SymmetricMatrix : public Matrix<T>
+{
+public:
+    // Default constructor:
+    SymmetricMatrix();
+
+    // Destructor:
+    ~SymmetricMatrix();
+
+    // Constructor with parameters:
+    SymmetricMatrix(cemUINT n_rows, cemUINT n_columns);
+    explicit SymmetricMatrix(const DenseMatrix<T>& dense);
+
+    // Copy constructor:
+    SymmetricMatrix(const SymmetricMatrix<T>& other);
+    SymmetricMatrix& operator = (const SymmetricMatrix<T>& other);
+
+    // Conversion to full storage:
+    operator DenseMatrix<T>() const;
+
+    // Get data members:
+    cemUINT num_rows() const;
+    cemUINT num_columns() const;
+    cemUINT8 num_entries() const;
+    const T& operator () (cemUINT row, cemUINT col) const;
+
+    // Set data members:
+    T& operator () (cemUINT row, cemUINT col);
+    void initialize();
+    void resize(cemUINT n_rows, cemUINT n_columns);
+
+    // Math operations:
+    void add(const SymmetricMatrix<T>& B);
+    const SymmetricMatrix& operator += (const SymmetricMatrix<T>& B);
+    void substract(const SymmetricMatrix<T>& B);
+    const SymmetricMatrix& operator -= (const SymmetricMatrix<T>& B);
+    void multiply_by_scalar(const T& scalar);
+
+    // Assembly:
+    void scatter_add(const std::vector<cemINT>& global_indices, DenseMatrix<T>& global) const;
+    void scatter_add(const std::vector<cemINT>& global_indices, SymmetricMatrix<T>& global) const;
+    void gather(const std::vector<cemINT>& global_indices, const DenseMatrix<T>& global);
+    void gather(const std::vector<cemINT>& global_indices, const SymmetricMatrix<T>& global);
+
+private:
+    cemINT  num_rows_;          /**< Number of rows (and columns) of the matrix */
+    T*      matrix_entries_;    /**< Lower triangle entries, stored column-wise */
+
+    void copy(const SymmetricMatrix<T>& matrix);
+    cemUINT8 location(cemUINT row, cemUINT col) const;
+};
+
+
+}
+
+
+
+#endif // SYMMETRICMATRIX_H
@@ -0,0 +1,703 @@
+#include <cmath>
+#include <algorithm>
+#include "AMGPreconditioner.h"
+#include "SparseProducts.h"
+#include "VectorKernels.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+const cemINT AMGPreconditioner::MAX_DIRECT_SIZE;
+const cemINT AMGPreconditioner::POWER_ITERATIONS;
+
+
+
+///***********************************************************************************************//
+/// CLASS AMGPreconditioner:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::AMGPreconditioner : Default constructor. */
+//************************************************************************************************//
+AMGPreconditioner::AMGPreconditioner()
+{
+    strength_threshold_ = 0.08;
+    coarse_size_ = 200;
+    max_levels_ = 20;
+    smoother_degree_ = 2;
+    num_structure_setups_ = 0;
+    fine_matrix_ = NULL;
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::num_levels : Gets number of levels (1 means a direct solve).
+ * @return : number of levels */
+//************************************************************************************************//
+cemINT AMGPreconditioner::num_levels() const {return static_cast<cemINT>(levels_.size());}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::num_level_rows : Gets number of rows of a level.
+ * @param [in] level : 0 (finest) to num_levels()-1
+ * @return : number of rows of the matrix of the level */
+//************************************************************************************************//
+cemINT AMGPreconditioner::num_level_rows(const cemINT& level) const
+{
+    return LevelMatrix(level).num_rows();
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::operator_complexity : Gets the entries of all levels over the
+ * entries of the finest one.
+ * @return : \f$ \sum_l nnz(A_l) / nnz(A_0) \f$ */
+//************************************************************************************************//
+cemDOUBLE AMGPreconditioner::operator_complexity() const
+{
+    if (levels_.empty() || LevelMatrix(0).num_entries() == 0)
+        return 0.0;
+
+    cemDOUBLE entries = 0.0;
+    for (cemINT l=0; l<num_levels(); ++l)
+        entries += LevelMatrix(l).num_entries();
+
+    return entries/LevelMatrix(0).num_entries();
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::num_structure_setups : Gets how many times SetUp() built the
+ * aggregates and patterns (instead of only updating values).
+ * @return : num_structure_setups_ */
+//************************************************************************************************//
+cemINT AMGPreconditioner::num_structure_setups() const {return num_structure_setups_;}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::strength_threshold : Gets threshold of strong connections.
+ * @return : strength_threshold_ */
+//************************************************************************************************//
+cemDOUBLE AMGPreconditioner::strength_threshold() const {return strength_threshold_;}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::coarse_size : Gets number of rows at which coarsening stops.
+ * @return : coarse_size_ */
+//************************************************************************************************//
+cemINT AMGPreconditioner::coarse_size() const {return coarse_size_;}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::max_levels : Gets maximum number of levels.
+ * @return : max_levels_ */
+//************************************************************************************************//
+cemINT AMGPreconditioner::max_levels() const {return max_levels_;}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::smoother_degree : Gets degree of the Chebyshev smoother.
+ * @return : smoother_degree_ */
+//************************************************************************************************//
+cemINT AMGPreconditioner::smoother_degree() const {return smoother_degree_;}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::set_strength_threshold : Sets threshold of strong connections.
+ * @param [in] threshold : \f$ 0 \le \theta < 1 \f$ */
+//************************************************************************************************//
+void AMGPreconditioner::set_strength_threshold(const cemDOUBLE& threshold)
+{
+    if (threshold < 0.0 || threshold >= 1.0)
+        throw(Exception("INPUT ERROR","Strength threshold must be in [0,1)"));
+
+    strength_threshold_ = threshold;
+    levels_.clear();
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::set_coarse_size : Sets number of rows at which coarsening stops.
+ * @param [in] coarse_size : rows (> 0, at most MAX_DIRECT_SIZE to end with a direct solve) */
+//************************************************************************************************//
+void AMGPreconditioner::set_coarse_size(const cemINT& coarse_size)
+{
+    if (coarse_size <= 0)
+        throw(Exception("INPUT ERROR","Coarse size must be positive"));
+
+    coarse_size_ = coarse_size;
+    levels_.clear();
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::set_max_levels : Sets maximum number of levels.
+ * @param [in] max_levels : levels (> 0) */
+//************************************************************************************************//
+void AMGPreconditioner::set_max_levels(const cemINT& max_levels)
+{
+    if (max_levels <= 0)
+        throw(Exception("INPUT ERROR","Maximum number of levels must be positive"));
+
+    max_levels_ = max_levels;
+    levels_.clear();
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::set_smoother_degree : Sets degree of the Chebyshev smoother.
+ * @param [in] degree : degree (> 0) */
+//************************************************************************************************//
+void AMGPreconditioner::set_smoother_degree(const cemINT& degree)
+{
+    if (degree <= 0)
+        throw(Exception("INPUT ERROR","Smoother degree must be positive"));
+
+    smoother_degree_ = degree;
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::SetUp : Builds the hierarchy, or only updates its values if the
+ * matrix has the same pattern as in the previous call.
+ * @param [in] A : symmetric positive definite matrix (must outlive the preconditioner) */
+//************************************************************************************************//
+void AMGPreconditioner::SetUp(const SparseMatrix<cemDOUBLE>& A)
+{
+    DiagonalPositions(A);
+    fine_matrix_ = &A;
+    num_rows_ = A.num_rows();
+
+    if (levels_.empty() || !HasSameStructure(A))
+    {
+        SetUpStructure(A);
+        return;
+    }
+
+    for (cemINT l=0; l+1<num_levels(); ++l)
+        SetUpLevelValues(l);
+
+    SetUpSmoother(num_levels()-1);
+    FactorizeCoarse();
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::Apply : One V-cycle for \f$ Az = r \f$ from \f$ z = 0 \f$.
+ * @param [in] r : num_rows() values
+ * @param [out] z : num_rows() values */
+//************************************************************************************************//
+void AMGPreconditioner::Apply(const cemDOUBLE* r, cemDOUBLE* z) const
+{
+    if (levels_.empty() || num_rows_ == 0)
+        return;
+
+    std::copy(r,r + num_rows_,levels_[0].b.begin());
+    Cycle(0);
+    std::copy(levels_[0].x.begin(),levels_[0].x.end(),z);
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::LevelMatrix : Gets the matrix of a level.
+ * @param [in] level : 0 (finest) to num_levels()-1
+ * @return : matrix of the level */
+//************************************************************************************************//
+const SparseMatrix<cemDOUBLE>& AMGPreconditioner::LevelMatrix(const cemINT& level) const
+{
+    if (level < 0 || level >= num_levels())
+        throw(Exception("OUT OF RANGE","Level " + cem_utils::NumberToString<cemINT>(level) +
+                        " does not exist"));
+
+    return level == 0 ? *fine_matrix_ : levels_[level].A;
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::HasSameStructure : Checks if a matrix has the pattern the hierarchy
+ * was built for.
+ * @param [in] A : sparse matrix
+ * @return : true if rows and columns of all entries match */
+//************************************************************************************************//
+cemBOOL AMGPreconditioner::HasSameStructure(const SparseMatrix<cemDOUBLE>& A) const
+{
+    if (static_cast<cemINT>(fine_row_offsets_.size()) != static_cast<cemINT>(A.num_rows()) + 1 ||
+        fine_row_offsets_.back() != A.num_entries())
+        return false;
+
+    return std::equal(fine_row_offsets_.begin(),fine_row_offsets_.end(),A.row_offsets()) &&
+           std::equal(fine_columns_.begin(),fine_columns_.end(),A.column_indices());
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::SetUpStructure : Builds aggregates, patterns and values of all
+ * levels.
+ * @param [in] A : fine matrix */
+//************************************************************************************************//
+void AMGPreconditioner::SetUpStructure(const SparseMatrix<cemDOUBLE>& A)
+{
+    fine_row_offsets_.assign(A.row_offsets(),A.row_offsets() + A.num_rows() + 1);
+    fine_columns_.assign(A.column_indices(),A.column_indices() + A.num_entries());
+
+    levels_.clear();
+    levels_.reserve(max_levels_);
+    levels_.push_back(Level());
+    for (cemINT l=0; l+1<max_levels_; ++l)
+    {
+        cemINT n = LevelMatrix(l).num_rows();
+        if (n <= coarse_size_)
+            break;
+
+        cemINT num_aggregates = Aggregate(l);
+        if (num_aggregates == 0 || num_aggregates >= n)
+            break;  // Coarsening stalled.
+
+        Level& level = levels_[l];
+        SetUpProlongationPattern(l,num_aggregates);
+        SparseTranspose(level.P,level.R,level.transpose_positions);
+        SparseProductPattern(LevelMatrix(l),level.P,level.AP);
+
+        levels_.push_back(Level());
+        SparseProductPattern(levels_[l].R,levels_[l].AP,levels_[l+1].A);
+        SetUpLevelValues(l);
+    }
+
+    SetUpSmoother(num_levels()-1);
+    FactorizeCoarse();
+    ++num_structure_setups_;
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::SetUpLevelValues : Computes the smoother, P, R and the next coarse
+ * matrix of a level from the values of its matrix (patterns already built).
+ * @param [in] level : level, not the coarsest */
+//************************************************************************************************//
+void AMGPreconditioner::SetUpLevelValues(const cemINT& level)
+{
+    SetUpSmoother(level);
+
+    Level& L = levels_[level];
+    const SparseMatrix<cemDOUBLE>& A = LevelMatrix(level);
+    cemINT n = A.num_rows();
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    const cemDOUBLE* a = A.values();
+    const cemDOUBLE* inverse_diagonal = &L.inverse_diagonal[0];
+    const cemINT8* slots = &L.prolongation_slots[0];
+    cemDOUBLE omega = 4.0/(3.0*L.lambda_max);
+
+    // P = (I - omega D^-1 A) P0, each row of P only depends on the same row of A:
+    L.P.initialize();
+    cemDOUBLE* p = L.P.values();
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<n; ++i)
+    {
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+        {
+            p[slots[k]] -= omega*inverse_diagonal[i]*a[k];
+            if (columns[k] == i)
+                p[slots[k]] += 1.0;
+        }
+    }
+
+    SparseTransposeValues(L.P,L.transpose_positions,L.R);
+    SparseProductValues(A,L.P,L.AP);
+    SparseProductValues(L.R,L.AP,levels_[level+1].A);
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::Aggregate : Groups the rows of a level into aggregates.
+ *
+ * Three greedy phases over the graph of strong connections: (1) a row whose strong neighbors are
+ * all free forms an aggregate with them; (2) the remaining rows join the aggregate of a strong
+ * neighbor from phase 1; (3) rows still free form aggregates with their free strong neighbors
+ * (a row without strong connections is an aggregate on its own).
+ * @param [in] level : level
+ * @return : number of aggregates */
+//************************************************************************************************//
+cemINT AMGPreconditioner::Aggregate(const cemINT& level)
+{
+    const SparseMatrix<cemDOUBLE>& A = LevelMatrix(level);
+    cemINT n = A.num_rows();
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    const cemDOUBLE* a = A.values();
+    std::vector<cemINT8> diagonal = DiagonalPositions(A);
+
+    // Strong connections of each row:
+    std::vector<cemINT8> strong_offsets(n+1,0);
+    std::vector<cemINT> strong_columns(A.num_entries());
+    cemDOUBLE theta2 = strength_threshold_*strength_threshold_;
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<n; ++i)
+    {
+        cemINT8 p = offsets[i];
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+        {
+            cemINT j = columns[k];
+            if (j != i && a[k]*a[k] > theta2*a[diagonal[i]]*a[diagonal[j]])
+                strong_columns[p++] = j;
+        }
+        strong_offsets[i+1] = p - offsets[i];
+    }
+
+    std::vector<cemINT8> strong_first(offsets,offsets + n);
+    for (cemINT i=0; i<n; ++i)
+        strong_offsets[i+1] += strong_offsets[i];
+
+    // Phase 1:
+    std::vector<cemINT>& aggregates = levels_[level].aggregates;
+    aggregates.assign(n,-1);
+    cemINT num_aggregates = 0;
+    for (cemINT i=0; i<n; ++i)
+    {
+        cemINT8 first = strong_first[i];
+        cemINT8 last = first + strong_offsets[i+1] - strong_offsets[i];
+        if (aggregates[i] >= 0 || first == last)
+            continue;
+
+        cemBOOL all_free = true;
+        for (cemINT8 k=first; k<last && all_free; ++k)
+            all_free = aggregates[strong_columns[k]] < 0;
+
+        if (!all_free)
+            continue;
+
+        aggregates[i] = num_aggregates;
+        for (cemINT8 k=first; k<last; ++k)
+            aggregates[strong_columns[k]] = num_aggregates;
+        ++num_aggregates;
+    }
+
+    // Phase 2:
+    std::vector<cemINT> phase1(aggregates);
+    for (cemINT i=0; i<n; ++i)
+    {
+        if (aggregates[i] >= 0)
+            continue;
+
+        cemINT8 first = strong_first[i];
+        cemINT8 last = first + strong_offsets[i+1] - strong_offsets[i];
+        for (cemINT8 k=first; k<last; ++k)
+        {
+            if (phase1[strong_columns[k]] >= 0)
+            {
+                aggregates[i] = phase1[strong_columns[k]];
+                break;
+            }
+        }
+    }
+
+    // Phase 3:
+    for (cemINT i=0; i<n; ++i)
+    {
+        if (aggregates[i] >= 0)
+            continue;
+
+        aggregates[i] = num_aggregates;
+        cemINT8 first = strong_first[i];
+        cemINT8 last = first + strong_offsets[i+1] - strong_offsets[i];
+        for (cemINT8 k=first; k<last; ++k)
+        {
+            if (aggregates[strong_columns[k]] < 0)
+                aggregates[strong_columns[k]] = num_aggregates;
+        }
+        ++num_aggregates;
+    }
+
+    return num_aggregates;
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::SetUpProlongationPattern : Pattern of \f$ P = (I - \omega D^{-1}A)
+ * P_0 \f$ (that of \f$ AP_0 \f$) and the entry of P each entry of A adds to.
+ * @param [in] level : level with aggregates
+ * @param [in] num_aggregates : number of aggregates (columns of P) */
+//************************************************************************************************//
+void AMGPreconditioner::SetUpProlongationPattern(const cemINT& level,
+                                                 const cemINT& num_aggregates)
+{
+    Level& L = levels_[level];
+    const SparseMatrix<cemDOUBLE>& A = LevelMatrix(level);
+    cemINT n = A.num_rows();
+
+    // Tentative prolongation, one entry per row:
+    std::vector<cemINT8> row_offsets(n+1);
+    for (cemINT i=0; i<=n; ++i)
+        row_offsets[i] = i;
+    SparseMatrix<cemDOUBLE> P0;
+    P0.set_pattern(n,num_aggregates,row_offsets,L.aggregates);
+
+    SparseProductPattern(A,P0,L.P);
+
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    const cemINT8* offsets_p = L.P.row_offsets();
+    const cemINT* columns_p = L.P.column_indices();
+    const cemINT* aggregates = &L.aggregates[0];
+    L.prolongation_slots.resize(A.num_entries());
+    cemINT8* slots = &L.prolongation_slots[0];
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<n; ++i)
+    {
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+            slots[k] = std::lower_bound(columns_p + offsets_p[i],columns_p + offsets_p[i+1],
+                                        aggregates[columns[k]]) - columns_p;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::SetUpSmoother : Inverse diagonal, work vectors and largest
+ * eigenvalue of \f$ D^{-1}A \f$ of a level.
+ *
+ * The eigenvalue is the Rayleigh quotient \f$ v^T A v / v^T D v \f$ after POWER_ITERATIONS
+ * iterations \f$ v \leftarrow D^{-1} A v \f$.
+ * @param [in] level : level */
+//************************************************************************************************//
+void AMGPreconditioner::SetUpSmoother(const cemINT& level)
+{
+    Level& L = levels_[level];
+    const SparseMatrix<cemDOUBLE>& A = LevelMatrix(level);
+    cemINT n = A.num_rows();
+    std::vector<cemINT8> diagonal = DiagonalPositions(A);
+
+    L.inverse_diagonal.resize(n);
+    for (cemINT i=0; i<n; ++i)
+        L.inverse_diagonal[i] = 1.0/A.values()[diagonal[i]];
+
+    L.x.resize(n);
+    L.b.resize(n);
+    L.r.resize(n);
+    L.d.resize(n);
+    L.q.resize(n);
+    L.lambda_max = 1.0;
+    if (n == 0)
+        return;
+
+    cemDOUBLE* v = &L.d[0];
+    cemDOUBLE* w = &L.q[0];
+    const cemDOUBLE* inverse_diagonal = &L.inverse_diagonal[0];
+    for (cemINT i=0; i<n; ++i)
+        v[i] = static_cast<cemDOUBLE>((i*7919 + 13)%1009)/1009.0 - 0.5;
+
+    for (cemINT it=0; it<POWER_ITERATIONS; ++it)
+    {
+        cemDOUBLE vAv = SparseMultiplyDot(A,v,w);
+        cemDOUBLE vDv = 0.0;
+        cemDOUBLE norm2 = 0.0;
+
+        #pragma omp parallel for schedule(static) reduction(+:vDv,norm2)
+        for (cemINT i=0; i<n; ++i)
+        {
+            vDv += v[i]*v[i]/inverse_diagonal[i];
+            v[i] = inverse_diagonal[i]*w[i];
+            norm2 += v[i]*v[i];
+        }
+
+        L.lambda_max = vAv/vDv;
+        if (norm2 == 0.0)
+            break;
+
+        cemDOUBLE scale = 1.0/std::sqrt(norm2);
+        for (cemINT i=0; i<n; ++i)
+            v[i] *= scale;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::FactorizeCoarse : Dense Cholesky factorization of the coarsest
+ * matrix (skipped if it has more than MAX_DIRECT_SIZE rows; it is then only smoothed). */
+//************************************************************************************************//
+void AMGPreconditioner::FactorizeCoarse()
+{
+    const SparseMatrix<cemDOUBLE>& A = LevelMatrix(num_levels()-1);
+    cemINT n = A.num_rows();
+    coarse_factor_.clear();
+    if (n > MAX_DIRECT_SIZE)
+        return;
+
+    // Lower triangle, row-major:
+    coarse_factor_.assign(static_cast<size_t>(n)*n,0.0);
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    for (cemINT i=0; i<n; ++i)
+    {
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+        {
+            if (columns[k] <= i)
+                coarse_factor_[static_cast<size_t>(i)*n + columns[k]] = A.values()[k];
+        }
+    }
+
+    for (cemINT j=0; j<n; ++j)
+    {
+        cemDOUBLE* row_j = &coarse_factor_[static_cast<size_t>(j)*n];
+        cemDOUBLE pivot = row_j[j];
+        for (cemINT k=0; k<j; ++k)
+            pivot -= row_j[k]*row_j[k];
+
+        if (!(pivot > 0.0))
+            throw(Exception("FACTORIZATION ERROR","Coarsest AMG matrix is not positive definite"));
+
+        row_j[j] = std::sqrt(pivot);
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT i=j+1; i<n; ++i)
+        {
+            cemDOUBLE* row_i = &coarse_factor_[static_cast<size_t>(i)*n];
+            cemDOUBLE sum = row_i[j];
+            for (cemINT k=0; k<j; ++k)
+                sum -= row_i[k]*row_j[k];
+            row_i[j] = sum/row_j[j];
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::Smooth : Chebyshev smoother of degree smoother_degree() for
+ * \f$ Ax = b \f$ on a level, on the interval \f$ [\lambda/30, 1.1\lambda] \f$ of
+ * \f$ D^{-1}A \f$.
+ * @param [in] level : level (uses its b and updates its x)
+ * @param [in] zero_initial_guess : start from x = 0 instead of the current x */
+//************************************************************************************************//
+void AMGPreconditioner::Smooth(const cemINT& level, const cemBOOL& zero_initial_guess) const
+{
+    const Level& L = levels_[level];
+    const SparseMatrix<cemDOUBLE>& A = LevelMatrix(level);
+    cemINT n = A.num_rows();
+    if (n == 0)
+        return;
+
+    cemDOUBLE* x = &L.x[0];
+    const cemDOUBLE* b = &L.b[0];
+    cemDOUBLE* r = &L.r[0];
+    cemDOUBLE* d = &L.d[0];
+    cemDOUBLE* q = &L.q[0];
+    const cemDOUBLE* inverse_diagonal = &L.inverse_diagonal[0];
+
+    cemDOUBLE upper = 1.1*L.lambda_max;
+    cemDOUBLE lower = upper/30.0;
+    cemDOUBLE theta = 0.5*(upper + lower);
+    cemDOUBLE delta = 0.5*(upper - lower);
+    cemDOUBLE sigma = theta/delta;
+    cemDOUBLE rho = 1.0/sigma;
+
+    if (zero_initial_guess)
+    {
+        #pragma omp parallel for schedule(static)
+        for (cemINT i=0; i<n; ++i)
+        {
+            x[i] = 0.0;
+            r[i] = b[i];
+            d[i] = inverse_diagonal[i]*b[i]/theta;
+        }
+    }
+    else
+    {
+        A.multiply(x,q);
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT i=0; i<n; ++i)
+        {
+            r[i] = b[i] - q[i];
+            d[i] = inverse_diagonal[i]*r[i]/theta;
+        }
+    }
+
+    for (cemINT k=1; ; ++k)
+    {
+        #pragma omp parallel for schedule(static)
+        for (cemINT i=0; i<n; ++i)
+            x[i] += d[i];
+
+        if (k == smoother_degree_)
+            break;
+
+        A.multiply(d,q);
+        cemDOUBLE rho_new = 1.0/(2.0*sigma - rho);
+        cemDOUBLE c1 = rho_new*rho;
+        cemDOUBLE c2 = 2.0*rho_new/delta;
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT i=0; i<n; ++i)
+        {
+            r[i] -= q[i];
+            d[i] = c1*d[i] + c2*inverse_diagonal[i]*r[i];
+        }
+        rho = rho_new;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief AMGPreconditioner::Cycle : V-cycle from a level down, \f$ x \approx A^{-1} b \f$ with
+ * the b and x of the level.
+ * @param [in] level : level */
+//************************************************************************************************//
+void AMGPreconditioner::Cycle(const cemINT& level) const
+{
+    const Level& L = levels_[level];
+    cemINT n = static_cast<cemINT>(L.x.size());
+
+    // Coarsest level:
+    if (level == num_levels()-1)
+    {
+        if (coarse_factor_.empty())
+        {
+            Smooth(level,true);
+            Smooth(level,false);
+            return;
+        }
+
+        cemDOUBLE* x = n > 0 ? &L.x[0] : NULL;
+        for (cemINT i=0; i<n; ++i)
+        {
+            const cemDOUBLE* row = &coarse_factor_[static_cast<size_t>(i)*n];
+            cemDOUBLE sum = L.b[i];
+            for (cemINT k=0; k<i; ++k)
+                sum -= row[k]*x[k];
+            x[i] = sum/row[i];
+        }
+        for (cemINT i=n-1; i>=0; --i)
+        {
+            const cemDOUBLE* row = &coarse_factor_[static_cast<size_t>(i)*n];
+            x[i] /= row[i];
+            for (cemINT k=0; k<i; ++k)
+                x[k] -= row[k]*x[i];
+        }
+        return;
+    }
+
+    // Pre-smoothing and restriction of the residual:
+    Smooth(level,true);
+    LevelMatrix(level).multiply(&L.x[0],&L.q[0]);
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<n; ++i)
+        L.r[i] = L.b[i] - L.q[i];
+
+    const Level& coarse = levels_[level+1];
+    L.R.multiply(&L.r[0],&coarse.b[0]);
+    Cycle(level+1);
+
+    // Coarse correction and post-smoothing:
+    L.P.multiply(&coarse.x[0],&L.q[0]);
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<n; ++i)
+        L.x[i] += L.q[i];
+
+    Smooth(level,false);
+}
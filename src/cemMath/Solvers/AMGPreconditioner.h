@@ -0,0 +1,106 @@
+#ifndef AMGPRECONDITIONER_H
+#define AMGPRECONDITIONER_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/SparseMatrix.h"
+#include "Preconditioners.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+//************************************************************************************************//
+/** @brief The AMGPreconditioner class : Smoothed-aggregation algebraic multigrid, one V-cycle per
+ * application.
+ *
+ * Each level groups strongly connected rows (\f$ |a_{ij}| > \theta \sqrt{a_{ii} a_{jj}} \f$) into
+ * aggregates, builds the tentative prolongation \f$ P_0 \f$ (one column of ones per aggregate),
+ * smooths it with one Jacobi step, \f$ P = (I - \frac{4}{3\lambda} D^{-1} A) P_0 \f$, and forms the
+ * Galerkin coarse matrix \f$ A_c = P^T A P \f$. Coarsening stops at coarse_size() rows, where a
+ * dense Cholesky factorization is used. The smoother is a Chebyshev polynomial in
+ * \f$ D^{-1} A \f$, applied before and after the coarse correction so the cycle is symmetric and
+ * can precondition CG. \f$ \lambda \f$ is the largest eigenvalue of \f$ D^{-1} A \f$, estimated
+ * with a few power iterations.
+ *
+ * SetUp() keeps the aggregates and the patterns of all levels. When it is called again for a
+ * matrix with the same pattern (e.g. new conductivities in a thermal iteration), only the values
+ * of P, of the coarse matrices and of the smoothers are computed again. Products, smoothers and
+ * cycles are threaded with OpenMP; the aggregation itself is sequential.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class AMGPreconditioner : public Preconditioner
+{
+public:
+    // Default constructor:
+    AMGPreconditioner();
+
+    // Get data members:
+    cemINT num_levels() const;
+    cemINT num_level_rows(const cemINT& level) const;
+    cemDOUBLE operator_complexity() const;
+    cemINT num_structure_setups() const;
+    cemDOUBLE strength_threshold() const;
+    cemINT coarse_size() const;
+    cemINT max_levels() const;
+    cemINT smoother_degree() const;
+
+    // Set data members (take effect on the next SetUp() that builds the structure):
+    void set_strength_threshold(const cemDOUBLE& threshold);
+    void set_coarse_size(const cemINT& coarse_size);
+    void set_max_levels(const cemINT& max_levels);
+    void set_smoother_degree(const cemINT& degree);
+
+    void SetUp(const SparseMatrix<cemDOUBLE>& A);
+    void Apply(const cemDOUBLE* r, cemDOUBLE* z) const;
+
+private:
+    /** @brief The Level struct : Matrices and work vectors of one level. */
+    struct Level
+    {
+        SparseMatrix<cemDOUBLE> A;                  //!< Matrix of the level (not used on level 0).
+        SparseMatrix<cemDOUBLE> P;                  //!< Prolongation to this level from the next.
+        SparseMatrix<cemDOUBLE> R;                  //!< Restriction, \f$ P^T \f$.
+        SparseMatrix<cemDOUBLE> AP;                 //!< \f$ AP \f$.
+        std::vector<cemINT> aggregates;             //!< Aggregate of each row.
+        std::vector<cemINT8> prolongation_slots;    //!< Entry of P of each entry of A.
+        std::vector<cemINT8> transpose_positions;   //!< Entry of P of each entry of R.
+        std::vector<cemDOUBLE> inverse_diagonal;    //!< \f$ 1/a_{ii} \f$.
+        cemDOUBLE lambda_max;                       //!< Largest eigenvalue of \f$ D^{-1}A \f$.
+        mutable std::vector<cemDOUBLE> x, b, r, d, q;   //!< Work vectors of the cycle.
+    };
+
+    cemDOUBLE strength_threshold_;          //!< \f$ \theta \f$ of the strength of connection.
+    cemINT coarse_size_;                    //!< Rows at which coarsening stops.
+    cemINT max_levels_;                     //!< Maximum number of levels.
+    cemINT smoother_degree_;                //!< Degree of the Chebyshev smoother.
+    cemINT num_structure_setups_;           //!< Times the aggregates and patterns were built.
+    const SparseMatrix<cemDOUBLE>* fine_matrix_;    //!< Matrix of the last SetUp() (level 0).
+    std::vector<cemINT8> fine_row_offsets_; //!< Pattern of the fine matrix of the structure.
+    std::vector<cemINT> fine_columns_;      //!< Pattern of the fine matrix of the structure.
+    std::vector<Level> levels_;             //!< Levels, finest first.
+    std::vector<cemDOUBLE> coarse_factor_;  //!< Dense Cholesky factor of the coarsest matrix.
+
+    static const cemINT MAX_DIRECT_SIZE = 4000;     //!< Largest coarsest level solved directly.
+    static const cemINT POWER_ITERATIONS = 15;      //!< Iterations of the eigenvalue estimate.
+
+    // Private member functions:
+    const SparseMatrix<cemDOUBLE>& LevelMatrix(const cemINT& level) const;
+    cemBOOL HasSameStructure(const SparseMatrix<cemDOUBLE>& A) const;
+    void SetUpStructure(const SparseMatrix<cemDOUBLE>& A);
+    void SetUpLevelValues(const cemINT& level);
+    cemINT Aggregate(const cemINT& level);
+    void SetUpProlongationPattern(const cemINT& level, const cemINT& num_aggregates);
+    void SetUpSmoother(const cemINT& level);
+    void FactorizeCoarse();
+    void Smooth(const cemINT& level, const cemBOOL& zero_initial_guess) const;
+    void Cycle(const cemINT& level) const;
+};
+
+
+}
+
+
+
+#endif // AMGPRECONDITIONER_H
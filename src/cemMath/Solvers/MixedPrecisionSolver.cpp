@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "MixedPrecisionSolver.h"
+#include "VectorKernels.h"
+#include "SolverTimer.h"
+#include "cemError.h"
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+//! Smallest reduction of the residual per refinement step before falling back to double.
+static const cemDOUBLE STAGNATION_FACTOR = 0.5;
+
+
+///***********************************************************************************************//
+/// CLASS MixedPrecisionSolver:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::MixedPrecisionSolver : Constructor with parameters.
+ * @param [in] ordering : fill-reducing ordering of the factorization */
+//************************************************************************************************//
+MixedPrecisionSolver::MixedPrecisionSolver(const OrderingType& ordering)
+    : cholesky_(ordering)
+{
+    matrix_ = NULL;
+    matrix_norm_ = 0.0;
+    tolerance_ = 1.0e-12;
+    max_refinements_ = 10;
+    num_fallbacks_ = 0;
+    cholesky_.set_precision(SINGLE_PRECISION);
+}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::tolerance : Gets relative residual to stop at.
+ * @return : tolerance_ */
+//************************************************************************************************//
+cemDOUBLE MixedPrecisionSolver::tolerance() const {return tolerance_;}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::max_refinements : Gets refinement steps before falling back to a
+ * double precision factor.
+ * @return : max_refinements_ */
+//************************************************************************************************//
+cemINT MixedPrecisionSolver::max_refinements() const {return max_refinements_;}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::precision : Gets precision of the current factor.
+ * @return : SINGLE_PRECISION, or DOUBLE_PRECISION after a fallback (until the next SetUp()) */
+//************************************************************************************************//
+FactorPrecision MixedPrecisionSolver::precision() const {return cholesky_.precision();}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::num_fallbacks : Gets number of double precision factorizations.
+ * @return : num_fallbacks_ */
+//************************************************************************************************//
+cemINT MixedPrecisionSolver::num_fallbacks() const {return num_fallbacks_;}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::cholesky : Gets the factorization.
+ * @return : cholesky_ */
+//************************************************************************************************//
+const SparseCholesky& MixedPrecisionSolver::cholesky() const {return cholesky_;}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::telemetry : Gets refinement steps (num_iterations) and residuals
+ * of the last Solve().
+ * @return : telemetry_ */
+//************************************************************************************************//
+const SolverTelemetry& MixedPrecisionSolver::telemetry() const {return telemetry_;}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::set_tolerance : Sets relative residual to stop at.
+ * @param [in] tolerance : positive tolerance */
+//************************************************************************************************//
+void MixedPrecisionSolver::set_tolerance(const cemDOUBLE& tolerance)
+{
+    if (tolerance <= 0.0)
+        throw(Exception("INPUT ERROR","Tolerance must be positive"));
+
+    tolerance_ = tolerance;
+}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::set_max_refinements : Sets refinement steps before falling back
+ * to a double precision factor.
+ * @param [in] max_refinements : non-negative number of steps */
+//************************************************************************************************//
+void MixedPrecisionSolver::set_max_refinements(const cemINT& max_refinements)
+{
+    if (max_refinements < 0)
+        throw(Exception("INPUT ERROR","Maximum number of refinements must be non-negative"));
+
+    max_refinements_ = max_refinements;
+}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::SetUp : Factorizes a matrix in single precision (in double if it
+ * is not positive definite in single precision).
+ * @param [in] A : symmetric positive definite matrix (must outlive the solves) */
+//************************************************************************************************//
+void MixedPrecisionSolver::SetUp(const SparseMatrix<cemDOUBLE>& A)
+{
+    cemDOUBLE start = WallTime();
+    matrix_ = &A;
+    r_.resize(A.num_rows());
+    d_.resize(A.num_rows());
+
+    // Infinity norm, for the backward error:
+    cemINT n = A.num_rows();
+    const cemINT8* offsets = A.row_offsets();
+    const cemDOUBLE* values = A.values();
+    cemDOUBLE norm = 0.0;
+    #pragma omp parallel for schedule(static) reduction(max:norm)
+    for (cemINT i=0; i<n; ++i)
+    {
+        cemDOUBLE sum = 0.0;
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+            sum += std::fabs(values[k]);
+        norm = std::max(norm,sum);
+    }
+    matrix_norm_ = norm;
+
+    cholesky_.set_precision(SINGLE_PRECISION);
+    try
+    {
+        cholesky_.Factorize(A);
+    }
+    catch (Exception&)
+    {
+        FallBack();
+    }
+    telemetry_.setup_time = WallTime() - start;
+}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::Solve : Solves \f$ Ax = b \f$ with iterative refinement.
+ *
+ * Uses the factor left by SetUp() or by the last fallback: once the matrix has been factorized in
+ * double precision, every later Solve() uses that factor until the next SetUp().
+ * @param [in] b : right-hand side, num_rows() values
+ * @param [out] x : solution, num_rows() values
+ * @return : true if the tolerance was reached, false if refinement with the double precision
+ * factor stagnated first (see telemetry() for details) */
+//************************************************************************************************//
+cemBOOL MixedPrecisionSolver::Solve(const cemDOUBLE* b, cemDOUBLE* x)
+{
+    if (matrix_ == NULL)
+        throw(Exception("SOLVER ERROR","SetUp() must be called before Solve()"));
+
+    cemDOUBLE start = WallTime();
+    cemINT n = matrix_->num_rows();
+    telemetry_.num_iterations = 0;
+    telemetry_.residual_history.clear();
+
+    cemDOUBLE norm_b = std::sqrt(VectorDot(n,b,b));
+    if (norm_b == 0.0)
+    {
+        for (cemINT i=0; i<n; ++i)
+            x[i] = 0.0;
+        telemetry_.converged = true;
+        telemetry_.initial_residual = 0.0;
+        telemetry_.final_residual = 0.0;
+        telemetry_.solve_time = WallTime() - start;
+        return true;
+    }
+
+    // Backward error reachable in double precision (as in LAPACK's dsposv):
+    cemDOUBLE backward_tolerance = std::sqrt(static_cast<cemDOUBLE>(n))*
+                                   std::numeric_limits<cemDOUBLE>::epsilon();
+
+    cholesky_.Solve(b,x);
+    cemDOUBLE backward_error;
+    cemDOUBLE residual = Residual(b,x,backward_error)/norm_b;
+    telemetry_.initial_residual = residual;
+    telemetry_.residual_history.push_back(residual);
+
+    // Refinement, x += L^-T L^-1 (b - Ax), with at least one step once the factor is in double
+    // precision (after a fallback here or in SetUp()), even if max_refinements() is 0:
+    cemINT num_steps = 0;
+    cemDOUBLE previous = 0.0;
+    while (residual > tolerance_ && backward_error > backward_tolerance)
+    {
+        cemINT max_steps = max_refinements_;
+        if (cholesky_.precision() == DOUBLE_PRECISION)
+            max_steps = std::max(max_refinements_,1);
+
+        cemBOOL stagnated = num_steps >= max_steps ||
+                            (num_steps > 0 && residual > STAGNATION_FACTOR*previous);
+        if (stagnated)
+        {
+            if (cholesky_.precision() == DOUBLE_PRECISION)
+                break;
+
+            FallBack();
+            num_steps = 0;
+        }
+
+        cholesky_.Solve(&r_[0],&d_[0]);
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT i=0; i<n; ++i)
+            x[i] += d_[i];
+
+        previous = residual;
+        residual = Residual(b,x,backward_error)/norm_b;
+        ++num_steps;
+        ++telemetry_.num_iterations;
+        telemetry_.residual_history.push_back(residual);
+    }
+
+    telemetry_.converged = residual <= tolerance_ || backward_error <= backward_tolerance;
+    telemetry_.final_residual = residual;
+    telemetry_.solve_time = WallTime() - start;
+    return telemetry_.converged;
+}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::FallBack : Factorizes the matrix again in double precision. */
+//************************************************************************************************//
+void MixedPrecisionSolver::FallBack()
+{
+    cholesky_.set_precision(DOUBLE_PRECISION);
+    cholesky_.Factorize(*matrix_);
+    ++num_fallbacks_;
+}
+
+
+//************************************************************************************************//
+/** @brief MixedPrecisionSolver::Residual : Computes \f$ r = b - Ax \f$ in double precision.
+ * @param [in] b : right-hand side
+ * @param [in] x : current solution
+ * @param [out] backward_error : \f$ \|r\|_\infty / (\|A\|_\infty \|x\|_\infty) \f$
+ * @return : \f$ \|r\| \f$ (r is left in r_) */
+//************************************************************************************************//
+cemDOUBLE MixedPrecisionSolver::Residual(const cemDOUBLE* b,
+                                         const cemDOUBLE* x,
+                                         cemDOUBLE& backward_error)
+{
+    cemINT n = matrix_->num_rows();
+    cemDOUBLE* r = &r_[0];
+    matrix_->multiply(x,r);
+
+    cemDOUBLE sum = 0.0;
+    cemDOUBLE max_r = 0.0;
+    cemDOUBLE max_x = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:sum) reduction(max:max_r,max_x)
+    for (cemINT i=0; i<n; ++i)
+    {
+        r[i] = b[i] - r[i];
+        sum += r[i]*r[i];
+        max_r = std::max(max_r,std::fabs(r[i]));
+        max_x = std::max(max_x,std::fabs(x[i]));
+    }
+
+    backward_error = max_x > 0.0 ? max_r/(matrix_norm_*max_x) : 1.0;
+    return std::sqrt(sum);
+}
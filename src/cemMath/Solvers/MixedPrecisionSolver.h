@@ -0,0 +1,80 @@
+#ifndef MIXEDPRECISIONSOLVER_H
+#define MIXEDPRECISIONSOLVER_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/SparseMatrix.h"
+#include "PCGSolver.h"
+#include "SparseCholesky.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+//************************************************************************************************//
+/** @brief The MixedPrecisionSolver class : Direct solver with a single precision factor refined to
+ * double precision accuracy.
+ *
+ * SetUp() factorizes the matrix in single precision, which halves the memory of the factor and
+ * the bytes streamed by each substitution. Solve() computes \f$ x_0 = L^{-T}L^{-1}b \f$ and then
+ * iterative refinement: the residual \f$ r = b - Ax \f$ is computed in double precision with the
+ * original matrix, the correction \f$ L^{-T}L^{-1}r \f$ with the single precision factor. Each
+ * step gains about \f$ -\log_{10}(10^{-7}\kappa(A)) \f$ digits, so a few steps are enough when
+ * \f$ \kappa(A) \f$ is well below \f$ 10^7 \f$. Refinement stops at the relative residual
+ * tolerance() or, as in LAPACK's dsposv, when the backward error
+ * \f$ \|r\|_\infty / (\|A\|_\infty \|x\|_\infty) \f$ is below \f$ \sqrt{n}\,\epsilon \f$, i.e. as
+ * accurate as a double precision factor would be.
+ *
+ * If a step does not reduce the residual by STAGNATION_FACTOR, or max_refinements() steps are not
+ * enough, the matrix is factorized again in double precision and refinement continues from the
+ * current solution for at least one step, even with max_refinements() = 0 (one step is usually
+ * enough). The same happens in SetUp() if the matrix is not positive definite in single precision.
+ * The double precision factor is then used by every later Solve(), since the next right-hand
+ * side would most likely fall back again; only the next SetUp() returns to single precision.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class MixedPrecisionSolver
+{
+public:
+    // Constructor with parameters:
+    MixedPrecisionSolver(const OrderingType& ordering = NESTED_DISSECTION);
+
+    // Get data members:
+    cemDOUBLE tolerance() const;
+    cemINT max_refinements() const;
+    FactorPrecision precision() const;
+    cemINT num_fallbacks() const;
+    const SparseCholesky& cholesky() const;
+    const SolverTelemetry& telemetry() const;
+
+    // Set data members:
+    void set_tolerance(const cemDOUBLE& tolerance);
+    void set_max_refinements(const cemINT& max_refinements);
+
+    // Solve:
+    void SetUp(const SparseMatrix<cemDOUBLE>& A);
+    cemBOOL Solve(const cemDOUBLE* b, cemDOUBLE* x);
+
+private:
+    const SparseMatrix<cemDOUBLE>* matrix_; //!< Matrix of the last SetUp() (not owned).
+    cemDOUBLE matrix_norm_;                 //!< \f$ \|A\|_\infty \f$.
+    SparseCholesky cholesky_;               //!< Single (or, after a fallback, double) factor.
+    cemDOUBLE tolerance_;                   //!< Relative residual to stop at.
+    cemINT max_refinements_;                //!< Refinement steps before falling back.
+    cemINT num_fallbacks_;                  //!< Times the matrix was factorized in double.
+    SolverTelemetry telemetry_;             //!< Refinement steps and residuals of the last Solve().
+    std::vector<cemDOUBLE> r_;              //!< Residual.
+    std::vector<cemDOUBLE> d_;              //!< Correction.
+
+    // Private member functions:
+    void FallBack();
+    cemDOUBLE Residual(const cemDOUBLE* b, const cemDOUBLE* x, cemDOUBLE& backward_error);
+};
+
+
+}
+
+
+
+#endif // MIXEDPRECISIONSOLVER_H
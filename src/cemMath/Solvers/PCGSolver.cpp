@@ -0,0 +1,447 @@
+#include <cmath>
+#include <algorithm>
+#include "PCGSolver.h"
+#include "VectorKernels.h"
+#include "SolverTimer.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+
+///***********************************************************************************************//
+/// STRUCT SolverTelemetry:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SolverTelemetry::SolverTelemetry : Default constructor (nothing solved). */
+//************************************************************************************************//
+SolverTelemetry::SolverTelemetry()
+{
+    num_iterations = 0;
+    converged = false;
+    initial_residual = 0.0;
+    final_residual = 0.0;
+    setup_time = 0.0;
+    solve_time = 0.0;
+}
+
+
+//************************************************************************************************//
+/** @brief SolverTelemetry::Print : Prints a one-line summary of the solve.
+ * @param [in,out] out : output stream */
+//************************************************************************************************//
+void SolverTelemetry::Print(std::ostream& out) const
+{
+    out << (converged ? "Converged" : "Not converged") << " in " << num_iterations
+        << " iterations, relative residual " << initial_residual << " -> " << final_residual
+        << ", setup " << setup_time << " s, solve " << solve_time << " s" << std::endl;
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS PCGSolver:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief PCGSolver::PCGSolver : Constructor with parameters.
+ * @param [in] type : preconditioner (JACOBI, SSOR, IC0 or AMG) */
+//************************************************************************************************//
+PCGSolver::PCGSolver(const PreconditionerType& type)
+{
+    matrix_ = NULL;
+    preconditioner_ = NULL;
+    tolerance_ = 1.0e-8;
+    max_iterations_ = 1000;
+    record_history_ = false;
+    set_preconditioner_type(type);
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::~PCGSolver : Destructor. */
+//************************************************************************************************//
+PCGSolver::~PCGSolver()
+{
+    CLEAN(preconditioner_);
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::tolerance : Gets relative residual to stop at.
+ * @return : tolerance_ */
+//************************************************************************************************//
+cemDOUBLE PCGSolver::tolerance() const {return tolerance_;}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::max_iterations : Gets maximum number of iterations.
+ * @return : max_iterations_ */
+//************************************************************************************************//
+cemINT PCGSolver::max_iterations() const {return max_iterations_;}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::preconditioner_type : Gets type of preconditioner.
+ * @return : preconditioner_type_ */
+//************************************************************************************************//
+PreconditionerType PCGSolver::preconditioner_type() const {return preconditioner_type_;}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::preconditioner : Gets the preconditioner.
+ * @return : preconditioner_ */
+//************************************************************************************************//
+const Preconditioner* PCGSolver::preconditioner() const {return preconditioner_;}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::telemetry : Gets convergence and timing of the last SetUp() and Solve().
+ * @return : telemetry_ */
+//************************************************************************************************//
+const SolverTelemetry& PCGSolver::telemetry() const {return telemetry_;}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::set_tolerance : Sets relative residual to stop at.
+ * @param [in] tolerance : \f$ \|r\|/\|b\| \f$ to reach (> 0) */
+//************************************************************************************************//
+void PCGSolver::set_tolerance(const cemDOUBLE& tolerance)
+{
+    if (tolerance <= 0.0)
+        throw(Exception("INPUT ERROR","Tolerance must be positive"));
+
+    tolerance_ = tolerance;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::set_max_iterations : Sets maximum number of iterations.
+ * @param [in] max_iterations : maximum number of iterations (>= 0) */
+//************************************************************************************************//
+void PCGSolver::set_max_iterations(const cemINT& max_iterations)
+{
+    if (max_iterations < 0)
+        throw(Exception("INPUT ERROR","Maximum number of iterations must be >= 0"));
+
+    max_iterations_ = max_iterations;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::set_preconditioner_type : Sets the preconditioner (SetUp() must be called
+ * again before solving).
+ * @param [in] type : JACOBI, SSOR, IC0 or AMG
+ * @param [in] omega : relaxation factor of SSOR */
+//************************************************************************************************//
+void PCGSolver::set_preconditioner_type(const PreconditionerType& type, const cemDOUBLE& omega)
+{
+    Preconditioner* preconditioner = Preconditioner::Create(type,omega);
+    CLEAN(preconditioner_);
+    preconditioner_ = preconditioner;
+    preconditioner_type_ = type;
+    matrix_ = NULL;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::set_record_history : Sets whether the residual of every iteration is kept
+ * in telemetry().residual_history.
+ * @param [in] record_history : true to keep the history */
+//************************************************************************************************//
+void PCGSolver::set_record_history(const cemBOOL& record_history)
+{
+    record_history_ = record_history;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::SetUp : Sets up the preconditioner for a matrix. Call it again whenever the
+ * values of the matrix change.
+ * @param [in] A : symmetric positive definite matrix (must outlive the solves) */
+//************************************************************************************************//
+void PCGSolver::SetUp(const SparseMatrix<cemDOUBLE>& A)
+{
+    cemDOUBLE start = WallTime();
+    preconditioner_->SetUp(A);
+    matrix_ = &A;
+
+    cemINT n = A.num_rows();
+    r_.resize(n);
+    z_.resize(n);
+    p_.resize(n);
+    q_.resize(n);
+    telemetry_.setup_time = WallTime() - start;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::UpdateMatrix : Solves with a changed matrix but keeps the preconditioner of
+ * the last SetUp().
+ *
+ * Meant for local changes (a few elements with a new conductivity): the old preconditioner is
+ * still symmetric positive definite and close to the new matrix, so CG converges with it, and
+ * passing the previous solution to Solve() as the initial guess leaves only the local correction
+ * to be found.
+ * @param [in] A : symmetric positive definite matrix of the same size (must outlive the solves) */
+//************************************************************************************************//
+void PCGSolver::UpdateMatrix(const SparseMatrix<cemDOUBLE>& A)
+{
+    if (matrix_ == NULL)
+        throw(Exception("SOLVER ERROR","SetUp() must be called before UpdateMatrix()"));
+    if (A.num_rows() != matrix_->num_rows())
+        throw(Exception("INPUT ERROR","Updated matrix must have " +
+                        cem_utils::NumberToString<cemINT>(matrix_->num_rows()) + " rows"));
+
+    matrix_ = &A;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::Solve : Solves \f$ Ax = b \f$.
+ * @param [in] b : right-hand side, num_rows() values
+ * @param [in,out] x : initial guess on entry, solution on exit
+ * @return : true if the tolerance was reached (see telemetry() for details) */
+//************************************************************************************************//
+cemBOOL PCGSolver::Solve(const cemDOUBLE* b, cemDOUBLE* x)
+{
+    if (matrix_ == NULL)
+        throw(Exception("SOLVER ERROR","SetUp() must be called before Solve()"));
+
+    cemDOUBLE start = WallTime();
+    cemINT n = matrix_->num_rows();
+    telemetry_.num_iterations = 0;
+    telemetry_.converged = false;
+    telemetry_.residual_history.clear();
+
+    cemDOUBLE norm_b = std::sqrt(VectorDot(n,b,b));
+    if (norm_b == 0.0)
+    {
+        for (cemINT i=0; i<n; ++i)
+            x[i] = 0.0;
+        telemetry_.converged = true;
+        telemetry_.initial_residual = 0.0;
+        telemetry_.final_residual = 0.0;
+        telemetry_.solve_time = WallTime() - start;
+        return true;
+    }
+
+    cemDOUBLE* r = &r_[0];
+    cemDOUBLE* z = &z_[0];
+    cemDOUBLE* p = &p_[0];
+    cemDOUBLE* q = &q_[0];
+
+    // r = b - Ax:
+    matrix_->multiply(x,q);
+    for (cemINT i=0; i<n; ++i)
+        r[i] = b[i] - q[i];
+
+    cemDOUBLE residual = std::sqrt(VectorDot(n,r,r))/norm_b;
+    telemetry_.initial_residual = residual;
+    if (residual > tolerance_)
+    {
+        cemDOUBLE rho = preconditioner_->ApplyDot(r,z);
+        for (cemINT i=0; i<n; ++i)
+            p[i] = z[i];
+
+        while (telemetry_.num_iterations < max_iterations_)
+        {
+            cemDOUBLE pq = SparseMultiplyDot(*matrix_,p,q);
+            if (!(pq > 0.0))
+                break;  // Matrix (or preconditioner) is not positive definite.
+
+            cemDOUBLE alpha = rho/pq;
+            residual = std::sqrt(VectorAxpyAxpyNorm2(n,alpha,p,q,x,r))/norm_b;
+            ++telemetry_.num_iterations;
+            if (record_history_)
+                telemetry_.residual_history.push_back(residual);
+
+            if (residual <= tolerance_)
+                break;
+
+            cemDOUBLE rho_new = preconditioner_->ApplyDot(r,z);
+            VectorXpay(n,z,rho_new/rho,p);
+            rho = rho_new;
+        }
+    }
+
+    telemetry_.final_residual = residual;
+    telemetry_.converged = residual <= tolerance_;
+    telemetry_.solve_time = WallTime() - start;
+    return telemetry_.converged;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::SolveBlock : Solves \f$ AX = B \f$ for several right-hand sides together.
+ *
+ * In telemetry(), num_iterations is that of the slowest column, initial_residual and
+ * final_residual are the largest over the columns, and residual_history has the largest residual
+ * of the columns still iterating.
+ * @param [in] num_rhs : number of right-hand sides
+ * @param [in] B : column-major num_rows() x num_rhs values (as in DenseMatrix)
+ * @param [in,out] X : initial guesses on entry, solutions on exit (same layout as B)
+ * @return : true if all columns reached the tolerance */
+//************************************************************************************************//
+cemBOOL PCGSolver::SolveBlock(const cemINT& num_rhs, const cemDOUBLE* B, cemDOUBLE* X)
+{
+    if (matrix_ == NULL)
+        throw(Exception("SOLVER ERROR","SetUp() must be called before Solve()"));
+
+    cemDOUBLE start = WallTime();
+    cemINT n = matrix_->num_rows();
+    cemINT8 ld = n;
+    telemetry_.num_iterations = 0;
+    telemetry_.converged = false;
+    telemetry_.initial_residual = 0.0;
+    telemetry_.final_residual = 0.0;
+    telemetry_.residual_history.clear();
+
+    // Columns still iterating are packed at the front of R, Z, P and Q:
+    block_.resize(4*ld*std::max(num_rhs,1));
+    cemDOUBLE* R = &block_[0];
+    cemDOUBLE* Z = R + ld*num_rhs;
+    cemDOUBLE* P = Z + ld*num_rhs;
+    cemDOUBLE* Q = P + ld*num_rhs;
+    std::vector<cemINT> columns(num_rhs);
+    std::vector<cemDOUBLE> norm_b(num_rhs),rho(num_rhs),residual(num_rhs);
+    std::vector<cemBOOL> breakdown(num_rhs,false);
+
+    // R = B - AX:
+    matrix_->multiply(num_rhs,X,Q);
+    cemINT num_active = 0;
+    for (cemINT v=0; v<num_rhs; ++v)
+    {
+        const cemDOUBLE* b = B + v*ld;
+        cemDOUBLE* x = X + v*ld;
+        cemDOUBLE nb = std::sqrt(VectorDot(n,b,b));
+        if (nb == 0.0)
+        {
+            std::fill(x,x + n,0.0);
+            continue;
+        }
+
+        cemDOUBLE* r = R + num_active*ld;
+        const cemDOUBLE* q = Q + v*ld;
+        for (cemINT i=0; i<n; ++i)
+            r[i] = b[i] - q[i];
+
+        cemDOUBLE res = std::sqrt(VectorDot(n,r,r))/nb;
+        telemetry_.initial_residual = std::max(telemetry_.initial_residual,res);
+        if (res <= tolerance_)
+        {
+            telemetry_.final_residual = std::max(telemetry_.final_residual,res);
+            continue;
+        }
+
+        columns[num_active] = v;
+        norm_b[num_active] = nb;
+        residual[num_active] = res;
+        ++num_active;
+    }
+
+    if (num_active > 0)
+    {
+        preconditioner_->ApplyBlock(num_active,R,Z);
+        for (cemINT s=0; s<num_active; ++s)
+        {
+            rho[s] = VectorDot(n,R + s*ld,Z + s*ld);
+            std::copy(Z + s*ld,Z + (s+1)*ld,P + s*ld);
+        }
+    }
+
+    while (num_active > 0 && telemetry_.num_iterations < max_iterations_)
+    {
+        matrix_->multiply(num_active,P,Q);
+        ++telemetry_.num_iterations;
+
+        cemDOUBLE largest = 0.0;
+        for (cemINT s=0; s<num_active; ++s)
+        {
+            cemDOUBLE* p = P + s*ld;
+            cemDOUBLE* q = Q + s*ld;
+            cemDOUBLE pq = VectorDot(n,p,q);
+            if (!(pq > 0.0))
+            {
+                breakdown[s] = true;    // Matrix (or preconditioner) is not positive definite.
+                continue;
+            }
+
+            cemDOUBLE alpha = rho[s]/pq;
+            cemDOUBLE* x = X + columns[s]*ld;
+            residual[s] = std::sqrt(VectorAxpyAxpyNorm2(n,alpha,p,q,x,R + s*ld))/norm_b[s];
+            largest = std::max(largest,residual[s]);
+        }
+
+        if (record_history_)
+            telemetry_.residual_history.push_back(largest);
+
+        // Converged (or broken down) columns leave the block, the last one takes their place:
+        for (cemINT s=num_active-1; s>=0; --s)
+        {
+            if (residual[s] > tolerance_ && !breakdown[s])
+                continue;
+
+            telemetry_.final_residual = std::max(telemetry_.final_residual,residual[s]);
+            --num_active;
+            if (s == num_active)
+                continue;
+
+            std::copy(R + num_active*ld,R + (num_active+1)*ld,R + s*ld);
+            std::copy(P + num_active*ld,P + (num_active+1)*ld,P + s*ld);
+            columns[s] = columns[num_active];
+            norm_b[s] = norm_b[num_active];
+            rho[s] = rho[num_active];
+            residual[s] = residual[num_active];
+            breakdown[s] = breakdown[num_active];
+        }
+
+        if (num_active == 0)
+            break;
+
+        preconditioner_->ApplyBlock(num_active,R,Z);
+        for (cemINT s=0; s<num_active; ++s)
+        {
+            cemDOUBLE rho_new = VectorDot(n,R + s*ld,Z + s*ld);
+            VectorXpay(n,Z + s*ld,rho_new/rho[s],P + s*ld);
+            rho[s] = rho_new;
+        }
+    }
+
+    for (cemINT s=0; s<num_active; ++s)
+        telemetry_.final_residual = std::max(telemetry_.final_residual,residual[s]);
+
+    telemetry_.converged = telemetry_.final_residual <= tolerance_;
+    telemetry_.solve_time = WallTime() - start;
+    return telemetry_.converged;
+}
+
+
+//************************************************************************************************//
+/** @brief PCGSolver::SolveBlock : Solves \f$ AX = B \f$ for the columns of a dense matrix.
+ * @param [in] B : num_rows() x num_rhs right-hand sides
+ * @param [in,out] X : initial guesses on entry if it has the size of B (otherwise resized and
+ * started from zero), solutions on exit
+ * @return : true if all columns reached the tolerance */
+//************************************************************************************************//
+cemBOOL PCGSolver::SolveBlock(const DenseMatrix<cemDOUBLE>& B, DenseMatrix<cemDOUBLE>& X)
+{
+    if (matrix_ == NULL)
+        throw(Exception("SOLVER ERROR","SetUp() must be called before Solve()"));
+
+    if (B.num_rows() != matrix_->num_rows())
+        throw(Exception("INPUT ERROR","Right-hand sides do not match the matrix"));
+
+    if (X.num_rows() != B.num_rows() || X.num_columns() != B.num_columns())
+    {
+        X.resize(B.num_rows(),B.num_columns());
+        X.initialize();
+    }
+
+    if (B.num_columns() == 0 || B.num_rows() == 0)
+        return true;
+
+    return SolveBlock(B.num_columns(),&B(0,0),&X(0,0));
+}
@@ -0,0 +1,104 @@
+#ifndef PCGSOLVER_H
+#define PCGSOLVER_H
+
+#include <vector>
+#include <iostream>
+#include "cemTypes.h"
+#include "Matrix/DenseMatrix.h"
+#include "Matrix/SparseMatrix.h"
+#include "Preconditioners.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+//************************************************************************************************//
+/** @brief The SolverTelemetry struct : Convergence history and timing of an iterative solve. */
+//************************************************************************************************//
+struct SolverTelemetry
+{
+    cemINT num_iterations;                  //!< Iterations done.
+    cemBOOL converged;                      //!< Relative residual reached the tolerance.
+    cemDOUBLE initial_residual;             //!< \f$ \|b - Ax_0\| / \|b\| \f$.
+    cemDOUBLE final_residual;               //!< \f$ \|b - Ax\| / \|b\| \f$ (recursive residual).
+    cemDOUBLE setup_time;                   //!< Seconds spent in SetUp() (preconditioner).
+    cemDOUBLE solve_time;                   //!< Seconds spent in the last Solve().
+    std::vector<cemDOUBLE> residual_history;    //!< Relative residual of each iteration.
+
+    SolverTelemetry();
+    void Print(std::ostream& out) const;
+};
+
+
+//************************************************************************************************//
+/** @brief The PCGSolver class : Preconditioned conjugate gradient for symmetric positive definite
+ * sparse matrices.
+ *
+ * Each iteration makes one pass over the matrix and four over the vectors: the product
+ * \f$ q = Ap \f$ is fused with \f$ p \cdot q \f$, the updates of x and r with \f$ r \cdot r \f$,
+ * the preconditioner with \f$ r \cdot z \f$ (in a single pass for Jacobi), and the new search
+ * direction is \f$ p = z + \beta p \f$. The matrix product and the vector kernels are threaded
+ * with OpenMP. The solve stops when \f$ \|r\| \le \mathrm{tolerance} \cdot \|b\| \f$.
+ *
+ * SolveBlock() runs the CG iterations of several right-hand sides in lockstep, so each iteration
+ * reads the matrix (and the preconditioner, if it supports it) once for all of them. Columns leave
+ * the block as they converge.
+ *
+ * After a local change of the matrix, UpdateMatrix() keeps the old preconditioner and Solve()
+ * warm-starts from the previous solution (see WoodburySolver for the direct counterpart).
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class PCGSolver
+{
+public:
+    // Constructor with parameters:
+    PCGSolver(const PreconditionerType& type = JACOBI);
+
+    // Destructor:
+    ~PCGSolver();
+
+    // Get data members:
+    cemDOUBLE tolerance() const;
+    cemINT max_iterations() const;
+    PreconditionerType preconditioner_type() const;
+    const Preconditioner* preconditioner() const;
+    const SolverTelemetry& telemetry() const;
+
+    // Set data members:
+    void set_tolerance(const cemDOUBLE& tolerance);
+    void set_max_iterations(const cemINT& max_iterations);
+    void set_preconditioner_type(const PreconditionerType& type, const cemDOUBLE& omega = 1.0);
+    void set_record_history(const cemBOOL& record_history);
+
+    // Solve:
+    void SetUp(const SparseMatrix<cemDOUBLE>& A);
+    void UpdateMatrix(const SparseMatrix<cemDOUBLE>& A);
+    cemBOOL Solve(const cemDOUBLE* b, cemDOUBLE* x);
+    cemBOOL SolveBlock(const cemINT& num_rhs, const cemDOUBLE* B, cemDOUBLE* X);
+    cemBOOL SolveBlock(const DenseMatrix<cemDOUBLE>& B, DenseMatrix<cemDOUBLE>& X);
+
+private:
+    const SparseMatrix<cemDOUBLE>* matrix_; //!< Matrix of the last SetUp() (not owned).
+    Preconditioner* preconditioner_;        //!< Preconditioner (owned).
+    PreconditionerType preconditioner_type_;//!< Type of preconditioner_.
+    cemDOUBLE tolerance_;                   //!< Relative residual to stop at.
+    cemINT max_iterations_;                 //!< Maximum number of iterations.
+    cemBOOL record_history_;                //!< Keep the residual of every iteration.
+    SolverTelemetry telemetry_;             //!< Telemetry of the last SetUp() and Solve().
+    std::vector<cemDOUBLE> r_;              //!< Residual.
+    std::vector<cemDOUBLE> z_;              //!< Preconditioned residual.
+    std::vector<cemDOUBLE> p_;              //!< Search direction.
+    std::vector<cemDOUBLE> q_;              //!< Matrix times search direction.
+    std::vector<cemDOUBLE> block_;          //!< Residuals, directions and products of SolveBlock().
+
+    PCGSolver(const PCGSolver& other);              // Not copyable (owns the preconditioner).
+    PCGSolver& operator = (const PCGSolver& other);
+};
+
+
+}
+
+
+
+#endif // PCGSOLVER_H
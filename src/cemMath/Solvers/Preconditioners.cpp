@@ -0,0 +1,429 @@
+#include <cmath>
+#include <algorithm>
+#include "Preconditioners.h"
+#include "AMGPreconditioner.h"
+#include "VectorKernels.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+const cemINT IC0Preconditioner::VECTOR_BLOCK;
+
+
+
+///***********************************************************************************************//
+/// CLASS Preconditioner:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief Preconditioner::num_rows : Gets number of rows of the matrix.
+ * @return : num_rows_ */
+//************************************************************************************************//
+cemINT Preconditioner::num_rows() const {return num_rows_;}
+
+
+//************************************************************************************************//
+/** @brief Preconditioner::ApplyDot : Applies the preconditioner and gets \f$ r \cdot z \f$.
+ *
+ * Generic version: Apply() followed by a dot product. Preconditioners that can do both in the
+ * same pass override it.
+ * @param [in] r : residual, num_rows() values
+ * @param [out] z : \f$ M^{-1} r \f$, num_rows() values
+ * @return : \f$ r \cdot z \f$ */
+//************************************************************************************************//
+cemDOUBLE Preconditioner::ApplyDot(const cemDOUBLE* r, cemDOUBLE* z) const
+{
+    Apply(r,z);
+    return VectorDot(num_rows_,r,z);
+}
+
+
+//************************************************************************************************//
+/** @brief Preconditioner::ApplyBlock : Applies the preconditioner to several vectors.
+ *
+ * Generic version: Apply() on each vector. Preconditioners that can share the reading of their
+ * data among vectors override it.
+ * @param [in] num_vectors : number of vectors
+ * @param [in] R : column-major num_rows() x num_vectors values
+ * @param [out] Z : \f$ M^{-1} R \f$, column-major num_rows() x num_vectors values */
+//************************************************************************************************//
+void Preconditioner::ApplyBlock(const cemINT& num_vectors, const cemDOUBLE* R, cemDOUBLE* Z) const
+{
+    for (cemINT v=0; v<num_vectors; ++v)
+        Apply(R + static_cast<cemINT8>(v)*num_rows_,Z + static_cast<cemINT8>(v)*num_rows_);
+}
+
+
+//************************************************************************************************//
+/** @brief Preconditioner::Create : Creates a preconditioner (to be deleted by the caller).
+ * @param [in] type : JACOBI, SSOR, IC0 or AMG
+ * @param [in] omega : relaxation factor of SSOR
+ * @return : new preconditioner */
+//************************************************************************************************//
+Preconditioner* Preconditioner::Create(const PreconditionerType& type, const cemDOUBLE& omega)
+{
+    switch (type)
+    {
+    case JACOBI:
+        return new JacobiPreconditioner;
+    case SSOR:
+        return new SSORPreconditioner(omega);
+    case IC0:
+        return new IC0Preconditioner;
+    case AMG:
+        return new AMGPreconditioner;
+    }
+
+    throw(Exception("INPUT ERROR","Unknown preconditioner type"));
+}
+
+
+//************************************************************************************************//
+/** @brief Preconditioner::DiagonalPositions : Finds the diagonal entry of each row.
+ * @param [in] A : square sparse matrix, every diagonal entry must be stored and positive
+ * @return : position of \f$ a_{ii} \f$ in the CSR arrays of each row i */
+//************************************************************************************************//
+std::vector<cemINT8> Preconditioner::DiagonalPositions(const SparseMatrix<cemDOUBLE>& A)
+{
+    if (A.num_rows() != A.num_columns())
+        throw(Exception("INPUT ERROR","Matrix must be square"));
+
+    cemINT n = A.num_rows();
+    std::vector<cemINT8> positions(n);
+    for (cemINT i=0; i<n; ++i)
+    {
+        positions[i] = A.find(i,i);
+        if (positions[i] < 0 || A.values()[positions[i]] <= 0.0)
+            throw(Exception("INPUT ERROR","Diagonal entry " + cem_utils::NumberToString<cemINT>(i) +
+                            " must be stored and positive"));
+    }
+
+    return positions;
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS JacobiPreconditioner:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief JacobiPreconditioner::SetUp : Stores the inverse of the diagonal.
+ * @param [in] A : symmetric positive definite matrix */
+//************************************************************************************************//
+void JacobiPreconditioner::SetUp(const SparseMatrix<cemDOUBLE>& A)
+{
+    std::vector<cemINT8> positions = DiagonalPositions(A);
+    num_rows_ = A.num_rows();
+    inverse_diagonal_.resize(num_rows_);
+    for (cemINT i=0; i<num_rows_; ++i)
+        inverse_diagonal_[i] = 1.0/A.values()[positions[i]];
+}
+
+
+//************************************************************************************************//
+/** @brief JacobiPreconditioner::Apply : Computes \f$ z = D^{-1} r \f$.
+ * @param [in] r : num_rows() values
+ * @param [out] z : num_rows() values */
+//************************************************************************************************//
+void JacobiPreconditioner::Apply(const cemDOUBLE* r, cemDOUBLE* z) const
+{
+    const cemDOUBLE* d = inverse_diagonal_.empty() ? NULL : &inverse_diagonal_[0];
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<num_rows_; ++i)
+        z[i] = d[i]*r[i];
+}
+
+
+//************************************************************************************************//
+/** @brief JacobiPreconditioner::ApplyDot : Computes \f$ z = D^{-1} r \f$ and \f$ r \cdot z \f$ in
+ * a single pass.
+ * @param [in] r : num_rows() values
+ * @param [out] z : num_rows() values
+ * @return : \f$ r \cdot z \f$ */
+//************************************************************************************************//
+cemDOUBLE JacobiPreconditioner::ApplyDot(const cemDOUBLE* r, cemDOUBLE* z) const
+{
+    const cemDOUBLE* d = inverse_diagonal_.empty() ? NULL : &inverse_diagonal_[0];
+    cemDOUBLE sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+    for (cemINT i=0; i<num_rows_; ++i)
+    {
+        z[i] = d[i]*r[i];
+        sum += r[i]*z[i];
+    }
+
+    return sum;
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS SSORPreconditioner:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SSORPreconditioner::SSORPreconditioner : Constructor with parameters.
+ * @param [in] omega : relaxation factor, 0 < omega < 2 (1 gives symmetric Gauss-Seidel) */
+//************************************************************************************************//
+SSORPreconditioner::SSORPreconditioner(const cemDOUBLE& omega)
+{
+    if (omega <= 0.0 || omega >= 2.0)
+        throw(Exception("INPUT ERROR","SSOR relaxation factor must be between 0 and 2"));
+
+    omega_ = omega;
+    matrix_ = NULL;
+}
+
+
+//************************************************************************************************//
+/** @brief SSORPreconditioner::SetUp : Keeps the matrix and finds its diagonal.
+ * @param [in] A : symmetric positive definite matrix (must outlive the preconditioner) */
+//************************************************************************************************//
+void SSORPreconditioner::SetUp(const SparseMatrix<cemDOUBLE>& A)
+{
+    diagonal_positions_ = DiagonalPositions(A);
+    num_rows_ = A.num_rows();
+    matrix_ = &A;
+}
+
+
+//************************************************************************************************//
+/** @brief SSORPreconditioner::Apply : Computes \f$ z = \omega(2-\omega) (D + \omega L^T)^{-1} D
+ * (D + \omega L)^{-1} r \f$ with a forward and a backward sweep.
+ * @param [in] r : num_rows() values
+ * @param [out] z : num_rows() values */
+//************************************************************************************************//
+void SSORPreconditioner::Apply(const cemDOUBLE* r, cemDOUBLE* z) const
+{
+    if (num_rows_ == 0)
+        return;
+
+    const cemINT8* offsets = matrix_->row_offsets();
+    const cemINT* columns = matrix_->column_indices();
+    const cemDOUBLE* a = matrix_->values();
+    const cemINT8* diagonal = &diagonal_positions_[0];
+
+    // Forward sweep, (D + omega L) y = r, then y = D y:
+    for (cemINT i=0; i<num_rows_; ++i)
+    {
+        cemDOUBLE sum = r[i];
+        for (cemINT8 k=offsets[i]; k<diagonal[i]; ++k)
+            sum -= omega_*a[k]*z[columns[k]];
+        z[i] = sum/a[diagonal[i]];
+    }
+
+    for (cemINT i=0; i<num_rows_; ++i)
+        z[i] *= a[diagonal[i]];
+
+    // Backward sweep, (D + omega L^T) z = y:
+    for (cemINT i=num_rows_-1; i>=0; --i)
+    {
+        cemDOUBLE sum = z[i];
+        for (cemINT8 k=diagonal[i]+1; k<offsets[i+1]; ++k)
+            sum -= omega_*a[k]*z[columns[k]];
+        z[i] = sum/a[diagonal[i]];
+    }
+
+    cemDOUBLE scale = omega_*(2.0 - omega_);
+    for (cemINT i=0; i<num_rows_; ++i)
+        z[i] *= scale;
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS IC0Preconditioner:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief IC0Preconditioner::IC0Preconditioner : Default constructor. */
+//************************************************************************************************//
+IC0Preconditioner::IC0Preconditioner()
+{
+    shift_ = 0.0;
+}
+
+
+//************************************************************************************************//
+/** @brief IC0Preconditioner::shift : Gets the diagonal shift used by the last SetUp().
+ * @return : shift_ (zero if the factorization did not break down) */
+//************************************************************************************************//
+cemDOUBLE IC0Preconditioner::shift() const {return shift_;}
+
+
+//************************************************************************************************//
+/** @brief IC0Preconditioner::SetUp : Copies the lower triangle of the matrix and factorizes it.
+ * @param [in] A : symmetric positive definite matrix */
+//************************************************************************************************//
+void IC0Preconditioner::SetUp(const SparseMatrix<cemDOUBLE>& A)
+{
+    std::vector<cemINT8> diagonal = DiagonalPositions(A);
+    num_rows_ = A.num_rows();
+
+    // Pattern of L (diagonal is the last entry of each row, as columns are sorted):
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    row_offsets_.assign(num_rows_+1,0);
+    for (cemINT i=0; i<num_rows_; ++i)
+        row_offsets_[i+1] = row_offsets_[i] + diagonal[i] - offsets[i] + 1;
+
+    column_indices_.resize(row_offsets_[num_rows_]);
+    values_.resize(row_offsets_[num_rows_]);
+    for (cemINT i=0; i<num_rows_; ++i)
+    {
+        for (cemINT8 k=offsets[i]; k<=diagonal[i]; ++k)
+            column_indices_[row_offsets_[i] + k - offsets[i]] = columns[k];
+    }
+
+    shift_ = 0.0;
+    while (!Factorize(A,shift_))
+    {
+        shift_ = shift_ == 0.0 ? 1.0e-3 : 2.0*shift_;
+        if (shift_ > 1.0)
+            throw(Exception("FACTORIZATION ERROR","Incomplete Cholesky factorization broke down"));
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief IC0Preconditioner::Factorize : Incomplete Cholesky factorization, row by row.
+ *
+ * \f$ l_{ik} = (a_{ik} - \sum_{j<k} l_{ij} l_{kj})/l_{kk} \f$ and
+ * \f$ l_{ii} = \sqrt{(1+\sigma) a_{ii} - \sum_{j<i} l_{ij}^2} \f$, with the sums restricted to the
+ * pattern. The entries of row i are scattered into a dense map so that each row k is traversed
+ * once.
+ * @param [in] A : symmetric positive definite matrix
+ * @param [in] shift : relative diagonal shift \f$ \sigma \f$
+ * @return : false if a pivot is not positive */
+//************************************************************************************************//
+cemBOOL IC0Preconditioner::Factorize(const SparseMatrix<cemDOUBLE>& A, const cemDOUBLE& shift)
+{
+    const cemINT8* offsets = A.row_offsets();
+    const cemDOUBLE* a = A.values();
+    std::vector<cemINT8> position(num_rows_,-1);
+    for (cemINT i=0; i<num_rows_; ++i)
+    {
+        cemINT8 first = row_offsets_[i];
+        cemINT8 last = row_offsets_[i+1] - 1;     // Diagonal.
+        for (cemINT8 p=first; p<=last; ++p)
+        {
+            values_[p] = a[offsets[i] + p - first];
+            position[column_indices_[p]] = p;
+        }
+
+        for (cemINT8 p=first; p<last; ++p)
+        {
+            cemINT k = column_indices_[p];
+            cemDOUBLE sum = values_[p];
+            for (cemINT8 q=row_offsets_[k]; q<row_offsets_[k+1]-1; ++q)
+            {
+                if (position[column_indices_[q]] >= 0)
+                    sum -= values_[position[column_indices_[q]]]*values_[q];
+            }
+            values_[p] = sum/values_[row_offsets_[k+1]-1];
+        }
+
+        cemDOUBLE pivot = (1.0 + shift)*values_[last];
+        for (cemINT8 p=first; p<last; ++p)
+            pivot -= values_[p]*values_[p];
+
+        for (cemINT8 p=first; p<=last; ++p)
+            position[column_indices_[p]] = -1;
+
+        if (!(pivot > 0.0))
+            return false;
+
+        values_[last] = std::sqrt(pivot);
+    }
+
+    return true;
+}
+
+
+//************************************************************************************************//
+/** @brief IC0Preconditioner::Apply : Computes \f$ z = (LL^T)^{-1} r \f$.
+ * @param [in] r : num_rows() values
+ * @param [out] z : num_rows() values */
+//************************************************************************************************//
+void IC0Preconditioner::Apply(const cemDOUBLE* r, cemDOUBLE* z) const
+{
+    // L y = r:
+    for (cemINT i=0; i<num_rows_; ++i)
+    {
+        cemDOUBLE sum = r[i];
+        for (cemINT8 p=row_offsets_[i]; p<row_offsets_[i+1]-1; ++p)
+            sum -= values_[p]*z[column_indices_[p]];
+        z[i] = sum/values_[row_offsets_[i+1]-1];
+    }
+
+    // L^T z = y, column by column:
+    for (cemINT i=num_rows_-1; i>=0; --i)
+    {
+        z[i] /= values_[row_offsets_[i+1]-1];
+        for (cemINT8 p=row_offsets_[i]; p<row_offsets_[i+1]-1; ++p)
+            z[column_indices_[p]] -= values_[p]*z[i];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief IC0Preconditioner::ApplyBlock : Computes \f$ Z = (LL^T)^{-1} R \f$, VECTOR_BLOCK
+ * vectors per pass over L.
+ * @param [in] num_vectors : number of vectors
+ * @param [in] R : column-major num_rows() x num_vectors values
+ * @param [out] Z : column-major num_rows() x num_vectors values */
+//************************************************************************************************//
+void IC0Preconditioner::ApplyBlock(const cemINT& num_vectors,
+                                   const cemDOUBLE* R,
+                                   cemDOUBLE* Z) const
+{
+    cemINT8 n = num_rows_;
+    for (cemINT first=0; first<num_vectors; first+=VECTOR_BLOCK)
+    {
+        cemINT block = std::min(VECTOR_BLOCK,num_vectors - first);
+        const cemDOUBLE* r = R + first*n;
+        cemDOUBLE* z = Z + first*n;
+        cemDOUBLE sums[VECTOR_BLOCK];
+
+        // L Y = R:
+        for (cemINT i=0; i<num_rows_; ++i)
+        {
+            for (cemINT v=0; v<block; ++v)
+                sums[v] = r[i + v*n];
+
+            for (cemINT8 p=row_offsets_[i]; p<row_offsets_[i+1]-1; ++p)
+            {
+                const cemDOUBLE* z_p = z + column_indices_[p];
+                for (cemINT v=0; v<block; ++v)
+                    sums[v] -= values_[p]*z_p[v*n];
+            }
+
+            cemDOUBLE inverse_diagonal = 1.0/values_[row_offsets_[i+1]-1];
+            for (cemINT v=0; v<block; ++v)
+                z[i + v*n] = sums[v]*inverse_diagonal;
+        }
+
+        // L^T Z = Y, column by column:
+        for (cemINT i=num_rows_-1; i>=0; --i)
+        {
+            cemDOUBLE inverse_diagonal = 1.0/values_[row_offsets_[i+1]-1];
+            for (cemINT v=0; v<block; ++v)
+            {
+                z[i + v*n] *= inverse_diagonal;
+                sums[v] = z[i + v*n];
+            }
+
+            for (cemINT8 p=row_offsets_[i]; p<row_offsets_[i+1]-1; ++p)
+            {
+                cemDOUBLE* z_p = z + column_indices_[p];
+                for (cemINT v=0; v<block; ++v)
+                    z_p[v*n] -= values_[p]*sums[v];
+            }
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef PRECONDITIONERS_H
+#define PRECONDITIONERS_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/SparseMatrix.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+/** @brief The PreconditionerType enum : Preconditioners of the iterative solvers. */
+enum PreconditionerType
+{
+    JACOBI=0,
+    SSOR=1,
+    IC0=2,
+    AMG=3,
+};
+
+//************************************************************************************************//
+/** @brief The Preconditioner class : Approximate inverse \f$ M^{-1} \f$ of a symmetric positive
+ * definite matrix stored in a SparseMatrix (both triangles, sorted columns). */
+//************************************************************************************************//
+class Preconditioner
+{
+public:
+    // Destructor:
+    virtual ~Preconditioner() {}
+
+    // Get data members:
+    cemINT num_rows() const;
+
+    // Set up for a matrix (again after its values change):
+    virtual void SetUp(const SparseMatrix<cemDOUBLE>& A) = 0;
+
+    // z = M^-1 r:
+    virtual void Apply(const cemDOUBLE* r, cemDOUBLE* z) const = 0;
+
+    // z = M^-1 r and return r.z:
+    virtual cemDOUBLE ApplyDot(const cemDOUBLE* r, cemDOUBLE* z) const;
+
+    // Z = M^-1 R for column-major blocks of vectors:
+    virtual void ApplyBlock(const cemINT& num_vectors, const cemDOUBLE* R, cemDOUBLE* Z) const;
+
+    static Preconditioner* Create(const PreconditionerType& type, const cemDOUBLE& omega = 1.0);
+
+protected:
+    cemINT num_rows_;   //!< Number of rows of the matrix.
+
+    // Default constructor:
+    Preconditioner() {num_rows_ = 0;}
+
+    static std::vector<cemINT8> DiagonalPositions(const SparseMatrix<cemDOUBLE>& A);
+};
+
+
+//************************************************************************************************//
+/** @brief The JacobiPreconditioner class : \f$ M = D \f$, the diagonal of the matrix. */
+//************************************************************************************************//
+class JacobiPreconditioner : public Preconditioner
+{
+public:
+    void SetUp(const SparseMatrix<cemDOUBLE>& A);
+    void Apply(const cemDOUBLE* r, cemDOUBLE* z) const;
+    cemDOUBLE ApplyDot(const cemDOUBLE* r, cemDOUBLE* z) const;
+
+private:
+    std::vector<cemDOUBLE> inverse_diagonal_;   //!< \f$ 1/a_{ii} \f$.
+};
+
+
+//************************************************************************************************//
+/** @brief The SSORPreconditioner class : Symmetric successive over-relaxation,
+ * \f$ M = \frac{1}{\omega(2-\omega)} (D + \omega L) D^{-1} (D + \omega L^T) \f$.
+ *
+ * Keeps a pointer to the matrix, which must outlive the preconditioner. The two triangular sweeps
+ * are sequential. */
+//************************************************************************************************//
+class SSORPreconditioner : public Preconditioner
+{
+public:
+    // Constructor with parameters:
+    SSORPreconditioner(const cemDOUBLE& omega = 1.0);
+
+    void SetUp(const SparseMatrix<cemDOUBLE>& A);
+    void Apply(const cemDOUBLE* r, cemDOUBLE* z) const;
+
+private:
+    cemDOUBLE omega_;                               //!< Relaxation factor, 0 < omega < 2.
+    const SparseMatrix<cemDOUBLE>* matrix_;         //!< Matrix of the last SetUp().
+    std::vector<cemINT8> diagonal_positions_;       //!< Position of \f$ a_{ii} \f$ in each row.
+};
+
+
+//************************************************************************************************//
+/** @brief The IC0Preconditioner class : Incomplete Cholesky factorization with no fill-in,
+ * \f$ M = LL^T \f$ with L restricted to the lower triangle of the pattern of the matrix.
+ *
+ * If the factorization breaks down (a non-positive pivot), it is repeated on
+ * \f$ A + \sigma \, \mathrm{diag}(A) \f$ with a growing shift \f$ \sigma \f$. The two triangular
+ * solves are sequential; ApplyBlock() solves VECTOR_BLOCK vectors per pass over L. */
+//************************************************************************************************//
+class IC0Preconditioner : public Preconditioner
+{
+public:
+    // Default constructor:
+    IC0Preconditioner();
+
+    // Get data members:
+    cemDOUBLE shift() const;
+
+    void SetUp(const SparseMatrix<cemDOUBLE>& A);
+    void Apply(const cemDOUBLE* r, cemDOUBLE* z) const;
+    void ApplyBlock(const cemINT& num_vectors, const cemDOUBLE* R, cemDOUBLE* Z) const;
+
+private:
+    cemDOUBLE shift_;                       //!< Diagonal shift used by the last SetUp().
+    std::vector<cemINT8> row_offsets_;      //!< Rows of L (diagonal entry last in each row).
+    std::vector<cemINT> column_indices_;    //!< Columns of L, sorted within each row.
+    std::vector<cemDOUBLE> values_;         //!< Entries of L.
+
+    static const cemINT VECTOR_BLOCK = 8;   //!< Vectors solved per pass over L.
+
+    cemBOOL Factorize(const SparseMatrix<cemDOUBLE>& A, const cemDOUBLE& shift);
+};
+
+
+}
+
+
+
+#endif // PRECONDITIONERS_H
@@ -0,0 +1,575 @@
+#include <algorithm>
+#include <cmath>
+#include "SchurComplementSolver.h"
+#include "SparseProducts.h"
+#include "VectorKernels.h"
+#include "SolverTimer.h"
+#include "MKL/BlasLevel3.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+const cemINT SchurComplementSolver::SCHUR_BLOCK;
+const cemINT SchurComplementSolver::MAX_ITERATIONS;
+
+
+//************************************************************************************************//
+/** @brief ExtractBlock : Copies the entries of some rows of a matrix in the columns of one owner.
+ * @param [in] A : sparse matrix
+ * @param [in] rows : rows to copy, in order
+ * @param [in] owner : owner of each column of A
+ * @param [in] id : owner of the columns to copy
+ * @param [in] position : column of the block of each column of A (increasing for each owner)
+ * @param [in] num_columns : columns of the block
+ * @param [out] block : rows.size() x num_columns matrix */
+//************************************************************************************************//
+static void ExtractBlock(const SparseMatrix<cemDOUBLE>& A,
+                         const std::vector<cemINT>& rows,
+                         const std::vector<cemINT>& owner,
+                         const cemINT& id,
+                         const std::vector<cemINT>& position,
+                         const cemINT& num_columns,
+                         SparseMatrix<cemDOUBLE>& block)
+{
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    const cemDOUBLE* values = A.values();
+    cemINT num_rows = static_cast<cemINT>(rows.size());
+
+    std::vector<cemINT8> row_offsets(num_rows+1,0);
+    std::vector<cemINT> column_indices;
+    std::vector<cemDOUBLE> block_values;
+    for (cemINT r=0; r<num_rows; ++r)
+    {
+        for (cemINT8 k=offsets[rows[r]]; k<offsets[rows[r]+1]; ++k)
+        {
+            if (owner[columns[k]] == id)
+            {
+                column_indices.push_back(position[columns[k]]);
+                block_values.push_back(values[k]);
+            }
+        }
+        row_offsets[r+1] = static_cast<cemINT8>(column_indices.size());
+    }
+
+    block.set_pattern(num_rows,num_columns,row_offsets,column_indices);
+    std::copy(block_values.begin(),block_values.end(),block.values());
+}
+
+
+//************************************************************************************************//
+/** @brief InterfaceProduct : Computes \f$ B_p^T y \f$ on the interface rows coupled to a domain.
+ * @param [in] Bt : \f$ B_p^T \f$
+ * @param [in] interface : interface rows coupled to the domain
+ * @param [in] y : interior values of the domain
+ * @param [out] product : one value per row of interface */
+//************************************************************************************************//
+static void InterfaceProduct(const SparseMatrix<cemDOUBLE>& Bt,
+                             const std::vector<cemINT>& interface,
+                             const cemDOUBLE* y,
+                             std::vector<cemDOUBLE>& product)
+{
+    const cemINT8* offsets = Bt.row_offsets();
+    const cemINT* columns = Bt.column_indices();
+    const cemDOUBLE* values = Bt.values();
+
+    product.resize(interface.size());
+    for (size_t c=0; c<interface.size(); ++c)
+    {
+        cemDOUBLE sum = 0.0;
+        for (cemINT8 k=offsets[interface[c]]; k<offsets[interface[c]+1]; ++k)
+            sum += values[k]*y[columns[k]];
+        product[c] = sum;
+    }
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS SchurComplementSolver:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::SchurComplementSolver : Constructor with parameters.
+ * @param [in] interface_solver : solver of the interface system */
+//************************************************************************************************//
+SchurComplementSolver::SchurComplementSolver(const InterfaceSolverType& interface_solver)
+{
+    interface_solver_ = interface_solver;
+    tolerance_ = 1.0e-10;
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::interface_solver : Gets solver of the interface system.
+ * @return : interface_solver_ */
+//************************************************************************************************//
+InterfaceSolverType SchurComplementSolver::interface_solver() const {return interface_solver_;}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::num_domains : Gets number of domains.
+ * @return : number of domains of the last SetUp() */
+//************************************************************************************************//
+cemINT SchurComplementSolver::num_domains() const {return static_cast<cemINT>(domains_.size());}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::num_interface_rows : Gets size of the interface system.
+ * @return : number of interface rows */
+//************************************************************************************************//
+cemINT SchurComplementSolver::num_interface_rows() const
+{
+    return static_cast<cemINT>(interface_rows_.size());
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::num_interior_rows : Gets number of interior rows of a domain.
+ * @param [in] domain : index of the domain
+ * @return : rows of \f$ A_{pp} \f$ */
+//************************************************************************************************//
+cemINT SchurComplementSolver::num_interior_rows(const cemINT& domain) const
+{
+    return static_cast<cemINT>(domains_[domain].rows.size());
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::interface_rows : Gets global rows of the interface.
+ * @return : interface_rows_ */
+//************************************************************************************************//
+const std::vector<cemINT>& SchurComplementSolver::interface_rows() const {return interface_rows_;}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::tolerance : Gets relative residual of INTERFACE_PCG.
+ * @return : tolerance_ */
+//************************************************************************************************//
+cemDOUBLE SchurComplementSolver::tolerance() const {return tolerance_;}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::telemetry : Gets timing and interface iterations.
+ * @return : telemetry_ */
+//************************************************************************************************//
+const SolverTelemetry& SchurComplementSolver::telemetry() const {return telemetry_;}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::set_interface_solver : Sets solver of the interface system (the
+ * dense Schur complement is formed in the next Solve() if needed).
+ * @param [in] interface_solver : INTERFACE_DIRECT or INTERFACE_PCG */
+//************************************************************************************************//
+void SchurComplementSolver::set_interface_solver(const InterfaceSolverType& interface_solver)
+{
+    interface_solver_ = interface_solver;
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::set_tolerance : Sets relative residual of INTERFACE_PCG.
+ * @param [in] tolerance : positive tolerance */
+//************************************************************************************************//
+void SchurComplementSolver::set_tolerance(const cemDOUBLE& tolerance)
+{
+    if (tolerance <= 0.0)
+        throw(Exception("INPUT ERROR","Tolerance must be positive"));
+
+    tolerance_ = tolerance;
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::SetUp : Splits the matrix into domains and factorizes them.
+ * @param [in] A : symmetric positive definite matrix (both triangles stored)
+ * @param [in] domains : domain of each row (negative for interface rows) */
+//************************************************************************************************//
+void SchurComplementSolver::SetUp(const SparseMatrix<cemDOUBLE>& A,
+                                  const std::vector<cemINT>& domains)
+{
+    cemDOUBLE start = WallTime();
+    SetUpDomains(A,domains);
+    FactorizeDomains();
+
+    schur_.clear();
+    if (interface_solver_ == INTERFACE_DIRECT)
+        FactorizeSchurComplement();
+
+    telemetry_.setup_time = WallTime() - start;
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::Solve : Solves \f$ Ax = b \f$.
+ * @param [in] b : right-hand side, one value per row of A
+ * @param [out] x : solution, one value per row of A
+ * @return : true unless INTERFACE_PCG did not reach the tolerance */
+//************************************************************************************************//
+cemBOOL SchurComplementSolver::Solve(const cemDOUBLE* b, cemDOUBLE* x)
+{
+    cemDOUBLE start = WallTime();
+    cemINT num_domains = static_cast<cemINT>(domains_.size());
+    cemINT m = static_cast<cemINT>(interface_rows_.size());
+
+    if (interface_solver_ == INTERFACE_DIRECT &&
+        static_cast<cemINT8>(schur_.size()) != static_cast<cemINT8>(m)*m)
+        FactorizeSchurComplement();
+
+    // Interior solves, y_p = A_pp^{-1} b_p, and their part of the interface right-hand side:
+    #pragma omp parallel for schedule(dynamic) if(num_domains > 1)
+    for (cemINT p=0; p<num_domains; ++p)
+    {
+        Domain& domain = domains_[p];
+        cemINT n_p = static_cast<cemINT>(domain.rows.size());
+        if (n_p == 0)
+            continue;
+
+        for (cemINT i=0; i<n_p; ++i)
+            domain.b[i] = b[domain.rows[i]];
+        domain.cholesky.Solve(&domain.b[0],&domain.b[0]);
+        InterfaceProduct(domain.Bt,domain.interface,&domain.b[0],domain.product);
+    }
+
+    // g = b_G - sum_p B_p^T y_p:
+    g_.resize(m);
+    for (cemINT c=0; c<m; ++c)
+        g_[c] = b[interface_rows_[c]];
+    for (cemINT p=0; p<num_domains; ++p)
+        for (size_t c=0; c<domains_[p].interface.size(); ++c)
+            g_[domains_[p].interface[c]] -= domains_[p].product[c];
+
+    cemBOOL converged = SolveInterface(m > 0 ? &g_[0] : NULL);
+    for (cemINT c=0; c<m; ++c)
+        x[interface_rows_[c]] = g_[c];
+
+    // Back substitution, x_p = A_pp^{-1} (b_p - B_p x_G):
+    #pragma omp parallel for schedule(dynamic) if(num_domains > 1)
+    for (cemINT p=0; p<num_domains; ++p)
+    {
+        Domain& domain = domains_[p];
+        cemINT n_p = static_cast<cemINT>(domain.rows.size());
+        if (n_p == 0)
+            continue;
+
+        if (m > 0)
+            domain.B.multiply(&g_[0],&domain.b[0]);
+        else
+            std::fill(domain.b.begin(),domain.b.end(),0.0);
+
+        for (cemINT i=0; i<n_p; ++i)
+            domain.b[i] = b[domain.rows[i]] - domain.b[i];
+        domain.cholesky.Solve(&domain.b[0],&domain.b[0]);
+        for (cemINT i=0; i<n_p; ++i)
+            x[domain.rows[i]] = domain.b[i];
+    }
+
+    telemetry_.solve_time = WallTime() - start;
+    return converged;
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::SetUpDomains : Finds the interface and extracts the blocks.
+ * @param [in] A : symmetric matrix
+ * @param [in] domains : domain of each row (negative for interface rows) */
+//************************************************************************************************//
+void SchurComplementSolver::SetUpDomains(const SparseMatrix<cemDOUBLE>& A,
+                                         const std::vector<cemINT>& domains)
+{
+    cemINT n = static_cast<cemINT>(A.num_rows());
+    if (A.num_rows() != A.num_columns())
+        throw(Exception("INPUT ERROR","Matrix must be square"));
+    if (static_cast<cemINT>(domains.size()) != n)
+        throw(Exception("INPUT ERROR","Expected the domain of " +
+                        cem_utils::NumberToString<cemINT>(n) + " rows"));
+
+    // Rows coupled to a domain with a lower index move to the interface:
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    cemINT num_domains = 0;
+    std::vector<cemINT> owner(domains);
+    for (cemINT i=0; i<n; ++i)
+    {
+        num_domains = std::max(num_domains,domains[i] + 1);
+        if (domains[i] < 0)
+        {
+            owner[i] = -1;
+            continue;
+        }
+
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+        {
+            cemINT j = columns[k];
+            if (domains[j] >= 0 && domains[j] < domains[i])
+            {
+                owner[i] = -1;
+                break;
+            }
+        }
+    }
+
+    // Rows of each domain and of the interface, and their position in it:
+    domains_.assign(num_domains,Domain());
+    interface_rows_.clear();
+    std::vector<cemINT> position(n);
+    for (cemINT i=0; i<n; ++i)
+    {
+        if (owner[i] < 0)
+        {
+            position[i] = static_cast<cemINT>(interface_rows_.size());
+            interface_rows_.push_back(i);
+        }
+        else
+        {
+            position[i] = static_cast<cemINT>(domains_[owner[i]].rows.size());
+            domains_[owner[i]].rows.push_back(i);
+        }
+    }
+
+    cemINT m = static_cast<cemINT>(interface_rows_.size());
+    ExtractBlock(A,interface_rows_,owner,-1,position,m,interface_matrix_);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (cemINT p=0; p<num_domains; ++p)
+    {
+        Domain& domain = domains_[p];
+        cemINT n_p = static_cast<cemINT>(domain.rows.size());
+        ExtractBlock(A,domain.rows,owner,p,position,n_p,domain.A);
+        ExtractBlock(A,domain.rows,owner,-1,position,m,domain.B);
+
+        std::vector<cemINT8> transpose_positions;
+        SparseTranspose(domain.B,domain.Bt,transpose_positions);
+        for (cemINT c=0; c<m; ++c)
+            if (domain.Bt.row_offsets()[c+1] > domain.Bt.row_offsets()[c])
+                domain.interface.push_back(c);
+
+        domain.b.resize(n_p);
+    }
+
+    // Jacobi preconditioner of INTERFACE_PCG:
+    inverse_diagonal_.resize(m);
+    for (cemINT c=0; c<m; ++c)
+    {
+        cemINT8 k = interface_matrix_.find(c,c);
+        if (k < 0 || interface_matrix_.values()[k] <= 0.0)
+            throw(Exception("INPUT ERROR","Interface row " +
+                            cem_utils::NumberToString<cemINT>(interface_rows_[c]) +
+                            " has no positive diagonal"));
+
+        inverse_diagonal_[c] = 1.0/interface_matrix_.values()[k];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::FactorizeDomains : Factorizes the interior of every domain, one
+ * domain per thread. */
+//************************************************************************************************//
+void SchurComplementSolver::FactorizeDomains()
+{
+    cemINT num_domains = static_cast<cemINT>(domains_.size());
+    cemINT failed = -1;
+
+    #pragma omp parallel for schedule(dynamic) if(num_domains > 1)
+    for (cemINT p=0; p<num_domains; ++p)
+    {
+        if (domains_[p].rows.empty())
+            continue;
+
+        try
+        {
+            domains_[p].cholesky.Factorize(domains_[p].A);
+        }
+        catch (Exception&)
+        {
+            #pragma omp critical
+            failed = p;
+        }
+    }
+
+    if (failed >= 0)
+        throw(Exception("FACTORIZATION ERROR","Interior of domain " +
+                        cem_utils::NumberToString<cemINT>(failed) +
+                        " is not positive definite"));
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::FactorizeSchurComplement : Forms the dense Schur complement and
+ * factorizes it.
+ *
+ * Each domain solves \f$ A_{pp}^{-1} B_p \f$ for SCHUR_BLOCK of its interface columns at a time
+ * into a private dense block \f$ B_p^T A_{pp}^{-1} B_p \f$ (rows and columns of its interface
+ * only), which is then subtracted from S in a single critical section per domain. */
+//************************************************************************************************//
+void SchurComplementSolver::FactorizeSchurComplement()
+{
+    cemINT num_domains = static_cast<cemINT>(domains_.size());
+    cemINT m = static_cast<cemINT>(interface_rows_.size());
+    cemINT8 ld = m;
+
+    schur_.assign(ld*m,0.0);
+    const cemINT8* interface_offsets = interface_matrix_.row_offsets();
+    for (cemINT r=0; r<m; ++r)
+        for (cemINT8 k=interface_offsets[r]; k<interface_offsets[r+1]; ++k)
+            schur_[interface_matrix_.column_indices()[k]*ld + r] = interface_matrix_.values()[k];
+
+    #pragma omp parallel for schedule(dynamic) if(num_domains > 1)
+    for (cemINT p=0; p<num_domains; ++p)
+    {
+        const Domain& domain = domains_[p];
+        cemINT n_p = static_cast<cemINT>(domain.rows.size());
+        cemINT m_p = static_cast<cemINT>(domain.interface.size());
+        const cemINT8* offsets = domain.Bt.row_offsets();
+        const cemINT* columns = domain.Bt.column_indices();
+        const cemDOUBLE* values = domain.Bt.values();
+        if (n_p == 0 || m_p == 0)
+            continue;
+
+        std::vector<cemDOUBLE> W(static_cast<cemINT8>(n_p)*std::min(m_p,SCHUR_BLOCK));
+        std::vector<cemDOUBLE> S_p(static_cast<cemINT8>(m_p)*m_p);
+        std::vector<cemDOUBLE> product;
+        for (cemINT first=0; first<m_p; first+=SCHUR_BLOCK)
+        {
+            cemINT k = std::min(SCHUR_BLOCK,m_p - first);
+
+            // W = A_pp^{-1} B_p(:,columns of the block):
+            std::fill(W.begin(),W.end(),0.0);
+            for (cemINT c=0; c<k; ++c)
+            {
+                cemINT row = domain.interface[first + c];
+                for (cemINT8 e=offsets[row]; e<offsets[row+1]; ++e)
+                    W[static_cast<cemINT8>(c)*n_p + columns[e]] = values[e];
+            }
+            domain.cholesky.SolveBlock(k,&W[0],&W[0]);
+
+            // S_p(:,block) = B_p^T W:
+            for (cemINT c=0; c<k; ++c)
+            {
+                const cemDOUBLE* w = &W[static_cast<cemINT8>(c)*n_p];
+                InterfaceProduct(domain.Bt,domain.interface,w,product);
+                std::copy(product.begin(),product.end(),
+                          S_p.begin() + static_cast<cemINT8>(first + c)*m_p);
+            }
+        }
+
+        // S(interface,interface) -= S_p, once per domain:
+        #pragma omp critical
+        for (cemINT c=0; c<m_p; ++c)
+        {
+            const cemDOUBLE* block_column = &S_p[static_cast<cemINT8>(c)*m_p];
+            cemDOUBLE* column = &schur_[domain.interface[c]*ld];
+            for (cemINT r=0; r<m_p; ++r)
+                column[domain.interface[r]] -= block_column[r];
+        }
+    }
+
+    if (m > 0 && MKL_CholeskyFactorization(m,&schur_[0],m) != 0)
+        throw(Exception("FACTORIZATION ERROR","Schur complement is not positive definite"));
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::ApplySchurComplement : Computes \f$ t = Sv \f$ without forming
+ * S (one solve per domain).
+ * @param [in] v : interface values
+ * @param [out] t : interface values */
+//************************************************************************************************//
+void SchurComplementSolver::ApplySchurComplement(const cemDOUBLE* v, cemDOUBLE* t)
+{
+    cemINT num_domains = static_cast<cemINT>(domains_.size());
+
+    #pragma omp parallel for schedule(dynamic) if(num_domains > 1)
+    for (cemINT p=0; p<num_domains; ++p)
+    {
+        Domain& domain = domains_[p];
+        if (domain.rows.empty())
+            continue;
+
+        domain.B.multiply(v,&domain.b[0]);
+        domain.cholesky.Solve(&domain.b[0],&domain.b[0]);
+        InterfaceProduct(domain.Bt,domain.interface,&domain.b[0],domain.product);
+    }
+
+    interface_matrix_.multiply(v,t);
+    for (cemINT p=0; p<num_domains; ++p)
+        for (size_t c=0; c<domains_[p].interface.size(); ++c)
+            t[domains_[p].interface[c]] -= domains_[p].product[c];
+}
+
+
+//************************************************************************************************//
+/** @brief SchurComplementSolver::SolveInterface : Solves \f$ Sx = g \f$.
+ * @param [in,out] x : g on entry, the interface solution on exit
+ * @return : true unless INTERFACE_PCG did not reach the tolerance (it throws if S turns out not
+ * to be positive definite, \f$ p \cdot Sp \le 0 \f$) */
+//************************************************************************************************//
+cemBOOL SchurComplementSolver::SolveInterface(cemDOUBLE* x)
+{
+    cemINT m = static_cast<cemINT>(interface_rows_.size());
+    telemetry_.num_iterations = 0;
+    telemetry_.residual_history.clear();
+    telemetry_.converged = true;
+    telemetry_.initial_residual = 0.0;
+    telemetry_.final_residual = 0.0;
+    if (m == 0)
+        return true;
+
+    if (interface_solver_ == INTERFACE_DIRECT)
+    {
+        MKL_TriangularSolve(m,&schur_[0],m,x,false);
+        MKL_TriangularSolve(m,&schur_[0],m,x,true);
+        return true;
+    }
+
+    // Jacobi-preconditioned CG from x = 0:
+    r_.assign(x,x + m);
+    z_.resize(m);
+    p_.resize(m);
+    q_.resize(m);
+    cemDOUBLE norm_g = std::sqrt(VectorDot(m,&r_[0],&r_[0]));
+    std::fill(x,x + m,0.0);
+    if (norm_g == 0.0)
+        return true;
+
+    telemetry_.initial_residual = 1.0;
+    cemDOUBLE residual = 1.0;
+    cemDOUBLE rho = 0.0;
+    while (residual > tolerance_ && telemetry_.num_iterations < MAX_ITERATIONS)
+    {
+        for (cemINT c=0; c<m; ++c)
+            z_[c] = inverse_diagonal_[c]*r_[c];
+
+        cemDOUBLE rho_new = VectorDot(m,&r_[0],&z_[0]);
+        if (telemetry_.num_iterations == 0)
+            p_ = z_;
+        else
+            VectorXpay(m,&z_[0],rho_new/rho,&p_[0]);
+        rho = rho_new;
+
+        ApplySchurComplement(&p_[0],&q_[0]);
+        cemDOUBLE pq = VectorDot(m,&p_[0],&q_[0]);
+        if (!(pq > 0.0))
+            throw(Exception("SOLVER ERROR","Schur complement is not positive definite (CG "
+                            "breakdown at iteration " +
+                            cem_utils::NumberToString<cemINT>(telemetry_.num_iterations) + ")"));
+
+        cemDOUBLE alpha = rho/pq;
+        for (cemINT c=0; c<m; ++c)
+        {
+            x[c] += alpha*p_[c];
+            r_[c] -= alpha*q_[c];
+        }
+
+        residual = std::sqrt(VectorDot(m,&r_[0],&r_[0]))/norm_g;
+        ++telemetry_.num_iterations;
+        telemetry_.residual_history.push_back(residual);
+    }
+
+    telemetry_.converged = residual <= tolerance_;
+    telemetry_.final_residual = residual;
+    return telemetry_.converged;
+}
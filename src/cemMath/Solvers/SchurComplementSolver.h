@@ -0,0 +1,110 @@
+#ifndef SCHURCOMPLEMENTSOLVER_H
+#define SCHURCOMPLEMENTSOLVER_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/SparseMatrix.h"
+#include "PCGSolver.h"
+#include "SparseCholesky.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+/** @brief The InterfaceSolverType enum : Solvers of the interface (Schur complement) system. */
+enum InterfaceSolverType
+{
+    INTERFACE_DIRECT=0,
+    INTERFACE_PCG=1,
+};
+
+
+//************************************************************************************************//
+/** @brief The SchurComplementSolver class : Non-overlapping domain decomposition with a direct
+ * solver in each domain (e.g. each copper layer of a board) and the interface solved separately.
+ *
+ * With the interior rows of domain p ordered first and the interface rows \f$ \Gamma \f$ (e.g. via
+ * ends) last, the matrix is
+ * \f[ \left[ \begin{array}{cc} A_{pp} & B_p \\ B_p^T & A_{\Gamma\Gamma} \end{array} \right] \f]
+ * and the interface unknowns solve \f$ S x_\Gamma = b_\Gamma - \sum_p B_p^T A_{pp}^{-1} b_p \f$
+ * with the Schur complement \f$ S = A_{\Gamma\Gamma} - \sum_p B_p^T A_{pp}^{-1} B_p \f$. The
+ * interior unknowns are then \f$ x_p = A_{pp}^{-1}(b_p - B_p x_\Gamma) \f$.
+ *
+ * SetUp() factorizes the interior of every domain with its own SparseCholesky, one domain per
+ * thread, so each task only holds the factor of its domain. With INTERFACE_DIRECT the domains
+ * then add \f$ B_p^T A_{pp}^{-1} B_p \f$ to a dense S, SCHUR_BLOCK interface columns at a time
+ * (block solves), and S is factorized with dense Cholesky. With INTERFACE_PCG, S is never formed:
+ * CG applies it with one solve per domain per iteration, preconditioned with the diagonal of
+ * \f$ A_{\Gamma\Gamma} \f$, which suits interfaces too large for a dense matrix. Solve() runs the
+ * interior solves of all domains concurrently in both cases.
+ *
+ * The domain of each row is given to SetUp(); rows with a negative domain are interface rows. A
+ * row coupled to a row of another domain also becomes an interface row (the one in the domain
+ * with the higher index), so a layer numbering alone is enough.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SchurComplementSolver
+{
+public:
+    // Constructor with parameters:
+    SchurComplementSolver(const InterfaceSolverType& interface_solver = INTERFACE_DIRECT);
+
+    // Get data members:
+    InterfaceSolverType interface_solver() const;
+    cemINT num_domains() const;
+    cemINT num_interface_rows() const;
+    cemINT num_interior_rows(const cemINT& domain) const;
+    const std::vector<cemINT>& interface_rows() const;
+    cemDOUBLE tolerance() const;
+    const SolverTelemetry& telemetry() const;
+
+    // Set data members:
+    void set_interface_solver(const InterfaceSolverType& interface_solver);
+    void set_tolerance(const cemDOUBLE& tolerance);
+
+    // Solve:
+    void SetUp(const SparseMatrix<cemDOUBLE>& A, const std::vector<cemINT>& domains);
+    cemBOOL Solve(const cemDOUBLE* b, cemDOUBLE* x);
+
+private:
+    /** @brief The Domain struct : Interior block, coupling and factor of one domain. */
+    struct Domain
+    {
+        std::vector<cemINT> rows;                   //!< Global rows of the interior.
+        std::vector<cemINT> interface;              //!< Interface rows coupled to the domain.
+        SparseMatrix<cemDOUBLE> A;                  //!< \f$ A_{pp} \f$.
+        SparseMatrix<cemDOUBLE> B;                  //!< \f$ B_p \f$ (columns in interface order).
+        SparseMatrix<cemDOUBLE> Bt;                 //!< \f$ B_p^T \f$.
+        SparseCholesky cholesky;                    //!< Factor of \f$ A_{pp} \f$.
+        std::vector<cemDOUBLE> b;                   //!< Interior work vector.
+        std::vector<cemDOUBLE> product;             //!< Interface work vector.
+    };
+
+    InterfaceSolverType interface_solver_;  //!< Solver of the interface system.
+    cemDOUBLE tolerance_;                   //!< Relative residual of INTERFACE_PCG.
+    std::vector<Domain> domains_;           //!< Domains.
+    std::vector<cemINT> interface_rows_;    //!< Global rows of the interface.
+    SparseMatrix<cemDOUBLE> interface_matrix_;  //!< \f$ A_{\Gamma\Gamma} \f$.
+    std::vector<cemDOUBLE> schur_;          //!< Cholesky factor of S (INTERFACE_DIRECT).
+    std::vector<cemDOUBLE> inverse_diagonal_;   //!< Jacobi preconditioner (INTERFACE_PCG).
+    SolverTelemetry telemetry_;             //!< Interface iterations of the last Solve().
+    std::vector<cemDOUBLE> g_, r_, z_, p_, q_;  //!< Interface work vectors.
+
+    static const cemINT SCHUR_BLOCK = 64;   //!< Interface columns per block solve of SetUp().
+    static const cemINT MAX_ITERATIONS = 1000;  //!< Maximum iterations of INTERFACE_PCG.
+
+    // Private member functions:
+    void SetUpDomains(const SparseMatrix<cemDOUBLE>& A, const std::vector<cemINT>& domains);
+    void FactorizeDomains();
+    void FactorizeSchurComplement();
+    void ApplySchurComplement(const cemDOUBLE* v, cemDOUBLE* t);
+    cemBOOL SolveInterface(cemDOUBLE* x);
+};
+
+
+}
+
+
+
+#endif // SCHURCOMPLEMENTSOLVER_H
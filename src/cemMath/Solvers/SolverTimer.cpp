@@ -0,0 +1,22 @@
+#include <ctime>
+#include "SolverTimer.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace cem_math;
+
+
+//************************************************************************************************//
+/** @brief WallTime : Elapsed time in seconds (clock() adds up the time of all threads, so it is
+ * only used without OpenMP).
+ * @return : seconds since an arbitrary origin */
+//************************************************************************************************//
+cemDOUBLE cem_math::WallTime()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return static_cast<cemDOUBLE>(clock())/CLOCKS_PER_SEC;
+#endif
+}
@@ -0,0 +1,19 @@
+#ifndef SOLVERTIMER_H
+#define SOLVERTIMER_H
+
+#include "cemTypes.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+// Timing of the solvers (setup and solve times of their telemetry):
+
+// Elapsed time in seconds since an arbitrary origin:
+cemDOUBLE WallTime();
+
+}
+
+
+#endif // SOLVERTIMER_H
@@ -0,0 +1,1125 @@
+#include <algorithm>
+#include "SparseCholesky.h"
+#include "MKL/BlasLevel3.h"
+#include "cemError.h"
+#include "cemUtils.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+const cemINT SparseCholesky::LEAF_SIZE;
+const cemINT SparseCholesky::RELAXED_WIDTH;
+const cemINT SparseCholesky::RHS_BLOCK;
+const cemINT SparseCholesky::ROW_BLOCK;
+
+
+//************************************************************************************************//
+/** @brief LevelStructure : Breadth-first search in a subgraph.
+ * @param [in] offsets : row offsets of the graph (pattern of a matrix, diagonal ignored)
+ * @param [in] columns : column indices of the graph
+ * @param [in] label : subgraph of each vertex
+ * @param [in] id : subgraph to search
+ * @param [in] root : first vertex
+ * @param [in,out] level : level of each vertex (-1 on entry for the vertices of the subgraph)
+ * @param [out] queue : reached vertices, by level
+ * @param [out] num_reached : number of reached vertices
+ * @return : number of levels */
+//************************************************************************************************//
+static cemINT LevelStructure(const cemINT8* offsets,
+                             const cemINT* columns,
+                             const std::vector<cemINT>& label,
+                             const cemINT& id,
+                             const cemINT& root,
+                             std::vector<cemINT>& level,
+                             std::vector<cemINT>& queue,
+                             cemINT& num_reached)
+{
+    queue[0] = root;
+    level[root] = 0;
+    num_reached = 1;
+    for (cemINT q=0; q<num_reached; ++q)
+    {
+        cemINT v = queue[q];
+        for (cemINT8 k=offsets[v]; k<offsets[v+1]; ++k)
+        {
+            cemINT w = columns[k];
+            if (label[w] == id && level[w] < 0)
+            {
+                level[w] = level[v] + 1;
+                queue[num_reached++] = w;
+            }
+        }
+    }
+
+    return level[queue[num_reached-1]] + 1;
+}
+
+
+
+///***********************************************************************************************//
+/// CLASS SparseCholesky:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief SparseCholesky::SparseCholesky : Constructor with parameters.
+ * @param [in] ordering : fill-reducing ordering */
+//************************************************************************************************//
+SparseCholesky::SparseCholesky(const OrderingType& ordering)
+{
+    ordering_ = ordering;
+    precision_ = DOUBLE_PRECISION;
+    num_rows_ = 0;
+    num_analyses_ = 0;
+    factorized_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::ordering : Gets fill-reducing ordering.
+ * @return : ordering_ */
+//************************************************************************************************//
+OrderingType SparseCholesky::ordering() const {return ordering_;}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::precision : Gets precision of the factor.
+ * @return : precision_ */
+//************************************************************************************************//
+FactorPrecision SparseCholesky::precision() const {return precision_;}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::num_rows : Gets number of rows of the analyzed matrix.
+ * @return : num_rows_ */
+//************************************************************************************************//
+cemINT SparseCholesky::num_rows() const {return num_rows_;}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::num_supernodes : Gets number of supernodes of L.
+ * @return : number of supernodes */
+//************************************************************************************************//
+cemINT SparseCholesky::num_supernodes() const
+{
+    return super_offsets_.empty() ? 0 : static_cast<cemINT>(super_offsets_.size()) - 1;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::num_factor_entries : Gets number of entries of L (lower triangle
+ * including the diagonal).
+ * @return : nnz(L) */
+//************************************************************************************************//
+cemINT8 SparseCholesky::num_factor_entries() const
+{
+    cemINT8 entries = 0;
+    for (cemINT s=0; s<num_supernodes(); ++s)
+    {
+        cemINT8 width = super_offsets_[s+1] - super_offsets_[s];
+        cemINT8 height = row_offsets_[s+1] - row_offsets_[s];
+        entries += width*height - width*(width-1)/2;
+    }
+
+    return entries;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::factor_bytes : Gets memory of the stored factor.
+ * @return : bytes of the dense blocks of L (0 before Factorize()) */
+//************************************************************************************************//
+cemINT8 SparseCholesky::factor_bytes() const
+{
+    return static_cast<cemINT8>(values_.size()*sizeof(cemDOUBLE) +
+                                single_values_.size()*sizeof(cemFLOAT));
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::num_analyses : Gets how many times Analyze() was run.
+ * @return : num_analyses_ */
+//************************************************************************************************//
+cemINT SparseCholesky::num_analyses() const {return num_analyses_;}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::is_factorized : Checks if Solve() can be called.
+ * @return : factorized_ */
+//************************************************************************************************//
+cemBOOL SparseCholesky::is_factorized() const {return factorized_;}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::permutation : Gets the ordering, row of A of each row of L.
+ * @return : permutation_ */
+//************************************************************************************************//
+const std::vector<cemINT>& SparseCholesky::permutation() const {return permutation_;}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::set_ordering : Sets fill-reducing ordering.
+ * @param [in] ordering : NATURAL_ORDERING or NESTED_DISSECTION */
+//************************************************************************************************//
+void SparseCholesky::set_ordering(const OrderingType& ordering)
+{
+    ordering_ = ordering;
+    pattern_offsets_.clear();
+    factorized_ = false;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::set_precision : Sets precision of the factor.
+ * @param [in] precision : DOUBLE_PRECISION or SINGLE_PRECISION */
+//************************************************************************************************//
+void SparseCholesky::set_precision(const FactorPrecision& precision)
+{
+    if (precision != precision_)
+        factorized_ = false;
+
+    precision_ = precision;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::Analyze : Symbolic factorization (ordering, supernodes and updates).
+ * @param [in] A : symmetric matrix (both triangles stored, only the pattern is used) */
+//************************************************************************************************//
+void SparseCholesky::Analyze(const SparseMatrix<cemDOUBLE>& A)
+{
+    if (A.num_rows() != A.num_columns())
+        throw(Exception("INPUT ERROR","Matrix must be square"));
+
+    cemINT n = A.num_rows();
+    num_rows_ = n;
+    factorized_ = false;
+    pattern_offsets_.assign(A.row_offsets(),A.row_offsets() + n + 1);
+    pattern_columns_.assign(A.column_indices(),A.column_indices() + A.num_entries());
+
+    permutation_.resize(n);
+    if (ordering_ == NESTED_DISSECTION)
+    {
+        NestedDissection(A);
+    }
+    else
+    {
+        for (cemINT i=0; i<n; ++i)
+            permutation_[i] = i;
+    }
+
+    inverse_permutation_.resize(n);
+    for (cemINT k=0; k<n; ++k)
+        inverse_permutation_[permutation_[k]] = k;
+
+    // Postorder of the elimination tree, so every subtree (and supernode) is contiguous:
+    std::vector<cemINT> parent;
+    EliminationTree(A,parent);
+
+    std::vector<cemINT> head(n,-1),next(n,-1);
+    for (cemINT j=n-1; j>=0; --j)
+    {
+        if (parent[j] >= 0)
+        {
+            next[j] = head[parent[j]];
+            head[parent[j]] = j;
+        }
+    }
+
+    std::vector<cemINT> postorder,stack;
+    postorder.reserve(n);
+    for (cemINT j=0; j<n; ++j)
+    {
+        if (parent[j] >= 0)
+            continue;
+
+        stack.push_back(j);
+        while (!stack.empty())
+        {
+            cemINT p = stack.back();
+            cemINT child = head[p];
+            if (child < 0)
+            {
+                stack.pop_back();
+                postorder.push_back(p);
+            }
+            else
+            {
+                head[p] = next[child];
+                stack.push_back(child);
+            }
+        }
+    }
+
+    std::vector<cemINT> permutation(n);
+    for (cemINT k=0; k<n; ++k)
+        permutation[k] = permutation_[postorder[k]];
+    permutation_.swap(permutation);
+    for (cemINT k=0; k<n; ++k)
+        inverse_permutation_[permutation_[k]] = k;
+
+    EliminationTree(A,parent);
+    SetUpSupernodes(A,parent);
+    SetUpUpdates();
+    ++num_analyses_;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::Factorize : Numeric factorization, in the precision of precision().
+ * Runs Analyze() first if the pattern of the matrix is not the analyzed one.
+ * @param [in] A : symmetric positive definite matrix (both triangles stored) */
+//************************************************************************************************//
+void SparseCholesky::Factorize(const SparseMatrix<cemDOUBLE>& A)
+{
+    if (!HasSamePattern(A))
+        Analyze(A);
+
+    factorized_ = false;
+    if (precision_ == SINGLE_PRECISION)
+    {
+        std::vector<cemDOUBLE>().swap(values_);
+        FactorizeValues(A,single_values_);
+    }
+    else
+    {
+        std::vector<cemFLOAT>().swap(single_values_);
+        FactorizeValues(A,values_);
+    }
+    factorized_ = true;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::Solve : Solves \f$ Ax = b \f$ with the factorization.
+ *
+ * With a SINGLE_PRECISION factor, b is rounded to single precision and the solution is only
+ * accurate to about \f$ 10^{-7} \kappa(A) \f$; see MixedPrecisionSolver to refine it.
+ * @param [in] b : num_rows() values
+ * @param [out] x : num_rows() values (may be the same array as b) */
+//************************************************************************************************//
+void SparseCholesky::Solve(const cemDOUBLE* b, cemDOUBLE* x) const
+{
+    if (!factorized_)
+        throw(Exception("SOLVER ERROR","Factorize() must be called before Solve()"));
+
+    cemINT n = num_rows_;
+    if (precision_ == SINGLE_PRECISION)
+    {
+        single_work_.resize(n);
+        cemFLOAT* y = n > 0 ? &single_work_[0] : NULL;
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT k=0; k<n; ++k)
+            y[k] = static_cast<cemFLOAT>(b[permutation_[k]]);
+
+        Substitute(single_values_,y);
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT k=0; k<n; ++k)
+            x[permutation_[k]] = y[k];
+    }
+    else
+    {
+        work_.resize(n);
+        cemDOUBLE* y = n > 0 ? &work_[0] : NULL;
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT k=0; k<n; ++k)
+            y[k] = b[permutation_[k]];
+
+        Substitute(values_,y);
+
+        #pragma omp parallel for schedule(static)
+        for (cemINT k=0; k<n; ++k)
+            x[permutation_[k]] = y[k];
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::SolveBlock : Solves \f$ AX = B \f$ for several right-hand sides,
+ * RHS_BLOCK of them per pass over L.
+ * @param [in] num_rhs : number of right-hand sides
+ * @param [in] B : column-major num_rows() x num_rhs values (as in DenseMatrix)
+ * @param [out] X : column-major num_rows() x num_rhs values (may be the same array as B) */
+//************************************************************************************************//
+void SparseCholesky::SolveBlock(const cemINT& num_rhs, const cemDOUBLE* B, cemDOUBLE* X) const
+{
+    if (!factorized_)
+        throw(Exception("SOLVER ERROR","Factorize() must be called before Solve()"));
+
+    cemINT n = num_rows_;
+    cemINT8 ld = n;
+    if (n == 0 || num_rhs <= 0)
+        return;
+
+    if (precision_ == SINGLE_PRECISION)
+        single_work_.resize(ld*std::min(num_rhs,RHS_BLOCK));
+    else
+        work_.resize(ld*std::min(num_rhs,RHS_BLOCK));
+
+    for (cemINT first_rhs=0; first_rhs<num_rhs; first_rhs+=RHS_BLOCK)
+    {
+        cemINT k = std::min(RHS_BLOCK,num_rhs - first_rhs);
+        const cemDOUBLE* b = B + first_rhs*ld;
+        cemDOUBLE* x = X + first_rhs*ld;
+
+        if (precision_ == SINGLE_PRECISION)
+        {
+            cemFLOAT* Y = &single_work_[0];
+
+            #pragma omp parallel for schedule(static)
+            for (cemINT i=0; i<n; ++i)
+                for (cemINT c=0; c<k; ++c)
+                    Y[i + c*ld] = static_cast<cemFLOAT>(b[permutation_[i] + c*ld]);
+
+            SubstituteBlock(single_values_,k,Y);
+
+            #pragma omp parallel for schedule(static)
+            for (cemINT i=0; i<n; ++i)
+                for (cemINT c=0; c<k; ++c)
+                    x[permutation_[i] + c*ld] = Y[i + c*ld];
+        }
+        else
+        {
+            cemDOUBLE* Y = &work_[0];
+
+            #pragma omp parallel for schedule(static)
+            for (cemINT i=0; i<n; ++i)
+                for (cemINT c=0; c<k; ++c)
+                    Y[i + c*ld] = b[permutation_[i] + c*ld];
+
+            SubstituteBlock(values_,k,Y);
+
+            #pragma omp parallel for schedule(static)
+            for (cemINT i=0; i<n; ++i)
+                for (cemINT c=0; c<k; ++c)
+                    x[permutation_[i] + c*ld] = Y[i + c*ld];
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::SolveBlock : Solves \f$ AX = B \f$ for the columns of a dense matrix.
+ * @param [in] B : num_rows() x num_rhs right-hand sides
+ * @param [out] X : solutions (resized to the size of B) */
+//************************************************************************************************//
+void SparseCholesky::SolveBlock(const DenseMatrix<cemDOUBLE>& B, DenseMatrix<cemDOUBLE>& X) const
+{
+    if (static_cast<cemINT>(B.num_rows()) != num_rows_)
+        throw(Exception("INPUT ERROR","Right-hand sides do not match the matrix"));
+
+    if (X.num_rows() != B.num_rows() || X.num_columns() != B.num_columns())
+        X.resize(B.num_rows(),B.num_columns());
+
+    if (B.num_columns() == 0 || B.num_rows() == 0)
+        return;
+
+    SolveBlock(B.num_columns(),&B(0,0),&X(0,0));
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::NestedDissection : Fill-reducing ordering by recursive bisection.
+ *
+ * Each subgraph is split by the middle level of a breadth-first search from a pseudo-peripheral
+ * vertex. Separator vertices without neighbors in the second half are moved to the first one.
+ * Both halves are ordered (recursively) before the separator; subgraphs of at most LEAF_SIZE
+ * vertices, or that cannot be split, keep their order.
+ * @param [in] A : symmetric matrix */
+//************************************************************************************************//
+void SparseCholesky::NestedDissection(const SparseMatrix<cemDOUBLE>& A)
+{
+    cemINT n = A.num_rows();
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+
+    std::vector<cemINT>& vertices = permutation_;
+    for (cemINT i=0; i<n; ++i)
+        vertices[i] = i;
+
+    std::vector<cemINT> label(n,0),level(n,-1),queue(n);
+    cemINT num_labels = 1;
+
+    // Subgraphs still to split, as (first position, size, label):
+    std::vector<cemINT> stack;
+    if (n > 0)
+    {
+        stack.push_back(0);
+        stack.push_back(n);
+        stack.push_back(0);
+    }
+
+    while (!stack.empty())
+    {
+        cemINT id = stack.back(); stack.pop_back();
+        cemINT size = stack.back(); stack.pop_back();
+        cemINT first = stack.back(); stack.pop_back();
+        if (size <= LEAF_SIZE)
+            continue;
+
+        cemINT* subgraph = &vertices[first];
+        cemINT num_reached = 0;
+        cemINT root = subgraph[0];
+        for (cemINT i=0; i<size; ++i)
+            level[subgraph[i]] = -1;
+        cemINT depth = LevelStructure(offsets,columns,label,id,root,level,queue,num_reached);
+
+        if (num_reached < size)
+        {
+            // Disconnected: the component of the root and the rest.
+            cemINT rest = num_reached;
+            for (cemINT i=0; i<size; ++i)
+                if (level[subgraph[i]] < 0)
+                    queue[rest++] = subgraph[i];
+
+            std::copy(queue.begin(),queue.begin() + size,subgraph);
+            for (cemINT i=0; i<num_reached; ++i)
+                label[subgraph[i]] = num_labels;
+            for (cemINT i=num_reached; i<size; ++i)
+                label[subgraph[i]] = num_labels + 1;
+
+            cemINT parts[6] = {first, num_reached, num_labels,
+                               first + num_reached, size - num_reached, num_labels + 1};
+            stack.insert(stack.end(),parts,parts + 6);
+            num_labels += 2;
+            continue;
+        }
+
+        // Pseudo-peripheral root, a vertex of smallest degree in the last level:
+        for (cemINT it=0; it<2; ++it)
+        {
+            cemINT candidate = queue[num_reached-1];
+            for (cemINT q=num_reached-1; q>=0 && level[queue[q]] == depth-1; --q)
+                if (offsets[queue[q]+1] - offsets[queue[q]] <
+                    offsets[candidate+1] - offsets[candidate])
+                    candidate = queue[q];
+
+            for (cemINT i=0; i<size; ++i)
+                level[subgraph[i]] = -1;
+            cemINT candidate_depth = LevelStructure(offsets,columns,label,id,candidate,level,
+                                                    queue,num_reached);
+            if (candidate_depth <= depth)
+            {
+                for (cemINT i=0; i<size; ++i)
+                    level[subgraph[i]] = -1;
+                LevelStructure(offsets,columns,label,id,root,level,queue,num_reached);
+                break;
+            }
+
+            root = candidate;
+            depth = candidate_depth;
+        }
+
+        // Separator, the level holding the middle vertex:
+        cemINT separator_level = level[queue[size/2]];
+        if (separator_level == 0 || separator_level == depth-1)
+            continue;
+
+        cemINT num_first = 0, num_second = 0, num_separator = 0;
+        for (cemINT q=0; q<size; ++q)
+        {
+            cemINT v = queue[q];
+            if (level[v] == separator_level)
+            {
+                cemBOOL needed = false;
+                for (cemINT8 k=offsets[v]; k<offsets[v+1] && !needed; ++k)
+                    needed = label[columns[k]] == id && level[columns[k]] > separator_level;
+
+                if (!needed)
+                    level[v] = separator_level - 1;
+            }
+
+            if (level[v] < separator_level)
+                ++num_first;
+            else if (level[v] > separator_level)
+                ++num_second;
+            else
+                ++num_separator;
+        }
+
+        cemINT next_first = 0, next_second = num_first, next_separator = num_first + num_second;
+        for (cemINT q=0; q<size; ++q)
+        {
+            cemINT v = queue[q];
+            if (level[v] < separator_level)
+            {
+                subgraph[next_first++] = v;
+                label[v] = num_labels;
+            }
+            else if (level[v] > separator_level)
+            {
+                subgraph[next_second++] = v;
+                label[v] = num_labels + 1;
+            }
+            else
+                subgraph[next_separator++] = v;
+        }
+
+        cemINT parts[6] = {first, num_first, num_labels,
+                           first + num_first, num_second, num_labels + 1};
+        stack.insert(stack.end(),parts,parts + 6);
+        num_labels += 2;
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::EliminationTree : Elimination tree of the permuted matrix.
+ * @param [in] A : symmetric matrix
+ * @param [out] parent : parent of each column of L (-1 for roots) */
+//************************************************************************************************//
+void SparseCholesky::EliminationTree(const SparseMatrix<cemDOUBLE>& A,
+                                     std::vector<cemINT>& parent) const
+{
+    cemINT n = num_rows_;
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+
+    parent.assign(n,-1);
+    std::vector<cemINT> ancestor(n,-1);
+    for (cemINT k=0; k<n; ++k)
+    {
+        cemINT row = permutation_[k];
+        for (cemINT8 l=offsets[row]; l<offsets[row+1]; ++l)
+        {
+            // Path from i to its root, compressed to point at k:
+            cemINT i = inverse_permutation_[columns[l]];
+            while (i >= 0 && i < k)
+            {
+                cemINT next = ancestor[i];
+                ancestor[i] = k;
+                if (next < 0)
+                    parent[i] = k;
+                i = next;
+            }
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::SetUpSupernodes : Column counts, supernodes, their rows and their
+ * levels.
+ *
+ * Row k of L has an entry in every column of the elimination tree between the columns of row k
+ * of the permuted matrix and k, so the counts and rows come from walking those paths.
+ * @param [in] A : symmetric matrix
+ * @param [in] parent : elimination tree (postordered) */
+//************************************************************************************************//
+void SparseCholesky::SetUpSupernodes(const SparseMatrix<cemDOUBLE>& A,
+                                     const std::vector<cemINT>& parent)
+{
+    cemINT n = num_rows_;
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+
+    // Column counts:
+    std::vector<cemINT> counts(n,1),mark(n,-1),num_children(n,0);
+    for (cemINT k=0; k<n; ++k)
+    {
+        mark[k] = k;
+        cemINT row = permutation_[k];
+        for (cemINT8 l=offsets[row]; l<offsets[row+1]; ++l)
+        {
+            for (cemINT i=inverse_permutation_[columns[l]]; i<k && mark[i] != k; i=parent[i])
+            {
+                ++counts[i];
+                mark[i] = k;
+            }
+        }
+
+        if (parent[k] >= 0)
+            ++num_children[parent[k]];
+    }
+
+    // Supernodes, chains of columns. Fundamental ones have columns with nested structures; up to
+    // RELAXED_WIDTH columns are merged anyway, storing the missing entries as zeros:
+    super_offsets_.assign(1,0);
+    for (cemINT j=1; j<n; ++j)
+    {
+        cemBOOL fundamental = counts[j-1] == counts[j] + 1 && num_children[j] == 1;
+        if (parent[j-1] != j || (!fundamental && j - super_offsets_.back() >= RELAXED_WIDTH))
+            super_offsets_.push_back(j);
+    }
+    if (n > 0)
+        super_offsets_.push_back(n);
+
+    cemINT num_super = num_supernodes();
+    std::vector<cemINT> supernode(n);
+    for (cemINT s=0; s<num_super; ++s)
+        for (cemINT j=super_offsets_[s]; j<super_offsets_[s+1]; ++j)
+            supernode[j] = s;
+
+    row_offsets_.assign(num_super+1,0);
+    value_offsets_.assign(num_super+1,0);
+    for (cemINT s=0; s<num_super; ++s)
+    {
+        cemINT last = super_offsets_[s+1] - 1;
+        cemINT8 height = last - super_offsets_[s] + counts[last];
+        row_offsets_[s+1] = row_offsets_[s] + height;
+        value_offsets_[s+1] = value_offsets_[s] + height*(super_offsets_[s+1] - super_offsets_[s]);
+    }
+
+    // Rows, the columns of the supernode and then the rows below in increasing order:
+    rows_.resize(row_offsets_[num_super]);
+    std::vector<cemINT8> fill(row_offsets_.begin(),row_offsets_.end()-1);
+    for (cemINT s=0; s<num_super; ++s)
+        for (cemINT j=super_offsets_[s]; j<super_offsets_[s+1]; ++j)
+            rows_[fill[s]++] = j;
+
+    std::vector<cemINT> last_row(num_super,-1);
+    std::fill(mark.begin(),mark.end(),-1);
+    for (cemINT k=0; k<n; ++k)
+    {
+        mark[k] = k;
+        cemINT row = permutation_[k];
+        for (cemINT8 l=offsets[row]; l<offsets[row+1]; ++l)
+        {
+            for (cemINT i=inverse_permutation_[columns[l]]; i<k && mark[i] != k; i=parent[i])
+            {
+                mark[i] = k;
+                cemINT s = supernode[i];
+                if (k >= super_offsets_[s+1] && last_row[s] != k)
+                {
+                    rows_[fill[s]++] = k;
+                    last_row[s] = k;
+                }
+            }
+        }
+    }
+
+    // Levels by height in the supernodal tree (children are numbered before their parents):
+    std::vector<cemINT> height(num_super,0);
+    cemINT num_levels = num_super > 0 ? 1 : 0;
+    for (cemINT s=0; s<num_super; ++s)
+    {
+        cemINT p = parent[super_offsets_[s+1]-1];
+        if (p >= 0)
+        {
+            height[supernode[p]] = std::max(height[supernode[p]],height[s] + 1);
+            num_levels = std::max(num_levels,height[supernode[p]] + 1);
+        }
+    }
+
+    level_offsets_.assign(num_levels+1,0);
+    for (cemINT s=0; s<num_super; ++s)
+        ++level_offsets_[height[s]+1];
+    for (cemINT l=0; l<num_levels; ++l)
+        level_offsets_[l+1] += level_offsets_[l];
+
+    level_supernodes_.resize(num_super);
+    std::vector<cemINT> next(level_offsets_.begin(),level_offsets_.end()-1);
+    for (cemINT s=0; s<num_super; ++s)
+        level_supernodes_[next[height[s]]++] = s;
+
+    values_.clear();
+    single_values_.clear();
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::HasSamePattern : Checks if a matrix has the analyzed pattern.
+ * @param [in] A : sparse matrix
+ * @return : true if rows and columns of all entries match */
+//************************************************************************************************//
+cemBOOL SparseCholesky::HasSamePattern(const SparseMatrix<cemDOUBLE>& A) const
+{
+    if (pattern_offsets_.empty() ||
+        static_cast<cemINT>(pattern_offsets_.size()) != static_cast<cemINT>(A.num_rows()) + 1 ||
+        pattern_offsets_.back() != A.num_entries())
+        return false;
+
+    return std::equal(pattern_offsets_.begin(),pattern_offsets_.end(),A.row_offsets()) &&
+           std::equal(pattern_columns_.begin(),pattern_columns_.end(),A.column_indices());
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::SetUpUpdates : For each supernode, the descendants with rows in its
+ * columns. The rows of a descendant are sorted, so those in the columns of one ancestor are a
+ * contiguous range. */
+//************************************************************************************************//
+void SparseCholesky::SetUpUpdates()
+{
+    cemINT num_super = num_supernodes();
+    std::vector<cemINT> supernode(num_rows_);
+    for (cemINT s=0; s<num_super; ++s)
+        for (cemINT j=super_offsets_[s]; j<super_offsets_[s+1]; ++j)
+            supernode[j] = s;
+
+    update_offsets_.assign(num_super+1,0);
+    for (cemINT pass=0; pass<2; ++pass)
+    {
+        std::vector<cemINT8> fill(update_offsets_.begin(),update_offsets_.end()-1);
+        for (cemINT d=0; d<num_super; ++d)
+        {
+            const cemINT* rows = &rows_[row_offsets_[d]];
+            cemINT height = static_cast<cemINT>(row_offsets_[d+1] - row_offsets_[d]);
+            cemINT r = super_offsets_[d+1] - super_offsets_[d];
+            while (r < height)
+            {
+                cemINT t = supernode[rows[r]];
+                cemINT end = r;
+                while (end < height && rows[end] < super_offsets_[t+1])
+                    ++end;
+
+                if (pass == 0)
+                    ++update_offsets_[t+1];
+                else
+                {
+                    update_sources_[fill[t]] = d;
+                    update_first_[fill[t]] = r;
+                    update_last_[fill[t]++] = end;
+                }
+                r = end;
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (cemINT s=0; s<num_super; ++s)
+                update_offsets_[s+1] += update_offsets_[s];
+            update_sources_.resize(update_offsets_[num_super]);
+            update_first_.resize(update_offsets_[num_super]);
+            update_last_.resize(update_offsets_[num_super]);
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::FactorizeValues : Computes L, level by level of the supernodal tree.
+ * @param [in] A : symmetric positive definite matrix with the analyzed pattern
+ * @param [out] values : dense blocks of the supernodes (values_ or single_values_) */
+//************************************************************************************************//
+template <class T>
+void SparseCholesky::FactorizeValues(const SparseMatrix<cemDOUBLE>& A, std::vector<T>& values)
+{
+    values.resize(value_offsets_.back());
+    cemINT num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    std::vector< std::vector<cemINT> > positions(num_threads);
+    std::vector< std::vector<T> > buffers(num_threads);
+    cemINT failed = -1;
+
+    // Levels with several supernodes are threaded over them. A lone supernode runs outside a
+    // parallel region and splits the rows of its dense kernels over the threads instead:
+    for (cemINT level=0; level+1<static_cast<cemINT>(level_offsets_.size()); ++level)
+    {
+        cemINT first = level_offsets_[level];
+        cemINT last = level_offsets_[level+1];
+        cemBOOL split_rows = (last - first == 1) && num_threads > 1;
+
+        #pragma omp parallel for schedule(dynamic) if(last - first > 1)
+        for (cemINT p=first; p<last; ++p)
+        {
+            cemINT thread = 0;
+#ifdef _OPENMP
+            thread = omp_get_thread_num();
+#endif
+            if (positions[thread].empty())
+                positions[thread].resize(num_rows_);
+
+            if (!FactorizeSupernode(A,level_supernodes_[p],values,positions[thread],
+                                    buffers[thread],split_rows))
+            {
+                #pragma omp critical
+                failed = level_supernodes_[p];
+            }
+        }
+
+        if (failed >= 0)
+            throw(Exception("FACTORIZATION ERROR","Matrix is not positive definite (column " +
+                            cem_utils::NumberToString<cemINT>(super_offsets_[failed]) +
+                            " of the ordered matrix)"));
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::FactorizeSupernode : Computes the columns of L of a supernode (all its
+ * descendants must be factorized).
+ * @param [in] A : symmetric positive definite matrix
+ * @param [in] s : supernode
+ * @param [in,out] values : dense blocks of the supernodes
+ * @param [in,out] position : work array of num_rows() values
+ * @param [in,out] buffer : work array for the updates (resized as needed)
+ * @param [in] split_rows : split the rows of the updates and of the off-diagonal block into blocks
+ * of ROW_BLOCK over the threads (only outside a parallel region)
+ * @return : false if the diagonal block is not positive definite */
+//************************************************************************************************//
+template <class T>
+cemBOOL SparseCholesky::FactorizeSupernode(const SparseMatrix<cemDOUBLE>& A,
+                                           const cemINT& s,
+                                           std::vector<T>& values,
+                                           std::vector<cemINT>& position,
+                                           std::vector<T>& buffer,
+                                           const cemBOOL& split_rows) const
+{
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    const cemDOUBLE* a = A.values();
+
+    cemINT f = super_offsets_[s];
+    cemINT width = super_offsets_[s+1] - f;
+    cemINT height = static_cast<cemINT>(row_offsets_[s+1] - row_offsets_[s]);
+    const cemINT* rows = &rows_[row_offsets_[s]];
+    T* L = &values[value_offsets_[s]];
+
+    for (cemINT r=0; r<height; ++r)
+        position[rows[r]] = r;
+
+    // Lower entries of the permuted matrix:
+    std::fill(L,L + static_cast<cemINT8>(width)*height,T(0));
+    for (cemINT j=f; j<f+width; ++j)
+    {
+        T* column = L + static_cast<cemINT8>(j-f)*height;
+        cemINT row = permutation_[j];
+        for (cemINT8 k=offsets[row]; k<offsets[row+1]; ++k)
+        {
+            cemINT i = inverse_permutation_[columns[k]];
+            if (i >= j)
+                column[position[i]] += static_cast<T>(a[k]);
+        }
+    }
+
+    // Updates from descendants, C = L_d(rows >= f) L_d(rows in the supernode)^T:
+    for (cemINT8 u=update_offsets_[s]; u<update_offsets_[s+1]; ++u)
+    {
+        cemINT d = update_sources_[u];
+        cemINT width_d = super_offsets_[d+1] - super_offsets_[d];
+        cemINT height_d = static_cast<cemINT>(row_offsets_[d+1] - row_offsets_[d]);
+        const cemINT* rows_d = &rows_[row_offsets_[d]] + update_first_[u];
+        const T* L_d = &values[value_offsets_[d]] + update_first_[u];
+        cemINT num_rows = height_d - update_first_[u];
+        cemINT num_columns = update_last_[u] - update_first_[u];
+
+        if (static_cast<cemINT8>(buffer.size()) < static_cast<cemINT8>(num_rows)*num_columns)
+            buffer.resize(static_cast<cemINT8>(num_rows)*num_columns);
+
+        // Rows of different blocks go to different rows of L:
+        cemINT block = split_rows ? ROW_BLOCK : num_rows;
+        cemINT num_blocks = (num_rows + block - 1)/block;
+        T* C = &buffer[0];
+
+        #pragma omp parallel for schedule(dynamic) if(num_blocks > 1)
+        for (cemINT b=0; b<num_blocks; ++b)
+        {
+            cemINT first_row = b*block;
+            cemINT block_rows = std::min(block,num_rows - first_row);
+            MKL_MatrixTimesMatrixTransposed(block_rows,num_columns,width_d,L_d + first_row,height_d,
+                                            L_d,height_d,C + first_row,num_rows);
+
+            for (cemINT c=0; c<num_columns; ++c)
+            {
+                T* column = L + static_cast<cemINT8>(rows_d[c]-f)*height;
+                const T* update = C + static_cast<cemINT8>(c)*num_rows;
+                for (cemINT r=std::max(c,first_row); r<first_row+block_rows; ++r)
+                    column[position[rows_d[r]]] -= update[r];
+            }
+        }
+    }
+
+    // Diagonal block and the rows below:
+    if (MKL_CholeskyFactorization(width,L,height) != 0)
+        return false;
+
+    cemINT below = height - width;
+    cemINT block = split_rows ? ROW_BLOCK : below;
+    cemINT num_blocks = (below > 0) ? (below + block - 1)/block : 0;
+
+    #pragma omp parallel for schedule(dynamic) if(num_blocks > 1)
+    for (cemINT b=0; b<num_blocks; ++b)
+    {
+        cemINT first_row = b*block;
+        MKL_TriangularSolveRightTransposed(std::min(block,below - first_row),width,L,height,
+                                           L + width + first_row,height);
+    }
+
+    return true;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::Substitute : Forward and backward substitution of a permuted vector,
+ * \f$ y = L^{-T}L^{-1}y \f$.
+ * @param [in] values : dense blocks of the supernodes (values_ or single_values_)
+ * @param [in,out] y : num_rows() values in the order of L */
+//************************************************************************************************//
+template <class T>
+void SparseCholesky::Substitute(const std::vector<T>& values, T* y) const
+{
+    cemINT num_levels = static_cast<cemINT>(level_offsets_.size()) - 1;
+
+    // Forward, L y = P b. Each supernode gathers the updates of its descendants:
+    for (cemINT level=0; level<num_levels; ++level)
+    {
+        cemINT first = level_offsets_[level];
+        cemINT last = level_offsets_[level+1];
+
+        #pragma omp parallel for schedule(dynamic) if(last - first > 1)
+        for (cemINT p=first; p<last; ++p)
+        {
+            cemINT s = level_supernodes_[p];
+            for (cemINT8 u=update_offsets_[s]; u<update_offsets_[s+1]; ++u)
+            {
+                cemINT d = update_sources_[u];
+                cemINT first_column = super_offsets_[d];
+                cemINT width = super_offsets_[d+1] - first_column;
+                cemINT height = static_cast<cemINT>(row_offsets_[d+1] - row_offsets_[d]);
+                const cemINT* rows = &rows_[row_offsets_[d]];
+                const T* L = &values[value_offsets_[d]];
+                for (cemINT c=0; c<width; ++c)
+                {
+                    T yc = y[first_column + c];
+                    const T* column = L + static_cast<cemINT8>(c)*height;
+                    for (cemINT r=update_first_[u]; r<update_last_[u]; ++r)
+                        y[rows[r]] -= column[r]*yc;
+                }
+            }
+
+            cemINT f = super_offsets_[s];
+            cemINT height = static_cast<cemINT>(row_offsets_[s+1] - row_offsets_[s]);
+            MKL_TriangularSolve(super_offsets_[s+1] - f,&values[value_offsets_[s]],height,
+                                y + f,false);
+        }
+    }
+
+    // Backward, L^T P x = y, from the root:
+    for (cemINT level=num_levels-1; level>=0; --level)
+    {
+        cemINT first = level_offsets_[level];
+        cemINT last = level_offsets_[level+1];
+
+        #pragma omp parallel for schedule(dynamic) if(last - first > 1)
+        for (cemINT p=first; p<last; ++p)
+        {
+            cemINT s = level_supernodes_[p];
+            cemINT f = super_offsets_[s];
+            cemINT width = super_offsets_[s+1] - f;
+            cemINT height = static_cast<cemINT>(row_offsets_[s+1] - row_offsets_[s]);
+            const cemINT* rows = &rows_[row_offsets_[s]];
+            const T* L = &values[value_offsets_[s]];
+            for (cemINT c=0; c<width; ++c)
+            {
+                const T* column = L + static_cast<cemINT8>(c)*height;
+                T sum = 0;
+                for (cemINT r=width; r<height; ++r)
+                    sum += column[r]*y[rows[r]];
+                y[f + c] -= sum;
+            }
+
+            MKL_TriangularSolve(width,L,height,y + f,true);
+        }
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief SparseCholesky::SubstituteBlock : Forward and backward substitution of a block of
+ * permuted vectors, \f$ Y = L^{-T}L^{-1}Y \f$.
+ *
+ * The update of a supernode by a descendant is a dgemm of its rows by the solved block of the
+ * descendant, and each diagonal block is a dtrsm.
+ * @param [in] values : dense blocks of the supernodes (values_ or single_values_)
+ * @param [in] k : number of vectors (at most RHS_BLOCK)
+ * @param [in,out] Y : column-major num_rows() x k values in the order of L */
+//************************************************************************************************//
+template <class T>
+void SparseCholesky::SubstituteBlock(const std::vector<T>& values, const cemINT& k, T* Y) const
+{
+    cemINT n = num_rows_;
+    cemINT8 ld = n;
+    cemINT num_levels = static_cast<cemINT>(level_offsets_.size()) - 1;
+    cemINT num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    std::vector< std::vector<T> > buffers(num_threads);
+
+    // Forward, L Y = P B:
+    for (cemINT level=0; level<num_levels; ++level)
+    {
+        cemINT first = level_offsets_[level];
+        cemINT last = level_offsets_[level+1];
+
+        #pragma omp parallel for schedule(dynamic) if(last - first > 1)
+        for (cemINT p=first; p<last; ++p)
+        {
+            cemINT thread = 0;
+#ifdef _OPENMP
+            thread = omp_get_thread_num();
+#endif
+            std::vector<T>& buffer = buffers[thread];
+            cemINT s = level_supernodes_[p];
+            for (cemINT8 u=update_offsets_[s]; u<update_offsets_[s+1]; ++u)
+            {
+                cemINT d = update_sources_[u];
+                cemINT width = super_offsets_[d+1] - super_offsets_[d];
+                cemINT height = static_cast<cemINT>(row_offsets_[d+1] - row_offsets_[d]);
+                const cemINT* rows = &rows_[row_offsets_[d]] + update_first_[u];
+                cemINT num_rows = update_last_[u] - update_first_[u];
+                if (static_cast<cemINT>(buffer.size()) < num_rows*k)
+                    buffer.resize(num_rows*k);
+
+                MKL_MatrixMultiply(false,num_rows,k,width,T(1),
+                                   &values[value_offsets_[d]] + update_first_[u],height,
+                                   Y + super_offsets_[d],n,T(0),&buffer[0],num_rows);
+
+                for (cemINT c=0; c<k; ++c)
+                    for (cemINT r=0; r<num_rows; ++r)
+                        Y[rows[r] + c*ld] -= buffer[r + c*num_rows];
+            }
+
+            cemINT f = super_offsets_[s];
+            cemINT height = static_cast<cemINT>(row_offsets_[s+1] - row_offsets_[s]);
+            MKL_TriangularSolve(super_offsets_[s+1] - f,k,&values[value_offsets_[s]],height,
+                                Y + f,n,false);
+        }
+    }
+
+    // Backward, L^T P X = Y, from the root:
+    for (cemINT level=num_levels-1; level>=0; --level)
+    {
+        cemINT first = level_offsets_[level];
+        cemINT last = level_offsets_[level+1];
+
+        #pragma omp parallel for schedule(dynamic) if(last - first > 1)
+        for (cemINT p=first; p<last; ++p)
+        {
+            cemINT thread = 0;
+#ifdef _OPENMP
+            thread = omp_get_thread_num();
+#endif
+            std::vector<T>& buffer = buffers[thread];
+            cemINT s = level_supernodes_[p];
+            cemINT f = super_offsets_[s];
+            cemINT width = super_offsets_[s+1] - f;
+            cemINT height = static_cast<cemINT>(row_offsets_[s+1] - row_offsets_[s]);
+            const cemINT* rows = &rows_[row_offsets_[s]];
+            const T* L = &values[value_offsets_[s]];
+            cemINT num_below = height - width;
+            if (num_below > 0)
+            {
+                if (static_cast<cemINT>(buffer.size()) < num_below*k)
+                    buffer.resize(num_below*k);
+
+                for (cemINT c=0; c<k; ++c)
+                    for (cemINT r=0; r<num_below; ++r)
+                        buffer[r + c*num_below] = Y[rows[width + r] + c*ld];
+
+                MKL_MatrixMultiply(true,width,k,num_below,T(-1),L + width,height,
+                                   &buffer[0],num_below,T(1),Y + f,n);
+            }
+
+            MKL_TriangularSolve(width,k,L,height,Y + f,n,true);
+        }
+    }
+}
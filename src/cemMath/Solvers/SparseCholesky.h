@@ -0,0 +1,147 @@
+#ifndef SPARSECHOLESKY_H
+#define SPARSECHOLESKY_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/DenseMatrix.h"
+#include "Matrix/SparseMatrix.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+/** @brief The OrderingType enum : Fill-reducing orderings of the direct solvers. */
+enum OrderingType
+{
+    NATURAL_ORDERING=0,
+    NESTED_DISSECTION=1,
+};
+
+/** @brief The FactorPrecision enum : Floating point precision of the stored factor. */
+enum FactorPrecision
+{
+    DOUBLE_PRECISION=0,
+    SINGLE_PRECISION=1,
+};
+
+//************************************************************************************************//
+/** @brief The SparseCholesky class : Supernodal sparse Cholesky factorization
+ * \f$ PAP^T = LL^T \f$ of a symmetric positive definite matrix.
+ *
+ * Analyze() only uses the pattern: it computes the fill-reducing ordering (nested dissection
+ * with level-set separators, postordered by the elimination tree), the column counts, the
+ * supernodes (chains of columns of L with the same structure, relaxed to store a few zeros in
+ * narrow ones) and, for each supernode, the descendants that update it. Factorize() computes L
+ * for the values of a matrix with that pattern and can be called again when only the values
+ * change. Each supernode is a dense column-major block, factorized left-looking with dgemm
+ * (updates), dpotrf (diagonal block) and dtrsm (off-diagonal block). SolveBlock() substitutes
+ * RHS_BLOCK right-hand sides per pass over L with the same dense kernels. Supernodes of the same
+ * height in the supernodal tree are independent, so the factorization and the triangular solves
+ * are threaded over them with OpenMP. The dense kernels themselves are sequential (the library
+ * links the sequential MKL), so a level with a single supernode (the top separators) splits the
+ * rows of its updates and of its off-diagonal block into blocks of ROW_BLOCK over the threads
+ * instead; its diagonal block is factorized by one thread.
+ *
+ * With SINGLE_PRECISION the factorization and the substitutions run in single precision (sgemm,
+ * spotrf, strsm), which halves the memory of L and the bytes read per solve. The solutions are
+ * then only accurate to single precision, and MixedPrecisionSolver refines them.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class SparseCholesky
+{
+public:
+    // Constructor with parameters:
+    SparseCholesky(const OrderingType& ordering = NESTED_DISSECTION);
+
+    // Get data members:
+    OrderingType ordering() const;
+    FactorPrecision precision() const;
+    cemINT num_rows() const;
+    cemINT num_supernodes() const;
+    cemINT8 num_factor_entries() const;
+    cemINT8 factor_bytes() const;
+    cemINT num_analyses() const;
+    cemBOOL is_factorized() const;
+    const std::vector<cemINT>& permutation() const;
+
+    // Set data members (Analyze() must be called again):
+    void set_ordering(const OrderingType& ordering);
+
+    // Set data members (Factorize() must be called again):
+    void set_precision(const FactorPrecision& precision);
+
+    void Analyze(const SparseMatrix<cemDOUBLE>& A);
+    void Factorize(const SparseMatrix<cemDOUBLE>& A);
+    void Solve(const cemDOUBLE* b, cemDOUBLE* x) const;
+    void SolveBlock(const cemINT& num_rhs, const cemDOUBLE* B, cemDOUBLE* X) const;
+    void SolveBlock(const DenseMatrix<cemDOUBLE>& B, DenseMatrix<cemDOUBLE>& X) const;
+
+private:
+    OrderingType ordering_;                     //!< Fill-reducing ordering.
+    FactorPrecision precision_;                 //!< Precision of the factor.
+    cemINT num_rows_;                           //!< Rows and columns of the matrix.
+    cemINT num_analyses_;                       //!< Times Analyze() was run.
+    cemBOOL factorized_;                        //!< Factorize() succeeded for the pattern.
+    std::vector<cemINT> permutation_;           //!< Row of A of each row of L.
+    std::vector<cemINT> inverse_permutation_;   //!< Row of L of each row of A.
+    std::vector<cemINT8> pattern_offsets_;      //!< Pattern of the analyzed matrix.
+    std::vector<cemINT> pattern_columns_;       //!< Pattern of the analyzed matrix.
+
+    // Supernodes:
+    std::vector<cemINT> super_offsets_;         //!< First column of each supernode.
+    std::vector<cemINT8> row_offsets_;          //!< First row index of each supernode.
+    std::vector<cemINT> rows_;                  //!< Rows of each supernode (its columns first).
+    std::vector<cemINT8> value_offsets_;        //!< First value of each supernode.
+    std::vector<cemDOUBLE> values_;             //!< Dense column-major blocks of L.
+    std::vector<cemFLOAT> single_values_;       //!< values_ of a SINGLE_PRECISION factor.
+
+    // Descendants that update each supernode, with the range of their rows in its columns:
+    std::vector<cemINT8> update_offsets_;       //!< First update of each supernode.
+    std::vector<cemINT> update_sources_;        //!< Descendant supernode.
+    std::vector<cemINT> update_first_;          //!< First row position in the descendant.
+    std::vector<cemINT> update_last_;           //!< Last row position (excluded).
+
+    // Supernodes by height in the supernodal tree (leaves first):
+    std::vector<cemINT> level_offsets_;         //!< First supernode of each level.
+    std::vector<cemINT> level_supernodes_;      //!< Supernodes of each level.
+
+    mutable std::vector<cemDOUBLE> work_;       //!< Permuted vectors of the solves.
+    mutable std::vector<cemFLOAT> single_work_; //!< work_ of a SINGLE_PRECISION factor.
+
+    static const cemINT LEAF_SIZE = 64;         //!< Subgraphs not dissected any further.
+    static const cemINT RELAXED_WIDTH = 16;     //!< Widest supernode merged with stored zeros.
+    static const cemINT RHS_BLOCK = 16;         //!< Right-hand sides per pass of SolveBlock().
+    static const cemINT ROW_BLOCK = 256;        //!< Rows per thread of a lone supernode.
+
+    // Private member functions:
+    void NestedDissection(const SparseMatrix<cemDOUBLE>& A);
+    void EliminationTree(const SparseMatrix<cemDOUBLE>& A, std::vector<cemINT>& parent) const;
+    void SetUpSupernodes(const SparseMatrix<cemDOUBLE>& A, const std::vector<cemINT>& parent);
+    cemBOOL HasSamePattern(const SparseMatrix<cemDOUBLE>& A) const;
+    void SetUpUpdates();
+
+    template <class T>
+    void FactorizeValues(const SparseMatrix<cemDOUBLE>& A, std::vector<T>& values);
+
+    template <class T>
+    cemBOOL FactorizeSupernode(const SparseMatrix<cemDOUBLE>& A,
+                               const cemINT& s,
+                               std::vector<T>& values,
+                               std::vector<cemINT>& position,
+                               std::vector<T>& buffer,
+                               const cemBOOL& split_rows) const;
+
+    template <class T>
+    void Substitute(const std::vector<T>& values, T* y) const;
+
+    template <class T>
+    void SubstituteBlock(const std::vector<T>& values, const cemINT& k, T* Y) const;
+};
+
+
+}
+
+
+
+#endif // SPARSECHOLESKY_H
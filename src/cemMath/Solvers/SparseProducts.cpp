@@ -0,0 +1,203 @@
+#include <algorithm>
+#include "SparseProducts.h"
+#include "cemError.h"
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+
+//************************************************************************************************//
+/** @brief SparseTranspose : Transposes a sparse matrix (pattern and values).
+ * @param [in] A : sparse matrix
+ * @param [out] At : \f$ A^T \f$
+ * @param [out] positions : entry of A of each entry of At, for SparseTransposeValues() */
+//************************************************************************************************//
+void cem_math::SparseTranspose(const SparseMatrix<cemDOUBLE>& A,
+                               SparseMatrix<cemDOUBLE>& At,
+                               std::vector<cemINT8>& positions)
+{
+    cemINT num_rows = A.num_rows();
+    cemINT num_columns = A.num_columns();
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+
+    // Counting sort by column (rows come out sorted within each column):
+    std::vector<cemINT8> row_offsets(num_columns+1,0);
+    for (cemINT8 k=0; k<A.num_entries(); ++k)
+        ++row_offsets[columns[k]+1];
+    for (cemINT j=0; j<num_columns; ++j)
+        row_offsets[j+1] += row_offsets[j];
+
+    std::vector<cemINT> column_indices(A.num_entries());
+    positions.resize(A.num_entries());
+    std::vector<cemINT8> next(row_offsets.begin(),row_offsets.end()-1);
+    for (cemINT i=0; i<num_rows; ++i)
+    {
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+        {
+            cemINT8 p = next[columns[k]]++;
+            column_indices[p] = i;
+            positions[p] = k;
+        }
+    }
+
+    At.set_pattern(num_columns,num_rows,row_offsets,column_indices);
+    SparseTransposeValues(A,positions,At);
+}
+
+
+//************************************************************************************************//
+/** @brief SparseTransposeValues : Copies the values of a matrix into its transpose.
+ * @param [in] A : sparse matrix
+ * @param [in] positions : from SparseTranspose()
+ * @param [in,out] At : \f$ A^T \f$ with the pattern of SparseTranspose() */
+//************************************************************************************************//
+void cem_math::SparseTransposeValues(const SparseMatrix<cemDOUBLE>& A,
+                                     const std::vector<cemINT8>& positions,
+                                     SparseMatrix<cemDOUBLE>& At)
+{
+    if (At.num_entries() != A.num_entries() ||
+        static_cast<cemINT8>(positions.size()) != A.num_entries())
+        throw(Exception("INPUT ERROR","Transpose does not match the matrix"));
+
+    const cemDOUBLE* values = A.values();
+    cemDOUBLE* values_t = At.values();
+    cemINT8 num_entries = A.num_entries();
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT8 k=0; k<num_entries; ++k)
+        values_t[k] = values[positions[k]];
+}
+
+
+//************************************************************************************************//
+/** @brief SparseProductPattern : Pattern of a sparse matrix-matrix product (values are zero).
+ *
+ * Rows are built in parallel in two passes (count, then fill and sort), each thread with its own
+ * marker array.
+ * @param [in] A : m x n sparse matrix
+ * @param [in] B : n x p sparse matrix
+ * @param [out] C : m x p pattern of \f$ AB \f$ */
+//************************************************************************************************//
+void cem_math::SparseProductPattern(const SparseMatrix<cemDOUBLE>& A,
+                                    const SparseMatrix<cemDOUBLE>& B,
+                                    SparseMatrix<cemDOUBLE>& C)
+{
+    if (A.num_columns() != B.num_rows())
+        throw(Exception("INPUT ERROR","Matrix sizes do not match"));
+
+    cemINT num_rows = A.num_rows();
+    cemINT num_columns = B.num_columns();
+    const cemINT8* offsets_a = A.row_offsets();
+    const cemINT* columns_a = A.column_indices();
+    const cemINT8* offsets_b = B.row_offsets();
+    const cemINT* columns_b = B.column_indices();
+
+    std::vector<cemINT8> row_offsets(num_rows+1,0);
+    std::vector<cemINT> column_indices;
+
+    #pragma omp parallel
+    {
+        std::vector<cemINT> marker(num_columns,-1);
+
+        #pragma omp for schedule(static)
+        for (cemINT i=0; i<num_rows; ++i)
+        {
+            cemINT8 count = 0;
+            for (cemINT8 k=offsets_a[i]; k<offsets_a[i+1]; ++k)
+            {
+                cemINT j = columns_a[k];
+                for (cemINT8 l=offsets_b[j]; l<offsets_b[j+1]; ++l)
+                {
+                    if (marker[columns_b[l]] != i)
+                    {
+                        marker[columns_b[l]] = i;
+                        ++count;
+                    }
+                }
+            }
+            row_offsets[i+1] = count;
+        }
+
+        #pragma omp single
+        {
+            for (cemINT i=0; i<num_rows; ++i)
+                row_offsets[i+1] += row_offsets[i];
+            column_indices.resize(row_offsets[num_rows]);
+        }
+
+        std::fill(marker.begin(),marker.end(),-1);
+
+        #pragma omp for schedule(static)
+        for (cemINT i=0; i<num_rows; ++i)
+        {
+            cemINT8 p = row_offsets[i];
+            for (cemINT8 k=offsets_a[i]; k<offsets_a[i+1]; ++k)
+            {
+                cemINT j = columns_a[k];
+                for (cemINT8 l=offsets_b[j]; l<offsets_b[j+1]; ++l)
+                {
+                    if (marker[columns_b[l]] != i)
+                    {
+                        marker[columns_b[l]] = i;
+                        column_indices[p++] = columns_b[l];
+                    }
+                }
+            }
+            std::sort(column_indices.begin() + row_offsets[i],column_indices.begin() + p);
+        }
+    }
+
+    C.set_pattern(num_rows,num_columns,row_offsets,column_indices);
+}
+
+
+//************************************************************************************************//
+/** @brief SparseProductValues : Values of a sparse matrix-matrix product with a known pattern.
+ * @param [in] A : m x n sparse matrix
+ * @param [in] B : n x p sparse matrix
+ * @param [in,out] C : \f$ AB \f$, with the pattern of SparseProductPattern() */
+//************************************************************************************************//
+void cem_math::SparseProductValues(const SparseMatrix<cemDOUBLE>& A,
+                                   const SparseMatrix<cemDOUBLE>& B,
+                                   SparseMatrix<cemDOUBLE>& C)
+{
+    if (A.num_rows() != C.num_rows() || B.num_columns() != C.num_columns())
+        throw(Exception("INPUT ERROR","Product pattern does not match the matrices"));
+
+    cemINT num_rows = A.num_rows();
+    const cemINT8* offsets_a = A.row_offsets();
+    const cemINT* columns_a = A.column_indices();
+    const cemDOUBLE* values_a = A.values();
+    const cemINT8* offsets_b = B.row_offsets();
+    const cemINT* columns_b = B.column_indices();
+    const cemDOUBLE* values_b = B.values();
+    const cemINT8* offsets_c = C.row_offsets();
+    const cemINT* columns_c = C.column_indices();
+    cemDOUBLE* values_c = C.values();
+
+    #pragma omp parallel
+    {
+        std::vector<cemINT8> position(C.num_columns(),-1);
+
+        #pragma omp for schedule(static)
+        for (cemINT i=0; i<num_rows; ++i)
+        {
+            for (cemINT8 p=offsets_c[i]; p<offsets_c[i+1]; ++p)
+            {
+                position[columns_c[p]] = p;
+                values_c[p] = 0.0;
+            }
+
+            for (cemINT8 k=offsets_a[i]; k<offsets_a[i+1]; ++k)
+            {
+                cemINT j = columns_a[k];
+                for (cemINT8 l=offsets_b[j]; l<offsets_b[j+1]; ++l)
+                    values_c[position[columns_b[l]]] += values_a[k]*values_b[l];
+            }
+
+            for (cemINT8 p=offsets_c[i]; p<offsets_c[i+1]; ++p)
+                position[columns_c[p]] = -1;
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef SPARSEPRODUCTS_H
+#define SPARSEPRODUCTS_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/SparseMatrix.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+// Sparse matrix transpose and product, each split into a pattern (symbolic) and a values
+// (numeric) step, so the values can be computed again without rebuilding the pattern.
+
+// At = A^T; positions[k] is the entry of A copied to entry k of At:
+void SparseTranspose(const SparseMatrix<cemDOUBLE>& A,
+                     SparseMatrix<cemDOUBLE>& At,
+                     std::vector<cemINT8>& positions);
+
+void SparseTransposeValues(const SparseMatrix<cemDOUBLE>& A,
+                           const std::vector<cemINT8>& positions,
+                           SparseMatrix<cemDOUBLE>& At);
+
+// C = A*B:
+void SparseProductPattern(const SparseMatrix<cemDOUBLE>& A,
+                          const SparseMatrix<cemDOUBLE>& B,
+                          SparseMatrix<cemDOUBLE>& C);
+
+void SparseProductValues(const SparseMatrix<cemDOUBLE>& A,
+                         const SparseMatrix<cemDOUBLE>& B,
+                         SparseMatrix<cemDOUBLE>& C);
+
+}
+
+
+
+#endif // SPARSEPRODUCTS_H
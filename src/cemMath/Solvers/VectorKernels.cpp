@@ -0,0 +1,103 @@
+#include "VectorKernels.h"
+
+using namespace cem_math;
+
+
+//************************************************************************************************//
+/** @brief VectorDot : Dot product of two double precision vectors, \f$ x \cdot y \f$.
+ * @param [in] N : Number of elements in vectors x and y
+ * @param [in] x : double precision vector
+ * @param [in] y : double precision vector
+ * @return : dot product */
+//************************************************************************************************//
+cemDOUBLE cem_math::VectorDot(const cemINT N, const cemDOUBLE* x, const cemDOUBLE* y)
+{
+    cemDOUBLE sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+    for (cemINT i=0; i<N; ++i)
+        sum += x[i]*y[i];
+
+    return sum;
+}
+
+
+//************************************************************************************************//
+/** @brief VectorXpay : Computes \f$ y = x + \beta y \f$ (e.g. the new search direction of CG).
+ * @param [in] N : Number of elements in vectors x and y
+ * @param [in] x : double precision vector
+ * @param [in] beta : scalar
+ * @param [in,out] y : double precision vector */
+//************************************************************************************************//
+void cem_math::VectorXpay(const cemINT N, const cemDOUBLE* x, const cemDOUBLE beta, cemDOUBLE* y)
+{
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<N; ++i)
+        y[i] = x[i] + beta*y[i];
+}
+
+
+//************************************************************************************************//
+/** @brief VectorAxpyAxpyNorm2 : Updates the solution and the residual of CG, and gets the squared
+ * norm of the new residual, in a single pass.
+ *
+ * Computes \f$ x \mathrel{+}= \alpha p \f$, \f$ r \mathrel{-}= \alpha q \f$ and \f$ r \cdot r \f$.
+ * @param [in] N : Number of elements in the vectors
+ * @param [in] alpha : step length
+ * @param [in] p : search direction
+ * @param [in] q : matrix times search direction
+ * @param [in,out] x : solution
+ * @param [in,out] r : residual
+ * @return : squared 2-norm of the updated residual */
+//************************************************************************************************//
+cemDOUBLE cem_math::VectorAxpyAxpyNorm2(const cemINT N,
+                                        const cemDOUBLE alpha,
+                                        const cemDOUBLE* p,
+                                        const cemDOUBLE* q,
+                                        cemDOUBLE* x,
+                                        cemDOUBLE* r)
+{
+    cemDOUBLE sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+    for (cemINT i=0; i<N; ++i)
+    {
+        x[i] += alpha*p[i];
+        r[i] -= alpha*q[i];
+        sum += r[i]*r[i];
+    }
+
+    return sum;
+}
+
+
+//************************************************************************************************//
+/** @brief SparseMultiplyDot : Sparse matrix-vector product fused with the dot product of CG,
+ * \f$ y = Ax \f$ and \f$ x \cdot y \f$.
+ * @param [in] A : square sparse matrix
+ * @param [in] x : num_rows() values
+ * @param [out] y : num_rows() values (must not overlap x)
+ * @return : \f$ x \cdot Ax \f$ */
+//************************************************************************************************//
+cemDOUBLE cem_math::SparseMultiplyDot(const SparseMatrix<cemDOUBLE>& A,
+                                      const cemDOUBLE* x,
+                                      cemDOUBLE* y)
+{
+    cemINT N = A.num_rows();
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    const cemDOUBLE* entries = A.values();
+    cemDOUBLE sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+    for (cemINT i=0; i<N; ++i)
+    {
+        cemDOUBLE row_sum = 0.0;
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+            row_sum += entries[k]*x[columns[k]];
+        y[i] = row_sum;
+        sum += x[i]*row_sum;
+    }
+
+    return sum;
+}
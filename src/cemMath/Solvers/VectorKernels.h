@@ -0,0 +1,36 @@
+#ifndef VECTORKERNELS_H
+#define VECTORKERNELS_H
+
+#include "cemTypes.h"
+#include "Matrix/SparseMatrix.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+// Threaded vector kernels of the iterative solvers. Kernels that do several operations go over
+// the vectors once, instead of once per operation.
+
+// Dot product:
+cemDOUBLE VectorDot(const cemINT N, const cemDOUBLE* x, const cemDOUBLE* y);
+
+// y = x + beta*y:
+void VectorXpay(const cemINT N, const cemDOUBLE* x, const cemDOUBLE beta, cemDOUBLE* y);
+
+// x += alpha*p, r -= alpha*q and return r.r:
+cemDOUBLE VectorAxpyAxpyNorm2(const cemINT N,
+                              const cemDOUBLE alpha,
+                              const cemDOUBLE* p,
+                              const cemDOUBLE* q,
+                              cemDOUBLE* x,
+                              cemDOUBLE* r);
+
+// y = A*x and return x.y:
+cemDOUBLE SparseMultiplyDot(const SparseMatrix<cemDOUBLE>& A, const cemDOUBLE* x, cemDOUBLE* y);
+
+}
+
+
+
+#endif // VECTORKERNELS_H
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include "WoodburySolver.h"
+#include "MKL/BlasLevel3.h"
+#include "cemError.h"
+#include "cemUtils.h"
+
+using namespace cem_math;
+using cemcommon::Exception;
+
+const cemINT WoodburySolver::DEFAULT_MAX_UPDATE_ROWS;
+const cemINT WoodburySolver::UPDATE_BLOCK;
+
+
+
+///***********************************************************************************************//
+/// CLASS WoodburySolver:
+///***********************************************************************************************//
+
+//************************************************************************************************//
+/** @brief WoodburySolver::WoodburySolver : Constructor with parameters.
+ * @param [in] ordering : fill-reducing ordering of the factorization */
+//************************************************************************************************//
+WoodburySolver::WoodburySolver(const OrderingType& ordering)
+    : cholesky_(ordering)
+{
+    max_update_rows_ = DEFAULT_MAX_UPDATE_ROWS;
+    num_factorizations_ = 0;
+}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::num_rows : Gets number of rows of the matrix.
+ * @return : rows of the base matrix */
+//************************************************************************************************//
+cemINT WoodburySolver::num_rows() const {return static_cast<cemINT>(base_.num_rows());}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::num_update_rows : Gets number of rows changed by the last Update().
+ * @return : rank of the update (0 if the base matrix is solved as is) */
+//************************************************************************************************//
+cemINT WoodburySolver::num_update_rows() const {return static_cast<cemINT>(update_rows_.size());}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::update_rows : Gets rows changed by the last Update().
+ * @return : update_rows_ */
+//************************************************************************************************//
+const std::vector<cemINT>& WoodburySolver::update_rows() const {return update_rows_;}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::max_update_rows : Gets most changed rows handled without refactorizing.
+ * @return : max_update_rows_ */
+//************************************************************************************************//
+cemINT WoodburySolver::max_update_rows() const {return max_update_rows_;}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::num_factorizations : Gets number of factorizations of a base matrix.
+ * @return : num_factorizations_ */
+//************************************************************************************************//
+cemINT WoodburySolver::num_factorizations() const {return num_factorizations_;}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::cholesky : Gets the factorization of the base matrix.
+ * @return : cholesky_ */
+//************************************************************************************************//
+const SparseCholesky& WoodburySolver::cholesky() const {return cholesky_;}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::set_max_update_rows : Sets most changed rows handled without
+ * refactorizing. An update of k rows costs k solves with the old factor and a k x k dense LU, and
+ * keeps O(k^2) values; each Solve() then costs two solves with the old factor.
+ * @param [in] max_update_rows : non-negative number of rows */
+//************************************************************************************************//
+void WoodburySolver::set_max_update_rows(const cemINT& max_update_rows)
+{
+    if (max_update_rows < 0)
+        throw(Exception("INPUT ERROR","Maximum number of update rows must be non-negative"));
+
+    max_update_rows_ = max_update_rows;
+}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::SetUp : Factorizes a base matrix and clears any update.
+ * @param [in] A : symmetric positive definite matrix (copied) */
+//************************************************************************************************//
+void WoodburySolver::SetUp(const SparseMatrix<cemDOUBLE>& A)
+{
+    Factorize(A);
+}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::Update : Sets the matrix to solve as a low-rank update of the base one.
+ * @param [in] A : symmetric matrix with the pattern of the base matrix, changed on a few rows
+ * (if not, it is factorized and becomes the base matrix) */
+//************************************************************************************************//
+void WoodburySolver::Update(const SparseMatrix<cemDOUBLE>& A)
+{
+    if (num_factorizations_ == 0 || !HasSamePattern(A))
+    {
+        Factorize(A);
+        return;
+    }
+
+    // Rows whose values changed:
+    cemINT n = static_cast<cemINT>(A.num_rows());
+    const cemINT8* offsets = A.row_offsets();
+    const cemINT* columns = A.column_indices();
+    const cemDOUBLE* values = A.values();
+    const cemDOUBLE* base_values = base_.values();
+    std::vector<char> changed(n,0);
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<n; ++i)
+    {
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+        {
+            if (values[k] != base_values[k])
+            {
+                changed[i] = 1;
+                break;
+            }
+        }
+    }
+
+    update_rows_.clear();
+    for (cemINT i=0; i<n; ++i)
+        if (changed[i])
+            update_rows_.push_back(i);
+
+    cemINT rank = static_cast<cemINT>(update_rows_.size());
+    if (rank > max_update_rows_)
+    {
+        Factorize(A);
+        return;
+    }
+    if (rank == 0)
+        return;
+
+    // C = (K - K_0) on the changed rows. The matrix is symmetric, so a changed entry (i,j) makes
+    // both i and j changed rows:
+    std::vector<cemINT> position(n,-1);
+    for (cemINT r=0; r<rank; ++r)
+        position[update_rows_[r]] = r;
+
+    coupling_.assign(static_cast<size_t>(rank)*rank,0.0);
+    for (cemINT r=0; r<rank; ++r)
+    {
+        cemINT i = update_rows_[r];
+        for (cemINT8 k=offsets[i]; k<offsets[i+1]; ++k)
+            if (position[columns[k]] >= 0)
+                coupling_[static_cast<size_t>(position[columns[k]])*rank + r] =
+                        values[k] - base_values[k];
+    }
+
+    // S = I + C U^T W with W = K_0^{-1} U. Only the changed rows of W are needed, so its columns
+    // are solved UPDATE_BLOCK at a time and never stored whole:
+    cemINT block = std::min(rank,UPDATE_BLOCK);
+    std::vector<cemDOUBLE> columns_block(static_cast<size_t>(n)*block);
+    std::vector<cemDOUBLE> restricted(static_cast<size_t>(rank)*rank);
+    for (cemINT first=0; first<rank; first+=block)
+    {
+        cemINT k = std::min(block,rank - first);
+        std::fill(columns_block.begin(),columns_block.end(),0.0);
+        for (cemINT c=0; c<k; ++c)
+            columns_block[static_cast<size_t>(c)*n + update_rows_[first + c]] = 1.0;
+        cholesky_.SolveBlock(k,&columns_block[0],&columns_block[0]);
+
+        for (cemINT c=0; c<k; ++c)
+            for (cemINT r=0; r<rank; ++r)
+                restricted[static_cast<size_t>(first + c)*rank + r] =
+                        columns_block[static_cast<size_t>(c)*n + update_rows_[r]];
+    }
+
+    capacitance_.assign(static_cast<size_t>(rank)*rank,0.0);
+    for (cemINT c=0; c<rank; ++c)
+        capacitance_[static_cast<size_t>(c)*rank + c] = 1.0;
+    MKL_MatrixMultiply(false,rank,rank,rank,1.0,&coupling_[0],rank,&restricted[0],rank,
+                       1.0,&capacitance_[0],rank);
+
+    pivots_.resize(rank);
+    if (MKL_LUFactorization(rank,&capacitance_[0],rank,&pivots_[0]) != 0)
+    {
+        update_rows_.clear();
+        throw(Exception("SOLVER ERROR","Updated matrix is singular"));
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::Solve : Solves \f$ Kx = b \f$ for the matrix of the last Update().
+ * @param [in] b : right-hand side, num_rows() values
+ * @param [out] x : solution, num_rows() values (may be b) */
+//************************************************************************************************//
+void WoodburySolver::Solve(const cemDOUBLE* b, cemDOUBLE* x) const
+{
+    if (num_factorizations_ == 0)
+        throw(Exception("SOLVER ERROR","SetUp() must be called before Solve()"));
+
+    // y = K_0^{-1} b:
+    cholesky_.Solve(b,x);
+
+    cemINT rank = static_cast<cemINT>(update_rows_.size());
+    if (rank == 0)
+        return;
+
+    // z = S^{-1} C U^T y, then x = y - K_0^{-1} U z (a second solve with the old factor):
+    cemINT n = num_rows();
+    work_.assign(n + 2*rank,0.0);
+    cemDOUBLE* correction = &work_[0];
+    cemDOUBLE* restricted = &work_[n];
+    cemDOUBLE* z = &work_[n + rank];
+    for (cemINT r=0; r<rank; ++r)
+        restricted[r] = x[update_rows_[r]];
+
+    MKL_MatrixMultiply(false,rank,1,rank,1.0,&coupling_[0],rank,restricted,rank,0.0,z,rank);
+    MKL_LUSolve(rank,1,&capacitance_[0],rank,&pivots_[0],z,rank);
+    for (cemINT r=0; r<rank; ++r)
+        correction[update_rows_[r]] = z[r];
+    cholesky_.Solve(correction,correction);
+
+    #pragma omp parallel for schedule(static)
+    for (cemINT i=0; i<n; ++i)
+        x[i] -= correction[i];
+}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::Factorize : Makes a matrix the base matrix and factorizes it.
+ * @param [in] A : symmetric positive definite matrix */
+//************************************************************************************************//
+void WoodburySolver::Factorize(const SparseMatrix<cemDOUBLE>& A)
+{
+    update_rows_.clear();
+    coupling_.clear();
+    capacitance_.clear();
+    pivots_.clear();
+
+    cholesky_.Factorize(A);
+    base_ = A;
+    ++num_factorizations_;
+}
+
+
+//************************************************************************************************//
+/** @brief WoodburySolver::HasSamePattern : Checks if a matrix has the pattern of the base one.
+ * @param [in] A : sparse matrix
+ * @return : true if the sizes, row offsets and column indices are the same */
+//************************************************************************************************//
+cemBOOL WoodburySolver::HasSamePattern(const SparseMatrix<cemDOUBLE>& A) const
+{
+    if (A.num_rows() != base_.num_rows() || A.num_entries() != base_.num_entries())
+        return false;
+
+    return std::equal(A.row_offsets(),A.row_offsets() + A.num_rows() + 1,base_.row_offsets()) &&
+           std::equal(A.column_indices(),A.column_indices() + A.num_entries(),
+                      base_.column_indices());
+}
@@ -0,0 +1,79 @@
+#ifndef WOODBURYSOLVER_H
+#define WOODBURYSOLVER_H
+
+#include <vector>
+#include "cemTypes.h"
+#include "Matrix/SparseMatrix.h"
+#include "SparseCholesky.h"
+
+using namespace cem_def;
+
+
+namespace cem_math {
+
+//************************************************************************************************//
+/** @brief The WoodburySolver class : Direct solver for a factorized matrix changed on a few rows.
+ *
+ * SetUp() factorizes a base matrix \f$ K_0 \f$ with a SparseCholesky. Update() takes a new matrix
+ * with the same pattern (e.g. after changing the conductivity of a few elements) and finds the
+ * rows D whose values changed, so \f$ K = K_0 + UCU^T \f$ with U the columns of the identity in D
+ * and C the dense block \f$ (K - K_0)_{DD} \f$. It then solves \f$ W = K_0^{-1}U \f$ with the
+ * existing factor, a few columns at a time, keeping only its changed rows \f$ U^TW \f$, and
+ * factorizes the small capacitance matrix \f$ S = I + CU^TW \f$ with LU (C is often singular, so
+ * the symmetric form \f$ C^{-1} + U^TW \f$ is not used). Solve() is then the
+ * Sherman-Morrison-Woodbury formula \f$ x = y - K_0^{-1}US^{-1}CU^Ty \f$ with
+ * \f$ y = K_0^{-1}b \f$: two solves with the old factor and a rank-|D| dense solve. Only
+ * |D| x |D| matrices are kept, never the n x |D| block W, so the rank is bounded by time rather than
+ * by memory.
+ *
+ * Updates are not accumulated: each Update() is relative to the factorized base matrix. When more
+ * than max_update_rows() rows changed, or the pattern changed, Update() factorizes the new matrix
+ * and makes it the base.
+ * @author Felipe Valdes V. */
+//************************************************************************************************//
+class WoodburySolver
+{
+public:
+    // Constructor with parameters:
+    WoodburySolver(const OrderingType& ordering = NESTED_DISSECTION);
+
+    // Get data members:
+    cemINT num_rows() const;
+    cemINT num_update_rows() const;
+    const std::vector<cemINT>& update_rows() const;
+    cemINT max_update_rows() const;
+    cemINT num_factorizations() const;
+    const SparseCholesky& cholesky() const;
+
+    // Set data members:
+    void set_max_update_rows(const cemINT& max_update_rows);
+
+    void SetUp(const SparseMatrix<cemDOUBLE>& A);
+    void Update(const SparseMatrix<cemDOUBLE>& A);
+    void Solve(const cemDOUBLE* b, cemDOUBLE* x) const;
+
+private:
+    SparseCholesky cholesky_;               //!< Factor of the base matrix.
+    SparseMatrix<cemDOUBLE> base_;          //!< Factorized base matrix \f$ K_0 \f$.
+    cemINT max_update_rows_;                //!< Most changed rows handled without refactorizing.
+    cemINT num_factorizations_;             //!< Times the base matrix was factorized.
+    std::vector<cemINT> update_rows_;       //!< Changed rows D, sorted.
+    std::vector<cemDOUBLE> coupling_;       //!< \f$ C = (K - K_0)_{DD} \f$, column-major.
+    std::vector<cemDOUBLE> capacitance_;    //!< LU factors of \f$ S = I + CU^TW \f$.
+    std::vector<cemINT> pivots_;            //!< Row interchanges of the LU factors.
+    mutable std::vector<cemDOUBLE> work_;   //!< Correction, \f$ U^Ty \f$ and z of Solve().
+
+    static const cemINT DEFAULT_MAX_UPDATE_ROWS = 200;  //!< Default of max_update_rows().
+    static const cemINT UPDATE_BLOCK = 16;              //!< Columns of W solved per pass.
+
+    // Private member functions:
+    void Factorize(const SparseMatrix<cemDOUBLE>& A);
+    cemBOOL HasSamePattern(const SparseMatrix<cemDOUBLE>& A) const;
+};
+
+
+}
+
+
+
+#endif // WOODBURYSOLVER_H
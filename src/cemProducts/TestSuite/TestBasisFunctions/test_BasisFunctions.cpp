@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <cmath>
 #include "cemConsts.h"
 #include "Quadrature/Quadrature.h"
 
@@ -168,6 +169,158 @@ TEST(TriShapeFunction,EvaluateEtaDeriv)
 }
 
 
+
+TEST(TriShapeFunction,EvaluateBatch)
+{
+    // More points than TriShapeFunction::BLOCK_SIZE, to cover several blocks:
+    cemINT num_points = 150;
+    std::vector<cemDOUBLE> ksi(num_points),eta(num_points);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        ksi[t] = static_cast<cemDOUBLE>(t % 15)/14.0;
+        eta[t] = (1.0 - ksi[t])*static_cast<cemDOUBLE>(t/15)/9.0;
+    }
+
+    cem_core::TriShapeFunction shape_function(6);
+    std::vector<cemDOUBLE> values(num_points),ksi_derivs(num_points),eta_derivs(num_points);
+    shape_function.EvaluateBatch(2,1,2,num_points,&ksi[0],&eta[0],
+                                 &values[0],&ksi_derivs[0],&eta_derivs[0]);
+
+    // Closed form of order 6, indices (2,1,2): N = A(ksi) B(eta) C(1-ksi-eta), with
+    // A = P_2(ksi) = 6ksi(6ksi-1)/2, B = P_1(eta) = 6eta and C = P_2(1-ksi-eta):
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        cemDOUBLE L = 1.0 - ksi[t] - eta[t];
+        cemDOUBLE A = 18.0*ksi[t]*ksi[t] - 3.0*ksi[t], dA = 36.0*ksi[t] - 3.0;
+        cemDOUBLE B = 6.0*eta[t], dB = 6.0;
+        cemDOUBLE C = 18.0*L*L - 3.0*L, dC = 36.0*L - 3.0;
+        cemDOUBLE value = A*B*C;
+        cemDOUBLE ksi_deriv = dA*B*C - A*B*dC;
+        cemDOUBLE eta_deriv = A*dB*C - A*B*dC;
+        ASSERT_NEAR(value,values[t],1.0e-13*(1.0 + std::fabs(value)));
+        ASSERT_NEAR(ksi_deriv,ksi_derivs[t],1.0e-12*(1.0 + std::fabs(ksi_deriv)));
+        ASSERT_NEAR(eta_deriv,eta_derivs[t],1.0e-12*(1.0 + std::fabs(eta_deriv)));
+    }
+
+    // Outputs that are not needed can be skipped:
+    std::vector<cemDOUBLE> only_values(num_points);
+    shape_function.EvaluateBatch(2,1,2,num_points,&ksi[0],&eta[0],&only_values[0],NULL,NULL);
+    for (cemINT t=0; t<num_points; ++t)
+        ASSERT_DOUBLE_EQ(values[t],only_values[t]);
+
+    // Silvester polynomials and their derivatives:
+    cem_core::ShapeFunction silvester_poly(4);
+    std::vector<cemDOUBLE> derivs(num_points);
+    silvester_poly.SilvesterPolynomials(3,num_points,&ksi[0],&values[0],&derivs[0]);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        // P_3(ksi) = u(u-1)(u-2)/6 with u = 4ksi:
+        cemDOUBLE u = 4.0*ksi[t];
+        cemDOUBLE value = u*(u-1.0)*(u-2.0)/6.0;
+        cemDOUBLE deriv = 4.0*(3.0*u*u - 6.0*u + 2.0)/6.0;
+        ASSERT_NEAR(value,values[t],1.0e-14*(1.0 + std::fabs(value)));
+        ASSERT_NEAR(deriv,derivs[t],1.0e-14*(1.0 + std::fabs(deriv)));
+    }
+
+    ASSERT_THROW(shape_function.EvaluateBatch(4,2,1,num_points,&ksi[0],&eta[0],&values[0],NULL,NULL),
+                 cemcommon::Exception);
+    ASSERT_THROW(silvester_poly.SilvesterPolynomials(5,num_points,&ksi[0],&values[0],NULL),
+                 cemcommon::Exception);
+}
+
+
+TEST(TriHierarchicalShapeFunction,EvaluateBatch)
+{
+    cemINT num_points = 45;
+    std::vector<cemDOUBLE> ksi(num_points),eta(num_points);
+    for (cemINT t=0; t<num_points; ++t)
+    {
+        ksi[t] = static_cast<cemDOUBLE>(t % 9)/8.0;
+        eta[t] = (1.0 - ksi[t])*static_cast<cemDOUBLE>(t/9)/4.0;
+    }
+
+    ASSERT_EQ(1,cem_core::TriHierarchicalShapeFunction::Degree(2));
+    ASSERT_EQ(2,cem_core::TriHierarchicalShapeFunction::Degree(3));
+    ASSERT_EQ(4,cem_core::TriHierarchicalShapeFunction::Degree(14));
+    ASSERT_EQ(5,cem_core::TriHierarchicalShapeFunction::Degree(15));
+
+    // Vertex functions are a partition of unity:
+    std::vector<cemDOUBLE> values(num_points),ksi_derivs(num_points),eta_derivs(num_points);
+    std::vector<cemDOUBLE> sum(num_points,0.0);
+    for (cemINT a=0; a<3; ++a)
+    {
+        cem_core::TriHierarchicalShapeFunction::EvaluateBatch(a,num_points,&ksi[0],&eta[0],
+                                                              &values[0],NULL,NULL);
+        for (cemINT t=0; t<num_points; ++t)
+            sum[t] += values[t];
+    }
+    for (cemINT t=0; t<num_points; ++t)
+        ASSERT_NEAR(1.0,sum[t],1.0e-14);
+
+    // Higher functions vanish at the vertices, edge functions vanish on the other two edges and
+    // interior functions on all of them:
+    cemDOUBLE vertex_ksi[3] = {1.0, 0.0, 0.0};
+    cemDOUBLE vertex_eta[3] = {0.0, 1.0, 0.0};
+    cemDOUBLE edge_ksi[3] = {0.3, 0.0, 0.6};    // points on edges 0-1, 1-2 and 2-0
+    cemDOUBLE edge_eta[3] = {0.7, 0.4, 0.0};
+    cemDOUBLE value;
+    for (cemINT index=3; index<28; ++index)
+    {
+        cemINT degree = cem_core::TriHierarchicalShapeFunction::Degree(index);
+        cemINT local = index - degree*(degree+1)/2;
+        for (cemINT a=0; a<3; ++a)
+        {
+            cem_core::TriHierarchicalShapeFunction::EvaluateBatch(index,1,&vertex_ksi[a],
+                                                                  &vertex_eta[a],&value,NULL,NULL);
+            ASSERT_NEAR(0.0,value,1.0e-14);
+        }
+        for (cemINT e=0; e<3; ++e)
+        {
+            cem_core::TriHierarchicalShapeFunction::EvaluateBatch(index,1,&edge_ksi[e],
+                                                                  &edge_eta[e],&value,NULL,NULL);
+            if (local == e)
+                ASSERT_GT(std::fabs(value),1.0e-3);
+            else
+                ASSERT_NEAR(0.0,value,1.0e-14);
+        }
+    }
+
+    // Derivatives against central differences:
+    cemDOUBLE h = 1.0e-6;
+    std::vector<cemDOUBLE> shifted(num_points),plus(num_points),minus(num_points);
+    for (cemINT index=0; index<28; ++index)
+    {
+        cem_core::TriHierarchicalShapeFunction::EvaluateBatch(index,num_points,&ksi[0],&eta[0],
+                                                              &values[0],&ksi_derivs[0],
+                                                              &eta_derivs[0]);
+        for (cemINT t=0; t<num_points; ++t)
+            shifted[t] = ksi[t] + h;
+        cem_core::TriHierarchicalShapeFunction::EvaluateBatch(index,num_points,&shifted[0],&eta[0],
+                                                              &plus[0],NULL,NULL);
+        for (cemINT t=0; t<num_points; ++t)
+            shifted[t] = ksi[t] - h;
+        cem_core::TriHierarchicalShapeFunction::EvaluateBatch(index,num_points,&shifted[0],&eta[0],
+                                                              &minus[0],NULL,NULL);
+        for (cemINT t=0; t<num_points; ++t)
+            ASSERT_NEAR((plus[t] - minus[t])/(2.0*h),ksi_derivs[t],1.0e-6);
+
+        for (cemINT t=0; t<num_points; ++t)
+            shifted[t] = eta[t] + h;
+        cem_core::TriHierarchicalShapeFunction::EvaluateBatch(index,num_points,&ksi[0],&shifted[0],
+                                                              &plus[0],NULL,NULL);
+        for (cemINT t=0; t<num_points; ++t)
+            shifted[t] = eta[t] - h;
+        cem_core::TriHierarchicalShapeFunction::EvaluateBatch(index,num_points,&ksi[0],&shifted[0],
+                                                              &minus[0],NULL,NULL);
+        for (cemINT t=0; t<num_points; ++t)
+            ASSERT_NEAR((plus[t] - minus[t])/(2.0*h),eta_derivs[t],1.0e-6);
+    }
+
+    ASSERT_THROW(cem_core::TriHierarchicalShapeFunction::EvaluateBatch(-1,num_points,&ksi[0],
+                                                                       &eta[0],&values[0],NULL,NULL),
+                 cemcommon::Exception);
+}
+
 //************************************************************************************************//
 /** @brief PlotShapeFunction : Writes file with x,y points and ShapeFunction(x,y) for plotting. */
 //************************************************************************************************//
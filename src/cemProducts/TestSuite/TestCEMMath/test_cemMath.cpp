@@ -5,10 +5,17 @@
 #include <iostream>
 #include <cstring>
 #include <time.h>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace cem_math;
 using cemcommon::Exception;
 
+
 //************************************************************************************************//
 // Main Test Function:
 //************************************************************************************************//
@@ -37,6 +44,19 @@ int RunTestCEMMath(int argc, char* argv[])
     {
         return TestMathBasics();
     }
+    if (!strcmp(argv[1],"-PCGBenchmark"))
+    {
+        return TestPCGBenchmark(argc > 2 ? atoi(argv[2]) : 1000);
+    }
+    if (!strcmp(argv[1],"-CholeskyBenchmark"))
+    {
+        return TestCholeskyBenchmark(argc > 2 ? atoi(argv[2]) : 1000);
+    }
+    if (!strcmp(argv[1],"-BlockSolveBenchmark"))
+    {
+        return TestBlockSolveBenchmark(argc > 2 ? atoi(argv[2]) : 300,
+                                       argc > 3 ? atoi(argv[3]) : 50);
+    }
     return 1;
 }
 
@@ -1790,7 +1810,7 @@ TEST(DenseMatrix,DeterminantD)
     A.resize(2,3);
     ASSERT_THROW(A.determinant(),Exception);
 
-    A.resize(3,3);
+    A.resize(4,4);
     ASSERT_THROW(A.determinant(),Exception);
 }
 
@@ -1807,7 +1827,7 @@ TEST(DenseMatrix,DeterminantF)
     A.resize(2,3);
     ASSERT_THROW(A.determinant(),Exception);
 
-    A.resize(3,3);
+    A.resize(4,4);
     ASSERT_THROW(A.determinant(),Exception);
 }
 
@@ -1826,7 +1846,7 @@ TEST(DenseMatrix,DeterminantDC)
     A.resize(2,3);
     ASSERT_THROW(A.determinant(),Exception);
 
-    A.resize(3,3);
+    A.resize(4,4);
     ASSERT_THROW(A.determinant(),Exception);
 }
 
@@ -1845,7 +1865,7 @@ TEST(DenseMatrix,DeterminantFC)
     A.resize(2,3);
     ASSERT_THROW(A.determinant(),Exception);
 
-    A.resize(3,3);
+    A.resize(4,4);
     ASSERT_THROW(A.determinant(),Exception);
 }
 
@@ -1867,10 +1887,32 @@ TEST(DenseMatrix,InverseD)
     A.resize(2,3);
     ASSERT_THROW(A.inverse(),Exception);
 
-    A.resize(3,3);
+    A.resize(4,4);
     ASSERT_THROW(A.inverse(),Exception);
 }
 
+TEST(DenseMatrix,Inverse3x3D)
+{
+    DenseMatrix<cemDOUBLE> A(3,3);
+    A(0,0) = 2.0;   A(0,1) = -1.0;  A(0,2) = 0.5;
+    A(1,0) = 0.3;   A(1,1) = 1.5;   A(1,2) = -0.7;
+    A(2,0) = -1.2;  A(2,1) = 0.4;   A(2,2) = 3.0;
+    ASSERT_NEAR(10.58,A.determinant(),1.0e-14);
+
+    // A times its inverse is the identity:
+    DenseMatrix<cemDOUBLE> B = A.inverse();
+    for (cemINT i=0; i<3; ++i)
+    {
+        for (cemINT j=0; j<3; ++j)
+        {
+            cemDOUBLE sum = 0.0;
+            for (cemINT k=0; k<3; ++k)
+                sum += A(i,k)*B(k,j);
+            ASSERT_NEAR((i == j) ? 1.0 : 0.0,sum,1.0e-15);
+        }
+    }
+}
+
 TEST(DenseMatrix,InverseF)
 {
     srand(time(NULL));
@@ -1889,7 +1931,7 @@ TEST(DenseMatrix,InverseF)
     A.resize(2,3);
     ASSERT_THROW(A.inverse(),Exception);
 
-    A.resize(3,3);
+    A.resize(4,4);
     ASSERT_THROW(A.inverse(),Exception);
 }
 
@@ -1934,6 +1976,1166 @@ TEST(DenseMatrix,InverseFC)
 }
 
 
+//************************************************************************************************//
+// SymmetricMatrix:
+//************************************************************************************************//
+TEST(SymmetricMatrix,ConstructorWithSize)
+{
+    SymmetricMatrix<cemDOUBLE> A(10,10);
+    ASSERT_EQ(10,A.num_rows());
+    ASSERT_EQ(10,A.num_columns());
+    ASSERT_EQ(55,A.num_entries());
+
+    ASSERT_THROW(SymmetricMatrix<cemDOUBLE> B(10,5),cemcommon::Exception);
+}
+
+TEST(SymmetricMatrix,SetAndGetEntryD)
+{
+    SymmetricMatrix<cemDOUBLE> A(3,3);
+    A(0,0) = 2.;
+    A(1,0) = cem_const::PI4;
+    A(2,1) = -1.5;
+    A(0,2) = 1.3e-4;
+
+    ASSERT_DOUBLE_EQ(2.,A(0,0));
+    ASSERT_DOUBLE_EQ(cem_const::PI4,A(0,1));
+    ASSERT_DOUBLE_EQ(cem_const::PI4,A(1,0));
+    ASSERT_DOUBLE_EQ(-1.5,A(1,2));
+    ASSERT_DOUBLE_EQ(1.3e-4,A(2,0));
+
+    // Packed lower triangle, column-wise:
+    ASSERT_DOUBLE_EQ(2.,(&A(0,0))[0]);
+    ASSERT_DOUBLE_EQ(cem_const::PI4,(&A(0,0))[1]);
+    ASSERT_DOUBLE_EQ(1.3e-4,(&A(0,0))[2]);
+    ASSERT_DOUBLE_EQ(-1.5,(&A(0,0))[4]);
+}
+
+TEST(SymmetricMatrix,PackAndUnpackD)
+{
+    srand(time(NULL));
+    DenseMatrix<cemDOUBLE> A(7,7);
+    for (cemINT j=0; j<7; ++j)
+    {
+        for (cemINT i=j; i<7; ++i)
+        {
+            A(i,j) = static_cast<cemDOUBLE>(rand() % 2000 - 1000)/static_cast<cemDOUBLE>(rand() % 100 + 1);
+            A(j,i) = A(i,j);
+        }
+    }
+
+    SymmetricMatrix<cemDOUBLE> S(A);
+    SymmetricMatrix<cemDOUBLE> T(S);
+    T.multiply_by_scalar(2.0);
+    T -= S;
+    DenseMatrix<cemDOUBLE> B = T;
+
+    ASSERT_EQ(A.num_rows(),B.num_rows());
+    ASSERT_EQ(A.num_columns(),B.num_columns());
+    for (cemINT j=0; j<7; ++j)
+    {
+        for (cemINT i=0; i<7; ++i)
+        {
+            ASSERT_DOUBLE_EQ(A(i,j),S(i,j));
+            ASSERT_DOUBLE_EQ(A(i,j),B(i,j));
+        }
+    }
+}
+
+TEST(SymmetricMatrix,ScatterAndGatherD)
+{
+    // Two overlapping 3x3 local matrices assembled into a 4x4 global matrix:
+    SymmetricMatrix<cemDOUBLE> A(3,3),B(3,3);
+    for (cemINT j=0; j<3; ++j)
+    {
+        for (cemINT i=j; i<3; ++i)
+        {
+            A(i,j) = 1.0 + i + 10.0*j;
+            B(i,j) = 100.0*(1.0 + i + 10.0*j);
+        }
+    }
+    std::vector<cemINT> indices_A(3),indices_B(3);
+    indices_A[0] = 0; indices_A[1] = 1; indices_A[2] = 2;
+    indices_B[0] = 3; indices_B[1] = 2; indices_B[2] = -1;   // Last row is not assembled.
+
+    DenseMatrix<cemDOUBLE> G(4,4);
+    G.initialize();
+    SymmetricMatrix<cemDOUBLE> G_packed(4,4);
+    G_packed.initialize();
+    A.scatter_add(indices_A,G);
+    B.scatter_add(indices_B,G);
+    A.scatter_add(indices_A,G_packed);
+    B.scatter_add(indices_B,G_packed);
+
+    ASSERT_DOUBLE_EQ(A(2,2) + B(1,1),G(2,2));
+    ASSERT_DOUBLE_EQ(B(0,1),G(3,2));
+    ASSERT_DOUBLE_EQ(B(0,1),G(2,3));
+    ASSERT_DOUBLE_EQ(A(0,1),G(1,0));
+    ASSERT_DOUBLE_EQ(0.0,G(3,0));
+    for (cemINT j=0; j<4; ++j)
+    {
+        for (cemINT i=0; i<4; ++i)
+            ASSERT_DOUBLE_EQ(G(i,j),G_packed(i,j));
+    }
+
+    // Gather back the block of B:
+    SymmetricMatrix<cemDOUBLE> C,C_packed;
+    C.gather(indices_B,G);
+    C_packed.gather(indices_B,G_packed);
+    ASSERT_EQ(3,C.num_rows());
+    ASSERT_DOUBLE_EQ(B(0,0),C(0,0));
+    ASSERT_DOUBLE_EQ(B(1,0),C(1,0));
+    ASSERT_DOUBLE_EQ(A(2,2) + B(1,1),C(1,1));
+    ASSERT_DOUBLE_EQ(0.0,C(2,0));
+    for (cemINT j=0; j<3; ++j)
+    {
+        for (cemINT i=0; i<3; ++i)
+            ASSERT_DOUBLE_EQ(C(i,j),C_packed(i,j));
+    }
+}
+
+
+//************************************************************************************************//
+// SparseMatrix:
+//************************************************************************************************//
+TEST(SparseMatrix,SetPatternAndFindD)
+{
+    // 3x4 pattern: row 0 = {0,2}, row 1 = {}, row 2 = {1,2,3}
+    std::vector<cemINT8> row_offsets(4);
+    row_offsets[0] = 0; row_offsets[1] = 2; row_offsets[2] = 2; row_offsets[3] = 5;
+    std::vector<cemINT> columns(5);
+    columns[0] = 0; columns[1] = 2; columns[2] = 1; columns[3] = 2; columns[4] = 3;
+
+    SparseMatrix<cemDOUBLE> A;
+    A.set_pattern(3,4,row_offsets,columns);
+    ASSERT_EQ(3,A.num_rows());
+    ASSERT_EQ(4,A.num_columns());
+    ASSERT_EQ(5,A.num_entries());
+    ASSERT_EQ(1,A.find(0,2));
+    ASSERT_EQ(4,A.find(2,3));
+    ASSERT_EQ(-1,A.find(0,1));
+    ASSERT_EQ(-1,A.find(1,1));
+    ASSERT_THROW(A.find(3,0),cemcommon::Exception);
+
+    A(0,2) = 1.5;
+    A(2,1) = -2.0;
+    const SparseMatrix<cemDOUBLE>& A_const = A;
+    ASSERT_DOUBLE_EQ(1.5,A_const(0,2));
+    ASSERT_DOUBLE_EQ(-2.0,A_const(2,1));
+    ASSERT_DOUBLE_EQ(1.5,A.values()[1]);
+    ASSERT_DOUBLE_EQ(0.0,A_const(1,3));
+    ASSERT_THROW(A(1,3) = 1.0,cemcommon::Exception);
+
+    // Values are cleared but the pattern is kept:
+    A.initialize();
+    ASSERT_EQ(5,A.num_entries());
+    ASSERT_DOUBLE_EQ(0.0,A_const(0,2));
+
+    // Columns must be sorted and without repetitions:
+    columns[3] = 1;
+    ASSERT_THROW(A.set_pattern(3,4,row_offsets,columns),cemcommon::Exception);
+    columns[3] = 4;
+    ASSERT_THROW(A.set_pattern(3,4,row_offsets,columns),cemcommon::Exception);
+    ASSERT_THROW(A.set_pattern(2,4,row_offsets,columns),cemcommon::Exception);
+
+    A.resize(2,2);
+    ASSERT_EQ(0,A.num_entries());
+    ASSERT_EQ(-1,A.find(1,1));
+}
+
+
+TEST(SparseMatrix,MultiplyD)
+{
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(4,3,A);
+
+    std::vector<cemDOUBLE> x(12),y(12);
+    for (cemINT i=0; i<12; ++i)
+        x[i] = 1.0 + i;
+    A.multiply(&x[0],&y[0]);
+
+    const SparseMatrix<cemDOUBLE>& A_const = A;
+    for (cemINT i=0; i<12; ++i)
+    {
+        cemDOUBLE expected = 0.0;
+        for (cemINT j=0; j<12; ++j)
+            expected += A_const(i,j)*x[j];
+        ASSERT_DOUBLE_EQ(expected,y[i]);
+    }
+
+    // Fused product and dot:
+    ASSERT_NEAR(VectorDot(12,&x[0],&y[0]),SparseMultiplyDot(A,&x[0],&y[0]),1.0e-12);
+}
+
+
+//************************************************************************************************//
+// Iterative solvers:
+//************************************************************************************************//
+TEST(SparseMatrix,MultiplyBlockD)
+{
+    // More vectors than a block, so the last block is partial:
+    cemINT num_vectors = 11;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(7,5,A);
+    cemINT N = A.num_rows();
+
+    DenseMatrix<cemDOUBLE> X(N,num_vectors),Y(N,num_vectors);
+    for (cemINT v=0; v<num_vectors; ++v)
+        for (cemINT i=0; i<N; ++i)
+            X(i,v) = std::cos(0.3*i + v);
+
+    A.multiply(num_vectors,&X(0,0),&Y(0,0));
+    std::vector<cemDOUBLE> y(N);
+    for (cemINT v=0; v<num_vectors; ++v)
+    {
+        A.multiply(&X(0,v),&y[0]);
+        for (cemINT i=0; i<N; ++i)
+            ASSERT_DOUBLE_EQ(y[i],Y(i,v));
+    }
+}
+
+
+TEST(VectorKernels,FusedKernelsD)
+{
+    cemINT N = 1000;
+    std::vector<cemDOUBLE> x(N),r(N),p(N),q(N),x_ref(N),r_ref(N);
+    for (cemINT i=0; i<N; ++i)
+    {
+        x[i] = x_ref[i] = std::sin(0.1*i);
+        r[i] = r_ref[i] = std::cos(0.3*i);
+        p[i] = 1.0 + 0.001*i;
+        q[i] = 2.0 - 0.002*i;
+    }
+
+    cemDOUBLE norm2 = VectorAxpyAxpyNorm2(N,0.5,&p[0],&q[0],&x[0],&r[0]);
+    cemDOUBLE expected = 0.0;
+    for (cemINT i=0; i<N; ++i)
+    {
+        ASSERT_DOUBLE_EQ(x_ref[i] + 0.5*p[i],x[i]);
+        ASSERT_DOUBLE_EQ(r_ref[i] - 0.5*q[i],r[i]);
+        expected += r[i]*r[i];
+    }
+    ASSERT_NEAR(expected,norm2,1.0e-10);
+
+    VectorXpay(N,&q[0],-2.0,&p[0]);
+    ASSERT_DOUBLE_EQ(q[10] - 2.0*(1.0 + 0.01),p[10]);
+}
+
+
+TEST(PCGSolver,LaplacianAllPreconditioners)
+{
+    cemINT nx = 40, ny = 30, N = nx*ny;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(nx,ny,A);
+
+    std::vector<cemDOUBLE> x_exact(N),b(N);
+    for (cemINT i=0; i<N; ++i)
+        x_exact[i] = std::sin(0.05*i) + 0.1*(i%7);
+    A.multiply(&x_exact[0],&b[0]);
+
+    PreconditionerType types[3] = {JACOBI, SSOR, IC0};
+    cemINT iterations[3];
+    for (cemINT t=0; t<3; ++t)
+    {
+        PCGSolver solver(types[t]);
+        solver.set_tolerance(1.0e-10);
+        solver.set_record_history(true);
+        solver.SetUp(A);
+
+        std::vector<cemDOUBLE> x(N,0.0);
+        ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+        for (cemINT i=0; i<N; ++i)
+            ASSERT_NEAR(x_exact[i],x[i],1.0e-7);
+
+        const SolverTelemetry& telemetry = solver.telemetry();
+        ASSERT_TRUE(telemetry.converged);
+        ASSERT_DOUBLE_EQ(1.0,telemetry.initial_residual);
+        ASSERT_LE(telemetry.final_residual,1.0e-10);
+        ASSERT_EQ(telemetry.num_iterations,static_cast<cemINT>(telemetry.residual_history.size()));
+        iterations[t] = telemetry.num_iterations;
+
+        // Starting from the solution needs no iteration:
+        ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+        ASSERT_EQ(0,solver.telemetry().num_iterations);
+    }
+
+    ASSERT_LT(iterations[1],iterations[0]);
+    ASSERT_LT(iterations[2],iterations[0]);
+}
+
+
+TEST(PCGSolver,IC0IsExactForTridiagonal)
+{
+    // IC(0) of a tridiagonal matrix has no dropped fill, so it is the Cholesky factorization:
+    cemINT N = 50;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(N,1,A);
+    std::vector<cemDOUBLE> b(N,1.0),x(N,0.0);
+
+    PCGSolver solver(IC0);
+    solver.SetUp(A);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_EQ(1,solver.telemetry().num_iterations);
+    ASSERT_DOUBLE_EQ(0.0,static_cast<const IC0Preconditioner*>(solver.preconditioner())->shift());
+}
+
+
+TEST(PCGSolver,StopsAtMaxIterations)
+{
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(30,30,A);
+    std::vector<cemDOUBLE> b(900,1.0),x(900,0.0);
+
+    PCGSolver solver;
+    solver.set_max_iterations(3);
+    ASSERT_THROW(solver.Solve(&b[0],&x[0]),cemcommon::Exception);
+    solver.SetUp(A);
+    ASSERT_FALSE(solver.Solve(&b[0],&x[0]));
+    ASSERT_EQ(3,solver.telemetry().num_iterations);
+    ASSERT_FALSE(solver.telemetry().converged);
+    ASSERT_GT(solver.telemetry().final_residual,solver.tolerance());
+
+    // Zero right-hand side gives zero solution:
+    std::vector<cemDOUBLE> zero(900,0.0);
+    ASSERT_TRUE(solver.Solve(&zero[0],&x[0]));
+    ASSERT_DOUBLE_EQ(0.0,x[0]);
+
+    ASSERT_THROW(solver.set_preconditioner_type(SSOR,2.0),cemcommon::Exception);
+}
+
+
+TEST(PCGSolver,SolveBlockMatchesSolve)
+{
+    cemINT n = 40, N = n*n, num_rhs = 6;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+
+    // Load scenarios, one of them empty:
+    DenseMatrix<cemDOUBLE> B(N,num_rhs);
+    for (cemINT v=0; v<num_rhs; ++v)
+        for (cemINT i=0; i<N; ++i)
+            B(i,v) = v == 2 ? 0.0 : std::sin(0.01*(v+1)*i) + 1.0/(v+1);
+
+    PreconditionerType types[2] = {IC0, AMG};
+    for (cemINT t=0; t<2; ++t)
+    {
+        PCGSolver solver(types[t]);
+        solver.set_tolerance(1.0e-10);
+        solver.SetUp(A);
+
+        cemINT max_iterations = 0;
+        DenseMatrix<cemDOUBLE> X_single(N,num_rhs);
+        X_single.initialize();
+        for (cemINT v=0; v<num_rhs; ++v)
+        {
+            ASSERT_TRUE(solver.Solve(&B(0,v),&X_single(0,v)));
+            max_iterations = std::max(max_iterations,solver.telemetry().num_iterations);
+        }
+
+        DenseMatrix<cemDOUBLE> X;
+        ASSERT_TRUE(solver.SolveBlock(B,X));
+        ASSERT_EQ(N,static_cast<cemINT>(X.num_rows()));
+        ASSERT_EQ(max_iterations,solver.telemetry().num_iterations);
+        ASSERT_LE(solver.telemetry().final_residual,1.0e-10);
+        for (cemINT v=0; v<num_rhs; ++v)
+            for (cemINT i=0; i<N; ++i)
+                ASSERT_NEAR(X_single(i,v),X(i,v),1.0e-8);
+
+        // Starting from the solutions needs no iteration:
+        ASSERT_TRUE(solver.SolveBlock(B,X));
+        ASSERT_EQ(0,solver.telemetry().num_iterations);
+    }
+}
+
+
+TEST(SparseProducts,TransposeAndProductD)
+{
+    SparseMatrix<cemDOUBLE> A,At,AtA;
+    CreateLaplacianMatrix(5,4,A);
+    A.values()[1] = -3.0;   // Not symmetric anymore.
+
+    std::vector<cemINT8> positions;
+    SparseTranspose(A,At,positions);
+    ASSERT_EQ(A.num_entries(),At.num_entries());
+    const SparseMatrix<cemDOUBLE>& A_const = A;
+    const SparseMatrix<cemDOUBLE>& At_const = At;
+    for (cemINT i=0; i<20; ++i)
+        for (cemINT j=0; j<20; ++j)
+            ASSERT_DOUBLE_EQ(A_const(i,j),At_const(j,i));
+
+    SparseProductPattern(At,A,AtA);
+    SparseProductValues(At,A,AtA);
+    const SparseMatrix<cemDOUBLE>& AtA_const = AtA;
+    for (cemINT i=0; i<20; ++i)
+    {
+        for (cemINT j=0; j<20; ++j)
+        {
+            cemDOUBLE sum = 0.0;
+            for (cemINT k=0; k<20; ++k)
+                sum += A_const(k,i)*A_const(k,j);
+            ASSERT_DOUBLE_EQ(sum,AtA_const(i,j));
+        }
+    }
+
+    // Values only:
+    A.values()[1] = -1.0;
+    SparseTransposeValues(A,positions,At);
+    SparseProductValues(At,A,AtA);
+    ASSERT_DOUBLE_EQ(-1.0,At_const(1,0));
+    ASSERT_DOUBLE_EQ(18.0,AtA_const(0,0));
+}
+
+
+TEST(AMGPreconditioner,MeshIndependentIterations)
+{
+    cemINT sizes[3] = {32, 64, 128};
+    cemINT iterations[3];
+    for (cemINT s=0; s<3; ++s)
+    {
+        SparseMatrix<cemDOUBLE> A;
+        CreateLaplacianMatrix(sizes[s],sizes[s],A);
+        cemINT N = A.num_rows();
+        std::vector<cemDOUBLE> x_exact(N),b(N),x(N,0.0);
+        for (cemINT i=0; i<N; ++i)
+            x_exact[i] = std::sin(0.05*i) + 0.1*(i%7);
+        A.multiply(&x_exact[0],&b[0]);
+
+        PCGSolver solver(AMG);
+        solver.set_tolerance(1.0e-10);
+        solver.SetUp(A);
+        ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+        for (cemINT i=0; i<N; ++i)
+            ASSERT_NEAR(x_exact[i],x[i],1.0e-6);
+
+        const AMGPreconditioner* amg =
+                static_cast<const AMGPreconditioner*>(solver.preconditioner());
+        ASSERT_GT(amg->num_levels(),1);
+        ASSERT_LE(amg->num_level_rows(amg->num_levels()-1),amg->coarse_size());
+        ASSERT_LT(amg->operator_complexity(),2.0);
+        iterations[s] = solver.telemetry().num_iterations;
+    }
+
+    // Iterations barely grow while the unknowns grow 16 times:
+    ASSERT_LE(iterations[2],25);
+    ASSERT_LE(iterations[2],iterations[0] + 6);
+}
+
+
+TEST(AMGPreconditioner,AnisotropicLaplacian)
+{
+    // Couplings along y are 100 times weaker than along x:
+    cemINT nx = 60, ny = 60, N = nx*ny;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(nx,ny,A);
+    for (cemINT i=0; i<N; ++i)
+    {
+        for (cemINT8 k=A.row_offsets()[i]; k<A.row_offsets()[i+1]; ++k)
+        {
+            cemINT j = A.column_indices()[k];
+            A.values()[k] = j == i ? 2.02 : (j == i-1 || j == i+1 ? -1.0 : -0.01);
+        }
+    }
+    std::vector<cemDOUBLE> b(N,1.0),x(N,0.0);
+
+    PCGSolver solver(AMG);
+    solver.SetUp(A);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_LE(solver.telemetry().num_iterations,30);
+
+    PCGSolver jacobi(JACOBI);
+    jacobi.SetUp(A);
+    std::vector<cemDOUBLE> y(N,0.0);
+    ASSERT_TRUE(jacobi.Solve(&b[0],&y[0]));
+    ASSERT_LT(solver.telemetry().num_iterations,jacobi.telemetry().num_iterations);
+}
+
+
+TEST(AMGPreconditioner,ReusesStructureForNewValues)
+{
+    cemINT n = 48, N = n*n;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    std::vector<cemDOUBLE> b(N,1.0),x(N,0.0),y(N,0.0);
+
+    PCGSolver solver(AMG);
+    solver.SetUp(A);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    const AMGPreconditioner* amg = static_cast<const AMGPreconditioner*>(solver.preconditioner());
+    cemINT num_levels = amg->num_levels();
+
+    // New values with the same pattern (twice the conductivity) keep the hierarchy:
+    for (cemINT8 k=0; k<A.num_entries(); ++k)
+        A.values()[k] *= 2.0;
+    solver.SetUp(A);
+    ASSERT_EQ(1,amg->num_structure_setups());
+    ASSERT_EQ(num_levels,amg->num_levels());
+    ASSERT_TRUE(solver.Solve(&b[0],&y[0]));
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(0.5*x[i],y[i],1.0e-6*std::fabs(x[i]));
+
+    // A new pattern builds it again:
+    SparseMatrix<cemDOUBLE> B;
+    CreateLaplacianMatrix(n+1,n,B);
+    solver.SetUp(B);
+    ASSERT_EQ(2,amg->num_structure_setups());
+
+    AMGPreconditioner preconditioner;
+    ASSERT_THROW(preconditioner.set_strength_threshold(1.5),cemcommon::Exception);
+    ASSERT_THROW(preconditioner.set_smoother_degree(0),cemcommon::Exception);
+}
+
+
+TEST(SparseCholesky,SolvesLaplacianWithBothOrderings)
+{
+    cemINT nx = 90, ny = 80, N = nx*ny;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(nx,ny,A);
+
+    std::vector<cemDOUBLE> x_exact(N),b(N);
+    for (cemINT i=0; i<N; ++i)
+        x_exact[i] = std::sin(0.05*i) + 0.1*(i%7);
+    A.multiply(&x_exact[0],&b[0]);
+
+    OrderingType orderings[2] = {NATURAL_ORDERING, NESTED_DISSECTION};
+    cemINT8 entries[2];
+    for (cemINT o=0; o<2; ++o)
+    {
+        SparseCholesky cholesky(orderings[o]);
+        ASSERT_THROW(cholesky.Solve(&b[0],&x_exact[0]),cemcommon::Exception);
+        cholesky.Factorize(A);
+        ASSERT_TRUE(cholesky.is_factorized());
+        ASSERT_EQ(1,cholesky.num_analyses());
+        ASSERT_LT(cholesky.num_supernodes(),N);
+
+        // The ordering is a permutation:
+        std::vector<cemINT> sorted(cholesky.permutation());
+        std::sort(sorted.begin(),sorted.end());
+        for (cemINT i=0; i<N; ++i)
+            ASSERT_EQ(i,sorted[i]);
+
+        std::vector<cemDOUBLE> x(N,0.0);
+        cholesky.Solve(&b[0],&x[0]);
+        for (cemINT i=0; i<N; ++i)
+            ASSERT_NEAR(x_exact[i],x[i],1.0e-10);
+        entries[o] = cholesky.num_factor_entries();
+    }
+
+    // Banded fill of the natural ordering is about nx entries per column:
+    ASSERT_GT(entries[0],static_cast<cemINT8>(N)*(nx-2));
+    ASSERT_LT(2*entries[1],entries[0]);
+}
+
+
+TEST(SparseCholesky,SolveBlockMatchesSolve)
+{
+    // More right-hand sides than a block, so the last block is partial:
+    cemINT n = 35, N = n*n, num_rhs = 21;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    DenseMatrix<cemDOUBLE> B(N,num_rhs),X;
+    for (cemINT v=0; v<num_rhs; ++v)
+        for (cemINT i=0; i<N; ++i)
+            B(i,v) = std::cos(0.02*(v+1)*i) + 0.1*v;
+
+    SparseCholesky cholesky;
+    ASSERT_THROW(cholesky.SolveBlock(B,X),cemcommon::Exception);
+    cholesky.Factorize(A);
+    cholesky.SolveBlock(B,X);
+    ASSERT_EQ(num_rhs,static_cast<cemINT>(X.num_columns()));
+
+    std::vector<cemDOUBLE> x(N),Ax(N);
+    for (cemINT v=0; v<num_rhs; ++v)
+    {
+        cholesky.Solve(&B(0,v),&x[0]);
+        A.multiply(&X(0,v),&Ax[0]);
+        for (cemINT i=0; i<N; ++i)
+        {
+            ASSERT_NEAR(x[i],X(i,v),1.0e-10*(1.0 + std::fabs(x[i])));
+            ASSERT_NEAR(B(i,v),Ax[i],1.0e-10);
+        }
+    }
+
+    // In place:
+    cholesky.SolveBlock(num_rhs,&B(0,0),&B(0,0));
+    ASSERT_NEAR(X(N/3,num_rhs-1),B(N/3,num_rhs-1),1.0e-12);
+}
+
+
+TEST(SparseCholesky,RefactorizeWithNewValues)
+{
+    cemINT n = 30, N = n*n;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    std::vector<cemDOUBLE> b(N,1.0),x(N),y(N);
+
+    SparseCholesky cholesky;
+    cholesky.Factorize(A);
+    cholesky.Solve(&b[0],&x[0]);
+
+    // New values with the same pattern skip the analysis:
+    for (cemINT8 k=0; k<A.num_entries(); ++k)
+        A.values()[k] *= 4.0;
+    cholesky.Factorize(A);
+    ASSERT_EQ(1,cholesky.num_analyses());
+    cholesky.Solve(&b[0],&y[0]);
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(0.25*x[i],y[i],1.0e-12*std::fabs(x[i]));
+
+    // Solving in place:
+    y = b;
+    cholesky.Solve(&y[0],&y[0]);
+    ASSERT_NEAR(0.25*x[N/2],y[N/2],1.0e-12*std::fabs(x[N/2]));
+
+    // Not positive definite:
+    A.values()[0] = -1.0;
+    ASSERT_THROW(cholesky.Factorize(A),cemcommon::Exception);
+    ASSERT_FALSE(cholesky.is_factorized());
+
+    // A new pattern is analyzed again:
+    SparseMatrix<cemDOUBLE> B;
+    CreateLaplacianMatrix(n+1,n,B);
+    cholesky.Factorize(B);
+    ASSERT_EQ(2,cholesky.num_analyses());
+    ASSERT_EQ(N+n,cholesky.num_rows());
+}
+
+
+TEST(SparseCholesky,SplitsRowsOfLoneSupernodes)
+{
+    // In the natural ordering the supernodal tree is a chain, and the supernodes have more rows
+    // below their diagonal block than a block of rows:
+    cemINT nx = 270, ny = 4, N = nx*ny;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(nx,ny,A);
+    std::vector<cemDOUBLE> b(N),x_serial(N),x(N),Ax(N);
+    for (cemINT i=0; i<N; ++i)
+        b[i] = 1.0 + 0.5*std::cos(0.01*i);
+
+    cemINT max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    SparseCholesky cholesky(NATURAL_ORDERING);
+    cholesky.Factorize(A);
+    cholesky.Solve(&b[0],&x_serial[0]);
+#ifdef _OPENMP
+    omp_set_num_threads(4);
+#endif
+    cholesky.Factorize(A);
+    cholesky.Solve(&b[0],&x[0]);
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif
+
+    A.multiply(&x[0],&Ax[0]);
+    for (cemINT i=0; i<N; ++i)
+    {
+        ASSERT_NEAR(x_serial[i],x[i],1.0e-12*std::fabs(x_serial[i]));
+        ASSERT_NEAR(b[i],Ax[i],1.0e-9);
+    }
+}
+
+
+TEST(SparseCholesky,SinglePrecisionFactor)
+{
+    cemINT n = 50, N = n*n;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    std::vector<cemDOUBLE> b(N,1.0),x(N),x_single(N);
+
+    SparseCholesky cholesky;
+    cholesky.Factorize(A);
+    cemINT8 double_bytes = cholesky.factor_bytes();
+    cholesky.Solve(&b[0],&x[0]);
+
+    cholesky.set_precision(SINGLE_PRECISION);
+    ASSERT_FALSE(cholesky.is_factorized());
+    cholesky.Factorize(A);
+    ASSERT_EQ(1,cholesky.num_analyses());
+    ASSERT_EQ(double_bytes/2,cholesky.factor_bytes());
+    cholesky.Solve(&b[0],&x_single[0]);
+
+    DenseMatrix<cemDOUBLE> B(N,3),X;
+    for (cemINT v=0; v<3; ++v)
+        for (cemINT i=0; i<N; ++i)
+            B(i,v) = 1.0;
+    cholesky.SolveBlock(B,X);
+
+    for (cemINT i=0; i<N; ++i)
+    {
+        ASSERT_NEAR(x[i],x_single[i],1.0e-4*x[i]);
+        ASSERT_NEAR(x_single[i],X(i,2),1.0e-5*x[i]);
+    }
+}
+
+
+//************************************************************************************************//
+/** @brief CreateGroundedLaplacianMatrix : Five-point Laplacian of a nx*ny grid with a weak
+ * connection of every point to ground, so the condition number is about 8/ground.
+ * @param [in] nx : points in x
+ * @param [in] ny : points in y
+ * @param [in] ground : conductance to ground
+ * @param [out] A : matrix */
+//************************************************************************************************//
+static void CreateGroundedLaplacianMatrix(const cemINT& nx,
+                                          const cemINT& ny,
+                                          const cemDOUBLE& ground,
+                                          SparseMatrix<cemDOUBLE>& A)
+{
+    CreateLaplacianMatrix(nx,ny,A);
+    for (cemINT i=0; i<nx*ny; ++i)
+    {
+        cemDOUBLE diagonal = ground;
+        for (cemINT8 k=A.row_offsets()[i]; k<A.row_offsets()[i+1]; ++k)
+            if (A.column_indices()[k] != i)
+                diagonal -= A.values()[k];
+        A(i,i) = diagonal;
+    }
+}
+
+
+TEST(MixedPrecisionSolver,RefinesToDoublePrecision)
+{
+    cemINT n = 60, N = n*n;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    std::vector<cemDOUBLE> b(N),x(N),expected(N);
+    for (cemINT i=0; i<N; ++i)
+        b[i] = 1.0 + std::cos(0.05*i);
+
+    MixedPrecisionSolver solver;
+    ASSERT_THROW(solver.Solve(&b[0],&x[0]),cemcommon::Exception);
+    solver.SetUp(A);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_EQ(SINGLE_PRECISION,solver.precision());
+    ASSERT_EQ(0,solver.num_fallbacks());
+    ASSERT_GT(solver.telemetry().initial_residual,1.0e-9);
+    ASSERT_LE(solver.telemetry().final_residual,1.0e-11);
+    ASSERT_LE(solver.telemetry().num_iterations,4);
+
+    SparseCholesky cholesky;
+    cholesky.Factorize(A);
+    cholesky.Solve(&b[0],&expected[0]);
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(expected[i],x[i],1.0e-10*std::fabs(expected[i]));
+}
+
+
+TEST(MixedPrecisionSolver,FallsBackToDoublePrecision)
+{
+    cemINT n = 40, N = n*n;
+    std::vector<cemDOUBLE> b(N),x(N);
+    for (cemINT i=0; i<N; ++i)
+        b[i] = std::sin(0.3*i);
+
+    // Refinement cut short:
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    MixedPrecisionSolver solver;
+    solver.set_max_refinements(0);
+    solver.SetUp(A);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_EQ(DOUBLE_PRECISION,solver.precision());
+    ASSERT_EQ(1,solver.num_fallbacks());
+    ASSERT_EQ(1,solver.telemetry().num_iterations);
+
+    // The double precision factor is kept until the next SetUp():
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_EQ(DOUBLE_PRECISION,solver.precision());
+    ASSERT_EQ(1,solver.num_fallbacks());
+    solver.SetUp(A);
+    ASSERT_EQ(SINGLE_PRECISION,solver.precision());
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_EQ(2,solver.num_fallbacks());
+
+    // Condition number beyond single precision (the single precision factorization breaks down
+    // or refinement diverges):
+    SparseMatrix<cemDOUBLE> B;
+    CreateGroundedLaplacianMatrix(n,n,1.0e-8,B);
+    MixedPrecisionSolver grounded;
+    grounded.set_tolerance(1.0e-8);
+    grounded.SetUp(B);
+    ASSERT_TRUE(grounded.Solve(&b[0],&x[0]));
+    ASSERT_EQ(DOUBLE_PRECISION,grounded.precision());
+    ASSERT_EQ(1,grounded.num_fallbacks());
+    ASSERT_LE(grounded.telemetry().final_residual,1.0e-8);
+}
+
+
+//************************************************************************************************//
+/** @brief CreateLayeredBoardMatrix : Five-point Laplacians of num_layers stacked n*n layers,
+ * connected by vias with conductance 10 every via_stride points in each direction.
+ * @param [in] n : points per side of each layer
+ * @param [in] num_layers : number of layers
+ * @param [in] via_stride : distance between vias
+ * @param [out] A : matrix
+ * @param [out] layers : layer of each row */
+//************************************************************************************************//
+static void CreateLayeredBoardMatrix(const cemINT& n,
+                                     const cemINT& num_layers,
+                                     const cemINT& via_stride,
+                                     SparseMatrix<cemDOUBLE>& A,
+                                     std::vector<cemINT>& layers)
+{
+    cemINT layer_size = n*n, N = num_layers*layer_size;
+    cemDOUBLE via = 10.0;
+    std::vector<cemINT8> row_offsets(N+1,0);
+    std::vector<cemINT> columns;
+    std::vector<cemDOUBLE> values;
+    layers.resize(N);
+    for (cemINT l=0; l<num_layers; ++l)
+    {
+        for (cemINT j=0; j<n; ++j)
+        {
+            for (cemINT i=0; i<n; ++i)
+            {
+                cemINT row = l*layer_size + j*n + i;
+                cemBOOL has_via = i%via_stride == via_stride/2 && j%via_stride == via_stride/2;
+                cemBOOL via_down = has_via && l > 0;
+                cemBOOL via_up = has_via && l < num_layers-1;
+                layers[row] = l;
+
+                if (via_down) {columns.push_back(row-layer_size); values.push_back(-via);}
+                if (j > 0) {columns.push_back(row-n); values.push_back(-1.0);}
+                if (i > 0) {columns.push_back(row-1); values.push_back(-1.0);}
+                columns.push_back(row);
+                values.push_back(4.0 + (via_down ? via : 0.0) + (via_up ? via : 0.0));
+                if (i < n-1) {columns.push_back(row+1); values.push_back(-1.0);}
+                if (j < n-1) {columns.push_back(row+n); values.push_back(-1.0);}
+                if (via_up) {columns.push_back(row+layer_size); values.push_back(-via);}
+                row_offsets[row+1] = columns.size();
+            }
+        }
+    }
+
+    A.set_pattern(N,N,row_offsets,columns);
+    std::copy(values.begin(),values.end(),A.values());
+}
+
+
+TEST(SchurComplementSolver,MatchesMonolithicSolve)
+{
+    // 3 layers with 5 x 5 vias between neighboring layers:
+    cemINT n = 30, num_layers = 3, N = num_layers*n*n;
+    SparseMatrix<cemDOUBLE> A;
+    std::vector<cemINT> layers;
+    CreateLayeredBoardMatrix(n,num_layers,6,A,layers);
+    std::vector<cemDOUBLE> b(N),x(N),expected(N);
+    for (cemINT i=0; i<N; ++i)
+        b[i] = 1.0 + std::sin(0.07*i);
+
+    SparseCholesky cholesky;
+    cholesky.Factorize(A);
+    cholesky.Solve(&b[0],&expected[0]);
+
+    // The upper end of each via is on the interface:
+    SchurComplementSolver solver;
+    solver.SetUp(A,layers);
+    ASSERT_EQ(num_layers,solver.num_domains());
+    ASSERT_EQ(2*25,solver.num_interface_rows());
+    ASSERT_EQ(n*n,solver.num_interior_rows(0));
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(expected[i],x[i],1.0e-10*std::fabs(expected[i]));
+
+    solver.set_interface_solver(INTERFACE_PCG);
+    solver.set_tolerance(1.0e-12);
+    std::fill(x.begin(),x.end(),0.0);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_GT(solver.telemetry().num_iterations,0);
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(expected[i],x[i],1.0e-9*std::fabs(expected[i]));
+
+    // Both ends of every via on the interface (vias are away from the edges, so only via rows
+    // have more than 5 entries), Schur complement formed on demand:
+    for (cemINT i=0; i<N; ++i)
+        if (A.row_offsets()[i+1] - A.row_offsets()[i] > 5)
+            layers[i] = -1;
+    solver.SetUp(A,layers);
+    ASSERT_EQ(num_layers*25,solver.num_interface_rows());
+    solver.set_interface_solver(INTERFACE_DIRECT);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(expected[i],x[i],1.0e-10*std::fabs(expected[i]));
+
+    layers.pop_back();
+    ASSERT_THROW(solver.SetUp(A,layers),cemcommon::Exception);
+
+    // Positive definite interiors and interface diagonal, but S = 0.5 - 1 - 1 < 0:
+    std::vector<cemINT8> row_offsets(4);
+    row_offsets[0] = 0; row_offsets[1] = 2; row_offsets[2] = 5; row_offsets[3] = 7;
+    std::vector<cemINT> columns(7);
+    columns[0] = 0; columns[1] = 1; columns[2] = 0; columns[3] = 1; columns[4] = 2;
+    columns[5] = 1; columns[6] = 2;
+    SparseMatrix<cemDOUBLE> C;
+    C.set_pattern(3,3,row_offsets,columns);
+    C(0,0) = 1.0; C(0,1) = 1.0; C(1,0) = 1.0; C(1,1) = 0.5; C(1,2) = 1.0; C(2,1) = 1.0; C(2,2) = 1.0;
+    std::vector<cemINT> domains(3);
+    domains[0] = 0; domains[1] = -1; domains[2] = 1;
+    std::vector<cemDOUBLE> c(3,1.0),y(3);
+    solver.set_interface_solver(INTERFACE_PCG);
+    solver.SetUp(C,domains);
+    ASSERT_THROW(solver.Solve(&c[0],&y[0]),cemcommon::Exception);
+    solver.set_interface_solver(INTERFACE_DIRECT);
+    ASSERT_THROW(solver.SetUp(C,domains),cemcommon::Exception);
+}
+
+
+//************************************************************************************************//
+/** @brief ChangeEdgeConductance : Adds delta to the conductance between two grid points, as a
+ * change of the conductivity of one element would.
+ * @param [in] i : first point
+ * @param [in] j : second point
+ * @param [in] delta : change of the conductance
+ * @param [in,out] A : matrix with entries (i,j) and (j,i) */
+//************************************************************************************************//
+static void ChangeEdgeConductance(const cemINT& i, const cemINT& j, const cemDOUBLE& delta,
+                                  SparseMatrix<cemDOUBLE>& A)
+{
+    A(i,i) += delta;
+    A(j,j) += delta;
+    A(i,j) -= delta;
+    A(j,i) -= delta;
+}
+
+
+TEST(WoodburySolver,MatchesRefactorization)
+{
+    cemINT n = 40, N = n*n;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    std::vector<cemDOUBLE> b(N),x(N),expected(N);
+    for (cemINT i=0; i<N; ++i)
+        b[i] = 1.0 + 0.5*std::sin(0.1*i);
+
+    WoodburySolver solver;
+    ASSERT_THROW(solver.Solve(&b[0],&x[0]),cemcommon::Exception);
+    solver.SetUp(A);
+
+    // A neck-down (lower conductance) and a wider trace (higher conductance) change 4 rows:
+    SparseMatrix<cemDOUBLE> A_new = A;
+    ChangeEdgeConductance(n*10 + 5,n*10 + 6,-0.9,A_new);
+    ChangeEdgeConductance(n*30 + 20,n*31 + 20,25.0,A_new);
+    solver.Update(A_new);
+    ASSERT_EQ(4,solver.num_update_rows());
+    ASSERT_EQ(1,solver.num_factorizations());
+
+    SparseCholesky cholesky;
+    cholesky.Factorize(A_new);
+    cholesky.Solve(&b[0],&expected[0]);
+    x = b;
+    solver.Solve(&x[0],&x[0]);
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(expected[i],x[i],1.0e-10*std::fabs(expected[i]));
+
+    // Updates are relative to the base matrix, not accumulated:
+    solver.Update(A);
+    ASSERT_EQ(0,solver.num_update_rows());
+    solver.Solve(&b[0],&x[0]);
+    cholesky.Factorize(A);
+    cholesky.Solve(&b[0],&expected[0]);
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(expected[i],x[i],1.0e-10*std::fabs(expected[i]));
+
+    // A wider trace changes 24 rows, more than one block of columns of the update:
+    SparseMatrix<cemDOUBLE> A_wide = A;
+    for (cemINT k=0; k<12; ++k)
+        ChangeEdgeConductance(n*20 + 2*k,n*20 + 2*k + 1,4.0,A_wide);
+    solver.Update(A_wide);
+    ASSERT_EQ(24,solver.num_update_rows());
+    ASSERT_EQ(1,solver.num_factorizations());
+    solver.Solve(&b[0],&x[0]);
+    cholesky.Factorize(A_wide);
+    cholesky.Solve(&b[0],&expected[0]);
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(expected[i],x[i],1.0e-10*std::fabs(expected[i]));
+
+    // Too many changed rows are factorized again:
+    solver.set_max_update_rows(3);
+    solver.Update(A_new);
+    ASSERT_EQ(0,solver.num_update_rows());
+    ASSERT_EQ(2,solver.num_factorizations());
+}
+
+
+TEST(PCGSolver,UpdateMatrixWarmStart)
+{
+    cemINT n = 60, N = n*n;
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(n,n,A);
+    std::vector<cemDOUBLE> b(N,1.0),x(N,0.0),x_cold(N,0.0);
+
+    PCGSolver solver(IC0);
+    solver.set_tolerance(1.0e-10);
+    solver.SetUp(A);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+
+    SparseMatrix<cemDOUBLE> A_new = A;
+    ChangeEdgeConductance(n*20 + 30,n*20 + 31,-0.5,A_new);
+    ChangeEdgeConductance(n*20 + 31,n*20 + 32,-0.5,A_new);
+
+    PCGSolver cold(IC0);
+    cold.set_tolerance(1.0e-10);
+    cold.SetUp(A_new);
+    ASSERT_TRUE(cold.Solve(&b[0],&x_cold[0]));
+
+    // Old preconditioner, previous solution as the initial guess:
+    solver.UpdateMatrix(A_new);
+    ASSERT_TRUE(solver.Solve(&b[0],&x[0]));
+    ASSERT_LT(solver.telemetry().num_iterations,cold.telemetry().num_iterations);
+    for (cemINT i=0; i<N; ++i)
+        ASSERT_NEAR(x_cold[i],x[i],1.0e-7);
+
+    SparseMatrix<cemDOUBLE> B;
+    CreateLaplacianMatrix(n+1,n,B);
+    ASSERT_THROW(solver.UpdateMatrix(B),cemcommon::Exception);
+}
+
+
+//************************************************************************************************//
+/** @brief CreateLaplacianMatrix : Five-point Laplacian of a nx*ny grid with Dirichlet boundary
+ * (symmetric positive definite, both triangles stored).
+ * @param [in] nx : grid points along x
+ * @param [in] ny : grid points along y
+ * @param [out] A : nx*ny matrix */
+//************************************************************************************************//
+void CreateLaplacianMatrix(const cemINT& nx,
+                           const cemINT& ny,
+                           SparseMatrix<cemDOUBLE>& A)
+{
+    cemINT N = nx*ny;
+    std::vector<cemINT8> row_offsets(N+1,0);
+    std::vector<cemINT> columns;
+    std::vector<cemDOUBLE> values;
+    columns.reserve(5*N);
+    values.reserve(5*N);
+    for (cemINT j=0; j<ny; ++j)
+    {
+        for (cemINT i=0; i<nx; ++i)
+        {
+            cemINT row = j*nx + i;
+            if (j > 0) {columns.push_back(row-nx); values.push_back(-1.0);}
+            if (i > 0) {columns.push_back(row-1); values.push_back(-1.0);}
+            columns.push_back(row); values.push_back(ny > 1 ? 4.0 : 2.0);
+            if (i < nx-1) {columns.push_back(row+1); values.push_back(-1.0);}
+            if (j < ny-1) {columns.push_back(row+nx); values.push_back(-1.0);}
+            row_offsets[row+1] = columns.size();
+        }
+    }
+
+    A.set_pattern(N,N,row_offsets,columns);
+    for (size_t k=0; k<values.size(); ++k)
+        A.values()[k] = values[k];
+}
+
+
+//************************************************************************************************//
+/** @brief TestPCGBenchmark : Solves a Laplacian of grid_size^2 unknowns with each preconditioner.
+ * @param [in] grid_size : grid points per side
+ * @return : 0 */
+//************************************************************************************************//
+int TestPCGBenchmark(const cemINT& grid_size)
+{
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(grid_size,grid_size,A);
+    cemINT N = A.num_rows();
+    std::vector<cemDOUBLE> b(N,1.0);
+
+    const char* names[4] = {"Jacobi", "SSOR", "IC(0)", "AMG"};
+    PreconditionerType types[4] = {JACOBI, SSOR, IC0, AMG};
+    for (cemINT t=0; t<4; ++t)
+    {
+        PCGSolver solver(types[t]);
+        solver.set_max_iterations(10*grid_size);
+        solver.SetUp(A);
+        std::vector<cemDOUBLE> x(N,0.0);
+        solver.Solve(&b[0],&x[0]);
+        std::cout << N << " unknowns, " << names[t] << ": ";
+        solver.telemetry().Print(std::cout);
+    }
+
+    return 0;
+}
+
+
+//************************************************************************************************//
+/** @brief TestCholeskyBenchmark : Factorizes and solves a Laplacian of grid_size^2 unknowns.
+ * @param [in] grid_size : grid points per side
+ * @return : 0 */
+//************************************************************************************************//
+int TestCholeskyBenchmark(const cemINT& grid_size)
+{
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(grid_size,grid_size,A);
+    cemINT N = A.num_rows();
+    std::vector<cemDOUBLE> b(N,1.0),x(N);
+
+    SparseCholesky cholesky;
+    cemDOUBLE start = WallTime();
+    cholesky.Analyze(A);
+    cemDOUBLE analyze = WallTime();
+    cholesky.Factorize(A);
+    cemDOUBLE factorize = WallTime();
+    cholesky.Solve(&b[0],&x[0]);
+    cemDOUBLE solve = WallTime();
+
+    std::cout << N << " unknowns, " << cholesky.num_supernodes() << " supernodes, "
+              << cholesky.num_factor_entries() << " entries in L" << std::endl;
+    std::cout << "Analyze " << analyze - start << " s, factorize " << factorize - analyze
+              << " s, solve " << solve - factorize << " s" << std::endl;
+
+    return 0;
+}
+
+
+//************************************************************************************************//
+/** @brief TestBlockSolveBenchmark : Solves a Laplacian of grid_size^2 unknowns for several
+ * right-hand sides, one at a time and as a block, with the direct solver and with PCG.
+ * @param [in] grid_size : grid points per side
+ * @param [in] num_rhs : number of right-hand sides
+ * @return : 0 */
+//************************************************************************************************//
+int TestBlockSolveBenchmark(const cemINT& grid_size, const cemINT& num_rhs)
+{
+    SparseMatrix<cemDOUBLE> A;
+    CreateLaplacianMatrix(grid_size,grid_size,A);
+    cemINT N = A.num_rows();
+    DenseMatrix<cemDOUBLE> B(N,num_rhs),X(N,num_rhs);
+    for (cemINT v=0; v<num_rhs; ++v)
+        for (cemINT i=0; i<N; ++i)
+            B(i,v) = 1.0 + 0.1*((i + v)%7);
+
+    SparseCholesky cholesky;
+    cholesky.Factorize(A);
+    cemDOUBLE start = WallTime();
+    for (cemINT v=0; v<num_rhs; ++v)
+        cholesky.Solve(&B(0,v),&X(0,v));
+    cemDOUBLE single = WallTime();
+    cholesky.SolveBlock(B,X);
+    cemDOUBLE block = WallTime();
+    std::cout << N << " unknowns, " << num_rhs << " right-hand sides" << std::endl;
+    std::cout << "Cholesky: one at a time " << single - start << " s, block "
+              << block - single << " s" << std::endl;
+
+    PCGSolver solver(IC0);
+    solver.SetUp(A);
+    start = WallTime();
+    for (cemINT v=0; v<num_rhs; ++v)
+    {
+        std::fill(&X(0,v),&X(0,v) + N,0.0);
+        solver.Solve(&B(0,v),&X(0,v));
+    }
+    single = WallTime();
+    X.initialize();
+    solver.SolveBlock(B,X);
+    block = WallTime();
+    std::cout << "PCG IC(0): one at a time " << single - start << " s, block "
+              << block - single << " s" << std::endl;
+
+    return 0;
+}
+
+
 int TestMathBasics()
 {
     DenseMatrix<cemFCOMPLEX> A(2,2);
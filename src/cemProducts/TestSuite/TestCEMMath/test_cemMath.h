@@ -5,9 +5,27 @@
 #include "cemTypes.h"
 #include "MKL/BlasLevel1.h"
 #include "Matrix/DenseMatrix.h"
+#include "Matrix/SymmetricMatrix.h"
+#include "Matrix/SparseMatrix.h"
+#include "Solvers/VectorKernels.h"
+#include "Solvers/PCGSolver.h"
+#include "Solvers/SparseProducts.h"
+#include "Solvers/AMGPreconditioner.h"
+#include "Solvers/SparseCholesky.h"
+#include "Solvers/WoodburySolver.h"
+#include "Solvers/MixedPrecisionSolver.h"
+#include "Solvers/SchurComplementSolver.h"
+#include "Solvers/SolverTimer.h"
 
 
 int TestMathBasics();
+int TestPCGBenchmark(const cemINT& grid_size);
+int TestCholeskyBenchmark(const cemINT& grid_size);
+int TestBlockSolveBenchmark(const cemINT& grid_size, const cemINT& num_rhs);
+
+void CreateLaplacianMatrix(const cemINT& nx,
+                           const cemINT& ny,
+                           cem_math::SparseMatrix<cemDOUBLE>& A);
 
 //************************************************************************************************//
 // This is an example on how to use Fixtures in GoogleTest
@@ -1,10 +1,20 @@
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <set>
 #include "cemError.h"
 #include "test_SolverElement.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 using cemcommon::Exception;
+using cem_math::WallTime;
+
 
 //************************************************************************************************//
 // Main Test Function:
@@ -34,6 +44,18 @@ int RunTestSolverElement(int argc, char* argv[])
     {
         return TestSolverElementBasics();
     }
+    if (!strcmp(argv[1],"-BatchBenchmark"))
+    {
+        return TestSolverElementBatchBenchmark();
+    }
+    if (!strcmp(argv[1],"-AssemblyBenchmark"))
+    {
+        return TestSparseAssemblyBenchmark();
+    }
+    if (!strcmp(argv[1],"-SystemBenchmark"))
+    {
+        return TestSparseSystemBenchmark();
+    }
     return 1;
 }
 
@@ -656,31 +678,2281 @@ TEST(SolverTriangle,setUp_matrix_N_NN_1_3)
     }
 }
 
-
-int TestSolverElementBasics()
+TEST(SolverTriangle,ReferenceTensors_analytic)
 {
     // Create single element:
     Element test_element;
     CreateSingleElement(test_element);
-    cem_core::SolverTriangle solver_element(&test_element,3,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    cemDOUBLE x1 = 1.0, y1 = -0.5, x2 = 1.0, y2 = 1.0, x3 = -0.5, y3 = 2.0;
+    cemDOUBLE b1 = y2 - y3, b2 = y3 - y1;
+    cemDOUBLE c1 = x3 - x2, c2 = x1 - x3;
+    cemDOUBLE delta = 0.5*(b1*c2 - b2*c1);
 
-    DenseMatrix<cemDOUBLE> K_analytic,K_numeric;
+    // Contraction of reference tensors must reproduce the hand-derived matrices:
+    for (cemINT coefficient_order=0; coefficient_order<=1; ++coefficient_order)
+    {
+        for (cemINT basis_order=1; basis_order<=3; ++basis_order)
+        {
+            cem_core::SolverTriangle solver_element(&test_element,basis_order,cem_core::SCALAR,
+                                                    cem_core::INTERPOLATORY,coefficient_order);
+            solver_element.setUp_matrix_N_NxNx(false);
+            solver_element.setUp_matrix_N_NyNy(false);
+            solver_element.setUp_matrix_N_NN(false);
+
+            const cem_core::TriReferenceTensors& tensors =
+                    cem_core::TriReferenceTensors::Get(basis_order,coefficient_order);
+            cemINT n = tensors.num_basis_functions();
+            SymmetricMatrix<cemDOUBLE> K_x(n,n),K_y(n,n),M(n,n);
+
+            for (cemINT k=0; k<tensors.num_coefficient_functions(); ++k)
+            {
+                tensors.Compute_N_NdNd_matrix(b1,b2,delta,k,&K_x(0,0));
+                tensors.Compute_N_NdNd_matrix(c1,c2,delta,k,&K_y(0,0));
+                tensors.Compute_N_NN_matrix(delta,k,&M(0,0));
+
+                const SymmetricMatrix<cemDOUBLE>& K_x_analytic = solver_element.matrix_N_NxNx(k);
+                const SymmetricMatrix<cemDOUBLE>& K_y_analytic = solver_element.matrix_N_NyNy(k);
+                const SymmetricMatrix<cemDOUBLE>& M_analytic = solver_element.matrix_N_NN(k);
+                for (cemINT j=0; j<n; ++j)
+                {
+                    for (cemINT i=0; i<n; ++i)
+                    {
+                        ASSERT_NEAR(K_x_analytic(i,j),K_x(i,j),1.0e-13);
+                        ASSERT_NEAR(K_y_analytic(i,j),K_y(i,j),1.0e-13);
+                        ASSERT_NEAR(M_analytic(i,j),M(i,j),1.0e-13);
+                    }
+                }
+            }
+        }
+    }
+}
 
-    std::ofstream file_analytic;
-    file_analytic.open("K_analytic.out",std::ofstream::out);
-    file_analytic.precision(15);
+TEST(SolverTriangle,setUp_matrices_from_reference_2_3)
+{
+    // Create single element:
+    Element test_element;
+    CreateSingleElement(test_element);
+    cem_core::SolverTriangle solver_element(&test_element,3,cem_core::SCALAR,cem_core::INTERPOLATORY,2);
 
+    // Get matrices (no analytical expressions for quadratic coefficients):
     solver_element.setUp_matrix_N_NxNx(false);
-    K_analytic = solver_element.matrix_N_NxNx(2);
-    K_analytic.WriteToFileByColumns(file_analytic);
-
-    std::ofstream file_numeric;
-    file_numeric.open("K_numeric.out",std::ofstream::out);
-    file_numeric.precision(15);
+    solver_element.setUp_matrix_N_NyNy(false);
+    solver_element.setUp_matrix_N_NN(false);
+    std::vector< DenseMatrix<cemDOUBLE> > K_x_reference,K_y_reference,M_reference;
+    for (cemINT k=0; k<6; ++k)
+    {
+        K_x_reference.push_back(solver_element.matrix_N_NxNx(k));
+        K_y_reference.push_back(solver_element.matrix_N_NyNy(k));
+        M_reference.push_back(solver_element.matrix_N_NN(k));
+    }
 
     solver_element.setUp_matrix_N_NxNx(true);
-    K_numeric = solver_element.matrix_N_NxNx(2);
-    K_numeric.WriteToFileByColumns(file_numeric);
+    solver_element.setUp_matrix_N_NyNy(true);
+    solver_element.setUp_matrix_N_NN(true);
+
+    // Compare matrices:
+    for (cemINT k=0; k<6; ++k)
+    {
+        for (cemINT i=0; i<10; ++i)
+        {
+            for (cemINT j=0; j<10; ++j)
+            {
+                ASSERT_NEAR(solver_element.matrix_N_NxNx(k)(i,j),K_x_reference[k](i,j),1.0e-13);
+                ASSERT_NEAR(solver_element.matrix_N_NyNy(k)(i,j),K_y_reference[k](i,j),1.0e-13);
+                ASSERT_NEAR(solver_element.matrix_N_NN(k)(i,j),M_reference[k](i,j),1.0e-13);
+            }
+        }
+    }
+}
+
+TEST(SolverTriangle,setUp_matrices_fused)
+{
+    // Create single element:
+    Element test_element;
+    CreateSingleElement(test_element);
+
+    for (cemINT p=1; p<=3; ++p)
+    {
+        for (cemINT q=0; q<=2; ++q)
+        {
+            for (cemINT force=0; force<2; ++force)
+            {
+                cem_core::SolverTriangle separate(&test_element,p,cem_core::SCALAR,cem_core::INTERPOLATORY,q);
+                separate.setUp_matrix_N_NxNx(force == 1);
+                separate.setUp_matrix_N_NyNy(force == 1);
+                separate.setUp_matrix_N_NN(force == 1);
+
+                cem_core::SolverTriangle fused(&test_element,p,cem_core::SCALAR,cem_core::INTERPOLATORY,q);
+                fused.setUp_matrices(force == 1);
+
+                // Copies must carry every family:
+                cem_core::SolverTriangle copied(fused);
+
+                for (cemINT k=0; k<(q+1)*(q+2)/2; ++k)
+                {
+                    const SymmetricMatrix<cemDOUBLE>& K_x = separate.matrix_N_NxNx(k);
+                    const SymmetricMatrix<cemDOUBLE>& K_y = separate.matrix_N_NyNy(k);
+                    const SymmetricMatrix<cemDOUBLE>& M = separate.matrix_N_NN(k);
+                    for (cemINT j=0; j<K_x.num_columns(); ++j)
+                    {
+                        for (cemINT i=0; i<K_x.num_rows(); ++i)
+                        {
+                            ASSERT_NEAR(K_x(i,j),fused.matrix_N_NxNx(k)(i,j),1.0e-13);
+                            ASSERT_NEAR(K_y(i,j),fused.matrix_N_NyNy(k)(i,j),1.0e-13);
+                            ASSERT_NEAR(M(i,j),fused.matrix_N_NN(k)(i,j),1.0e-13);
+                            ASSERT_NEAR(K_x(i,j) + K_y(i,j),fused.matrix_N_GradGrad(k)(i,j),1.0e-13);
+                            ASSERT_EQ(fused.matrix_N_GradGrad(k)(i,j),copied.matrix_N_GradGrad(k)(i,j));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(SolverTriangle,TriMatrixBatch_1_2)
+{
+    // Random triangles, enough for one full block plus a partial one:
+    srand(time(NULL));
+    cemINT num_triangles = cem_core::TriMatrixBatch::LANES + 3;
+    std::vector<cemDOUBLE> x1(num_triangles),y1(num_triangles),x2(num_triangles);
+    std::vector<cemDOUBLE> y2(num_triangles),x3(num_triangles),y3(num_triangles);
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        x1[t] = static_cast<cemDOUBLE>(rand() % 1000)/1000.0;
+        y1[t] = static_cast<cemDOUBLE>(rand() % 1000)/1000.0;
+        x2[t] = x1[t] + 1.0 + static_cast<cemDOUBLE>(rand() % 1000)/1000.0;
+        y2[t] = y1[t] + static_cast<cemDOUBLE>(rand() % 1000)/2000.0;
+        x3[t] = x1[t] + static_cast<cemDOUBLE>(rand() % 1000)/2000.0;
+        y3[t] = y1[t] + 1.0 + static_cast<cemDOUBLE>(rand() % 1000)/1000.0;
+    }
+
+    // Batched computation:
+    cem_core::TriMatrixBatch batch(2,1);
+    std::vector<cemDOUBLE> K_x(batch.buffer_size(num_triangles));
+    std::vector<cemDOUBLE> K_y(batch.buffer_size(num_triangles));
+    std::vector<cemDOUBLE> M(batch.buffer_size(num_triangles));
+    batch.Compute(num_triangles,&x1[0],&y1[0],&x2[0],&y2[0],&x3[0],&y3[0],&K_x[0],&K_y[0],&M[0]);
+
+    // Compare with one-at-a-time computation:
+    DenseMatrix<cemDOUBLE> K_batch;
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        std::vector<Node> nodes(3);
+        nodes[0].set_coordinates(x1[t],y1[t],0.0);
+        nodes[1].set_coordinates(x2[t],y2[t],0.0);
+        nodes[2].set_coordinates(x3[t],y3[t],0.0);
+        std::vector<Node*> node_ptrs(3);
+        for (cemINT i=0; i<3; ++i)
+            node_ptrs[i] = &nodes[i];
+        Element test_element;
+        test_element.set_node_ptrs(node_ptrs);
+
+        cem_core::SolverTriangle solver_element(&test_element,2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        solver_element.setUp_matrix_N_NxNx(false);
+        solver_element.setUp_matrix_N_NyNy(false);
+        solver_element.setUp_matrix_N_NN(false);
+
+        for (cemINT k=0; k<3; ++k)
+        {
+            batch.GetMatrix(&K_x[0],t,k,K_batch);
+            for (cemINT j=0; j<6; ++j)
+                for (cemINT i=0; i<6; ++i)
+                    ASSERT_NEAR(solver_element.matrix_N_NxNx(k)(i,j),K_batch(i,j),1.0e-12);
+
+            batch.GetMatrix(&K_y[0],t,k,K_batch);
+            for (cemINT j=0; j<6; ++j)
+                for (cemINT i=0; i<6; ++i)
+                    ASSERT_NEAR(solver_element.matrix_N_NyNy(k)(i,j),K_batch(i,j),1.0e-12);
+
+            batch.GetMatrix(&M[0],t,k,K_batch);
+            for (cemINT j=0; j<6; ++j)
+                for (cemINT i=0; i<6; ++i)
+                    ASSERT_NEAR(solver_element.matrix_N_NN(k)(i,j),K_batch(i,j),1.0e-12);
+        }
+    }
+}
+
+TEST(SolverTriangle,SolverTriangleArena_2_1)
+{
+    // Random triangles, spread over several chunks:
+    srand(time(NULL));
+    cemINT num_triangles = 11;
+    std::vector<Node> nodes(3*num_triangles);
+    std::vector<Element> elements(num_triangles);
+    std::vector<Node*> node_ptrs(3);
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        cemDOUBLE x = static_cast<cemDOUBLE>(rand() % 1000)/1000.0;
+        cemDOUBLE y = static_cast<cemDOUBLE>(rand() % 1000)/1000.0;
+        nodes[3*t].set_coordinates(x,y,0.0);
+        nodes[3*t+1].set_coordinates(x + 1.0 + static_cast<cemDOUBLE>(rand() % 1000)/1000.0,y,0.0);
+        nodes[3*t+2].set_coordinates(x,y + 1.0 + static_cast<cemDOUBLE>(rand() % 1000)/1000.0,0.0);
+        for (cemINT i=0; i<3; ++i)
+            node_ptrs[i] = &nodes[3*t+i];
+        elements[t].set_node_ptrs(node_ptrs);
+    }
+
+    cem_core::SolverTriangleArena arena(2,1,4);
+    ASSERT_EQ(0,arena.Add(&elements[0]));
+    const cemDOUBLE* first_record = arena.geometry(0);
+    for (cemINT t=1; t<num_triangles; ++t)
+        ASSERT_EQ(t,arena.Add(&elements[t]));
+
+    // Records never move:
+    ASSERT_EQ(num_triangles,arena.num_elements());
+    ASSERT_EQ(first_record,arena.geometry(0));
+
+    // Compare with SolverTriangle:
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        ASSERT_EQ(&elements[t],arena.element_ptr(t));
+
+        cem_core::SolverTriangle solver_element(&elements[t],2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        solver_element.setUp_matrices(false);
+        for (cemINT k=0; k<3; ++k)
+        {
+            for (cemINT m=0; m<21; ++m)
+            {
+                ASSERT_NEAR((&solver_element.matrix_N_NxNx(k)(0,0))[m],arena.matrix_N_NxNx(t,k)[m],1.0e-12);
+                ASSERT_NEAR((&solver_element.matrix_N_NyNy(k)(0,0))[m],arena.matrix_N_NyNy(t,k)[m],1.0e-12);
+                ASSERT_NEAR((&solver_element.matrix_N_NN(k)(0,0))[m],arena.matrix_N_NN(t,k)[m],1.0e-12);
+                ASSERT_NEAR((&solver_element.matrix_N_GradGrad(k)(0,0))[m],arena.matrix_N_GradGrad(t,k)[m],1.0e-12);
+            }
+        }
+    }
+
+    ASSERT_THROW(arena.matrix_N_NN(num_triangles,0),cemcommon::Exception);
+    ASSERT_THROW(arena.matrix_N_NN(0,3),cemcommon::Exception);
+
+    arena.Clear();
+    ASSERT_EQ(0,arena.num_elements());
+}
+
+
+
+TEST(SolverTriangle,SolverTriangleArena_growth)
+{
+    // One triangle added many times:
+    std::vector<Node> nodes(3);
+    nodes[0].set_coordinates(0.0,0.0,0.0);
+    nodes[1].set_coordinates(1.0,0.0,0.0);
+    nodes[2].set_coordinates(0.0,1.0,0.0);
+    std::vector<Node*> node_ptrs(3);
+    for (cemINT i=0; i<3; ++i)
+        node_ptrs[i] = &nodes[i];
+    Element element;
+    element.set_node_ptrs(node_ptrs);
+
+    // Add() grows the element list geometrically, so it is reallocated O(log n) times:
+    cemINT num_triangles = 10000;
+    cem_core::SolverTriangleArena arena(1,0,256);
+    cemINT capacity = arena.element_capacity();
+    cemINT num_growths = 0;
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        arena.Add(&element);
+        if (arena.element_capacity() != capacity)
+        {
+            if (capacity > 0)
+                ASSERT_GE(arena.element_capacity(),capacity + capacity/2);
+            capacity = arena.element_capacity();
+            ++num_growths;
+        }
+    }
+    ASSERT_EQ(num_triangles,arena.num_elements());
+    ASSERT_LE(num_growths,30);
+
+    // Reserve() sizes it exactly, and Add() then never grows it:
+    arena.Clear();
+    ASSERT_EQ(0,arena.element_capacity());
+    arena.Reserve(num_triangles);
+    capacity = arena.element_capacity();
+    ASSERT_GE(capacity,num_triangles);
+    for (cemINT t=0; t<num_triangles; ++t)
+        arena.Add(&element);
+    ASSERT_EQ(capacity,arena.element_capacity());
+}
+
+TEST(SolverTriangle,TriKernels_dispatch)
+{
+    // Triangle (0,0), (2,0.3), (0.4,1.5):
+    cemDOUBLE b1 = 0.3 - 1.5;
+    cemDOUBLE b2 = 1.5 - 0.0;
+    cemDOUBLE c1 = 0.4 - 2.0;
+    cemDOUBLE c2 = 0.0 - 0.4;
+    cemDOUBLE delta = 0.5*(b1*c2 - b2*c1);
+    cemDOUBLE inverse_jacobian[4] = {0.5*b1/delta, 0.5*c1/delta, 0.5*b2/delta, 0.5*c2/delta};
+
+    for (cemINT p=1; p<=3; ++p)
+    {
+        for (cemINT q=0; q<=2; ++q)
+        {
+            cem_core::TriKernels::ReferenceKernel reference_kernel;
+            cem_core::TriKernels::NumericalKernel numerical_kernel;
+            reference_kernel = cem_core::TriKernels::GetReferenceKernel(p,q);
+            numerical_kernel = cem_core::TriKernels::GetNumericalKernel(p,q);
+            ASSERT_TRUE(reference_kernel != NULL);
+            ASSERT_TRUE(numerical_kernel != NULL);
+
+            const cem_core::TriReferenceTensors& tensors = cem_core::TriReferenceTensors::Get(p,q);
+            const cem_core::TriTabulation& tabulation = cem_core::TriTabulation::Get(p,q);
+            cemINT size = tensors.num_packed_entries();
+            cemINT num_coefficients = tensors.num_coefficient_functions();
+
+            // Expected values, from the generic contraction:
+            std::vector<cemDOUBLE> N_NxNx(num_coefficients*size), N_NyNy(num_coefficients*size);
+            std::vector<cemDOUBLE> N_NN(num_coefficients*size);
+            for (cemINT k=0; k<num_coefficients; ++k)
+            {
+                tensors.Compute_N_NdNd_matrix(b1,b2,delta,k,&N_NxNx[k*size]);
+                tensors.Compute_N_NdNd_matrix(c1,c2,delta,k,&N_NyNy[k*size]);
+                tensors.Compute_N_NN_matrix(delta,k,&N_NN[k*size]);
+            }
+
+            // Both kernels:
+            std::vector<cemDOUBLE> reference(4*num_coefficients*size);
+            std::vector<cemDOUBLE> numerical(4*num_coefficients*size);
+            cemDOUBLE* ptrs[4][cem_core::TriKernels::MAX_COEFFICIENTS];
+            for (cemINT k=0; k<num_coefficients; ++k)
+            {
+                reference_kernel(tensors,k,b1,b2,c1,c2,delta,
+                                 &reference[(0*num_coefficients + k)*size],
+                                 &reference[(1*num_coefficients + k)*size],
+                                 &reference[(2*num_coefficients + k)*size],
+                                 &reference[(3*num_coefficients + k)*size]);
+                for (cemINT family=0; family<4; ++family)
+                    ptrs[family][k] = &numerical[(family*num_coefficients + k)*size];
+            }
+            numerical_kernel(tabulation,inverse_jacobian,2.0*delta,ptrs[0],ptrs[1],ptrs[2],ptrs[3]);
+
+            for (cemINT m=0; m<num_coefficients*size; ++m)
+            {
+                cemDOUBLE N_GradGrad = N_NxNx[m] + N_NyNy[m];
+                ASSERT_NEAR(N_NxNx[m],reference[0*num_coefficients*size + m],1.0e-12);
+                ASSERT_NEAR(N_NyNy[m],reference[1*num_coefficients*size + m],1.0e-12);
+                ASSERT_NEAR(N_NN[m],reference[2*num_coefficients*size + m],1.0e-12);
+                ASSERT_NEAR(N_GradGrad,reference[3*num_coefficients*size + m],1.0e-12);
+                ASSERT_NEAR(N_NxNx[m],numerical[0*num_coefficients*size + m],1.0e-10);
+                ASSERT_NEAR(N_NyNy[m],numerical[1*num_coefficients*size + m],1.0e-10);
+                ASSERT_NEAR(N_NN[m],numerical[2*num_coefficients*size + m],1.0e-10);
+                ASSERT_NEAR(N_GradGrad,numerical[3*num_coefficients*size + m],1.0e-10);
+            }
+        }
+    }
+
+    // No kernel outside the specialized range:
+    ASSERT_TRUE(cem_core::TriKernels::GetReferenceKernel(0,0) == NULL);
+    ASSERT_TRUE(cem_core::TriKernels::GetReferenceKernel(1,3) == NULL);
+    ASSERT_TRUE(cem_core::TriKernels::GetNumericalKernel(4,0) == NULL);
+
+    // Index tables:
+    cemINT index_i, index_j, index_k;
+    cem_core::SolverTriangle::GetShapeFunctionIndices(3,7,index_i,index_j,index_k);
+    ASSERT_EQ(1,index_i);
+    ASSERT_EQ(0,index_j);
+    ASSERT_EQ(2,index_k);
+    ASSERT_THROW(cem_core::SolverTriangle::GetShapeFunctionIndices(2,6,index_i,index_j,index_k),
+                 cemcommon::Exception);
+}
+
+
+TEST(SolverTriangle,TriIndexTables)
+{
+    // Constant tables follow the generation rule:
+    std::vector<cemINT> ijk;
+    for (cemINT p=0; p<=cem_core::TriIndexTables::MAX_CONSTANT_ORDER; ++p)
+    {
+        cem_core::TriIndexTables::Generate(p,ijk);
+        ASSERT_EQ(3*(p+1)*(p+2)/2,static_cast<cemINT>(ijk.size()));
+        const cemINT* table = cem_core::TriIndexTables::Get(p);
+        for (cemINT m=0; m<static_cast<cemINT>(ijk.size()); ++m)
+            ASSERT_EQ(ijk[m],table[m]);
+    }
+
+    // Generated table: every index triple adds up to the order and appears once:
+    cemINT order = 8;
+    cemINT num_functions = (order+1)*(order+2)/2;
+    const cemINT* table = cem_core::TriIndexTables::Get(order);
+    ASSERT_EQ(table,cem_core::TriIndexTables::Get(order));
+    for (cemINT m=0; m<num_functions; ++m)
+    {
+        ASSERT_EQ(order,table[3*m] + table[3*m+1] + table[3*m+2]);
+        for (cemINT n=0; n<m; ++n)
+            ASSERT_FALSE(table[3*m] == table[3*n] && table[3*m+1] == table[3*n+1]);
+    }
+
+    // Vertices, then edge 0-1, then interior of the 15-node triangle of cemMesh.h:
+    cemINT index_i, index_j, index_k;
+    cem_core::SolverTriangle::GetShapeFunctionIndices(4,3,index_i,index_j,index_k);
+    ASSERT_EQ(3,index_i);
+    ASSERT_EQ(1,index_j);
+    ASSERT_EQ(0,index_k);
+    cem_core::SolverTriangle::GetShapeFunctionIndices(4,14,index_i,index_j,index_k);
+    ASSERT_EQ(1,index_i);
+    ASSERT_EQ(1,index_j);
+    ASSERT_EQ(2,index_k);
+    ASSERT_THROW(cem_core::SolverTriangle::GetShapeFunctionIndices(4,15,index_i,index_j,index_k),
+                 cemcommon::Exception);
+}
+
+
+TEST(SolverTriangle,setUp_matrices_high_order)
+{
+    Node node1(0.0,0.0,0.0);
+    Node node2(2.0,0.3,0.0);
+    Node node3(0.4,1.5,0.0);
+    std::vector<Node*> node_ptrs(3);
+    node_ptrs[0] = &node1;
+    node_ptrs[1] = &node2;
+    node_ptrs[2] = &node3;
+    Element element;
+    element.set_node_ptrs(node_ptrs);
+    cemDOUBLE area = 0.5*(2.0*1.5 - 0.3*0.4);
+
+    for (cemINT p=4; p<=6; ++p)
+    {
+        cem_core::SolverTriangle reference(&element,p,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        cem_core::SolverTriangle numerical(&element,p,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        reference.setUp_matrices(false);
+        numerical.setUp_matrices(true);
+
+        cemINT n = (p+1)*(p+2)/2;
+        cemDOUBLE sum = 0.0;
+        for (cemINT k=0; k<3; ++k)
+        {
+            for (cemINT j=0; j<n; ++j)
+            {
+                for (cemINT i=j; i<n; ++i)
+                {
+                    ASSERT_NEAR(reference.matrix_N_NxNx(k)(i,j),numerical.matrix_N_NxNx(k)(i,j),1.0e-10);
+                    ASSERT_NEAR(reference.matrix_N_NyNy(k)(i,j),numerical.matrix_N_NyNy(k)(i,j),1.0e-10);
+                    ASSERT_NEAR(reference.matrix_N_NN(k)(i,j),numerical.matrix_N_NN(k)(i,j),1.0e-10);
+                    sum += (i == j ? 1.0 : 2.0)*reference.matrix_N_NN(k)(i,j);
+                }
+            }
+        }
+
+        // Basis and coefficient functions are partitions of unity:
+        ASSERT_NEAR(area,sum,1.0e-10);
+    }
+}
+
+
+TEST(SolverTriangle,quadrature_order_limit)
+{
+    Node node1(0.0,0.0,0.0);
+    Node node2(1.0,0.0,0.0);
+    Node node3(0.0,1.0,0.0);
+    std::vector<Node*> node_ptrs(3);
+    node_ptrs[0] = &node1;
+    node_ptrs[1] = &node2;
+    node_ptrs[2] = &node3;
+    Element element;
+    element.set_node_ptrs(node_ptrs);
+
+    // Orders whose matrices need a rule above the highest one (2p+q > 14) are rejected up front:
+    cem_core::TriQuadrature quadrature;
+    ASSERT_EQ(14,quadrature.getMaxPolyOrder());
+    cem_core::SolverTriangle highest(&element,6,cem_core::SCALAR,cem_core::INTERPOLATORY,2);
+    ASSERT_NO_THROW(highest.setUp_matrices(false));
+    ASSERT_THROW(cem_core::SolverTriangle(&element,6,cem_core::SCALAR,cem_core::INTERPOLATORY,3),
+                 cemcommon::Exception);
+
+    cem_core::SolverTriangle hierarchical(&element,2,cem_core::SCALAR,cem_core::HIERARCHICAL,1);
+    hierarchical.setUp_matrices(false);
+    ASSERT_NO_THROW(hierarchical.UpdateBasisFunctionOrder(6));
+    ASSERT_THROW(hierarchical.UpdateBasisFunctionOrder(7),cemcommon::Exception);
+    ASSERT_EQ(6,hierarchical.basis_function_order());
+}
+
+
+TEST(SolverTriangle,setUp_matrices_hierarchical)
+{
+    Node node1(0.0,0.0,0.0);
+    Node node2(2.0,0.3,0.0);
+    Node node3(0.4,1.5,0.0);
+    std::vector<Node*> node_ptrs(3);
+    node_ptrs[0] = &node1;
+    node_ptrs[1] = &node2;
+    node_ptrs[2] = &node3;
+    Element element;
+    element.set_node_ptrs(node_ptrs);
+    cemDOUBLE area = 0.5*(2.0*1.5 - 0.3*0.4);
+    cemDOUBLE x[3] = {0.0, 2.0, 0.4};
+    cemDOUBLE y[3] = {0.0, 0.3, 1.5};
+
+    // Matrices of order p-1 are the leading blocks of the matrices of order p:
+    cem_core::SolverTriangle lower(&element,1,cem_core::SCALAR,cem_core::HIERARCHICAL,1);
+    lower.setUp_matrices(false);
+    for (cemINT p=2; p<=6; ++p)
+    {
+        cem_core::SolverTriangle higher(&element,p,cem_core::SCALAR,cem_core::HIERARCHICAL,1);
+        higher.setUp_matrices(false);
+        cemINT n = p*(p+1)/2;
+        for (cemINT k=0; k<3; ++k)
+        {
+            for (cemINT j=0; j<n; ++j)
+            {
+                for (cemINT i=j; i<n; ++i)
+                {
+                    ASSERT_NEAR(lower.matrix_N_NxNx(k)(i,j),higher.matrix_N_NxNx(k)(i,j),1.0e-12);
+                    ASSERT_NEAR(lower.matrix_N_NyNy(k)(i,j),higher.matrix_N_NyNy(k)(i,j),1.0e-12);
+                    ASSERT_NEAR(lower.matrix_N_NN(k)(i,j),higher.matrix_N_NN(k)(i,j),1.0e-12);
+                }
+            }
+        }
+
+        // Vertex functions reproduce x and y, and coefficient functions add up to one:
+        cemDOUBLE xx = 0.0, yy = 0.0;
+        for (cemINT k=0; k<3; ++k)
+        {
+            for (cemINT a=0; a<3; ++a)
+            {
+                for (cemINT b=0; b<3; ++b)
+                {
+                    xx += x[a]*higher.matrix_N_NxNx(k)(a,b)*x[b];
+                    yy += y[a]*higher.matrix_N_NyNy(k)(a,b)*y[b];
+                }
+            }
+        }
+        ASSERT_NEAR(area,xx,1.0e-12);
+        ASSERT_NEAR(area,yy,1.0e-12);
+
+        lower = higher;
+    }
+
+    // Raising or lowering the order gives the same matrices as setting them up again:
+    cem_core::SolverTriangle updated(&element,2,cem_core::SCALAR,cem_core::HIERARCHICAL,1);
+    updated.setUp_matrices(false);
+    cemINT orders[4] = {4, 5, 3, 1};
+    for (cemINT m=0; m<4; ++m)
+    {
+        cemINT p = orders[m];
+        updated.UpdateBasisFunctionOrder(p);
+        ASSERT_EQ(p,updated.basis_function_order());
+
+        cem_core::SolverTriangle fresh(&element,p,cem_core::SCALAR,cem_core::HIERARCHICAL,1);
+        fresh.setUp_matrices(false);
+        cemINT n = (p+1)*(p+2)/2;
+        for (cemINT k=0; k<3; ++k)
+        {
+            ASSERT_EQ(n,static_cast<cemINT>(updated.matrix_N_GradGrad(k).num_rows()));
+            for (cemINT j=0; j<n; ++j)
+            {
+                for (cemINT i=j; i<n; ++i)
+                {
+                    ASSERT_NEAR(fresh.matrix_N_NxNx(k)(i,j),updated.matrix_N_NxNx(k)(i,j),1.0e-12);
+                    ASSERT_NEAR(fresh.matrix_N_NyNy(k)(i,j),updated.matrix_N_NyNy(k)(i,j),1.0e-12);
+                    ASSERT_NEAR(fresh.matrix_N_NN(k)(i,j),updated.matrix_N_NN(k)(i,j),1.0e-12);
+                    ASSERT_NEAR(fresh.matrix_N_GradGrad(k)(i,j),updated.matrix_N_GradGrad(k)(i,j),
+                                1.0e-12);
+                }
+            }
+        }
+    }
+
+    ASSERT_THROW(updated.UpdateBasisFunctionOrder(0),cemcommon::Exception);
+}
+
+
+TEST(SolverTriangle,UpdateBasisFunctionOrder_curvilinear)
+{
+    // Second-order triangle with a curved edge between nodes 1 and 2:
+    Node nodes[6] = {Node(0.0,0.0,0.0), Node(1.0,0.0,0.0), Node(0.0,1.0,0.0),
+                     Node(0.5,0.0,0.0), Node(0.6,0.6,0.0), Node(0.0,0.5,0.0)};
+    std::vector<Node*> node_ptrs(6);
+    for (cemINT a=0; a<6; ++a)
+        node_ptrs[a] = &nodes[a];
+    Element curved(Element::TRI,2);
+    curved.set_node_ptrs(node_ptrs);
+
+    // Integrands are rational, so the leading blocks depend on the rule: raising or lowering the
+    // order must give the matrices of a fresh set up at the new order, not reuse the old rows:
+    cem_core::SolverTriangle updated(&curved,2,cem_core::SCALAR,cem_core::HIERARCHICAL,1);
+    updated.setUp_matrices(false);
+    cemINT orders[3] = {4, 5, 3};
+    for (cemINT m=0; m<3; ++m)
+    {
+        cemINT p = orders[m];
+        updated.UpdateBasisFunctionOrder(p);
+
+        cem_core::SolverTriangle fresh(&curved,p,cem_core::SCALAR,cem_core::HIERARCHICAL,1);
+        fresh.setUp_matrices(false);
+        cemINT n = (p+1)*(p+2)/2;
+        for (cemINT k=0; k<3; ++k)
+        {
+            ASSERT_EQ(n,static_cast<cemINT>(updated.matrix_N_NN(k).num_rows()));
+            for (cemINT e=0; e<n*(n+1)/2; ++e)
+            {
+                ASSERT_EQ((&fresh.matrix_N_NxNx(k)(0,0))[e],(&updated.matrix_N_NxNx(k)(0,0))[e]);
+                ASSERT_EQ((&fresh.matrix_N_NyNy(k)(0,0))[e],(&updated.matrix_N_NyNy(k)(0,0))[e]);
+                ASSERT_EQ((&fresh.matrix_N_NN(k)(0,0))[e],(&updated.matrix_N_NN(k)(0,0))[e]);
+            }
+        }
+    }
+}
+
+
+TEST(SolverTriangle,setUp_matrices_curvilinear)
+{
+    // Second-order triangle with a curved edge between nodes 1 and 2:
+    Node nodes[6] = {Node(0.0,0.0,0.0), Node(1.0,0.0,0.0), Node(0.0,1.0,0.0),
+                     Node(0.5,0.0,0.0), Node(0.6,0.6,0.0), Node(0.0,0.5,0.0)};
+    std::vector<Node*> node_ptrs(6);
+    for (cemINT a=0; a<6; ++a)
+        node_ptrs[a] = &nodes[a];
+    Element curved(Element::TRI,2);
+    curved.set_node_ptrs(node_ptrs);
+
+    cem_core::SolverTriangle solver_element(&curved,2,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+    solver_element.setUp_matrices(false);
+    const cem_math::SymmetricMatrix<cemDOUBLE>& N_NxNx = solver_element.matrix_N_NxNx(0);
+    const cem_math::SymmetricMatrix<cemDOUBLE>& N_NyNy = solver_element.matrix_N_NyNy(0);
+    const cem_math::SymmetricMatrix<cemDOUBLE>& N_NN = solver_element.matrix_N_NN(0);
+
+    // Area under the parabolic edge:
+    cemDOUBLE area = 0.5 + 2.0/3.0*0.2;
+    cemDOUBLE sum = 0.0;
+    for (cemINT i=0; i<6; ++i)
+    {
+        for (cemINT j=0; j<6; ++j)
+            sum += N_NN(i,j);
+    }
+    ASSERT_NEAR(area,sum,1.0e-12);
+
+    // Isoparametric basis functions reproduce u=x and u=y exactly:
+    cemDOUBLE x_Kx_x = 0.0, x_Ky_x = 0.0, y_Ky_y = 0.0;
+    for (cemINT i=0; i<6; ++i)
+    {
+        cemDOUBLE row_sum = 0.0;
+        for (cemINT j=0; j<6; ++j)
+        {
+            x_Kx_x += nodes[i][0]*N_NxNx(i,j)*nodes[j][0];
+            x_Ky_x += nodes[i][0]*N_NyNy(i,j)*nodes[j][0];
+            y_Ky_y += nodes[i][1]*N_NyNy(i,j)*nodes[j][1];
+            row_sum += N_NxNx(i,j);
+        }
+        ASSERT_NEAR(0.0,row_sum,1.0e-12);
+    }
+    ASSERT_NEAR(area,x_Kx_x,1.0e-12);
+    ASSERT_NEAR(0.0,x_Ky_x,1.0e-12);
+    ASSERT_NEAR(area,y_Ky_y,1.0e-12);
+
+    // Straight edges: same matrices as the flat triangle:
+    nodes[4].set_coordinates(0.5,0.5,0.0);
+    Element flat;
+    node_ptrs.resize(3);
+    flat.set_node_ptrs(node_ptrs);
+    cem_core::SolverTriangle straight_element(&curved,3,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    cem_core::SolverTriangle flat_element(&flat,3,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    straight_element.setUp_matrices(false);
+    flat_element.setUp_matrices(false);
+    for (cemINT k=0; k<3; ++k)
+    {
+        for (cemINT m=0; m<55; ++m)
+        {
+            ASSERT_DOUBLE_EQ((&flat_element.matrix_N_NxNx(k)(0,0))[m],(&straight_element.matrix_N_NxNx(k)(0,0))[m]);
+            ASSERT_DOUBLE_EQ((&flat_element.matrix_N_NN(k)(0,0))[m],(&straight_element.matrix_N_NN(k)(0,0))[m]);
+        }
+    }
+
+    // One setUp_matrix_* call integrates every family of a curved triangle, and later calls reuse
+    // them until the orders change:
+    nodes[4].set_coordinates(0.6,0.6,0.0);
+    cem_core::SolverTriangle all_element(&curved,3,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    cem_core::SolverTriangle single_element(&curved,3,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    all_element.setUp_matrices(false);
+    single_element.setUp_matrix_N_NxNx(false);
+    ASSERT_EQ(10,static_cast<cemINT>(single_element.matrix_N_NN(2).num_rows()));
+    single_element.setUp_matrix_N_NyNy(false);
+    single_element.setUp_matrix_N_NN(false);
+    for (cemINT k=0; k<3; ++k)
+    {
+        for (cemINT m=0; m<55; ++m)
+        {
+            ASSERT_EQ((&all_element.matrix_N_NxNx(k)(0,0))[m],(&single_element.matrix_N_NxNx(k)(0,0))[m]);
+            ASSERT_EQ((&all_element.matrix_N_NyNy(k)(0,0))[m],(&single_element.matrix_N_NyNy(k)(0,0))[m]);
+            ASSERT_EQ((&all_element.matrix_N_NN(k)(0,0))[m],(&single_element.matrix_N_NN(k)(0,0))[m]);
+        }
+    }
+    single_element.set_coefficient_order(0);
+    single_element.setUp_matrix_N_NN(false);
+    ASSERT_EQ(1,single_element.num_coefficient_functions());
+    sum = 0.0;
+    for (cemINT i=0; i<10; ++i)
+    {
+        for (cemINT j=0; j<10; ++j)
+            sum += single_element.matrix_N_NN(0)(i,j);
+    }
+    ASSERT_NEAR(area,sum,1.0e-12);
+
+    // The extra order of curvilinear rules is clamped to the highest rule (2p+q <= 14):
+    ASSERT_EQ(2,cem_core::TriTabulation::Get(5,1,2).extra_order());
+    ASSERT_EQ(1,cem_core::TriTabulation::Get(6,1,2).extra_order());
+    ASSERT_EQ(0,cem_core::TriTabulation::Get(6,2,2).extra_order());
+
+    // Third-order geometry is not supported:
+    Element cubic(Element::TRI,3);
+    cem_core::SolverTriangle cubic_element(&cubic,1,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+    ASSERT_THROW(cubic_element.setUp_matrices(false),cemcommon::Exception);
+}
+
+
+TEST(SolverTriangle,setUp_matrices_3D)
+{
+    // Flat and curvilinear triangles in the XY plane:
+    cemDOUBLE xy[6][2] = {{0.0,0.0}, {2.0,0.3}, {0.4,1.5}, {1.0,0.0}, {1.3,1.0}, {0.2,0.75}};
+    std::vector<Node> flat_nodes(6),rotated_nodes(6);
+
+    // Same triangles after a rotation about (1,1,1) and a translation:
+    cemDOUBLE c = cos(0.7), s = sin(0.7), t = 1.0 - cos(0.7), r = 1.0/sqrt(3.0);
+    cemDOUBLE R[3][3] = {{t*r*r + c, t*r*r - s*r, t*r*r + s*r},
+                         {t*r*r + s*r, t*r*r + c, t*r*r - s*r},
+                         {t*r*r - s*r, t*r*r + s*r, t*r*r + c}};
+    for (cemINT a=0; a<6; ++a)
+    {
+        flat_nodes[a].set_coordinates(xy[a][0],xy[a][1],0.0);
+        rotated_nodes[a].set_coordinates(R[0][0]*xy[a][0] + R[0][1]*xy[a][1] + 0.1,
+                                         R[1][0]*xy[a][0] + R[1][1]*xy[a][1] - 0.2,
+                                         R[2][0]*xy[a][0] + R[2][1]*xy[a][1] + 0.3);
+    }
+
+    for (cemINT order=1; order<=2; ++order)
+    {
+        cemINT num_nodes = (order == 1) ? 3 : 6;
+        std::vector<Node*> flat_ptrs(num_nodes),rotated_ptrs(num_nodes);
+        for (cemINT a=0; a<num_nodes; ++a)
+        {
+            flat_ptrs[a] = &flat_nodes[a];
+            rotated_ptrs[a] = &rotated_nodes[a];
+        }
+        Element flat(Element::TRI,order), rotated(Element::TRI,order);
+        flat.set_node_ptrs(flat_ptrs);
+        rotated.set_node_ptrs(rotated_ptrs);
+
+        cem_core::SolverTriangle flat_element(&flat,2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        cem_core::SolverTriangle rotated_element(&rotated,2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        flat_element.setUp_matrices(false);
+        rotated_element.setUp_matrices(false);
+        for (cemINT k=0; k<3; ++k)
+        {
+            for (cemINT m=0; m<21; ++m)
+            {
+                ASSERT_NEAR((&flat_element.matrix_N_GradGrad(k)(0,0))[m],
+                            (&rotated_element.matrix_N_GradGrad(k)(0,0))[m],1.0e-12);
+                ASSERT_NEAR((&flat_element.matrix_N_NN(k)(0,0))[m],
+                            (&rotated_element.matrix_N_NN(k)(0,0))[m],1.0e-12);
+            }
+        }
+    }
+
+    // Edge nodes out of the plane of the vertices:
+    rotated_nodes[4].set_coordinates(1.3,1.0,5.0);
+    std::vector<Node*> rotated_ptrs(6);
+    for (cemINT a=0; a<6; ++a)
+        rotated_ptrs[a] = &rotated_nodes[a];
+    Element warped(Element::TRI,2);
+    warped.set_node_ptrs(rotated_ptrs);
+    cem_core::SolverTriangle warped_element(&warped,2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    ASSERT_THROW(warped_element.setUp_matrices(false),cemcommon::Exception);
+}
+
+
+//************************************************************************************************//
+/** @brief CheckContractMatrices : Compares the contracted matrices of an element with the sum of
+ * its matrices of each coefficient function.
+ * @param [in] element : element with matrices already set up */
+//************************************************************************************************//
+static void CheckContractMatrices(cem_core::SolverElement& element)
+{
+    cemINT m = element.num_coefficient_functions();
+    std::vector<cemDOUBLE> beta(m);
+    for (cemINT k=0; k<m; ++k)
+        beta[k] = 1.0 + 0.25*k*k - 0.1*k;
+
+    cem_math::SymmetricMatrix<cemDOUBLE> N_NxNx,N_NyNy,N_NN,N_GradGrad;
+    element.ContractMatrices(beta,&N_NxNx,&N_NyNy,&N_NN,&N_GradGrad);
+
+    cemINT n = element.matrix_N_NN(0).num_rows();
+    ASSERT_EQ(n,static_cast<cemINT>(N_GradGrad.num_rows()));
+    for (cemINT j=0; j<n; ++j)
+    {
+        for (cemINT i=j; i<n; ++i)
+        {
+            cemDOUBLE K_x = 0.0, K_y = 0.0, M = 0.0, K = 0.0;
+            for (cemINT k=0; k<m; ++k)
+            {
+                K_x += beta[k]*element.matrix_N_NxNx(k)(i,j);
+                K_y += beta[k]*element.matrix_N_NyNy(k)(i,j);
+                M += beta[k]*element.matrix_N_NN(k)(i,j);
+                K += beta[k]*element.matrix_N_GradGrad(k)(i,j);
+            }
+            ASSERT_NEAR(K_x,N_NxNx(i,j),1.0e-12);
+            ASSERT_NEAR(K_y,N_NyNy(i,j),1.0e-12);
+            ASSERT_NEAR(M,N_NN(i,j),1.0e-12);
+            ASSERT_NEAR(K,N_GradGrad(i,j),1.0e-12);
+        }
+    }
+
+    // Families that are not needed can be skipped:
+    cem_math::SymmetricMatrix<cemDOUBLE> only_mass;
+    element.ContractMatrices(beta,NULL,NULL,&only_mass,NULL);
+    for (cemINT j=0; j<n; ++j)
+    {
+        for (cemINT i=j; i<n; ++i)
+            ASSERT_DOUBLE_EQ(N_NN(i,j),only_mass(i,j));
+    }
+
+    beta.push_back(1.0);
+    ASSERT_THROW(element.ContractMatrices(beta,&N_NxNx,NULL,NULL,NULL),cemcommon::Exception);
+}
+
+
+TEST(SolverTriangle,ContractMatrices)
+{
+    Node node1(0.0,0.0,0.0);
+    Node node2(2.0,0.3,0.0);
+    Node node3(0.4,1.5,0.0);
+    std::vector<Node*> node_ptrs(3);
+    node_ptrs[0] = &node1;
+    node_ptrs[1] = &node2;
+    node_ptrs[2] = &node3;
+    Element element;
+    element.set_node_ptrs(node_ptrs);
+
+    // Flat triangles, from the reference tensors:
+    for (cemINT p=1; p<=4; ++p)
+    {
+        for (cemINT q=0; q<=2; ++q)
+        {
+            cem_core::SolverTriangle flat(&element,p,cem_core::SCALAR,cem_core::INTERPOLATORY,q);
+            flat.setUp_matrices(false);
+            CheckContractMatrices(flat);
+        }
+    }
+
+    // Hierarchical functions, numerically:
+    cem_core::SolverTriangle hierarchical(&element,3,cem_core::SCALAR,cem_core::HIERARCHICAL,2);
+    hierarchical.setUp_matrices(false);
+    CheckContractMatrices(hierarchical);
+
+    // Curvilinear triangle, numerically:
+    Node nodes[6] = {Node(0.0,0.0,0.0), Node(1.0,0.0,0.0), Node(0.0,1.0,0.0),
+                     Node(0.5,0.0,0.0), Node(0.6,0.6,0.0), Node(0.0,0.5,0.0)};
+    std::vector<Node*> curved_ptrs(6);
+    for (cemINT a=0; a<6; ++a)
+        curved_ptrs[a] = &nodes[a];
+    Element curved(Element::TRI,2);
+    curved.set_node_ptrs(curved_ptrs);
+    cem_core::SolverTriangle curvilinear(&curved,2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    curvilinear.setUp_matrices(false);
+    CheckContractMatrices(curvilinear);
+
+    // Quadrangles, before sum factorization:
+    Node corners[4] = {Node(0.0,0.0,0.0), Node(2.0,0.3,0.0), Node(1.7,1.4,0.0), Node(0.2,1.1,0.0)};
+    std::vector<Node*> quad_ptrs(4);
+    for (cemINT a=0; a<4; ++a)
+        quad_ptrs[a] = &corners[a];
+    Element quad(Element::QUAD,1);
+    quad.set_node_ptrs(quad_ptrs);
+    cem_core::SolverQuadrangle quadrangle(&quad,2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    quadrangle.setUp_matrices(false);
+    CheckContractMatrices(quadrangle);
+
+    // Solids, at each quadrature point:
+    Node apexes[6] = {Node(0.0,0.0,0.0), Node(1.2,0.1,0.0), Node(0.3,0.9,0.0),
+                      Node(0.2,0.1,1.5), Node(1.4,0.2,1.8), Node(0.6,1.0,1.5)};
+    std::vector<Node*> solid_ptrs(6);
+    for (cemINT a=0; a<6; ++a)
+        solid_ptrs[a] = &apexes[a];
+    Element prism(Element::PRISM,1);
+    prism.set_node_ptrs(solid_ptrs);
+    cem_core::SolverPrism solid_prism(&prism,2,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    solid_prism.setUp_matrices(false);
+    CheckContractMatrices(solid_prism);
+
+    solid_ptrs.resize(4);
+    Element tet(Element::TET,1);
+    tet.set_node_ptrs(solid_ptrs);
+    cem_core::SolverTetrahedron tetrahedron(&tet,3,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+    tetrahedron.setUp_matrices(false);
+    CheckContractMatrices(tetrahedron);
+}
+
+
+TEST(TriMatrixFreeOperator,Apply)
+{
+    // Skewed grid of 3x3 cells, two triangles per cell (more triangles than LANES):
+    cemINT num_cells = 3;
+    cemINT num_triangles = 2*num_cells*num_cells;
+    std::vector<Node> nodes((num_cells+1)*(num_cells+1));
+    for (cemINT j=0; j<=num_cells; ++j)
+        for (cemINT i=0; i<=num_cells; ++i)
+            nodes[j*(num_cells+1) + i].set_coordinates(0.5*i + 0.1*j,0.4*j + 0.05*i*i,0.0);
+
+    std::vector<Element> elements(num_triangles);
+    std::vector<cemDOUBLE> x1(num_triangles),y1(num_triangles),x2(num_triangles);
+    std::vector<cemDOUBLE> y2(num_triangles),x3(num_triangles),y3(num_triangles);
+    std::vector<cemINT> vertices(3*num_triangles);
+    std::vector<Node*> node_ptrs(3);
+    for (cemINT j=0; j<num_cells; ++j)
+    {
+        for (cemINT i=0; i<num_cells; ++i)
+        {
+            cemINT n0 = j*(num_cells+1) + i;
+            cemINT corners[2][3] = {{n0, n0+1, n0+num_cells+2}, {n0, n0+num_cells+2, n0+num_cells+1}};
+            for (cemINT h=0; h<2; ++h)
+            {
+                cemINT t = 2*(j*num_cells + i) + h;
+                for (cemINT v=0; v<3; ++v)
+                {
+                    node_ptrs[v] = &nodes[corners[h][v]];
+                    vertices[3*t + v] = corners[h][v];
+                }
+                elements[t].set_node_ptrs(node_ptrs);
+                x1[t] = nodes[corners[h][0]][0]; y1[t] = nodes[corners[h][0]][1];
+                x2[t] = nodes[corners[h][1]][0]; y2[t] = nodes[corners[h][1]][1];
+                x3[t] = nodes[corners[h][2]][0]; y3[t] = nodes[corners[h][2]][1];
+            }
+        }
+    }
+
+    srand(7);
+    for (cemINT p=1; p<=3; ++p)
+    {
+        cemINT q = 1;
+        cemINT n = (p+1)*(p+2)/2;
+        cemINT m = (q+1)*(q+2)/2;
+
+        // Vertices are shared; any other function gets its own dof:
+        std::vector<cemINT> dofs(n*num_triangles);
+        cemINT num_dofs = static_cast<cemINT>(nodes.size());
+        for (cemINT t=0; t<num_triangles; ++t)
+        {
+            for (cemINT i=0; i<n; ++i)
+                dofs[t*n + i] = i < 3 ? vertices[3*t + i] : num_dofs++;
+        }
+
+        std::vector<cemDOUBLE> alpha(m*num_triangles),beta(m*num_triangles);
+        for (cemINT k=0; k<m*num_triangles; ++k)
+        {
+            alpha[k] = 1.0 + static_cast<cemDOUBLE>(rand())/RAND_MAX;
+            beta[k] = static_cast<cemDOUBLE>(rand())/RAND_MAX;
+        }
+
+        cem_core::TriMatrixFreeOperator matrix_free(p,q);
+        matrix_free.SetUp(num_triangles,&x1[0],&y1[0],&x2[0],&y2[0],&x3[0],&y3[0],
+                          &dofs[0],&alpha[0],&beta[0]);
+        ASSERT_EQ(num_dofs,matrix_free.num_dofs());
+
+        // Assemble the same operator from the element matrices:
+        std::vector<cemDOUBLE> K(num_dofs*num_dofs,0.0);
+        for (cemINT t=0; t<num_triangles; ++t)
+        {
+            cem_core::SolverTriangle solver_element(&elements[t],p,cem_core::SCALAR,cem_core::INTERPOLATORY,q);
+            solver_element.setUp_matrices(false);
+            for (cemINT k=0; k<m; ++k)
+            {
+                for (cemINT j=0; j<n; ++j)
+                {
+                    for (cemINT i=0; i<n; ++i)
+                    {
+                        K[dofs[t*n + i]*num_dofs + dofs[t*n + j]] +=
+                                alpha[t*m + k]*solver_element.matrix_N_GradGrad(k)(i,j) +
+                                beta[t*m + k]*solver_element.matrix_N_NN(k)(i,j);
+                    }
+                }
+            }
+        }
+
+        std::vector<cemDOUBLE> x(num_dofs),y(num_dofs),diagonal(num_dofs);
+        for (cemINT d=0; d<num_dofs; ++d)
+        {
+            x[d] = static_cast<cemDOUBLE>(rand())/RAND_MAX - 0.5;
+            y[d] = 1.0;
+        }
+        matrix_free.Apply(&x[0],&y[0]);
+        matrix_free.GetDiagonal(&diagonal[0]);
+        for (cemINT r=0; r<num_dofs; ++r)
+        {
+            cemDOUBLE expected = 1.0;
+            for (cemINT c=0; c<num_dofs; ++c)
+                expected += K[r*num_dofs + c]*x[c];
+            ASSERT_NEAR(expected,y[r],1.0e-12);
+            ASSERT_NEAR(K[r*num_dofs + r],diagonal[r],1.0e-12);
+        }
+
+        // Without mass coefficients only the stiffness part is applied:
+        matrix_free.SetUp(num_triangles,&x1[0],&y1[0],&x2[0],&y2[0],&x3[0],&y3[0],
+                          &dofs[0],&alpha[0],NULL);
+        std::vector<cemDOUBLE> ones(num_dofs,1.0);
+        std::vector<cemDOUBLE> K_ones(num_dofs,0.0);
+        matrix_free.Apply(&ones[0],&K_ones[0]);
+        for (cemINT d=0; d<num_dofs; ++d)
+        {
+            if (d < static_cast<cemINT>(nodes.size()) || p == 1)
+                ASSERT_NEAR(0.0,K_ones[d],1.0e-12);
+        }
+    }
+}
+
+
+TEST(TriMatrixFreeOperator,ClockwiseTriangle)
+{
+    // Two counterclockwise triangles and a clockwise one, sharing vertices:
+    Node nodes[4] = {Node(0.0,0.0,0.0), Node(1.0,0.1,0.0), Node(0.2,0.9,0.0), Node(1.1,1.2,0.0)};
+    cemINT num_triangles = 3;
+    cemINT corners[3][3] = {{0,1,2}, {2,1,3}, {3,1,0}};
+
+    cemINT p = 2, q = 1;
+    cemINT n = (p+1)*(p+2)/2;
+    cemINT m = (q+1)*(q+2)/2;
+    std::vector<Element> elements(num_triangles);
+    std::vector<cemDOUBLE> x1(num_triangles),y1(num_triangles),x2(num_triangles);
+    std::vector<cemDOUBLE> y2(num_triangles),x3(num_triangles),y3(num_triangles);
+    std::vector<cemINT> dofs(n*num_triangles);
+    std::vector<Node*> node_ptrs(3);
+    cemINT num_dofs = 4;
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        for (cemINT v=0; v<3; ++v)
+            node_ptrs[v] = &nodes[corners[t][v]];
+        elements[t].set_node_ptrs(node_ptrs);
+        x1[t] = nodes[corners[t][0]][0]; y1[t] = nodes[corners[t][0]][1];
+        x2[t] = nodes[corners[t][1]][0]; y2[t] = nodes[corners[t][1]][1];
+        x3[t] = nodes[corners[t][2]][0]; y3[t] = nodes[corners[t][2]][1];
+        for (cemINT i=0; i<n; ++i)
+            dofs[t*n + i] = i < 3 ? corners[t][i] : num_dofs++;
+    }
+    ASSERT_LT((x2[2] - x1[2])*(y3[2] - y1[2]) - (y2[2] - y1[2])*(x3[2] - x1[2]),0.0);
+
+    srand(11);
+    std::vector<cemDOUBLE> alpha(m*num_triangles),beta(m*num_triangles);
+    for (cemINT k=0; k<m*num_triangles; ++k)
+    {
+        alpha[k] = 1.0 + static_cast<cemDOUBLE>(rand())/RAND_MAX;
+        beta[k] = static_cast<cemDOUBLE>(rand())/RAND_MAX;
+    }
+
+    // Matrix-vector product with the matrix assembled from SolverTriangle:
+    std::vector<cemDOUBLE> x(num_dofs),expected(num_dofs,0.0),y(num_dofs,0.0);
+    for (cemINT d=0; d<num_dofs; ++d)
+        x[d] = static_cast<cemDOUBLE>(rand())/RAND_MAX - 0.5;
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        cem_core::SolverTriangle solver_element(&elements[t],p,cem_core::SCALAR,cem_core::INTERPOLATORY,q);
+        solver_element.setUp_matrices(false);
+        for (cemINT k=0; k<m; ++k)
+            for (cemINT j=0; j<n; ++j)
+                for (cemINT i=0; i<n; ++i)
+                    expected[dofs[t*n + i]] += (alpha[t*m + k]*solver_element.matrix_N_GradGrad(k)(i,j) +
+                                                beta[t*m + k]*solver_element.matrix_N_NN(k)(i,j))*x[dofs[t*n + j]];
+    }
+
+    cem_core::TriMatrixFreeOperator matrix_free(p,q);
+    matrix_free.SetUp(num_triangles,&x1[0],&y1[0],&x2[0],&y2[0],&x3[0],&y3[0],
+                      &dofs[0],&alpha[0],&beta[0]);
+    matrix_free.Apply(&x[0],&y[0]);
+    for (cemINT r=0; r<num_dofs; ++r)
+        ASSERT_NEAR(expected[r],y[r],1.0e-12);
+}
+
+
+TEST(SparseAssembler,AssembleTriangleMesh)
+{
+    // Grid of 3x2 cells, two quadratic triangles per cell:
+    cemINT nx = 3, ny = 2, p = 2, n = 6;
+    cemINT num_triangles = 2*nx*ny;
+    std::vector<Node> nodes((nx+1)*(ny+1));
+    for (cemINT j=0; j<=ny; ++j)
+        for (cemINT i=0; i<=nx; ++i)
+            nodes[j*(nx+1) + i].set_coordinates(0.5*i + 0.1*j,0.4*j + 0.05*i*i,0.0);
+
+    // Vertices are shared (node 0 is fixed); any other function gets its own dof:
+    std::vector<Element> elements(num_triangles);
+    std::vector<cemINT> element_offsets(num_triangles+1,0);
+    std::vector<cemINT> element_dofs(n*num_triangles);
+    std::vector<Node*> node_ptrs(3);
+    cemINT num_dofs = static_cast<cemINT>(nodes.size()) - 1;
+    for (cemINT j=0; j<ny; ++j)
+    {
+        for (cemINT i=0; i<nx; ++i)
+        {
+            cemINT n0 = j*(nx+1) + i;
+            cemINT corners[2][3] = {{n0, n0+1, n0+nx+2}, {n0, n0+nx+2, n0+nx+1}};
+            for (cemINT h=0; h<2; ++h)
+            {
+                cemINT t = 2*(j*nx + i) + h;
+                for (cemINT v=0; v<3; ++v)
+                    node_ptrs[v] = &nodes[corners[h][v]];
+                elements[t].set_node_ptrs(node_ptrs);
+                element_offsets[t+1] = element_offsets[t] + n;
+                for (cemINT k=0; k<n; ++k)
+                    element_dofs[t*n + k] = k < 3 ? corners[h][k] - 1 : num_dofs++;
+            }
+        }
+    }
+
+    cem_core::SparseAssembler assembler;
+    assembler.SetUpPattern(num_dofs,element_offsets,element_dofs);
+    ASSERT_EQ(num_dofs,assembler.num_dofs());
+    ASSERT_EQ(num_triangles,assembler.num_elements());
+
+    SparseMatrix<cemDOUBLE> K;
+    assembler.SetUpMatrix(K);
+    ASSERT_EQ(num_dofs,static_cast<cemINT>(K.num_rows()));
+    ASSERT_EQ(assembler.num_entries(),K.num_entries());
+
+    std::vector<SymmetricMatrix<cemDOUBLE> > local(num_triangles);
+    DenseMatrix<cemDOUBLE> K_dense(num_dofs,num_dofs);
+    K_dense.initialize();
+    std::vector<cemDOUBLE> b(num_dofs,0.0),b_expected(num_dofs,0.0),local_b(n);
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        cem_core::SolverTriangle solver_element(&elements[t],p,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+        solver_element.setUp_matrices(false);
+        local[t] = solver_element.matrix_N_GradGrad(0);
+        local[t] += solver_element.matrix_N_NN(0);
+
+        std::vector<cemINT> indices(element_dofs.begin() + t*n,element_dofs.begin() + (t+1)*n);
+        local[t].scatter_add(indices,K_dense);
+        assembler.AddElementMatrix(t,local[t],K);
+
+        for (cemINT k=0; k<n; ++k)
+        {
+            local_b[k] = 1.0 + k + t;
+            if (indices[k] >= 0)
+                b_expected[indices[k]] += local_b[k];
+        }
+        assembler.AddElementVector(t,&local_b[0],&b[0]);
+    }
+
+    // Columns are sorted and unique, and the pattern holds every nonzero of the dense matrix:
+    const SparseMatrix<cemDOUBLE>& K_const = K;
+    const cemINT8* row_offsets = K.row_offsets();
+    const cemINT* columns = K.column_indices();
+    for (cemINT r=0; r<num_dofs; ++r)
+    {
+        for (cemINT8 k=row_offsets[r]+1; k<row_offsets[r+1]; ++k)
+            ASSERT_LT(columns[k-1],columns[k]);
+
+        for (cemINT c=0; c<num_dofs; ++c)
+        {
+            ASSERT_NEAR(K_dense(r,c),K_const(r,c),1.0e-13);
+            if (K_dense(r,c) != 0.0)
+                ASSERT_GE(K.find(r,c),0);
+        }
+        ASSERT_DOUBLE_EQ(b_expected[r],b[r]);
+    }
+
+    // Functions that are not vertices only couple with their own triangle:
+    ASSERT_EQ(n,row_offsets[num_dofs] - row_offsets[num_dofs-1]);
+
+    // Reassembly through the same slots gives the same values:
+    std::vector<cemDOUBLE> values(K.values(),K.values() + K.num_entries());
+    K.initialize();
+    for (cemINT t=0; t<num_triangles; ++t)
+        assembler.AddElementMatrix(t,local[t],K);
+    for (cemINT8 k=0; k<K.num_entries(); ++k)
+        ASSERT_EQ(values[k],K.values()[k]);
+
+    SymmetricMatrix<cemDOUBLE> wrong_size(3,3);
+    ASSERT_THROW(assembler.AddElementMatrix(0,wrong_size,K),cemcommon::Exception);
+    ASSERT_THROW(assembler.AddElementMatrix(num_triangles,local[0],K),cemcommon::Exception);
+}
+
+
+//************************************************************************************************//
+/** @brief CreateGridConnectivity : Connectivity of a grid of nx*ny cells with two triangles per
+ * cell and n functions per triangle; vertices are shared and any other function gets its own dof.
+ * @return : number of degrees of freedom */
+//************************************************************************************************//
+static cemINT CreateGridConnectivity(const cemINT& nx,
+                                     const cemINT& ny,
+                                     const cemINT& n,
+                                     std::vector<cemINT>& element_offsets,
+                                     std::vector<cemINT>& element_dofs)
+{
+    cemINT num_triangles = 2*nx*ny;
+    element_offsets.assign(num_triangles+1,0);
+    element_dofs.resize(n*num_triangles);
+    cemINT num_dofs = (nx+1)*(ny+1);
+    for (cemINT j=0; j<ny; ++j)
+    {
+        for (cemINT i=0; i<nx; ++i)
+        {
+            cemINT n0 = j*(nx+1) + i;
+            cemINT corners[2][3] = {{n0, n0+1, n0+nx+2}, {n0, n0+nx+2, n0+nx+1}};
+            for (cemINT h=0; h<2; ++h)
+            {
+                cemINT t = 2*(j*nx + i) + h;
+                element_offsets[t+1] = element_offsets[t] + n;
+                for (cemINT k=0; k<n; ++k)
+                    element_dofs[t*n + k] = k < 3 ? corners[h][k] : num_dofs++;
+            }
+        }
+    }
+
+    return num_dofs;
+}
+
+
+//************************************************************************************************//
+/** @brief CreateUnstructuredConnectivity : Connectivity of a grid of nx*ny cells cut along a random
+ * diagonal, with elements and dofs in random order (as a mesh generator leaves them on a board:
+ * irregular vertex valences and no locality in the numbering).
+ * @param [in] nx,ny : number of cells in x and y
+ * @param [in] n : basis functions per triangle (3 vertex dofs, the rest not shared)
+ * @param [in] seed : seed of rand()
+ * @param [out] element_offsets : 2*nx*ny+1 offsets
+ * @param [out] element_dofs : n dofs per triangle
+ * @return : number of dofs */
+//************************************************************************************************//
+static cemINT CreateUnstructuredConnectivity(const cemINT& nx,
+                                             const cemINT& ny,
+                                             const cemINT& n,
+                                             const cemINT& seed,
+                                             std::vector<cemINT>& element_offsets,
+                                             std::vector<cemINT>& element_dofs)
+{
+    srand(seed);
+    cemINT num_triangles = 2*nx*ny;
+    std::vector<cemINT> cell_dofs(n*num_triangles);
+    cemINT num_dofs = (nx+1)*(ny+1);
+    for (cemINT j=0; j<ny; ++j)
+    {
+        for (cemINT i=0; i<nx; ++i)
+        {
+            cemINT n0 = j*(nx+1) + i;
+            cemINT corners[2][2][3] = {{{n0, n0+1, n0+nx+2}, {n0, n0+nx+2, n0+nx+1}},
+                                       {{n0, n0+1, n0+nx+1}, {n0+1, n0+nx+2, n0+nx+1}}};
+            cemINT diagonal = rand()%2;
+            for (cemINT h=0; h<2; ++h)
+            {
+                cemINT t = 2*(j*nx + i) + h;
+                for (cemINT k=0; k<n; ++k)
+                    cell_dofs[t*n + k] = k < 3 ? corners[diagonal][h][k] : num_dofs++;
+            }
+        }
+    }
+
+    // Random order of the elements and labels of the dofs:
+    std::vector<cemINT> element_order(num_triangles),labels(num_dofs);
+    for (cemINT t=0; t<num_triangles; ++t)
+        element_order[t] = t;
+    for (cemINT d=0; d<num_dofs; ++d)
+        labels[d] = d;
+    for (cemINT t=num_triangles-1; t>0; --t)
+        std::swap(element_order[t],element_order[rand()%(t+1)]);
+    for (cemINT d=num_dofs-1; d>0; --d)
+        std::swap(labels[d],labels[rand()%(d+1)]);
+
+    element_offsets.assign(num_triangles+1,0);
+    element_dofs.resize(n*num_triangles);
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        element_offsets[t+1] = element_offsets[t] + n;
+        for (cemINT k=0; k<n; ++k)
+            element_dofs[t*n + k] = labels[cell_dofs[element_order[t]*n + k]];
+    }
+
+    return num_dofs;
+}
+
+
+TEST(SparseAssembler,ParallelAssembly)
+{
+    cemINT n = 6;
+    std::vector<cemINT> element_offsets,element_dofs;
+    cemINT num_dofs = CreateGridConnectivity(7,5,n,element_offsets,element_dofs);
+    cemINT num_triangles = static_cast<cemINT>(element_offsets.size()) - 1;
+
+    cem_core::SparseAssembler assembler;
+    assembler.SetUpPattern(num_dofs,element_offsets,element_dofs);
+
+    // Colors cover every element once, and elements of a color do not share dofs:
+    const std::vector<cemINT>& color_offsets = assembler.color_offsets();
+    const std::vector<cemINT>& color_elements = assembler.color_elements();
+    ASSERT_GT(assembler.num_colors(),1);
+    ASSERT_LE(assembler.num_colors(),12);
+    ASSERT_EQ(num_triangles,color_offsets[assembler.num_colors()]);
+    std::vector<cemINT> count(num_triangles,0);
+    for (cemINT c=0; c<assembler.num_colors(); ++c)
+    {
+        std::vector<bool> used(num_dofs,false);
+        for (cemINT k=color_offsets[c]; k<color_offsets[c+1]; ++k)
+        {
+            cemINT e = color_elements[k];
+            ++count[e];
+            for (cemINT l=element_offsets[e]; l<element_offsets[e+1]; ++l)
+            {
+                ASSERT_FALSE(used[element_dofs[l]]);
+                used[element_dofs[l]] = true;
+            }
+        }
+    }
+    for (cemINT e=0; e<num_triangles; ++e)
+        ASSERT_EQ(1,count[e]);
+
+    srand(11);
+    std::vector<SymmetricMatrix<cemDOUBLE> > local(num_triangles,SymmetricMatrix<cemDOUBLE>(n,n));
+    for (cemINT e=0; e<num_triangles; ++e)
+    {
+        for (cemINT j=0; j<n; ++j)
+            for (cemINT i=j; i<n; ++i)
+                local[e](i,j) = static_cast<cemDOUBLE>(rand())/RAND_MAX - 0.5;
+    }
+
+    SparseMatrix<cemDOUBLE> K_serial,K_colored,K_reduction;
+    assembler.SetUpMatrix(K_serial);
+    assembler.SetUpMatrix(K_colored);
+    assembler.SetUpMatrix(K_reduction);
+    for (cemINT e=0; e<num_triangles; ++e)
+        assembler.AddElementMatrix(e,local[e],K_serial);
+
+    // Assemble twice to check that the thread buffers are cleared:
+    for (cemINT pass=0; pass<2; ++pass)
+    {
+        K_colored.initialize();
+        K_reduction.initialize();
+        assembler.Assemble(local,K_colored,cem_core::SparseAssembler::COLORED);
+        assembler.Assemble(local,K_reduction,cem_core::SparseAssembler::THREAD_REDUCTION);
+        for (cemINT8 k=0; k<K_serial.num_entries(); ++k)
+        {
+            ASSERT_NEAR(K_serial.values()[k],K_colored.values()[k],1.0e-14);
+            ASSERT_NEAR(K_serial.values()[k],K_reduction.values()[k],1.0e-14);
+        }
+    }
+
+    local.pop_back();
+    ASSERT_THROW(assembler.Assemble(local,K_colored),cemcommon::Exception);
+}
+
+
+TEST(SparseAssembler,ThreadReductionBuffers)
+{
+    cemINT n = 3;
+    std::vector<cemINT> grid_offsets,grid_dofs;
+    cemINT num_dofs = CreateGridConnectivity(9,6,n,grid_offsets,grid_dofs);
+    cemINT num_triangles = static_cast<cemINT>(grid_offsets.size()) - 1;
+
+    // Shuffle the elements, so every range of elements spreads over the whole grid:
+    std::vector<cemINT> order(num_triangles);
+    for (cemINT e=0; e<num_triangles; ++e)
+        order[e] = (7*e) % num_triangles;
+    std::vector<cemINT> element_offsets(1,0),element_dofs;
+    for (cemINT e=0; e<num_triangles; ++e)
+    {
+        element_dofs.insert(element_dofs.end(),grid_dofs.begin() + grid_offsets[order[e]],
+                            grid_dofs.begin() + grid_offsets[order[e]+1]);
+        element_offsets.push_back(static_cast<cemINT>(element_dofs.size()));
+    }
+
+    cem_core::SparseAssembler assembler;
+    assembler.SetUpPattern(num_dofs,element_offsets,element_dofs);
+    ASSERT_EQ(0,assembler.num_buffer_values());
+
+    srand(13);
+    std::vector<SymmetricMatrix<cemDOUBLE> > local(num_triangles,SymmetricMatrix<cemDOUBLE>(n,n));
+    for (cemINT e=0; e<num_triangles; ++e)
+    {
+        for (cemINT j=0; j<n; ++j)
+            for (cemINT i=j; i<n; ++i)
+                local[e](i,j) = static_cast<cemDOUBLE>(rand())/RAND_MAX - 0.5;
+    }
+
+    SparseMatrix<cemDOUBLE> K_serial,K_reduction;
+    assembler.SetUpMatrix(K_serial);
+    assembler.SetUpMatrix(K_reduction);
+    for (cemINT e=0; e<num_triangles; ++e)
+        assembler.AddElementMatrix(e,local[e],K_serial);
+
+    cemINT max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    for (cemINT num_threads=1; num_threads<=3; ++num_threads)
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(num_threads);
+#endif
+        K_reduction.initialize();
+        assembler.Assemble(local,K_reduction,cem_core::SparseAssembler::THREAD_REDUCTION);
+        for (cemINT8 k=0; k<K_serial.num_entries(); ++k)
+            ASSERT_NEAR(K_serial.values()[k],K_reduction.values()[k],1.0e-14);
+
+        // Entries touched by the range of elements of each thread:
+        cemINT threads_used = 1;
+#ifdef _OPENMP
+        threads_used = num_threads;
+#endif
+        cemINT8 num_touched = 0;
+        for (cemINT t=0; t<threads_used; ++t)
+        {
+            std::set< std::pair<cemINT,cemINT> > touched;
+            for (cemINT e=t*num_triangles/threads_used; e<(t+1)*num_triangles/threads_used; ++e)
+                for (cemINT i=element_offsets[e]; i<element_offsets[e+1]; ++i)
+                    for (cemINT j=element_offsets[e]; j<element_offsets[e+1]; ++j)
+                        if (element_dofs[i] >= 0 && element_dofs[j] >= 0)
+                            touched.insert(std::make_pair(element_dofs[i],element_dofs[j]));
+            num_touched += static_cast<cemINT8>(touched.size());
+        }
+        ASSERT_EQ(num_touched,assembler.num_buffer_values());
+        ASSERT_LT(assembler.num_buffer_values(),threads_used*K_serial.num_entries() + 1);
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif
+}
+
+
+//************************************************************************************************//
+/** @brief CreateGridMesh : Skewed grid of nx*ny cells with two triangles per cell, numbered as in
+ * CreateGridConnectivity.
+ * @param [out] nodes : (nx+1)*(ny+1) nodes (must not be resized afterwards)
+ * @param [out] elements : 2*nx*ny triangles */
+//************************************************************************************************//
+static void CreateGridMesh(const cemINT& nx,
+                           const cemINT& ny,
+                           std::vector<Node>& nodes,
+                           std::vector<Element>& elements)
+{
+    nodes.resize((nx+1)*(ny+1));
+    for (cemINT j=0; j<=ny; ++j)
+        for (cemINT i=0; i<=nx; ++i)
+            nodes[j*(nx+1) + i].set_coordinates(0.5*i + 0.1*j,0.4*j + 0.05*i*i,0.0);
+
+    elements.resize(2*nx*ny);
+    std::vector<Node*> node_ptrs(3);
+    for (cemINT j=0; j<ny; ++j)
+    {
+        for (cemINT i=0; i<nx; ++i)
+        {
+            cemINT n0 = j*(nx+1) + i;
+            cemINT corners[2][3] = {{n0, n0+1, n0+nx+2}, {n0, n0+nx+2, n0+nx+1}};
+            for (cemINT h=0; h<2; ++h)
+            {
+                for (cemINT v=0; v<3; ++v)
+                    node_ptrs[v] = &nodes[corners[h][v]];
+                elements[2*(j*nx + i) + h].set_node_ptrs(node_ptrs);
+            }
+        }
+    }
+}
+
+
+TEST(SparseSystem,AssembleWithNewCoefficients)
+{
+    cemINT nx = 4, ny = 3, p = 2, q = 1, n = 6, m = 3;
+    std::vector<Node> nodes;
+    std::vector<Element> elements;
+    CreateGridMesh(nx,ny,nodes,elements);
+    std::vector<cemINT> element_offsets,element_dofs;
+    cemINT num_dofs = CreateGridConnectivity(nx,ny,n,element_offsets,element_dofs);
+    cemINT num_triangles = static_cast<cemINT>(elements.size());
+
+    std::vector<cem_core::SolverTriangle> triangles;
+    triangles.reserve(num_triangles);
+    std::vector<cem_core::SolverElement*> solver_elements(num_triangles);
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        triangles.push_back(cem_core::SolverTriangle(&elements[t],p,cem_core::SCALAR,cem_core::INTERPOLATORY,q));
+        solver_elements[t] = &triangles[t];
+    }
+
+    cem_core::SparseSystem system;
+    system.SetUp(num_dofs,solver_elements,element_offsets,element_dofs);
+    ASSERT_EQ(num_dofs,system.num_dofs());
+    ASSERT_EQ(m,system.num_coefficients(0));
+    const cemINT* columns = system.matrix().column_indices();
+    const cemDOUBLE* values = system.matrix().values();
+
+    srand(5);
+    std::vector<cemDOUBLE> alpha(m*num_triangles),beta(m*num_triangles),no_mass;
+    for (cemINT iteration=0; iteration<3; ++iteration)
+    {
+        // New conductivity (and mass term on the second iteration only):
+        for (cemINT k=0; k<m*num_triangles; ++k)
+        {
+            alpha[k] = 1.0 + static_cast<cemDOUBLE>(rand())/RAND_MAX;
+            beta[k] = static_cast<cemDOUBLE>(rand())/RAND_MAX;
+        }
+        const std::vector<cemDOUBLE>& mass = iteration == 1 ? beta : no_mass;
+        system.Assemble(alpha,mass);
+        ASSERT_EQ(iteration+1,system.num_assemblies());
+
+        // Same pattern and storage on every iteration:
+        ASSERT_EQ(columns,system.matrix().column_indices());
+        ASSERT_EQ(values,system.matrix().values());
+
+        DenseMatrix<cemDOUBLE> K(num_dofs,num_dofs);
+        K.initialize();
+        for (cemINT t=0; t<num_triangles; ++t)
+        {
+            std::vector<cemINT> indices(element_dofs.begin() + t*n,element_dofs.begin() + (t+1)*n);
+            triangles[t].setUp_matrices(false);
+            for (cemINT k=0; k<m; ++k)
+            {
+                SymmetricMatrix<cemDOUBLE> local = triangles[t].matrix_N_GradGrad(k);
+                local.multiply_by_scalar(alpha[t*m + k]);
+                local.scatter_add(indices,K);
+                if (iteration == 1)
+                {
+                    local = triangles[t].matrix_N_NN(k);
+                    local.multiply_by_scalar(beta[t*m + k]);
+                    local.scatter_add(indices,K);
+                }
+            }
+        }
+
+        for (cemINT r=0; r<num_dofs; ++r)
+            for (cemINT c=0; c<num_dofs; ++c)
+                ASSERT_NEAR(K(r,c),system.matrix()(r,c),1.0e-12);
+    }
+
+    alpha.pop_back();
+    ASSERT_THROW(system.Assemble(alpha,no_mass),cemcommon::Exception);
+}
+
+
+TEST(SparseSystem,BadElementThrows)
+{
+    cemINT nx = 3, ny = 2, p = 2, q = 1, n = 6, m = 3;
+    std::vector<Node> nodes;
+    std::vector<Element> elements;
+    CreateGridMesh(nx,ny,nodes,elements);
+    std::vector<cemINT> element_offsets,element_dofs;
+    cemINT num_dofs = CreateGridConnectivity(nx,ny,n,element_offsets,element_dofs);
+    cemINT num_triangles = static_cast<cemINT>(elements.size());
+
+    std::vector<cem_core::SolverTriangle> triangles;
+    triangles.reserve(num_triangles);
+    std::vector<cem_core::SolverElement*> solver_elements(num_triangles);
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        triangles.push_back(cem_core::SolverTriangle(&elements[t],p,cem_core::SCALAR,cem_core::INTERPOLATORY,q));
+        solver_elements[t] = &triangles[t];
+    }
+
+    cem_core::SparseSystem system;
+    system.SetUp(num_dofs,solver_elements,element_offsets,element_dofs);
+    std::vector<cemDOUBLE> alpha(m*num_triangles,1.0),no_mass;
+    system.Assemble(alpha,no_mass);
+
+    // Degenerate, tilted triangle (its three nodes on a line out of the X-Y plane):
+    std::vector<Node> line(3);
+    for (cemINT v=0; v<3; ++v)
+        line[v].set_coordinates(1.0*v,0.5*v,0.25*v);
+    std::vector<Node*> node_ptrs(3);
+    for (cemINT v=0; v<3; ++v)
+        node_ptrs[v] = &line[v];
+    Element degenerate;
+    degenerate.set_node_ptrs(node_ptrs);
+    triangles[4].set_element_ptr(&degenerate);
+    ASSERT_THROW(system.Assemble(alpha,no_mass),cemcommon::Exception);
+
+    // Still usable once the element is fixed:
+    triangles[4].set_element_ptr(&elements[4]);
+    system.Assemble(alpha,no_mass);
+    ASSERT_EQ(2,system.num_assemblies());
+}
+
+
+TEST(SparseSystem,FirstAssemblyInParallel)
+{
+    // Orders not used by other tests, so the first assembly fills the shared caches:
+    cemINT nx = 4, ny = 4, p = 4, q = 3, n = 15, m = 10;
+    std::vector<Node> nodes;
+    std::vector<Element> elements;
+    CreateGridMesh(nx,ny,nodes,elements);
+    std::vector<cemINT> element_offsets,element_dofs;
+    cemINT num_dofs = CreateGridConnectivity(nx,ny,n,element_offsets,element_dofs);
+    cemINT num_triangles = static_cast<cemINT>(elements.size());
+
+    // Interpolatory and hierarchical elements mixed in the same system:
+    std::vector<cem_core::SolverTriangle> triangles;
+    triangles.reserve(num_triangles);
+    std::vector<cem_core::SolverElement*> solver_elements(num_triangles);
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        cem_core::BasisFunctionType type = t%2 == 0 ? cem_core::INTERPOLATORY : cem_core::HIERARCHICAL;
+        triangles.push_back(cem_core::SolverTriangle(&elements[t],p,cem_core::SCALAR,type,q));
+        solver_elements[t] = &triangles[t];
+    }
+
+    cemINT max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+#endif
+    cem_core::SparseSystem system;
+    system.SetUp(num_dofs,solver_elements,element_offsets,element_dofs);
+    ASSERT_EQ(m,system.num_coefficients(0));
+
+    srand(9);
+    std::vector<cemDOUBLE> alpha(m*num_triangles),no_mass;
+    for (cemINT k=0; k<m*num_triangles; ++k)
+        alpha[k] = 1.0 + static_cast<cemDOUBLE>(rand())/RAND_MAX;
+    system.Assemble(alpha,no_mass);
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif
+
+    DenseMatrix<cemDOUBLE> K(num_dofs,num_dofs);
+    K.initialize();
+    for (cemINT t=0; t<num_triangles; ++t)
+    {
+        std::vector<cemINT> indices(element_dofs.begin() + t*n,element_dofs.begin() + (t+1)*n);
+        triangles[t].setUp_matrices(false);
+        for (cemINT k=0; k<m; ++k)
+        {
+            SymmetricMatrix<cemDOUBLE> local = triangles[t].matrix_N_GradGrad(k);
+            local.multiply_by_scalar(alpha[t*m + k]);
+            local.scatter_add(indices,K);
+        }
+    }
+
+    for (cemINT r=0; r<num_dofs; ++r)
+        for (cemINT c=0; c<num_dofs; ++c)
+            ASSERT_NEAR(K(r,c),system.matrix()(r,c),1.0e-10);
+}
+
+
+TEST(SparseSystem,HierarchicalEdgeOrientation)
+{
+    // Triangles ABC and CBD share edge BC, which they run in opposite directions; D is the mirror
+    // image of A across BC, so a function that is continuous across BC gets the same
+    // contribution from both triangles:
+    cemINT p = 3, n = 10, num_dofs = 16;
+    cemDOUBLE bx = 1.0, by = 0.1, cx = 0.2, cy = 0.9;
+    cemDOUBLE tx = (cx - bx)/std::sqrt((cx-bx)*(cx-bx) + (cy-by)*(cy-by));
+    cemDOUBLE ty = (cy - by)/std::sqrt((cx-bx)*(cx-bx) + (cy-by)*(cy-by));
+    cemDOUBLE projection = -(bx*tx + by*ty);
+    cemDOUBLE dx = 2.0*(bx + projection*tx);
+    cemDOUBLE dy = 2.0*(by + projection*ty);
+    Node nodes[4] = {Node(0.0,0.0,0.0), Node(bx,by,0.0), Node(cx,cy,0.0), Node(dx,dy,0.0)};
+    for (cemINT v=0; v<4; ++v)
+        nodes[v].set_node_id(v);
+    cemINT vertices[2][3] = {{0,1,2}, {2,1,3}};
+
+    // Dofs: vertices, then two functions (degrees 2 and 3) per edge AB, BC, CA, BD, CD, then one
+    // interior function per triangle:
+    cemINT edge_of[4][4] = {{-1,0,2,-1}, {0,-1,1,3}, {2,1,-1,4}, {-1,3,4,-1}};
+    std::vector<Element> elements(2);
+    std::vector<cemINT> element_dofs(2*n);
+    std::vector<cem_core::SolverTriangle> triangles(2);
+    cemDOUBLE x1[2],y1[2],x2[2],y2[2],x3[2],y3[2];
+    for (cemINT t=0; t<2; ++t)
+    {
+        std::vector<Node*> node_ptrs(3);
+        for (cemINT v=0; v<3; ++v)
+        {
+            cemINT a = vertices[t][v];
+            cemINT b = vertices[t][(v+1)%3];
+            node_ptrs[v] = &nodes[a];
+            element_dofs[t*n + v] = a;
+            element_dofs[t*n + 3 + v] = 4 + 2*edge_of[a][b];
+            element_dofs[t*n + 6 + v] = 4 + 2*edge_of[a][b] + 1;
+        }
+        element_dofs[t*n + 9] = 14 + t;
+        elements[t].set_node_ptrs(node_ptrs);
+        triangles[t] = cem_core::SolverTriangle(&elements[t],p,cem_core::SCALAR,cem_core::HIERARCHICAL,0);
+
+        x1[t] = nodes[vertices[t][0]][0]; y1[t] = nodes[vertices[t][0]][1];
+        x2[t] = nodes[vertices[t][1]][0]; y2[t] = nodes[vertices[t][1]][1];
+        x3[t] = nodes[vertices[t][2]][0]; y3[t] = nodes[vertices[t][2]][1];
+    }
+
+    // Both triangles, and triangle ABC alone (same dofs):
+    std::vector<cemDOUBLE> alpha(2,1.0),beta(2,0.5);
+    std::vector<cem_core::SolverElement*> solver_elements(2);
+    solver_elements[0] = &triangles[0];
+    solver_elements[1] = &triangles[1];
+    std::vector<cemINT> element_offsets(3,0);
+    element_offsets[1] = n;
+    element_offsets[2] = 2*n;
+    cem_core::SparseSystem system;
+    system.SetUp(num_dofs,solver_elements,element_offsets,element_dofs);
+    system.Assemble(alpha,beta);
+
+    solver_elements.pop_back();
+    element_offsets.pop_back();
+    std::vector<cemINT> first_dofs(element_dofs.begin(),element_dofs.begin() + n);
+    std::vector<cemDOUBLE> first_alpha(1,1.0),first_beta(1,0.5);
+    cem_core::SparseSystem first;
+    first.SetUp(num_dofs,solver_elements,element_offsets,first_dofs);
+    first.Assemble(first_alpha,first_beta);
+
+    // Vertices B and C, and the functions of degree 2 and 3 of edge BC:
+    cemINT shared[4] = {1, 2, 6, 7};
+    for (cemINT i=0; i<4; ++i)
+        for (cemINT j=0; j<4; ++j)
+            ASSERT_NEAR(system.matrix()(shared[i],shared[j]),
+                        2.0*first.matrix()(shared[i],shared[j]),1.0e-12);
+    ASSERT_GT(std::fabs(first.matrix()(7,1)),1.0e-3);
+
+    // The matrix-free operator orients edges by vertex dofs, which here follow the node ids:
+    cem_core::TriMatrixFreeOperator matrix_free(p,0,cem_core::HIERARCHICAL);
+    matrix_free.SetUp(2,x1,y1,x2,y2,x3,y3,&element_dofs[0],&alpha[0],&beta[0]);
+    for (cemINT j=0; j<num_dofs; ++j)
+    {
+        std::vector<cemDOUBLE> e_j(num_dofs,0.0),column(num_dofs,0.0);
+        e_j[j] = 1.0;
+        matrix_free.Apply(&e_j[0],&column[0]);
+        for (cemINT i=0; i<num_dofs; ++i)
+            ASSERT_NEAR(system.matrix()(i,j),column[i],1.0e-12);
+    }
+}
+
+
+TEST(SolverQuadrangle,GetShapeFunctionIndices)
+{
+    // Quadrangle9 of cemMesh.h:
+    cemINT expected[9][2] = {{0,0}, {2,0}, {2,2}, {0,2}, {1,0}, {2,1}, {1,2}, {0,1}, {1,1}};
+    for (cemINT m=0; m<9; ++m)
+    {
+        cemINT index_u,index_v;
+        cem_core::SolverQuadrangle::GetShapeFunctionIndices(2,m,index_u,index_v);
+        ASSERT_EQ(index_u,expected[m][0]);
+        ASSERT_EQ(index_v,expected[m][1]);
+    }
+
+    // Every (u,v) pair appears exactly once:
+    for (cemINT order=1; order<=6; ++order)
+    {
+        cemINT n = (order+1)*(order+1);
+        std::vector<cemINT> count(n,0);
+        for (cemINT m=0; m<n; ++m)
+        {
+            cemINT index_u,index_v;
+            cem_core::SolverQuadrangle::GetShapeFunctionIndices(order,m,index_u,index_v);
+            count[index_u*(order+1) + index_v] += 1;
+        }
+        for (cemINT m=0; m<n; ++m)
+            ASSERT_EQ(count[m],1);
+    }
+
+    cemINT index_u,index_v;
+    ASSERT_THROW(cem_core::SolverQuadrangle::GetShapeFunctionIndices(2,9,index_u,index_v),
+                 cemcommon::Exception);
+}
+
+
+TEST(SolverQuadrangle,setUp_matrices_unit_square)
+{
+    Node n1(0.0,0.0,0.0), n2(1.0,0.0,0.0), n3(1.0,1.0,0.0), n4(0.0,1.0,0.0);
+    std::vector<Node*> node_ptrs(4);
+    node_ptrs[0] = &n1;
+    node_ptrs[1] = &n2;
+    node_ptrs[2] = &n3;
+    node_ptrs[3] = &n4;
+    Element square(Element::QUAD,1);
+    square.set_node_ptrs(node_ptrs);
+
+    cem_core::SolverQuadrangle element(&square,1,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+    element.setUp_matrices(false);
+
+    // Bilinear stiffness and mass matrices of the unit square:
+    for (cemINT i=0; i<4; ++i)
+    {
+        for (cemINT j=0; j<4; ++j)
+        {
+            cemINT distance = (i-j+4)%4;
+            cemDOUBLE stiffness = (distance == 0) ? 2.0/3.0 : (distance == 2) ? -1.0/3.0 : -1.0/6.0;
+            cemDOUBLE mass = (distance == 0) ? 1.0/9.0 : (distance == 2) ? 1.0/36.0 : 1.0/18.0;
+            ASSERT_NEAR(element.matrix_N_GradGrad(0)(i,j),stiffness,1.0e-14);
+            ASSERT_NEAR(element.matrix_N_NN(0)(i,j),mass,1.0e-14);
+        }
+    }
+
+    // One setUp_matrix_* call integrates every family, later calls reuse them:
+    cem_core::SolverQuadrangle single(&square,1,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+    single.setUp_matrix_N_NN(false);
+    ASSERT_EQ(4,static_cast<cemINT>(single.matrix_N_GradGrad(0).num_rows()));
+    single.setUp_matrix_N_NxNx(false);
+    single.setUp_matrix_N_NyNy(false);
+    for (cemINT m=0; m<10; ++m)
+    {
+        ASSERT_EQ((&element.matrix_N_NxNx(0)(0,0))[m],(&single.matrix_N_NxNx(0)(0,0))[m]);
+        ASSERT_EQ((&element.matrix_N_NyNy(0)(0,0))[m],(&single.matrix_N_NyNy(0)(0,0))[m]);
+        ASSERT_EQ((&element.matrix_N_NN(0)(0,0))[m],(&single.matrix_N_NN(0)(0,0))[m]);
+    }
+    single.set_basis_function_order(2);
+    single.setUp_matrix_N_NxNx(false);
+    ASSERT_EQ(9,static_cast<cemINT>(single.matrix_N_NN(0).num_rows()));
+
+    Element triangle(Element::TRI,1);
+    ASSERT_THROW(cem_core::SolverQuadrangle(&triangle,1,cem_core::SCALAR,cem_core::INTERPOLATORY,0),
+                 cemcommon::Exception);
+}
+
+
+TEST(SolverQuadrangle,setUp_matrices_bilinear)
+{
+    // A convex quadrangle that is not a parallelogram:
+    cemDOUBLE x[4] = {0.0, 2.0, 1.7, 0.2};
+    cemDOUBLE y[4] = {0.0, 0.3, 1.4, 1.1};
+    std::vector<Node> nodes(4);
+    std::vector<Node*> node_ptrs(4);
+    for (cemINT a=0; a<4; ++a)
+    {
+        nodes[a].set_coordinates(x[a],y[a],0.5);
+        node_ptrs[a] = &nodes[a];
+    }
+    Element quad(Element::QUAD,1);
+    quad.set_node_ptrs(node_ptrs);
+    cemDOUBLE area = 0.5*((x[0]*y[1] - x[1]*y[0]) + (x[1]*y[2] - x[2]*y[1]) +
+                          (x[2]*y[3] - x[3]*y[2]) + (x[3]*y[0] - x[0]*y[3]));
+
+    for (cemINT p=1; p<=4; ++p)
+    {
+        cem_core::SolverQuadrangle element(&quad,p,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        element.setUp_matrices(false);
+        ASSERT_EQ(element.num_coefficient_functions(),4);
+
+        // Coordinates of the nodes of the basis functions (x and y are in the space of order p):
+        cemINT n = (p+1)*(p+1);
+        std::vector<cemDOUBLE> node_x(n),node_y(n);
+        for (cemINT i=0; i<n; ++i)
+        {
+            cemINT index_u,index_v;
+            cem_core::SolverQuadrangle::GetShapeFunctionIndices(p,i,index_u,index_v);
+            cemDOUBLE u = -1.0 + 2.0*index_u/p, v = -1.0 + 2.0*index_v/p;
+            cemDOUBLE L[4] = {0.25*(1.0-u)*(1.0-v), 0.25*(1.0+u)*(1.0-v),
+                              0.25*(1.0+u)*(1.0+v), 0.25*(1.0-u)*(1.0+v)};
+            node_x[i] = L[0]*x[0] + L[1]*x[1] + L[2]*x[2] + L[3]*x[3];
+            node_y[i] = L[0]*y[0] + L[1]*y[1] + L[2]*y[2] + L[3]*y[3];
+        }
+
+        // Coefficient functions add up to 1, so the sum over k is the plain matrix:
+        cemDOUBLE mass = 0.0, xx = 0.0, yx = 0.0, xy = 0.0;
+        std::vector<cemDOUBLE> row_sum(n,0.0);
+        for (cemINT k=0; k<4; ++k)
+        {
+            for (cemINT i=0; i<n; ++i)
+            {
+                for (cemINT j=0; j<n; ++j)
+                {
+                    mass += element.matrix_N_NN(k)(i,j);
+                    xx += node_x[i]*element.matrix_N_NxNx(k)(i,j)*node_x[j];
+                    yx += node_y[i]*element.matrix_N_NxNx(k)(i,j)*node_y[j];
+                    xy += node_x[i]*element.matrix_N_NyNy(k)(i,j)*node_x[j];
+                    row_sum[i] += element.matrix_N_GradGrad(k)(i,j);
+                }
+            }
+        }
+        ASSERT_NEAR(mass,area,1.0e-12);
+        ASSERT_NEAR(xx,area,1.0e-10);
+        ASSERT_NEAR(yx,0.0,1.0e-10);
+        ASSERT_NEAR(xy,0.0,1.0e-10);
+        for (cemINT i=0; i<n; ++i)
+            ASSERT_NEAR(row_sum[i],0.0,1.0e-10);
+    }
+}
+
+
+TEST(SolverTetrahedron,setUp_matrices_linear)
+{
+    Node n1(0.0,0.0,0.0), n2(1.0,0.0,0.0), n3(0.0,1.0,0.0), n4(0.0,0.0,1.0);
+    std::vector<Node*> node_ptrs(4);
+    node_ptrs[0] = &n1;
+    node_ptrs[1] = &n2;
+    node_ptrs[2] = &n3;
+    node_ptrs[3] = &n4;
+    Element tet(Element::TET,1);
+    tet.set_node_ptrs(node_ptrs);
+
+    cem_core::SolverTetrahedron element(&tet,1,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+    element.setUp_matrices(false);
+
+    // Gradients of the barycentric coordinates, and volume 1/6:
+    cemDOUBLE gradients[4][3] = {{-1.0,-1.0,-1.0}, {1.0,0.0,0.0}, {0.0,1.0,0.0}, {0.0,0.0,1.0}};
+    for (cemINT i=0; i<4; ++i)
+    {
+        for (cemINT j=0; j<4; ++j)
+        {
+            cemDOUBLE mass = (i == j) ? 1.0/60.0 : 1.0/120.0;
+            ASSERT_NEAR(element.matrix_N_NxNx(0)(i,j),gradients[i][0]*gradients[j][0]/6.0,1.0e-14);
+            ASSERT_NEAR(element.matrix_N_NyNy(0)(i,j),gradients[i][1]*gradients[j][1]/6.0,1.0e-14);
+            ASSERT_NEAR(element.matrix_N_NzNz(0)(i,j),gradients[i][2]*gradients[j][2]/6.0,1.0e-14);
+            ASSERT_NEAR(element.matrix_N_NN(0)(i,j),mass,1.0e-14);
+        }
+    }
+
+    ASSERT_THROW(cem_core::SolverTetrahedron(&tet,4,cem_core::SCALAR,cem_core::INTERPOLATORY,0),
+                 cemcommon::Exception);
+    Element prism(Element::PRISM,1);
+    ASSERT_THROW(cem_core::SolverTetrahedron(&prism,1,cem_core::SCALAR,cem_core::INTERPOLATORY,0),
+                 cemcommon::Exception);
+}
+
+
+// Checks volume, reproduction of x, y and z, and zero row sums of N_GradGrad. node_xyz holds the
+// coordinates of the node of each basis function:
+static void CheckSolidElement(const cem_core::SolverSolidElement& element,
+                              const std::vector< std::vector<cemDOUBLE> >& node_xyz,
+                              const cemDOUBLE& volume)
+{
+    cemINT n = node_xyz.size();
+    cemDOUBLE mass = 0.0;
+    cemDOUBLE derivs[3][3] = {{0.0,0.0,0.0}, {0.0,0.0,0.0}, {0.0,0.0,0.0}};
+    std::vector<cemDOUBLE> row_sum(n,0.0);
+    for (cemINT k=0; k<element.num_coefficient_functions(); ++k)
+    {
+        const SymmetricMatrix<cemDOUBLE>* matrices[3] = {&element.matrix_N_NxNx(k),
+                                                        &element.matrix_N_NyNy(k),
+                                                        &element.matrix_N_NzNz(k)};
+        for (cemINT i=0; i<n; ++i)
+        {
+            for (cemINT j=0; j<n; ++j)
+            {
+                mass += element.matrix_N_NN(k)(i,j);
+                row_sum[i] += element.matrix_N_GradGrad(k)(i,j);
+                for (cemINT d=0; d<3; ++d)
+                {
+                    for (cemINT c=0; c<3; ++c)
+                        derivs[d][c] += node_xyz[i][c]*(*matrices[d])(i,j)*node_xyz[j][c];
+                }
+            }
+        }
+    }
+
+    ASSERT_NEAR(mass,volume,1.0e-12);
+    for (cemINT d=0; d<3; ++d)
+    {
+        for (cemINT c=0; c<3; ++c)
+            ASSERT_NEAR(derivs[d][c],(c == d) ? volume : 0.0,1.0e-10);
+    }
+    for (cemINT i=0; i<n; ++i)
+        ASSERT_NEAR(row_sum[i],0.0,1.0e-10);
+}
+
+
+TEST(SolverTetrahedron,setUp_matrices_high_order)
+{
+    cemDOUBLE xyz[4][3] = {{0.1,0.0,-0.2}, {1.3,0.2,0.1}, {0.3,1.1,0.0}, {0.4,0.3,0.9}};
+    std::vector<Node> nodes(4);
+    std::vector<Node*> node_ptrs(4);
+    for (cemINT a=0; a<4; ++a)
+    {
+        nodes[a].set_coordinates(xyz[a][0],xyz[a][1],xyz[a][2]);
+        node_ptrs[a] = &nodes[a];
+    }
+    Element tet(Element::TET,1);
+    tet.set_node_ptrs(node_ptrs);
+
+    cemDOUBLE e[3][3];
+    for (cemINT r=0; r<3; ++r)
+    {
+        for (cemINT c=0; c<3; ++c)
+            e[r][c] = xyz[r+1][c] - xyz[0][c];
+    }
+    cemDOUBLE volume = (e[0][0]*(e[1][1]*e[2][2] - e[1][2]*e[2][1]) -
+                        e[0][1]*(e[1][0]*e[2][2] - e[1][2]*e[2][0]) +
+                        e[0][2]*(e[1][0]*e[2][1] - e[1][1]*e[2][0]))/6.0;
+
+    for (cemINT p=1; p<=3; ++p)
+    {
+        cem_core::SolverTetrahedron element(&tet,p,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+        element.setUp_matrices(false);
+        ASSERT_EQ(element.num_coefficient_functions(),4);
+
+        cemINT n = (p+1)*(p+2)*(p+3)/6;
+        std::vector< std::vector<cemDOUBLE> > node_xyz(n,std::vector<cemDOUBLE>(3,0.0));
+        for (cemINT i=0; i<n; ++i)
+        {
+            cemINT ijkl[4];
+            cem_core::SolverTetrahedron::GetShapeFunctionIndices(p,i,ijkl[0],ijkl[1],ijkl[2],ijkl[3]);
+            ASSERT_EQ(ijkl[0]+ijkl[1]+ijkl[2]+ijkl[3],p);
+            for (cemINT a=0; a<4; ++a)
+            {
+                for (cemINT c=0; c<3; ++c)
+                    node_xyz[i][c] += xyz[a][c]*ijkl[a]/p;
+            }
+        }
+        CheckSolidElement(element,node_xyz,volume);
+    }
+}
+
+
+TEST(SolverPrism,setUp_matrices)
+{
+    // A slanted prism (affine), and one whose top is not parallel to its bottom:
+    cemDOUBLE xyz[6][3] = {{0.0,0.0,0.0}, {1.2,0.1,0.0}, {0.3,0.9,0.0},
+                           {0.2,0.1,1.5}, {1.4,0.2,1.5}, {0.5,1.0,1.5}};
+    cemDOUBLE area = 0.5*(1.2*0.9 - 0.1*0.3);
+    for (cemINT geometry=0; geometry<2; ++geometry)
+    {
+        if (geometry == 1)
+        {
+            xyz[4][2] = 1.8;
+            xyz[5][0] = 0.6;
+        }
+
+        std::vector<Node> nodes(6);
+        std::vector<Node*> node_ptrs(6);
+        for (cemINT a=0; a<6; ++a)
+        {
+            nodes[a].set_coordinates(xyz[a][0],xyz[a][1],xyz[a][2]);
+            node_ptrs[a] = &nodes[a];
+        }
+        Element prism(Element::PRISM,1);
+        prism.set_node_ptrs(node_ptrs);
+
+        cemDOUBLE volume = 0.0;
+        for (cemINT p=1; p<=2; ++p)
+        {
+            cem_core::SolverPrism element(&prism,p,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+            element.setUp_matrices(false);
+            ASSERT_EQ(element.num_coefficient_functions(),6);
+
+            // Volume of the non-affine prism comes from its linear element:
+            if (p == 1)
+            {
+                for (cemINT k=0; k<6; ++k)
+                {
+                    for (cemINT i=0; i<6; ++i)
+                    {
+                        for (cemINT j=0; j<6; ++j)
+                            volume += element.matrix_N_NN(k)(i,j);
+                    }
+                }
+                if (geometry == 0)
+                    ASSERT_NEAR(volume,1.5*area,1.0e-12);
+            }
+
+            cemINT n = (p+1)*(p+1)*(p+2)/2;
+            std::vector< std::vector<cemDOUBLE> > node_xyz(n,std::vector<cemDOUBLE>(3,0.0));
+            for (cemINT m=0; m<n; ++m)
+            {
+                cemINT triangle_index,line_index,ijk[3];
+                cem_core::SolverPrism::GetShapeFunctionIndices(p,m,triangle_index,line_index);
+                cem_core::SolverTriangle::GetShapeFunctionIndices(p,triangle_index,ijk[0],ijk[1],ijk[2]);
+                cemDOUBLE height = static_cast<cemDOUBLE>(line_index)/p;
+                for (cemINT a=0; a<3; ++a)
+                {
+                    for (cemINT c=0; c<3; ++c)
+                        node_xyz[m][c] += ijk[a]*((1.0-height)*xyz[a][c] + height*xyz[a+3][c])/p;
+                }
+            }
+            CheckSolidElement(element,node_xyz,volume);
+        }
+    }
+
+    Node node;
+    std::vector<Node*> node_ptrs(6,&node);
+    Element flat(Element::PRISM,1);
+    flat.set_node_ptrs(node_ptrs);
+    cem_core::SolverPrism element(&flat,1,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+    ASSERT_THROW(element.setUp_matrices(false),cemcommon::Exception);
+}
+
+
+int TestSolverElementBasics()
+{
+    // Create single element:
+    Element test_element;
+    CreateSingleElement(test_element);
+    cem_core::SolverTriangle solver_element(&test_element,3,cem_core::SCALAR,cem_core::INTERPOLATORY,1);
+
+    DenseMatrix<cemDOUBLE> K_analytic,K_numeric;
+
+    std::ofstream file_analytic;
+    file_analytic.open("K_analytic.out",std::ofstream::out);
+    file_analytic.precision(15);
+
+    solver_element.setUp_matrix_N_NxNx(false);
+    K_analytic = solver_element.matrix_N_NxNx(2);
+    K_analytic.WriteToFileByColumns(file_analytic);
+
+    std::ofstream file_numeric;
+    file_numeric.open("K_numeric.out",std::ofstream::out);
+    file_numeric.precision(15);
+
+    solver_element.setUp_matrix_N_NxNx(true);
+    K_numeric = solver_element.matrix_N_NxNx(2);
+    K_numeric.WriteToFileByColumns(file_numeric);
+
+    return 0;
+}
+
+
+int TestSolverElementBatchBenchmark()
+{
+    // Structured grid of right triangles:
+    cemINT num_cells = 300;
+    cemINT num_triangles = 2*num_cells*num_cells;
+    std::vector<Node> nodes((num_cells+1)*(num_cells+1));
+    for (cemINT j=0; j<=num_cells; ++j)
+        for (cemINT i=0; i<=num_cells; ++i)
+            nodes[j*(num_cells+1) + i].set_coordinates(i*1.0e-3,j*1.0e-3,0.0);
+
+    std::vector<Element> elements(num_triangles);
+    std::vector<cemDOUBLE> x1(num_triangles),y1(num_triangles),x2(num_triangles);
+    std::vector<cemDOUBLE> y2(num_triangles),x3(num_triangles),y3(num_triangles);
+    std::vector<Node*> node_ptrs(3);
+    for (cemINT j=0; j<num_cells; ++j)
+    {
+        for (cemINT i=0; i<num_cells; ++i)
+        {
+            cemINT n0 = j*(num_cells+1) + i;
+            cemINT corners[2][3] = {{n0, n0+1, n0+num_cells+2}, {n0, n0+num_cells+2, n0+num_cells+1}};
+            for (cemINT h=0; h<2; ++h)
+            {
+                cemINT t = 2*(j*num_cells + i) + h;
+                for (cemINT v=0; v<3; ++v)
+                    node_ptrs[v] = &nodes[corners[h][v]];
+                elements[t].set_node_ptrs(node_ptrs);
+                x1[t] = nodes[corners[h][0]][0]; y1[t] = nodes[corners[h][0]][1];
+                x2[t] = nodes[corners[h][1]][0]; y2[t] = nodes[corners[h][1]][1];
+                x3[t] = nodes[corners[h][2]][0]; y3[t] = nodes[corners[h][2]][1];
+            }
+        }
+    }
+
+    for (cemINT order=1; order<=3; ++order)
+    {
+        // One triangle at a time:
+        clock_t start = clock();
+        for (cemINT t=0; t<num_triangles; ++t)
+        {
+            cem_core::SolverTriangle solver_element(&elements[t],order,cem_core::SCALAR,cem_core::INTERPOLATORY,0);
+            solver_element.setUp_matrix_N_NxNx(false);
+            solver_element.setUp_matrix_N_NyNy(false);
+            solver_element.setUp_matrix_N_NN(false);
+        }
+        cemDOUBLE time_single = static_cast<cemDOUBLE>(clock() - start)/CLOCKS_PER_SEC;
+
+        // Batched:
+        cem_core::TriMatrixBatch batch(order,0);
+        std::vector<cemDOUBLE> K_x(batch.buffer_size(num_triangles));
+        std::vector<cemDOUBLE> K_y(batch.buffer_size(num_triangles));
+        std::vector<cemDOUBLE> M(batch.buffer_size(num_triangles));
+        start = clock();
+        batch.Compute(num_triangles,&x1[0],&y1[0],&x2[0],&y2[0],&x3[0],&y3[0],&K_x[0],&K_y[0],&M[0]);
+        cemDOUBLE time_batch = static_cast<cemDOUBLE>(clock() - start)/CLOCKS_PER_SEC;
+
+        // Arena:
+        start = clock();
+        cem_core::SolverTriangleArena arena(order,0);
+        arena.Reserve(num_triangles);
+        for (cemINT t=0; t<num_triangles; ++t)
+            arena.Add(&elements[t]);
+        cemDOUBLE time_arena = static_cast<cemDOUBLE>(clock() - start)/CLOCKS_PER_SEC;
+
+        std::cout << "Order " << order << ", " << num_triangles << " triangles: "
+                  << "SolverTriangle " << time_single << " s, "
+                  << "TriMatrixBatch " << time_batch << " s, "
+                  << "SolverTriangleArena " << time_arena << " s" << std::endl;
+    }
+
+    return 0;
+}
+
+
+int TestSparseAssemblyBenchmark()
+{
+    // Board-sized unstructured mesh of triangles (e.g. one copper layer):
+    cemINT nx = 600;
+    cemINT ny = 400;
+    for (cemINT order=1; order<=3; ++order)
+    {
+        cemINT n = (order+1)*(order+2)/2;
+        std::vector<cemINT> element_offsets,element_dofs;
+        cemINT num_dofs = CreateUnstructuredConnectivity(nx,ny,n,order,element_offsets,element_dofs);
+        cemINT num_triangles = static_cast<cemINT>(element_offsets.size()) - 1;
+
+        cemDOUBLE start = WallTime();
+        cem_core::SparseAssembler assembler;
+        assembler.SetUpPattern(num_dofs,element_offsets,element_dofs);
+        SparseMatrix<cemDOUBLE> K;
+        assembler.SetUpMatrix(K);
+        cemDOUBLE time_symbolic = WallTime() - start;
+
+        std::vector<SymmetricMatrix<cemDOUBLE> > local(num_triangles,SymmetricMatrix<cemDOUBLE>(n,n));
+        for (cemINT e=0; e<num_triangles; ++e)
+        {
+            for (cemINT j=0; j<n; ++j)
+                for (cemINT i=j; i<n; ++i)
+                    local[e](i,j) = 1.0/(1.0 + i + j);
+        }
+
+        const cemINT num_repetitions = 5;
+        cemDOUBLE time_mode[2];
+        for (cemINT mode=0; mode<2; ++mode)
+        {
+            // First call sizes the thread buffers:
+            assembler.Assemble(local,K,static_cast<cem_core::SparseAssembler::AssemblyMode>(mode));
+            start = WallTime();
+            for (cemINT r=0; r<num_repetitions; ++r)
+            {
+                K.initialize();
+                assembler.Assemble(local,K,static_cast<cem_core::SparseAssembler::AssemblyMode>(mode));
+            }
+            time_mode[mode] = (WallTime() - start)/num_repetitions;
+        }
+
+        std::cout << "Order " << order << ", " << num_triangles << " triangles, "
+                  << K.num_entries() << " entries, " << assembler.num_colors() << " colors: "
+                  << "symbolic " << time_symbolic << " s, "
+                  << "colored " << time_mode[0] << " s ("
+                  << num_triangles/time_mode[0]*1.0e-6 << " Melem/s), "
+                  << "reduction " << time_mode[1] << " s ("
+                  << num_triangles/time_mode[1]*1.0e-6 << " Melem/s)" << std::endl;
+    }
+
+    return 0;
+}
+
+
+int TestSparseSystemBenchmark()
+{
+    // Electro-thermal loop: same mesh, new conductivity on every iteration:
+    cemINT nx = 300;
+    cemINT ny = 200;
+    cemINT q = 1;
+    cemINT num_iterations = 5;
+    std::vector<Node> nodes;
+    std::vector<Element> elements;
+    CreateGridMesh(nx,ny,nodes,elements);
+    cemINT num_triangles = static_cast<cemINT>(elements.size());
+
+    for (cemINT order=1; order<=3; ++order)
+    {
+        cemINT n = (order+1)*(order+2)/2;
+        cemINT m = (q+1)*(q+2)/2;
+        std::vector<cemINT> element_offsets,element_dofs;
+        cemINT num_dofs = CreateGridConnectivity(nx,ny,n,element_offsets,element_dofs);
+
+        cemDOUBLE start = WallTime();
+        std::vector<cem_core::SolverTriangle> triangles;
+        triangles.reserve(num_triangles);
+        std::vector<cem_core::SolverElement*> solver_elements(num_triangles);
+        for (cemINT t=0; t<num_triangles; ++t)
+        {
+            triangles.push_back(cem_core::SolverTriangle(&elements[t],order,cem_core::SCALAR,cem_core::INTERPOLATORY,q));
+            solver_elements[t] = &triangles[t];
+        }
+
+        cem_core::SparseSystem system;
+        system.SetUp(num_dofs,solver_elements,element_offsets,element_dofs);
+        std::cout << "Order " << order << ", " << num_triangles << " triangles, "
+                  << system.matrix().num_entries() << " entries:";
+
+        std::vector<cemDOUBLE> sigma(m*num_triangles);
+        for (cemINT iteration=0; iteration<num_iterations; ++iteration)
+        {
+            for (cemINT k=0; k<m*num_triangles; ++k)
+                sigma[k] = 5.8e7/(1.0 + 3.9e-3*(10.0*iteration + k%7));
+
+            system.Assemble(sigma,std::vector<cemDOUBLE>());
+            cemDOUBLE time_iteration = WallTime() - start;
+            std::cout << " " << time_iteration << " s";
+            start = WallTime();
+        }
+        std::cout << std::endl;
+    }
 
     return 0;
 }
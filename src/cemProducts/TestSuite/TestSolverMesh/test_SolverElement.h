@@ -2,12 +2,25 @@
 #define TESTSOLVERELEMENT_H
 #include "gtest/gtest.h"
 #include "cemMesh.h"
+#include "Quadrature/Quadrature.h"
 #include "SolverMesh/SolverElement.h"
+#include "SolverMesh/TriReferenceTensors.h"
+#include "SolverMesh/TriTabulation.h"
+#include "SolverMesh/TriMatrixBatch.h"
+#include "SolverMesh/SolverTriangleArena.h"
+#include "SolverMesh/TriKernels.h"
+#include "SolverMesh/TriMatrixFreeOperator.h"
+#include "SolverMesh/SparseAssembler.h"
+#include "SolverMesh/SparseSystem.h"
+#include "Solvers/SolverTimer.h"
 
 using namespace cem_mesh;
 
 
 int TestSolverElementBasics();
+int TestSolverElementBatchBenchmark();
+int TestSparseAssemblyBenchmark();
+int TestSparseSystemBenchmark();
 
 void CreateSingleElement(Element& elem);
 